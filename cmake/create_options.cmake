@@ -16,7 +16,7 @@ option (ENABLE_STATIC_DAQ "Link static DAQ modules" ON)
 option (ENABLE_VALGRIND "Only use if you are testing with valgrind" OFF)
 option (ENABLE_PPM "Disable packet/rule performance monitor" OFF)
 option (ENABLE_PPM_TEST "Enable packet/rule performance monitor for readback" OFF)
-option (ENABLE_PERFPROFILING "Disable preprocessor and rule performance profiling" OFF)
+option (ENABLE_PERFPROFILING "Disable preprocessor and rule performance profiling" ON)
 option (ENABLE_LINUX_SMP_STATS "Enable statistics reporting through proc" OFF)
 option (ENABLE_PTHREAD "Disable pthread support" ON)
 option (ENABLE_DEBUG_MSGS "Enable debug printing options (bugreports and developers only)" OFF)
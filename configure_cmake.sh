@@ -32,7 +32,7 @@ Optional Features:
     --enable-valgrind        Only use if you are testing with valgrind.
     --enable-ppm            Enable packet/rule performance monitor
     --enable-ppm-test        Enable packet/rule performance monitor for readback
-    --enable-perf-profiling  Enable preprocessor and rule performance profiling
+    --disable-perf-profiling Disable preprocessor and rule performance profiling
     --enable-linux-smp-stats Enable statistics reporting through proc
     --enable-debug-msgs      Enable debug printing options (bugreports and developers only)
     --enable-debug           Enable debugging options (bugreports and developers only)
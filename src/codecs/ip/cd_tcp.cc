@@ -132,6 +132,13 @@ private:
 };
 
 static sfip_var_t* SynToMulticastDstIp = NULL;
+
+// the daq flag only applies to the wire packet's (outermost) tcp header
+static inline bool hw_verified(const RawData& raw, const CodecData& codec)
+{
+    return (raw.pkth->flags & DAQ_PKT_FLAG_HW_TCP_CS_GOOD) and
+        codec.ip_layer_cnt == 1;
+}
 } // namespace
 
 void TcpCodec::get_protocol_ids(std::vector<uint16_t>& v)
@@ -166,7 +173,8 @@ bool TcpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
     /* Checksum code moved in front of the other decoder alerts.
        If it's a bad checksum (maybe due to encrypted ESP traffic), the other
        alerts could be false positives. */
-    if ( SnortConfig::tcp_checksums() )
+    if ( SnortConfig::tcp_checksums() and !codec.is_cooked() and
+        !hw_verified(raw, codec) )
     {
         uint16_t csum;
         PegCount* bad_cksum_cnt;
@@ -203,7 +211,7 @@ bool TcpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& snort)
             csum = checksum::tcp_cksum((uint16_t*)(tcph), raw.len, &ph6);
         }
 
-        if (csum && !codec.is_cooked())
+        if (csum)
         {
             if ( !(codec.codec_flags & CODEC_UNSURE_ENCAP) )
             {
@@ -789,3 +797,7 @@ static const CodecApi tcp_api =
 
 const BaseApi* cd_tcp = &tcp_api.base;
 
+#ifdef UNIT_TEST
+// FIXIT-L see sfip/sf_ip.cc
+#include "checksum_test.cc"
+#endif
@@ -22,8 +22,15 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cstddef>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace checksum
 {
 struct Pseudoheader6
@@ -54,6 +61,14 @@ inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len, const Pseudohea
 inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len);
 inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len);
 
+//  update a checksum for a change to the data it covers (RFC 1624) instead
+//  of computing it again.  cksum and the data are as read from the packet.
+//  buffers must start on an even offset of the covered data and len must
+//  be even.
+inline uint16_t cksum_update(uint16_t cksum, uint16_t old_word, uint16_t new_word);
+inline uint16_t cksum_update(
+    uint16_t cksum, const void* old_buf, const void* new_buf, std::size_t len);
+
 /*
  *  NOTE: Since multiple dynamic libraries use checksums, the choice
  *          is to either include all of the checksum details in a header,
@@ -87,84 +102,122 @@ struct Psuedoheader6Union
     };
 };
 
-static inline uint16_t cksum_add(const uint16_t* buf, std::size_t len, uint32_t cksum)
+// the sum is accumulated in native byte order 64 bits at a time (or 128 /
+// 256 bits at a time with SSE2 / AVX2 for payloads) and folded to 16 bits
+// at the end.  this gives the same result as summing 16 bit words since
+// 2^16 == 1 in one's complement arithmetic (RFC 1071).
+static inline void sum_words(const uint8_t*& sp, std::size_t& len, uint64_t& sum)
 {
-    const uint16_t* sp = buf;
-    std::size_t n, sn;
+#if defined(__AVX2__)
+    // each 32 bit lane takes 4 words per 64 bytes so it can't overflow
+    // within a block (and a block covers any IP datagram)
+    const std::size_t max_block = 1 << 16;
 
-    if (len > 1 )
+    while ( len >= 256 )
     {
-        sn = ((len / 2) & 0xF);  // == len/2 % 16
-        n = (((len / 2) + 15) / 16);   // ceiling of (len / 2) / 16
+        std::size_t n = (len < max_block ? len : max_block) / 64;
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc = zero;
+        len -= n * 64;
 
-        switch (sn)
+        while ( n-- )
         {
-        case 0:
-            sn = 16;
-            cksum += sp[15];
-        case 15:
-            cksum += sp[14];
-        case 14:
-            cksum += sp[13];
-        case 13:
-            cksum += sp[12];
-        case 12:
-            cksum += sp[11];
-        case 11:
-            cksum += sp[10];
-        case 10:
-            cksum += sp[9];
-        case 9:
-            cksum += sp[8];
-        case 8:
-            cksum  += sp[7];
-        case 7:
-            cksum += sp[6];
-        case 6:
-            cksum += sp[5];
-        case 5:
-            cksum += sp[4];
-        case 4:
-            cksum += sp[3];
-        case 3:
-            cksum += sp[2];
-        case 2:
-            cksum += sp[1];
-        case 1:
-            cksum += sp[0];
+            __m256i a = _mm256_loadu_si256((const __m256i*)sp);
+            __m256i b = _mm256_loadu_si256((const __m256i*)(sp + 32));
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(a, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(a, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(b, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(b, zero));
+            sp += 64;
         }
-        sp += sn;
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+
+        for ( auto l : lanes )
+            sum += l;
+    }
+#elif defined(__SSE2__)
+    // each 32 bit lane takes 4 words per 32 bytes so it can't overflow
+    // within a block (and a block covers any IP datagram)
+    const std::size_t max_block = 1 << 16;
 
-        /* XXX - unroll loop using Duff's device. */
-        while (--n > 0)
+    while ( len >= 256 )
+    {
+        std::size_t n = (len < max_block ? len : max_block) / 32;
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        len -= n * 32;
+
+        while ( n-- )
         {
-            cksum += sp[0];
-            cksum += sp[1];
-            cksum += sp[2];
-            cksum += sp[3];
-            cksum += sp[4];
-            cksum += sp[5];
-            cksum += sp[6];
-            cksum += sp[7];
-            cksum += sp[8];
-            cksum += sp[9];
-            cksum += sp[10];
-            cksum += sp[11];
-            cksum += sp[12];
-            cksum += sp[13];
-            cksum += sp[14];
-            cksum += sp[15];
-            sp += 16;
+            __m128i a = _mm_loadu_si128((const __m128i*)sp);
+            __m128i b = _mm_loadu_si128((const __m128i*)(sp + 16));
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(a, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(a, zero));
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(b, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(b, zero));
+            sp += 32;
         }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+
+        for ( auto l : lanes )
+            sum += l;
+    }
+#endif
+    // headers and the tail, with an end around carry
+    while ( len >= 8 )
+    {
+        uint64_t w;
+        memcpy(&w, sp, sizeof(w));
+        sum += w;
+        sum += (sum < w);
+        sp += 8;
+        len -= 8;
+    }
+    if ( len >= 4 )
+    {
+        uint32_t w;
+        memcpy(&w, sp, sizeof(w));
+        sum += w;
+        sum += (sum < w);
+        sp += 4;
+        len -= 4;
+    }
+    if ( len >= 2 )
+    {
+        uint16_t w;
+        memcpy(&w, sp, sizeof(w));
+        sum += w;
+        sum += (sum < w);
+        sp += 2;
+        len -= 2;
     }
+}
 
-    if (len & 1)
-        cksum += (*(unsigned char*)sp);
+static inline uint16_t fold(uint64_t sum)
+{
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    return (uint16_t)sum;
+}
 
-    cksum  = (cksum >> 16) + (cksum & 0x0000ffff);
-    cksum += (cksum >> 16);
+static inline uint16_t cksum_add(const uint16_t* buf, std::size_t len, uint32_t cksum)
+{
+    const uint8_t* sp = reinterpret_cast<const uint8_t*>(buf);
+    uint64_t sum = cksum;
+
+    sum_words(sp, len, sum);
 
-    return (uint16_t)(~cksum);
+    if (len & 1)
+    {
+        sum += *sp;
+        sum += (sum < *sp);
+    }
+
+    return (uint16_t)(~fold(sum));
 }
 
 static inline void add_ipv4_pseudoheader(const Pseudoheader* const ph4,
@@ -338,6 +391,34 @@ inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len)
     return detail::cksum_add(buf, len, cksum);
 }
 
+// HC' = ~(~HC + ~m + m')
+inline uint16_t cksum_update(uint16_t cksum, uint16_t old_word, uint16_t new_word)
+{
+    uint64_t sum = (uint16_t)~cksum;
+    sum += (uint16_t)~old_word;
+    sum += new_word;
+    return (uint16_t)~detail::fold(sum);
+}
+
+inline uint16_t cksum_update(
+    uint16_t cksum, const void* old_buf, const void* new_buf, std::size_t len)
+{
+    const uint8_t* a = static_cast<const uint8_t*>(old_buf);
+    const uint8_t* b = static_cast<const uint8_t*>(new_buf);
+    uint64_t sum = (uint16_t)~cksum;
+
+    for ( std::size_t i = 0; i + 1 < len; i += 2 )
+    {
+        uint16_t m, n;
+        memcpy(&m, a + i, sizeof(m));
+        memcpy(&n, b + i, sizeof(n));
+
+        if ( m != n )
+            sum += (uint16_t)~m + (uint32_t)n;
+    }
+    return (uint16_t)~detail::fold(sum);
+}
+
 static inline uint16_t cksum_add(const uint16_t* buf, std::size_t len)
 { return detail::cksum_add(buf, len, 0); }
 } // namespace checksum
@@ -0,0 +1,162 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// checksum_test.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catch/catch.hpp"
+
+#include "checksum.h"
+
+//---------------------------------------------------------------
+
+// the 16 bit loop that cksum_add() replaced
+static uint16_t ref_cksum(const uint8_t* p, size_t len)
+{
+    uint64_t sum = 0;
+
+    while ( len > 1 )
+    {
+        uint16_t w;
+        memcpy(&w, p, sizeof(w));
+        sum += w;
+        p += 2;
+        len -= 2;
+    }
+    if ( len )
+        sum += *p;
+
+    while ( sum >> 16 )
+        sum = (sum >> 16) + (sum & 0xffff);
+
+    return (uint16_t)~sum;
+}
+
+static uint16_t cksum(const uint8_t* p, size_t len)
+{ return checksum::cksum_add((const uint16_t*)p, len); }
+
+// covers the word tail and more than one simd block
+#define MAX_LEN 1100
+#define MAX_ALIGN 32
+
+static uint8_t data[MAX_LEN + MAX_ALIGN];
+
+static void fill(uint8_t b)
+{
+    if ( b )
+        memset(data, b, sizeof(data));
+    else
+    {
+        srand(1);
+
+        for ( auto& d : data )
+            d = rand();
+    }
+}
+
+static bool check_all()
+{
+    for ( unsigned a = 0; a < MAX_ALIGN; ++a )
+    {
+        for ( unsigned n = 0; n <= MAX_LEN; ++n )
+        {
+            if ( cksum(data + a, n) != ref_cksum(data + a, n) )
+                return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("cksum_add random", "[checksum]")
+{
+    fill(0);
+    CHECK(check_all());
+}
+
+TEST_CASE("cksum_add ones", "[checksum]")
+{
+    // every word is 0xffff so each add carries
+    fill(0xff);
+    CHECK(check_all());
+}
+
+TEST_CASE("cksum_add large", "[checksum]")
+{
+    // more than one 64K simd block
+    const size_t len = (1 << 17) + 3;
+    uint8_t* buf = new uint8_t[len + 1];
+    memset(buf, 0xff, len + 1);
+
+    CHECK(cksum(buf, len) == ref_cksum(buf, len));
+    CHECK(cksum(buf + 1, len) == ref_cksum(buf + 1, len));
+
+    delete[] buf;
+}
+
+TEST_CASE("cksum_update word", "[checksum]")
+{
+    fill(0);
+
+    for ( unsigned i = 0; i < 40; i += 2 )
+    {
+        uint8_t pkt[40];
+        memcpy(pkt, data + i, sizeof(pkt));
+        uint16_t sum = cksum(pkt, sizeof(pkt));
+
+        uint16_t m, n = 0x1234 + i;
+        memcpy(&m, pkt + i, sizeof(m));
+        memcpy(pkt + i, &n, sizeof(n));
+
+        CHECK(checksum::cksum_update(sum, m, n) == cksum(pkt, sizeof(pkt)));
+    }
+}
+
+TEST_CASE("cksum_update buffer", "[checksum]")
+{
+    fill(0);
+
+    for ( unsigned off = 0; off < 20; off += 2 )
+    {
+        for ( unsigned len = 2; off + len <= 40; len += 2 )
+        {
+            uint8_t pkt[40], old[40];
+            memcpy(pkt, data, sizeof(pkt));
+            uint16_t sum = cksum(pkt, sizeof(pkt));
+
+            // nop out an option-like span
+            memcpy(old, pkt + off, len);
+            memset(pkt + off, 1, len);
+
+            CHECK(checksum::cksum_update(sum, old, pkt + off, len) ==
+                cksum(pkt, sizeof(pkt)));
+        }
+    }
+}
+
+TEST_CASE("cksum_update unchanged", "[checksum]")
+{
+    fill(0);
+    uint16_t sum = cksum(data, 20);
+    CHECK(checksum::cksum_update(sum, data, data, 20) == sum);
+}
@@ -53,6 +53,7 @@
 #include "events/event_wrapper.h"
 #include "events/event_queue.h"
 #include "log/obfuscation.h"
+#include "time/latency.h"
 #include "time/profiler.h"
 #include "time/ppm.h"
 #include "stream/stream_api.h"
@@ -148,13 +149,17 @@ void snort_inspect(Packet* p)
         inspected = true;
 
         if ( do_detect )
+        {
             snort_detect(p);
+            Latency::lap(LS_DETECT);
+        }
     }
 
     check_tags_flag = 1;
 
     /* Check for normally closed session */
     stream.check_session_closed(p);
+    Latency::lap(LS_STREAM);
 
     /*
     ** By checking tagging here, we make sure that we log the
@@ -197,6 +202,7 @@ void snort_inspect(Packet* p)
     PERF_PROFILE(eventqPerfStats);
     SnortEventqLog(p);
     SnortEventqReset();
+    Latency::lap(LS_LOG);
 }
 
 void snort_log(Packet* p)
@@ -446,6 +446,14 @@ int detection_option_node_evaluate(
     }
     else if (node->option_type == RULE_OPTION_TYPE_PCRE)
     {
+#ifdef PPM_MGR
+        if ( PPM_LOAD_LEVEL() >= PPM_LOAD_NO_PCRE )
+        {
+            ppm_stats.load_pcre_skips++;
+            state->last_check.result = result;
+            return result;
+        }
+#endif
         IpsOption* opt = (IpsOption*)node->option_data;
         try_again = opt->retry();
     }
@@ -513,7 +521,7 @@ int detection_option_node_evaluate(
                 if ( f_result )
                 {
 #ifdef PERF_PROFILING
-                    if (PROFILING_RULES)
+                    if (PROFILING_RULES && profile_sampled)
                         otn->state[get_instance_id()].matches++;
 #endif
                     if ( !eval_data->flowbit_noalert )
@@ -746,7 +754,7 @@ int detection_option_node_evaluate(
 #ifdef PERF_PROFILING
         // We're essentially checking this node again and it potentially
         // might match again
-        if ( continue_loop && PROFILING_RULES )
+        if ( continue_loop && PROFILING_RULES && profile_sampled )
             state->checks++;
 #endif
 
@@ -792,11 +800,11 @@ typedef struct node_profile_stats
 
 static void detection_option_node_update_otn_stats(
     detection_option_tree_node_t* node,
-    node_profile_stats_t* stats, uint64_t checks
+    node_profile_stats_t* stats, uint64_t checks,
 #ifdef PPM_MGR
-    , uint64_t disables
+    uint64_t disables,
 #endif
-    )
+    OtnStatsMap* sums)
 {
     int i;
     node_profile_stats_t local_stats; /* cumulative stats for this node */
@@ -840,7 +848,7 @@ static void detection_option_node_update_otn_stats(
         /* Update stats for this otn */
         // FIXIT-M should be sum of instances (only called from main thread)
         OptTreeNode* otn = (OptTreeNode*)node->option_data;
-        OtnState* state = otn->state + get_instance_id();
+        OtnState* state = sums ? &(*sums)[otn] : otn->state + get_instance_id();
         state->ticks += local_stats.ticks;
         state->ticks_match += local_stats.ticks_match;
         state->ticks_no_match += local_stats.ticks_no_match;
@@ -856,16 +864,16 @@ static void detection_option_node_update_otn_stats(
         for (i=0; i<node->num_children; i++)
         {
             detection_option_node_update_otn_stats(
-                node->children[i], &local_stats, checks
+                node->children[i], &local_stats, checks,
 #ifdef PPM_MGR
-                , disables
+                disables,
 #endif
-                );
+                sums);
         }
     }
 }
 
-void detection_option_tree_update_otn_stats(SFXHASH* doth)
+static void detection_option_tree_update_otn_stats(SFXHASH* doth, OtnStatsMap* sums)
 {
     if (doth == NULL)
         return;
@@ -894,16 +902,44 @@ void detection_option_tree_update_otn_stats(SFXHASH* doth)
         if ( checks )
         {
             detection_option_node_update_otn_stats(
-                node, NULL, checks
+                node, NULL, checks,
 #ifdef PPM_MGR
-                , disables
+                disables,
 #endif
-                );
+                sums);
         }
         hashnode = sfxhash_findnext(doth);
     }
 }
 
+void detection_option_tree_update_otn_stats(SFXHASH* doth)
+{ detection_option_tree_update_otn_stats(doth, nullptr); }
+
+void detection_option_tree_sum_otn_stats(SFXHASH* doth, OtnStatsMap& sums)
+{ detection_option_tree_update_otn_stats(doth, &sums); }
+
+static void detection_option_node_reset_stats(detection_option_tree_node_t* node)
+{
+    for ( unsigned i = 0; i < get_instance_max(); ++i )
+    {
+        dot_node_state_t& state = node->state[i];
+        state.ticks = state.ticks_match = state.ticks_no_match = 0;
+        state.checks = state.disables = 0;
+    }
+
+    for ( int i = 0; i < node->num_children; ++i )
+        detection_option_node_reset_stats(node->children[i]);
+}
+
+void detection_option_tree_reset_stats(SFXHASH* doth)
+{
+    if ( !doth )
+        return;
+
+    for ( SFXHASH_NODE* h = sfxhash_findfirst(doth); h; h = sfxhash_findnext(doth) )
+        detection_option_node_reset_stats((detection_option_tree_node_t*)h->data);
+}
+
 #endif
 
 detection_option_tree_root_t* new_root()
@@ -36,11 +36,15 @@
 #endif
 
 #include <sys/time.h>
+#include <unordered_map>
+
 #include "main/snort_types.h"
 #include "detection/rule_option_types.h"
 
 struct Packet;
 struct SFXHASH;
+struct OptTreeNode;
+struct OtnState;
 
 typedef int (* eval_func_t)(void* option_data, class Cursor&, Packet*);
 
@@ -139,7 +143,15 @@ void DetectionTreeHashTableFree(SFXHASH*);
 void print_option_tree(detection_option_tree_node_t* node, int level);
 #endif
 #ifdef PERF_PROFILING
+typedef std::unordered_map<OptTreeNode*, OtnState> OtnStatsMap;
+
 void detection_option_tree_update_otn_stats(SFXHASH*);
+
+// like update but leaves the otns alone so it can be called repeatedly
+void detection_option_tree_sum_otn_stats(SFXHASH*, OtnStatsMap&);
+
+// clears the profile of every node for all packet threads
+void detection_option_tree_reset_stats(SFXHASH*);
 #endif
 
 detection_option_tree_root_t* new_root();
@@ -1015,6 +1015,14 @@ static inline int fpEvalHeaderSW(PortGroup* port_group, Packet* p,
         //if ( p->is_data() )
         //    break;
 
+#ifdef PPM_MGR
+        // shedding load; skip the nfp rules but still restore the ip
+        // layer below
+        if ( port_group->nfp_rule_count and PPM_LOAD_LEVEL() >= PPM_LOAD_FAST_PATTERN )
+            ppm_stats.load_nfp_skips += port_group->nfp_rule_count;
+
+        else
+#endif
         if (port_group->nfp_rule_count)
         {
             // walk and test the nfp OTNs
@@ -39,13 +39,15 @@
 #include "hash/sfxhash.h"
 #include "sfip/sfip_t.h"
 #include "sfip/sf_ip.h"
+#include "flow/flow.h"
+#include "utils/stats.h"
 
 /*  D E F I N E S  **************************************************/
 #define MAX_TAG_NODES   256
 
 /* by default we'll set a 5 minute timeout if we see no activity
- * on a tag with a 'count' metric so that we prune dead sessions
- * periodically since we're not doing TCP state tracking
+ * on a host tag with a 'count' metric so that we prune dead hosts
+ * periodically.  session tags go away with their flow.
  */
 #define TAG_PRUNE_QUANTUM   300
 #define TAG_MEMCAP          4194304  /* 4MB */
@@ -54,24 +56,12 @@
 #define TAG_LOG_PKT         1
 
 /*  D A T A   S T R U C T U R E S  **********************************/
-/**Key used for identifying a session or host.
- */
-struct tTagFlowKey
-{
-    sfip_t sip;  ///source IP address
-    sfip_t dip;  ///destination IP address
-
-    /* ports */
-    uint16_t sp; ///source port
-    uint16_t dp; ///destination port
-};
-
 /**Node identifying a session or host based tagging.
  */
 struct TagNode
 {
-    /**key identifying a session or host. */
-    tTagFlowKey key;
+    /**tagged host; the key for host tags, unused for session tags */
+    sfip_t host;
 
     /** number of packets/seconds/bytes to tag for */
     int seconds;
@@ -98,14 +88,32 @@ struct TagNode
     void* log_list;  // retain custom logging if any from triggering alert
 };
 
+/**Session tags live on the tagged flow and are released with it.
+ */
+class TagFlowData : public FlowData
+{
+public:
+    TagFlowData();
+    ~TagFlowData();
+
+    static void init()
+    { flow_id = FlowData::get_flow_id(); }
+
+public:
+    static unsigned flow_id;
+    TagNode node;
+};
+
+unsigned TagFlowData::flow_id = 0;
+
 /*  G L O B A L S  **************************************************/
 static THREAD_LOCAL SFXHASH* host_tag_cache_ptr = nullptr;
 
-// FIXIT-M utilize Flow instead of separate cache
-static THREAD_LOCAL SFXHASH* ssn_tag_cache_ptr = nullptr;
+// session tags are found via the flow; this only counts them so packets
+// can skip the flow data search when no session is tagged
+static THREAD_LOCAL unsigned ssn_tag_count = 0;
 
 static THREAD_LOCAL uint32_t last_prune_time = 0;
-static THREAD_LOCAL uint32_t tag_alloc_faults = 0;
 static THREAD_LOCAL uint32_t tag_memory_usage = 0;
 
 static THREAD_LOCAL bool s_exclusive = false;
@@ -117,66 +125,42 @@ static THREAD_LOCAL unsigned s_sessions = 0;
 static const unsigned s_max_sessions = 1;
 
 /*  P R O T O T Y P E S  ********************************************/
-static TagNode* TagAlloc(SFXHASH*);
-static void TagFree(SFXHASH*, TagNode*);
-static int TagFreeSessionNodeFunc(void* key, void* data);
+static bool TagReserve(unsigned);
+static void TagRelease(TagNode*, unsigned);
 static int TagFreeHostNodeFunc(void* key, void* data);
 static int PruneTagCache(uint32_t, int);
 static int PruneTime(SFXHASH* tree, uint32_t thetime);
 static void TagSession(Packet*, TagData*, uint32_t, uint16_t, void*);
 static void TagHost(Packet*, TagData*, uint32_t, uint16_t, void*);
 static void AddTagNode(Packet*, TagData*, int, uint32_t, uint16_t, void*);
-static inline void SwapTag(TagNode*);
 
-/**Calculated memory needed per node insertion into respective cache. Its includes
- * memory needed for allocating TagNode, SFXHASH_NODE, and key size.
- *
- * @param hash - pointer to SFXHASH that should point to either ssn_tag_cache_ptr
- * or host_tag_cache_ptr.
- *
- * @returns number of bytes needed
+/**Memory needed per host tag, including the hash node and key.
  */
-static inline unsigned int memory_per_node(
-    SFXHASH* hash
-    )
-{
-    if (hash == ssn_tag_cache_ptr)
-    {
-        return sizeof(tTagFlowKey)+sizeof(SFXHASH_NODE)+sizeof(TagNode);
-    }
-    else if (hash == host_tag_cache_ptr)
-    {
-        return sizeof(sfip_t)+sizeof(SFXHASH_NODE)+sizeof(TagNode);
-    }
+static const unsigned host_tag_size =
+    sizeof(sfip_t) + sizeof(SFXHASH_NODE) + sizeof(TagNode);
 
-    return 0;
-}
+static const unsigned ssn_tag_size = sizeof(TagFlowData);
 
-/** Allocate a TagNode
+/** Account for a new tag
  *
- * Alocates a TagNode while guaranteeing that total memory usage remains within TAG_MEMCAP.
- * Least used nodes may be deleted from ssn_tag_cache and host_tag_cache to make space if
- * the limit is being exceeded.
+ * Guarantees that total memory usage remains within TAG_MEMCAP.  Least used
+ * host tags may be deleted to make space if the limit is being exceeded;
+ * session tags are only released with their flows.
  *
- * @param hash - pointer to SFXHASH that should point to either ssn_tag_cache_ptr
- * or host_tag_cache_ptr.
+ * @param size - bytes needed for the new tag
  *
- * @returns a pointer to new TagNode or NULL if memory couldn't * be allocated
+ * @returns true if the tag fits
  */
-static TagNode* TagAlloc(
-    SFXHASH* hash
-    )
+static bool TagReserve(unsigned size)
 {
-    TagNode* tag_node = NULL;
-
-    if (tag_memory_usage + memory_per_node(hash) > TAG_MEMCAP)
+    if (tag_memory_usage + size > TAG_MEMCAP)
     {
         /* aggressively prune */
         struct timeval tv;
         struct timezone tz;
         int pruned_nodes = 0;
 
-        tag_alloc_faults++;
+        pc.tag_faults++;
 
         gettimeofday(&tv, &tz);
 
@@ -190,101 +174,75 @@ static TagNode* TagAlloc(
 
             /* unlikely to happen since memcap has been reached */
             if (pruned_nodes == 0)
-                return NULL;
+                return false;
         }
     }
 
-    tag_node = (TagNode*)calloc(1, sizeof(TagNode));
+    tag_memory_usage += size;
 
-    if (tag_node != NULL)
-        tag_memory_usage += memory_per_node(hash);
+    if ( tag_memory_usage > pc.tag_memory )
+        pc.tag_memory = tag_memory_usage;
 
-    return tag_node;
+    return true;
 }
 
-/**Frees allocated TagNode.
+/**Release the accounting for a tag.
  *
- * @param hash - pointer to SFXHASH that should point to either ssn_tag_cache_ptr
- * or host_tag_cache_ptr.
- * @param node - pointer to node to be freed
+ * @param node - tag being released
+ * @param size - bytes accounted by TagReserve()
  */
-static void TagFree(
-    SFXHASH* hash,
-    TagNode* node
-    )
+static void TagRelease(TagNode* node, unsigned size)
 {
-    if (node == NULL)
-        return;
-
     if ( node->metric & TAG_METRIC_SESSION )
         s_exclusive = false;
 
-    free((void*)node);
-    tag_memory_usage -= memory_per_node(hash);
+    tag_memory_usage -= size;
 }
 
-/**Callback from session tag cache to free user data.
- * @param key - pointer to key to session tag
- * @param data - pointer to user data, to be freed.
- * @returns 0
- */
-static int TagFreeSessionNodeFunc(void*, void* data)
+TagFlowData::TagFlowData() : FlowData(flow_id)
 {
-    TagFree(ssn_tag_cache_ptr, (TagNode*)data);
-    return 0;
+    memset(&node, 0, sizeof(node));
+    ++ssn_tag_count;
+}
+
+TagFlowData::~TagFlowData()
+{
+    TagRelease(&node, ssn_tag_size);
+    --ssn_tag_count;
 }
 
 /**Callback from host tag cache to free user data.
- * @param key - pointer to key to session tag
+ * @param key - pointer to key to host tag
  * @param data - pointer to user data, to be freed.
  * @returns 0
  */
 static int TagFreeHostNodeFunc(void*, void* data)
 {
-    TagFree(host_tag_cache_ptr, (TagNode*)data);
+    TagNode* node = (TagNode*)data;
+
+    if ( node )
+    {
+        TagRelease(node, host_tag_size);
+        free(node);
+    }
     return 0;
 }
 
-/**Reset all data structures and free all memory.
+/**Reset all host tags.  Session tags are reset with their flows.
  */
 void TagCacheReset(void)
 {
-    sfxhash_make_empty(ssn_tag_cache_ptr);
     sfxhash_make_empty(host_tag_cache_ptr);
 }
 
-/**
- * swap the sips and dips, dp's and sp's
- *
- * @param np TagNode ptr
- */
-static inline void SwapTag(TagNode* np)
+void InitTagFlows(void)
 {
-    sfip_t tip;
-    uint16_t tport;
-
-    tip = np->key.sip;
-    np->key.sip = np->key.dip;
-    np->key.dip = tip;
-
-    tport = np->key.sp;
-    np->key.sp = np->key.dp;
-    np->key.dp = tport;
+    TagFlowData::init();
 }
 
 void InitTag(void)
 {
-    unsigned int hashTableSize = TAG_MEMCAP/sizeof(TagNode);
-
-    ssn_tag_cache_ptr = sfxhash_new(
-        hashTableSize,                      /* number of hash buckets */
-        sizeof(tTagFlowKey),             /* size of the key we're going to use */
-        0,                                  /* size of the storage node */
-        0,                                  /* disable memcap*/
-        0,                                  /* use auto node recovery */
-        NULL,                               /* anr free function */
-        TagFreeSessionNodeFunc,             /* user free function */
-        0);                                 /* recycle node flag */
+    unsigned int hashTableSize = TAG_MEMCAP/host_tag_size;
 
     host_tag_cache_ptr = sfxhash_new(
         hashTableSize,               /* number of hash buckets */
@@ -299,14 +257,10 @@ void InitTag(void)
 
 void CleanupTag(void)
 {
-    if (ssn_tag_cache_ptr)
-    {
-        sfxhash_delete(ssn_tag_cache_ptr);
-    }
-
     if (host_tag_cache_ptr)
     {
         sfxhash_delete(host_tag_cache_ptr);
+        host_tag_cache_ptr = nullptr;
     }
 }
 
@@ -342,12 +296,17 @@ static void TagHost(Packet* p, TagData* tag, uint32_t time, uint16_t event_id, v
 static void AddTagNode(Packet* p, TagData* tag, int mode, uint32_t now,
     uint16_t event_id, void* log_list)
 {
-    TagNode* idx;  /* index pointer */
-    TagNode* returned;
-    SFXHASH* tag_cache_ptr = NULL;
+    TagNode idx;  /* index pointer */
+    TagNode* returned = NULL;
 
     DebugMessage(DEBUG_FLOW, "Adding new Tag Head\n");
 
+    if ( mode == TAG_SESSION and !p->flow )
+    {
+        DebugMessage(DEBUG_FLOW, "No flow to tag\n");
+        return;
+    }
+
     if ( tag->tag_metric & TAG_METRIC_SESSION )
     {
         if ( s_exclusive )
@@ -359,112 +318,129 @@ static void AddTagNode(Packet* p, TagData* tag, int mode, uint32_t now,
         s_exclusive = true;
         ++s_sessions;
     }
-    if (mode == TAG_SESSION)
-    {
-        DebugMessage(DEBUG_FLOW,"Session Tag!\n");
-        tag_cache_ptr = ssn_tag_cache_ptr;
-    }
-    else
-    {
-        DebugMessage(DEBUG_FLOW,"Host Tag!\n");
-        tag_cache_ptr = host_tag_cache_ptr;
-    }
-    idx = TagAlloc(tag_cache_ptr);
 
-    /* If a TagNode couldn't be allocated, just write an error message
-     * and return - won't be able to track this one. */
-    if (idx == NULL)
-    {
-        ErrorMessage("AddTagNode(): Unable to allocate %u bytes of memory for new TagNode\n",
-            (unsigned)sizeof(TagNode));
-        return;
-    }
+    memset(&idx, 0, sizeof(idx));
 
-    sfip_copy(idx->key.sip, p->ptrs.ip_api.get_src());
-    sfip_copy(idx->key.dip, p->ptrs.ip_api.get_dst());
-    idx->key.sp = p->ptrs.sp;
-    idx->key.dp = p->ptrs.dp;
-    idx->metric = tag->tag_metric;
-    idx->last_access = now;
-    idx->event_id = event_id;
-    idx->event_time.tv_sec = p->pkth->ts.tv_sec;
-    idx->event_time.tv_usec = p->pkth->ts.tv_usec;
-    idx->mode = mode;
-    idx->pkt_count = 0;
-    idx->log_list = log_list;
-
-    if (idx->metric & TAG_METRIC_SECONDS)
+    /* if we're supposed to be tagging the other side, swap it
+       around -- Lawrence Reed */
+    if (mode == TAG_HOST_DST)
+        sfip_copy(idx.host, p->ptrs.ip_api.get_dst());
+    else
+        sfip_copy(idx.host, p->ptrs.ip_api.get_src());
+
+    idx.metric = tag->tag_metric;
+    idx.last_access = now;
+    idx.event_id = event_id;
+    idx.event_time.tv_sec = p->pkth->ts.tv_sec;
+    idx.event_time.tv_usec = p->pkth->ts.tv_usec;
+    idx.mode = mode;
+    idx.pkt_count = 0;
+    idx.log_list = log_list;
+
+    if (idx.metric & TAG_METRIC_SECONDS)
     {
         /* set the expiration time for this tag */
-        idx->seconds = now + tag->tag_seconds;
+        idx.seconds = now + tag->tag_seconds;
     }
 
-    if (idx->metric & TAG_METRIC_BYTES)
+    if (idx.metric & TAG_METRIC_BYTES)
     {
         /* set the expiration time for this tag */
-        idx->bytes = tag->tag_bytes;
+        idx.bytes = tag->tag_bytes;
     }
 
-    if (idx->metric & TAG_METRIC_PACKETS)
+    if (idx.metric & TAG_METRIC_PACKETS)
     {
         /* set the expiration time for this tag */
-        idx->packets = tag->tag_packets;
+        idx.packets = tag->tag_packets;
     }
 
     /* check for duplicates */
-    returned = (TagNode*)sfxhash_find(tag_cache_ptr, idx);
-
-    if (returned == NULL)
+    if (mode == TAG_SESSION)
     {
-        DebugMessage(DEBUG_FLOW,"Looking the other way!!\n");
-        SwapTag(idx);
-        returned = (TagNode*)sfxhash_find(tag_cache_ptr, idx);
-        SwapTag(idx);
-    }
+        DebugMessage(DEBUG_FLOW,"Session Tag!\n");
+        TagFlowData* fd = (TagFlowData*)
+            p->flow->get_application_data(TagFlowData::flow_id);
 
-    if (returned == NULL)
+        if ( fd )
+            returned = &fd->node;
+    }
+    else
     {
-        DebugMessage(DEBUG_FLOW,"Inserting a New Tag!\n");
+        DebugMessage(DEBUG_FLOW,"Host Tag!\n");
+        sfip_t key;
 
-        /* if we're supposed to be tagging the other side, swap it
-           around -- Lawrence Reed */
-        if (mode == TAG_HOST_DST)
-        {
-            SwapTag(idx);
-        }
+        sfip_copy(key, p->ptrs.ip_api.get_src());
+        returned = (TagNode*)sfxhash_find(host_tag_cache_ptr, &key);
 
-        if (sfxhash_add(tag_cache_ptr, idx, idx) != SFXHASH_OK)
+        if (returned == NULL)
         {
-            DebugMessage(DEBUG_FLOW,
-                "sfxhash_add failed, that's going to "
-                "make life difficult\n");
-            TagFree(tag_cache_ptr, idx);
-            return;
+            DebugMessage(DEBUG_FLOW,"Looking the other way!!\n");
+            sfip_copy(key, p->ptrs.ip_api.get_dst());
+            returned = (TagNode*)sfxhash_find(host_tag_cache_ptr, &key);
         }
     }
-    else
+
+    if (returned != NULL)
     {
         DebugMessage(DEBUG_FLOW,"Existing Tag found!\n");
 
-        if (idx->metric & TAG_METRIC_SECONDS)
-            returned->seconds = idx->seconds;
+        if (idx.metric & TAG_METRIC_SECONDS)
+            returned->seconds = idx.seconds;
         else
-            returned->seconds += idx->seconds;
+            returned->seconds += idx.seconds;
+
+        return;
+    }
+
+    DebugMessage(DEBUG_FLOW,"Inserting a New Tag!\n");
+    unsigned size = (mode == TAG_SESSION) ? ssn_tag_size : host_tag_size;
+
+    /* If a tag couldn't be allocated, just write an error message
+     * and return - won't be able to track this one. */
+    if ( !TagReserve(size) )
+    {
+        ErrorMessage("AddTagNode(): Unable to allocate %u bytes of memory for new TagNode\n",
+            size);
+        return;
+    }
+
+    if (mode == TAG_SESSION)
+    {
+        TagFlowData* fd = new TagFlowData;
+        fd->node = idx;
+        p->flow->set_application_data(fd);
+        pc.tag_sessions++;
+        return;
+    }
+
+    TagNode* node = (TagNode*)malloc(sizeof(*node));
+
+    if ( node )
+    {
+        *node = idx;
 
-        /* get rid of the new tag since we are using an existing one */
-        TagFree(tag_cache_ptr, idx);
+        if (sfxhash_add(host_tag_cache_ptr, &node->host, node) == SFXHASH_OK)
+        {
+            pc.tag_hosts++;
+            return;
+        }
+        DebugMessage(DEBUG_FLOW,
+            "sfxhash_add failed, that's going to "
+            "make life difficult\n");
+        free(node);
     }
+    TagRelease(&idx, size);
 }
 
 int CheckTagList(Packet* p, Event* event, void** log_list)
 {
-    TagNode idx;
+    TagFlowData* fd = NULL;
     TagNode* returned = NULL;
-    SFXHASH* taglist = NULL;
     char create_event = 1;
 
     /* check for active tags */
-    if (!sfxhash_count(host_tag_cache_ptr) && !sfxhash_count(ssn_tag_cache_ptr))
+    if (!ssn_tag_count && !sfxhash_count(host_tag_cache_ptr))
     {
         return 0;
     }
@@ -475,64 +451,42 @@ int CheckTagList(Packet* p, Event* event, void** log_list)
         return 0;
     }
 
-    DebugFormat(DEBUG_FLOW,"Host Tags Active: %d   Session Tags Active: %d\n",
-        sfxhash_count(host_tag_cache_ptr), sfxhash_count(ssn_tag_cache_ptr));
-
-    DebugMessage(DEBUG_FLOW, "[*] Checking session tag list (forward)...\n");
-
-    sfip_copy(idx.key.sip, p->ptrs.ip_api.get_src());
-    sfip_copy(idx.key.dip, p->ptrs.ip_api.get_dst());
-    idx.key.sp = p->ptrs.sp;
-    idx.key.dp = p->ptrs.dp;
+    DebugFormat(DEBUG_FLOW,"Host Tags Active: %d   Session Tags Active: %u\n",
+        sfxhash_count(host_tag_cache_ptr), ssn_tag_count);
 
     /* check for session tags... */
-    returned = (TagNode*)sfxhash_find(ssn_tag_cache_ptr, &idx);
-
-    if (returned == NULL)
+    if ( ssn_tag_count && p->flow )
     {
-        sfip_copy(idx.key.dip, p->ptrs.ip_api.get_src());
-        sfip_copy(idx.key.sip, p->ptrs.ip_api.get_dst());
-        idx.key.dp = p->ptrs.sp;
-        idx.key.sp = p->ptrs.dp;
+        DebugMessage(DEBUG_FLOW, "[*] Checking session tag on flow...\n");
+        fd = (TagFlowData*)p->flow->get_application_data(TagFlowData::flow_id);
 
-        DebugMessage(DEBUG_FLOW, "   Checking session tag list (reverse)...\n");
-        returned = (TagNode*)sfxhash_find(ssn_tag_cache_ptr, &idx);
-
-        if (returned == NULL)
+        if ( fd )
         {
-            DebugMessage(DEBUG_FLOW, "   Checking host tag list "
-                "(forward)...\n");
+            DebugMessage(DEBUG_FLOW,"   [*!*] Found session node\n");
+            returned = &fd->node;
+        }
+    }
 
-            returned = (TagNode*)sfxhash_find(host_tag_cache_ptr, &idx);
+    if ( !returned && sfxhash_count(host_tag_cache_ptr) )
+    {
+        sfip_t key;
 
-            if (returned == NULL)
-            {
-                /*
-                **  Only switch sip, because that's all we check for
-                **  the host tags.
-                */
-                sfip_copy(idx.key.sip, p->ptrs.ip_api.get_src());
+        DebugMessage(DEBUG_FLOW, "   Checking host tag list...\n");
 
-                returned = (TagNode*)sfxhash_find(host_tag_cache_ptr, &idx);
-            }
+        sfip_copy(key, p->ptrs.ip_api.get_dst());
+        returned = (TagNode*)sfxhash_find(host_tag_cache_ptr, &key);
 
-            if (returned != NULL)
-            {
-                DebugMessage(DEBUG_FLOW,"   [*!*] Found host node\n");
-                taglist = host_tag_cache_ptr;
-            }
+        if (returned == NULL)
+        {
+            sfip_copy(key, p->ptrs.ip_api.get_src());
+            returned = (TagNode*)sfxhash_find(host_tag_cache_ptr, &key);
         }
-        else
+
+        if (returned != NULL)
         {
-            DebugMessage(DEBUG_FLOW,"   [*!*] Found session node\n");
-            taglist = ssn_tag_cache_ptr;
+            DebugMessage(DEBUG_FLOW,"   [*!*] Found host node\n");
         }
     }
-    else
-    {
-        DebugMessage(DEBUG_FLOW,"   [*!*] Found session node\n");
-        taglist = ssn_tag_cache_ptr;
-    }
 
     if (returned != NULL)
     {
@@ -599,7 +553,10 @@ int CheckTagList(Packet* p, Event* event, void** log_list)
             DebugMessage(DEBUG_FLOW,
                 "    Prune condition met for tag, removing from list\n");
 
-            if (sfxhash_remove(taglist, returned) != SFXHASH_OK)
+            if ( fd )
+                p->flow->free_application_data(fd);
+
+            else if (sfxhash_remove(host_tag_cache_ptr, returned) != SFXHASH_OK)
             {
                 LogMessage("WARNING: failed to remove tagNode from hash.\n");
             }
@@ -626,31 +583,17 @@ static int PruneTagCache(uint32_t thetime, int mustdie)
 
     if (mustdie == 0)
     {
-        if (sfxhash_count(ssn_tag_cache_ptr) != 0)
-        {
-            pruned = PruneTime(ssn_tag_cache_ptr, thetime);
-        }
-
         if (sfxhash_count(host_tag_cache_ptr) != 0)
         {
-            pruned += PruneTime(host_tag_cache_ptr, thetime);
+            pruned = PruneTime(host_tag_cache_ptr, thetime);
         }
     }
     else
     {
         TagNode* lru_node = NULL;
 
-        while (pruned < mustdie &&
-            (sfxhash_count(ssn_tag_cache_ptr) > 0 || sfxhash_count(host_tag_cache_ptr) > 0))
+        while (pruned < mustdie && sfxhash_count(host_tag_cache_ptr) > 0)
         {
-            if ((lru_node = (TagNode*)sfxhash_lru(ssn_tag_cache_ptr)) != NULL)
-            {
-                if (sfxhash_remove(ssn_tag_cache_ptr, lru_node) != SFXHASH_OK)
-                {
-                    LogMessage("WARNING: failed to remove tagNode from hash.\n");
-                }
-                pruned++;
-            }
             if ((lru_node = (TagNode*)sfxhash_lru(host_tag_cache_ptr)) != NULL)
             {
                 if (sfxhash_remove(host_tag_cache_ptr, lru_node) != SFXHASH_OK)
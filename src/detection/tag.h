@@ -23,9 +23,8 @@
 
 // rule option tag causes logging of some number of subsequent packets
 // following an alert.  this module is use by the tag option to implement
-// that functionality.  uses its own hash table.
-//
-// FIXIT-L convert tags to use flow instead of hash table.
+// that functionality.  session tags are kept on the flow and host tags in
+// a per thread table keyed by address.
 
 #include <cstdint>
 
@@ -54,7 +53,8 @@ struct TagData
     int tag_direction;  /* source or dest, used for host tagging */
 };
 
-void InitTag(void);
+void InitTagFlows(void);  // once at startup
+void InitTag(void);       // per packet thread
 void CleanupTag(void);
 int CheckTagList(Packet*, Event*, void**);
 void SetTags(Packet*, const OptTreeNode*, uint16_t);
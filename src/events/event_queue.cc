@@ -60,6 +60,8 @@
 #include "utils/stats.h"
 #include "filters/sfthreshold.h"
 #include "parser/parser.h"
+#include "main/snort_config.h"
+#include "detection/treenodes.h"
 
 typedef struct s_SNORT_EVENTQ_USER
 {
@@ -93,6 +95,32 @@ void SnortEventqPop(void)
         qIndex--;
 }
 
+//-------------------------------------------------
+// events are ranked by priority if so configured, otherwise they all rank
+// the same and are kept in the order added.  fp_detect has already sorted
+// rule events within each action group and action groups take precedence,
+// so the group's evaluation order is the major key of the rank and the
+// priority only orders events within a group.
+static inline int get_rank(const OptTreeNode* otn, RuleType type)
+{
+    if ( snort_conf->event_queue_config->order != SNORT_EVENTQ_PRIORITY )
+        return 0;
+
+    // builtin events get their action from the current policy
+    if ( type == RULE_TYPE__NONE )
+    {
+        RuleTreeNode* rtn = getRtnFromOtn(otn);
+        type = rtn ? rtn->type : RULE_TYPE__ALERT;
+    }
+
+    unsigned pri = otn->sigInfo.priority;
+
+    if ( pri > 0xFFFF )
+        pri = 0xFFFF;
+
+    return (SnortConfig::get_eval_index(type) << 16) | pri;
+}
+
 //-------------------------------------------------
 /*
 **  Set default values
@@ -132,15 +160,19 @@ int SnortEventqAdd(const OptTreeNode* otn)
         return 0;
     }
 
-    EventNode* en = (EventNode*)sfeventq_event_alloc(event_queue[qIndex]);
+    SF_EVENTQ* eq = event_queue[qIndex];
+    int rank = get_rank(otn, rtn->type);
 
-    if ( !en )
+    // full and this one would not displace anything
+    if ( !sfeventq_accepts(eq, rank) )
         return -1;
 
+    EventNode* en = (EventNode*)sfeventq_event_alloc(eq);
+
     en->otn = otn;
     en->rtn = rtn;
 
-    if ( sfeventq_add(event_queue[qIndex], en) )
+    if ( sfeventq_add(eq, en, rank) )
         return -1;
 
     s_events++;
@@ -156,16 +188,19 @@ int SnortEventqAdd(uint32_t gid, uint32_t sid, RuleType type)
     if ( !otn )
         return 0;
 
-    EventNode* en = (EventNode*)sfeventq_event_alloc(event_queue[qIndex]);
+    SF_EVENTQ* eq = event_queue[qIndex];
+    int rank = get_rank(otn, type);
 
-    if ( !en )
+    if ( !sfeventq_accepts(eq, rank) )
         return -1;
 
+    EventNode* en = (EventNode*)sfeventq_event_alloc(eq);
+
     en->otn = otn;
     en->rtn = nullptr;  // lookup later after ips policy selection
     en->type = type;
 
-    if ( sfeventq_add(event_queue[qIndex], en) )
+    if ( sfeventq_add(eq, en, rank) )
         return -1;
 
     s_events++;
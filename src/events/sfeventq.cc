@@ -29,7 +29,9 @@
 **
 **  The sfeventq functions provide a generic way for handling events,
 **  prioritizing those events, and acting on the highest ranked events
-**  with a user function.
+**  with a user function.  Events are kept in a fixed array ordered by
+**  rank so a packet that generates many candidate events only pays for
+**  a binary search per event and nothing to reset the queue.
 **
 **  Example on using sfeventq:
 **
@@ -40,7 +42,9 @@
 **       sfeventq_event_alloc() allocates the memory for storing the event.
 **       sfeventq_add() adds the event and prioritizes the event in the queue.
 **       You should only allocate and add one event at a time.  Otherwise,
-**       event_alloc() will return NULL on memory exhaustion.
+**       event_alloc() will return NULL on memory exhaustion.  When the
+**       queue is full, sfeventq_accepts() tells whether an event of the
+**       given rank would be kept so callers can skip building it.
 **
 **  3. Event actions
 **       sfeventq_action() will call the provided function on the initialized
@@ -54,8 +58,13 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include "utils/util.h"
 
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
 /*
 **  NAME
 **    sfeventq_new::
@@ -65,10 +74,10 @@
 **  queue will support, the number of top nodes to log in the queue, and the
 **  size of the event structure that the user will fill in.
 **
-**  @return integer
+**  @return SF_EVENTQ*
 **
-**  @retval -1 failure
-**  @retval  0 success
+**  @retval NULL failure
+**  @retval !NULL success
 */
 SF_EVENTQ* sfeventq_new(int max_nodes, int log_nodes, int event_size)
 {
@@ -79,20 +88,27 @@ SF_EVENTQ* sfeventq_new(int max_nodes, int log_nodes, int event_size)
 
     eq = (SF_EVENTQ*)SnortAlloc(sizeof(SF_EVENTQ));
 
-    /* Initialize the memory for the nodes that we are going to use. */
-    eq->node_mem = (SF_EVENTQ_NODE*)SnortAlloc(sizeof(SF_EVENTQ_NODE) * max_nodes);
+    /* one extra slot for the reserve event */
+    eq->slot = (int*)SnortAlloc(sizeof(int) * (max_nodes + 1));
+    eq->rank = (int*)SnortAlloc(sizeof(int) * (max_nodes + 1));
     eq->event_mem = (char*)SnortAlloc(event_size * (max_nodes + 1));
 
+    for ( int i = 0; i <= max_nodes; ++i )
+        eq->slot[i] = i;
+
     eq->max_nodes = max_nodes;
     eq->log_nodes = log_nodes;
     eq->event_size = event_size;
     eq->cur_nodes = 0;
-    eq->cur_events = 0;
-    eq->reserve_event = (char*)(&eq->event_mem[max_nodes * eq->event_size]);
 
     return eq;
 }
 
+static inline void* get_event(SF_EVENTQ* eq, int slot)
+{
+    return &eq->event_mem[slot * eq->event_size];
+}
+
 /*
 **  NAME
 **    sfeventq_event_alloc::
@@ -100,35 +116,17 @@ SF_EVENTQ* sfeventq_new(int max_nodes, int log_nodes, int event_size)
 /**
 **  Allocate the memory for an event to add to the event queue.  This
 **  function is meant to be called first, the event structure filled in,
-**  and then added to the queue.  While you can allocate several times before
-**  adding to the queue, this is not recommended as you may get a NULL ptr
-**  if you allocate more than the max node number.
+**  and then added to the queue.  If the queue is full, the reserve event
+**  is returned; sfeventq_add() will then keep it only if it outranks the
+**  last queued event.
 **
 **  @return  void *
 **
-**  @retval  NULL unable to allocate memory.
 **  @retval !NULL ptr to memory.
 */
 void* sfeventq_event_alloc(SF_EVENTQ* eq)
 {
-    void* event;
-
-    if (eq->cur_events >= eq->max_nodes)
-    {
-        if (eq->reserve_event == NULL)
-            return NULL;
-
-        event = (void*)eq->reserve_event;
-        eq->reserve_event = NULL;
-
-        return event;
-    }
-
-    event = (void*)(&eq->event_mem[eq->cur_events * eq->event_size]);
-
-    eq->cur_events++;
-
-    return event;
+    return get_event(eq, eq->slot[eq->cur_nodes]);
 }
 
 /*
@@ -136,17 +134,14 @@ void* sfeventq_event_alloc(SF_EVENTQ* eq)
 **    sfeventq_reset::
 */
 /**
-**  Resets the event queue.  We also set the reserve event back
-**  to the last event in the queue.
+**  Resets the event queue.  The slot array is always a permutation so
+**  all slots become free without touching them.
 **
 **  @return void
 */
 void sfeventq_reset(SF_EVENTQ* eq)
 {
-    eq->head = NULL;
     eq->cur_nodes = 0;
-    eq->cur_events = 0;
-    eq->reserve_event = (char*)(&eq->event_mem[eq->max_nodes * eq->event_size]);
 }
 
 /*
@@ -164,51 +159,27 @@ void sfeventq_free(SF_EVENTQ* eq)
     if (eq == NULL)
         return;
 
-    /* Free the memory for the nodes that were in use. */
-    if (eq->node_mem != NULL)
-    {
-        free(eq->node_mem);
-        eq->node_mem = NULL;
-    }
-
-    if (eq->event_mem != NULL)
-    {
-        free(eq->event_mem);
-        eq->event_mem = NULL;
-    }
-
+    free(eq->slot);
+    free(eq->rank);
+    free(eq->event_mem);
     free(eq);
 }
 
 /*
 **  NAME
-**    get_eventq_node::
+**    sfeventq_accepts::
 */
 /**
-**  This function returns a ptr to the node to use.  We allocate the last
-**  event node if we have exhausted the event queue.  Before we allocate
-**  the last node, we determine if the incoming event has a higher
-**  priority than the last node.  If it does, we allocate the node, otherwise
-**  we drop it because it is lower priority.
-**
-**  If the last node is allocated, we have to point the reserve_event to
-**  the allocated event memory, since the reserved_event memory was used
-**  for the incoming event.
-**
-**  @return SF_EVENTQ_NODE *
+**  Tells whether an event with the given rank would be queued.
 **
-**  @retval NULL resource exhaustion and event is lower priority than last node
-**  @retval !NULL ptr to node memory.
+**  @return bool
 */
-static SF_EVENTQ_NODE* get_eventq_node(SF_EVENTQ* eq, void*)
+bool sfeventq_accepts(SF_EVENTQ* eq, int rank)
 {
-    if (eq->cur_nodes >= eq->max_nodes)
-        return NULL;
+    if ( eq->cur_nodes < eq->max_nodes )
+        return true;
 
-    /*
-    **  We grab the next node from the node memory.
-    */
-    return &eq->node_mem[eq->cur_nodes++];
+    return rank < eq->rank[eq->slot[eq->max_nodes - 1]];
 }
 
 /*
@@ -216,53 +187,56 @@ static SF_EVENTQ_NODE* get_eventq_node(SF_EVENTQ* eq, void*)
 **    sfeventq_add:
 */
 /**
-**  Add this event to the queue using the supplied ordering
-**  function.  If the queue is exhausted, then we compare the
-**  event to be added with the last event, and decide whether
-**  it is a higher priority than the last node.
+**  Add the event last returned by sfeventq_event_alloc() to the queue
+**  after any queued events of equal or lower rank.  If the queue is
+**  exhausted, the event replaces the last event only if it ranks lower
+**  (better); the displaced event's memory becomes the new reserve.
 **
 **  @return integer
 **
 **  @retval -1 add event failed
 **  @retval  0 add event succeeded
 */
-int sfeventq_add(SF_EVENTQ* eq, void* event)
+int sfeventq_add(SF_EVENTQ* eq, void* event, int rank)
 {
-    SF_EVENTQ_NODE* node;
-
     if (!event)
         return -1;
 
-    /*
-    **  If get_eventq_node() returns NULL, this means that
-    **  we have exhausted the eventq and the incoming event
-    **  is lower in priority then the last ranked event.
-    **  So we just drop it.
-    */
-    node = get_eventq_node(eq, event);
-    if (!node)
-        return -1;
+    int n = eq->cur_nodes;
+    int s = eq->slot[n];
 
-    node->event = event;
-    node->next  = NULL;
-    node->prev  = NULL;
+    if ( event != get_event(eq, s) )
+        return -1;
 
-    /*
-    **  This is the first node
-    */
-    if (eq->cur_nodes == 1)
+    if ( n == eq->max_nodes )
     {
-        eq->head = eq->last = node;
-        return 0;
+        if ( !sfeventq_accepts(eq, rank) )
+            return -1;
+
+        /* swap the incoming event in for the last one */
+        eq->slot[n] = eq->slot[n - 1];
+        --n;
     }
+    else
+        eq->cur_nodes++;
+
+    /* upper bound keeps equal ranks in insertion order */
+    int lo = 0, hi = n;
 
-    /*
-    **  This means we are the last node.
-    */
-    node->prev = eq->last;
+    while ( lo < hi )
+    {
+        int mid = (lo + hi) / 2;
+
+        if ( eq->rank[eq->slot[mid]] <= rank )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if ( n > lo )
+        memmove(eq->slot + lo + 1, eq->slot + lo, (n - lo) * sizeof(*eq->slot));
 
-    eq->last->next = node;
-    eq->last = node;
+    eq->slot[lo] = s;
+    eq->rank[s] = rank;
 
     return 0;
 }
@@ -283,132 +257,115 @@ int sfeventq_add(SF_EVENTQ* eq, void* event)
 */
 int sfeventq_action(SF_EVENTQ* eq, int (* action_func)(void*, void*), void* user)
 {
-    SF_EVENTQ_NODE* node;
-    int logged = 0;
-
     if (action_func == NULL)
         return -1;
 
-    if (eq->head == NULL)
+    if ( !eq->cur_nodes )
         return 0;
 
-    for (node = eq->head; node != NULL; node = node->next)
-    {
-        if (logged >= eq->log_nodes)
-            return 1;
+    int n = eq->cur_nodes < eq->log_nodes ? eq->cur_nodes : eq->log_nodes;
 
-        if (action_func(node->event, user))
+    for ( int i = 0; i < n; ++i )
+    {
+        if (action_func(get_event(eq, eq->slot[i]), user))
             return -1;
-
-        logged++;
     }
 
     return 1;
 }
 
-//#define I_WANT_MY_MAIN
-#ifdef  I_WANT_MY_MAIN
+#ifdef UNIT_TEST
 
-#include <stdio.h>
-#include <time.h>
-
-int myaction(void* event, void* user)
+static int add_event(SF_EVENTQ* eq, int val, int rank)
 {
-    int* e;
-
-    if (!event)
-        return 1;
-
-    e = (int*)event;
-
-    printf("-- EVENT: %d\n", *e);
+    int* e = (int*)sfeventq_event_alloc(eq);
+    *e = val;
+    return sfeventq_add(eq, e, rank);
+}
 
+static int get_events(void* event, void* user)
+{
+    int** pv = (int**)user;
+    *(*pv)++ = *(int*)event;
     return 0;
 }
 
-int main(int argc, char** argv)
+static int dump(SF_EVENTQ* eq, int* vals)
 {
-    int max_events;
-    int log_events;
-    int add_events;
-    int* event;
-    int iCtr;
-    SF_EVENTQ* eq;
+    int* pv = vals;
+    sfeventq_action(eq, get_events, &pv);
+    return pv - vals;
+}
 
-    if (argc < 4)
-    {
-        printf("-- Not enough args\n");
-        return 1;
-    }
+TEST_CASE("eventq fifo", "[sfeventq]")
+{
+    SF_EVENTQ* eq = sfeventq_new(4, 3, sizeof(int));
+    int vals[4];
 
-    max_events = atoi(argv[1]);
-    if (max_events <= 0)
-    {
-        printf("-- max_events invalid.\n");
-        return 1;
-    }
+    for ( int i = 0; i < 6; ++i )
+        CHECK(add_event(eq, i, 0) == (i < 4 ? 0 : -1));
 
-    log_events = atoi(argv[2]);
-    if (log_events <= 0)
-    {
-        printf("-- log_events invalid.\n");
-        return 1;
-    }
+    CHECK(eq->cur_nodes == 4);
+    CHECK(dump(eq, vals) == 3);
+    CHECK(vals[0] == 0);
+    CHECK(vals[1] == 1);
+    CHECK(vals[2] == 2);
 
-    add_events = atoi(argv[3]);
-    if (add_events <= 0)
-    {
-        printf("-- add_events invalid.\n");
-        return 1;
-    }
+    sfeventq_free(eq);
+}
 
-    if (max_events < log_events)
-    {
-        printf("-- log_events greater than max_events\n");
-        return 1;
-    }
+TEST_CASE("eventq rank", "[sfeventq]")
+{
+    SF_EVENTQ* eq = sfeventq_new(3, 3, sizeof(int));
+    int vals[3];
 
-    srandom(time(NULL));
+    add_event(eq, 30, 3);
+    add_event(eq, 10, 1);
+    add_event(eq, 31, 3);
 
-    eq = sfeventq_new(max_events, log_events, sizeof(int));
-    if (eq == NULL)
-    {
-        printf("Couldn't allocate the event queue\n");
-        return 1;
-    }
+    CHECK(!sfeventq_accepts(eq, 3));
+    CHECK(sfeventq_accepts(eq, 2));
 
-    do
-    {
-        printf("-- Event Queue Test --\n\n");
+    // displaces 31 which ranks last
+    CHECK(add_event(eq, 20, 2) == 0);
+    CHECK(add_event(eq, 32, 3) == -1);
+
+    CHECK(dump(eq, vals) == 3);
+    CHECK(vals[0] == 10);
+    CHECK(vals[1] == 20);
+    CHECK(vals[2] == 30);
+
+    // displaced memory is reused without disturbing queued events
+    CHECK(add_event(eq, 0, 0) == 0);
+    CHECK(dump(eq, vals) == 3);
+    CHECK(vals[0] == 0);
+    CHECK(vals[1] == 10);
+    CHECK(vals[2] == 20);
 
-        for (iCtr = 0; iCtr < add_events; iCtr++)
-        {
-            event  = (int*)sfeventq_event_alloc(eq);
-            if (!event)
-            {
-                printf("-- event allocation failed\n");
-                return 1;
-            }
+    sfeventq_free(eq);
+}
 
-            *event = (int)(random()%3);
+TEST_CASE("eventq reset", "[sfeventq]")
+{
+    SF_EVENTQ* eq = sfeventq_new(2, 2, sizeof(int));
+    int vals[2];
 
-            sfeventq_add(eq, event);
-            printf("-- added %d\n", *event);
-        }
+    add_event(eq, 1, 5);
+    add_event(eq, 2, 4);
+    add_event(eq, 3, 1);
 
-        printf("\n-- Logging\n\n");
+    sfeventq_reset(eq);
+    CHECK(dump(eq, vals) == 0);
 
-        if (sfeventq_action(eq, myaction, NULL))
-        {
-            printf("-- There was a problem.\n");
-            return 1;
-        }
+    add_event(eq, 4, 0);
+    add_event(eq, 5, 0);
+    CHECK(add_event(eq, 6, 0) == -1);
 
-        sfeventq_reset(eq);
-    }
-    while (getc(stdin) < 14);
+    CHECK(dump(eq, vals) == 2);
+    CHECK(vals[0] == 4);
+    CHECK(vals[1] == 5);
 
-    return 0;
+    sfeventq_free(eq);
 }
 
 #endif
@@ -20,34 +20,24 @@
 #ifndef SFEVENTQ_H
 #define SFEVENTQ_H
 
-typedef struct s_SF_EVENTQ_NODE
-{
-    void* event;
-
-    struct s_SF_EVENTQ_NODE* prev;
-    struct s_SF_EVENTQ_NODE* next;
-}  SF_EVENTQ_NODE;
+// bounded event queue kept as a small array ordered by rank.  event memory
+// is owned by the queue and addressed through a permutation of slots so
+// that insert is a binary search plus a short move and reset is O(1).
+// lower ranks come first; equal ranks keep insertion order.
 
-typedef struct s_SF_EVENTQ
+struct SF_EVENTQ
 {
     /*
-    **  Handles the actual ordering and memory
-    **  of the event queue and it's nodes.
+    **  slot[0 .. cur_nodes-1] are queued in rank order and
+    **  slot[cur_nodes .. max_nodes] are free.  slot[max_nodes] is the
+    **  reserve used to hold an incoming event when the queue is full
+    **  so it can be compared against the last queued event.
     */
-    SF_EVENTQ_NODE* head;
-    SF_EVENTQ_NODE* last;
+    int* slot;
+    int* rank;          // indexed by slot number
 
-    SF_EVENTQ_NODE* node_mem;
     char* event_mem;
 
-    /*
-    **  The reserve event allows us to allocate one extra node
-    **  and compare against the last event in the queue to determine
-    **  if the incoming event is a higher priority than the last
-    **  event in the queue.
-    */
-    char* reserve_event;
-
     /*
     **  Queue configuration
     */
@@ -60,13 +50,13 @@ typedef struct s_SF_EVENTQ
     **  nodes in the event queue.
     */
     int cur_nodes;
-    int cur_events;
-}  SF_EVENTQ;
+};
 
 SF_EVENTQ* sfeventq_new(int max_nodes, int log_nodes, int event_size);
 void* sfeventq_event_alloc(SF_EVENTQ*);
 void sfeventq_reset(SF_EVENTQ*);
-int sfeventq_add(SF_EVENTQ*, void* event);
+int sfeventq_add(SF_EVENTQ*, void* event, int rank = 0);
+bool sfeventq_accepts(SF_EVENTQ*, int rank);
 int sfeventq_action(SF_EVENTQ*, int (* action_func)(void* event, void* user), void* user);
 void sfeventq_free(SF_EVENTQ*);
 
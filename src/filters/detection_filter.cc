@@ -26,9 +26,10 @@
 #include "utils/util.h"
 #include "parser/parser.h"
 #include "filters/sfthd.h"
-#include "main/thread.h"
 
-static THREAD_LOCAL SFXHASH* detection_filter_hash = NULL;
+// shared by all packet threads so detection_filter counts are global like
+// event_filter and rate_filter; created and deleted by the main thread
+static FilterCache* detection_filter_hash = NULL;
 
 DetectionFilterConfig* DetectionFilterConfigNew(void)
 {
@@ -70,7 +71,7 @@ void detection_filter_reset_active(void)
     if (detection_filter_hash == NULL)
         return;
 
-    sfxhash_make_empty(detection_filter_hash);
+    detection_filter_hash->make_empty();
 }
 
 void* detection_filter_create(DetectionFilterConfig* df_config, THDX_STRUCT* thdx)
@@ -109,7 +110,7 @@ void detection_filter_term()
     if ( !detection_filter_hash )
         return;
 
-    sfxhash_delete(detection_filter_hash);
+    delete detection_filter_hash;
     detection_filter_hash = NULL;
 }
 
@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// filter_cache.cc
+
+#include "filter_cache.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+
+// don't split small caches; at the minimum memcap this leaves a single
+// shard which behaves exactly like the old single table
+#define FILTER_CACHE_MIN_NODES 512
+
+FilterCache::FilterCache(unsigned n, size_t key)
+{
+    shards = new Shard[n];
+    num_shards = n;
+    key_size = key;
+
+    for ( unsigned i = 0; i < n; ++i )
+        shards[i].hash = nullptr;
+}
+
+FilterCache::~FilterCache()
+{
+    for ( unsigned i = 0; i < num_shards; ++i )
+    {
+        if ( shards[i].hash )
+            sfxhash_delete(shards[i].hash);
+    }
+    delete[] shards;
+}
+
+FilterCache* FilterCache::create(unsigned bytes, size_t key, size_t data)
+{
+    size_t size = key + data;
+    unsigned nodes = bytes / size;
+    unsigned n = 1;
+
+    while ( n < FILTER_CACHE_MAX_SHARDS and nodes / (2 * n) >= FILTER_CACHE_MIN_NODES )
+        n *= 2;
+
+    FilterCache* fc = new FilterCache(n, key);
+    unsigned nbytes = bytes / n;
+
+    /* Calc max ip nodes for this memory */
+    if ( nbytes < size )
+        nbytes = size;
+
+    int nrows = nbytes / size;
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        fc->shards[i].hash = sfxhash_new(
+            nrows,  /* try one node per row - for speed */
+            key,    /* keys size */
+            data,   /* data size */
+            nbytes, /* memcap **/
+            1,      /* ANR flag - true ?- Automatic Node Recovery=ANR */
+            0,      /* ANR callback - none */
+            0,      /* user freemem callback - none */
+            1);     /* Recycle nodes ?*/
+
+        if ( !fc->shards[i].hash )
+        {
+            delete fc;
+            return nullptr;
+        }
+    }
+    return fc;
+}
+
+// fnv-1a; the shard index must not correlate with the row index sfxhash
+// computes from the same key or each shard would only use some of its rows
+unsigned FilterCache::get_index(const void* key) const
+{
+    const uint8_t* k = (const uint8_t*)key;
+    uint32_t h = 2166136261u;
+
+    for ( size_t i = 0; i < key_size; ++i )
+    {
+        h ^= k[i];
+        h *= 16777619u;
+    }
+    return (h ^ (h >> 16)) & (num_shards - 1);
+}
+
+void FilterCache::make_empty()
+{
+    for ( unsigned i = 0; i < num_shards; ++i )
+    {
+        std::lock_guard<std::mutex> lock(shards[i].lock);
+        sfxhash_make_empty(shards[i].hash);
+    }
+}
+
+unsigned FilterCache::get_count()
+{
+    unsigned n = 0;
+
+    for ( unsigned i = 0; i < num_shards; ++i )
+    {
+        std::lock_guard<std::mutex> lock(shards[i].lock);
+        n += sfxhash_count(shards[i].hash);
+    }
+    return n;
+}
+
+unsigned FilterCache::get_anr_count()
+{
+    unsigned n = 0;
+
+    for ( unsigned i = 0; i < num_shards; ++i )
+    {
+        std::lock_guard<std::mutex> lock(shards[i].lock);
+        n += sfxhash_anr_count(shards[i].hash);
+    }
+    return n;
+}
+
@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// filter_cache.h
+
+#ifndef FILTER_CACHE_H
+#define FILTER_CACHE_H
+
+// tracking table for rate_filter, event_filter, and detection_filter that
+// is shared by all packet threads.  nodes are spread over independently
+// locked shards, each an sfxhash with an equal part of the memcap doing its
+// own node recovery, so threads only contend when their keys land in the
+// same shard.  the shard stays locked for the lookup and the update so
+// counts and windows are exact regardless of which thread sees the event.
+
+#include <stddef.h>
+#include <mutex>
+
+#include "hash/sfxhash.h"
+
+#define FILTER_CACHE_MAX_SHARDS 16
+
+class FilterCache
+{
+public:
+    // bytes is the memcap of the whole cache; returns null if any shard
+    // can't be allocated
+    static FilterCache* create(unsigned bytes, size_t key, size_t data);
+    ~FilterCache();
+
+    void make_empty();
+
+    unsigned get_shards() const
+    { return num_shards; }
+
+    unsigned get_count();       // nodes in use across all shards
+    unsigned get_anr_count();   // nodes recovered across all shards
+
+private:
+    friend class FilterCacheLock;
+
+    FilterCache(unsigned shards, size_t key);
+    unsigned get_index(const void* key) const;
+
+    struct Shard
+    {
+        std::mutex lock;
+        SFXHASH* hash;
+    };
+
+    Shard* shards;
+    unsigned num_shards;
+    size_t key_size;
+};
+
+// holds the shard of key for the life of this object
+class FilterCacheLock
+{
+public:
+    FilterCacheLock(FilterCache* fc, const void* key)
+        : shard(fc->shards[fc->get_index(key)])
+    { shard.lock.lock(); }
+
+    ~FilterCacheLock()
+    { shard.lock.unlock(); }
+
+    SFXHASH* get_hash()
+    { return shard.hash; }
+
+private:
+    FilterCache::Shard& shard;
+};
+
+#endif
+
@@ -38,6 +38,7 @@
 #include "utils/sflsq.h"
 #include "hash/sfghash.h"
 #include "hash/sfxhash.h"
+#include "filters/filter_cache.h"
 #include "sfip/sf_ipvar.h"
 
 // Number of hash rows for gid 1 (rules)
@@ -95,7 +96,8 @@ typedef struct
     time_t revertTime;
 } tSFRFTrackingNode;
 
-SFXHASH* rf_hash = NULL;
+// shared by all packet threads
+FilterCache* rf_hash = NULL;
 
 // private methods ...
 static int _checkThreshold(
@@ -111,8 +113,8 @@ static int _checkSamplingPeriod(
     );
 
 static tSFRFTrackingNode* _getSFRFTrackingNode(
-    const sfip_t*,
-    unsigned tid,
+    SFXHASH*,
+    const tSFRFTrackingNodeKey*,
     time_t curTime
     );
 
@@ -134,29 +136,14 @@ static void _updateDependentThresholds(
  * @param nbytes maximum memory to use for thresholding objects, in bytes.
  * @return  pointer to newly created tSFRFContext
 */
-#define SFRF_BYTES (sizeof(tSFRFTrackingNodeKey) + sizeof(tSFRFTrackingNode))
 
 static void SFRF_New(unsigned nbytes)
 {
-    int nrows;
-
-    /* Calc max ip nodes for this memory */
-    if ( nbytes < SFRF_BYTES )
-    {
-        nbytes = SFRF_BYTES;
-    }
-    nrows = nbytes / (SFRF_BYTES);
-
     /* Create global hash table for all of the IP Nodes */
-    rf_hash = sfxhash_new(
-        nrows,  /* try one node per row - for speed */
+    rf_hash = FilterCache::create(
+        nbytes,
         sizeof(tSFRFTrackingNodeKey), /* keys size */
-        sizeof(tSFRFTrackingNode),     /* data size */
-        nbytes,                  /* memcap **/
-        1,         /* ANR flag - true ?- Automatic Node Recovery=ANR */
-        0,         /* ANR callback - none */
-        0,         /* user freemem callback - none */
-        1);       /* Recycle nodes ?*/
+        sizeof(tSFRFTrackingNode));    /* data size */
 }
 
 void SFRF_Delete(void)
@@ -164,14 +151,14 @@ void SFRF_Delete(void)
     if ( !rf_hash )
         return;
 
-    sfxhash_delete(rf_hash);
+    delete rf_hash;
     rf_hash = NULL;
 }
 
 void SFRF_Flush(void)
 {
     if ( rf_hash )
-        sfxhash_make_empty(rf_hash);
+        rf_hash->make_empty();
 }
 
 static void SFRF_ConfigNodeFree(void* item)
@@ -378,9 +365,19 @@ static int SFRF_TestObject(
     )
 {
     tSFRFTrackingNode* dynNode;
+    tSFRFTrackingNodeKey key;
     int retValue = -1;
 
-    dynNode = _getSFRFTrackingNode(ip, cfgNode->tid, curTime);
+    /* Setup key */
+    key.ip = *(ip);
+    key.tid = cfgNode->tid;
+    key.policyId = get_network_policy()->policy_id;
+
+    // the node is shared by all packet threads so hold its shard until
+    // the sampling period, count, and state are updated
+    FilterCacheLock lock(rf_hash, &key);
+
+    dynNode = _getSFRFTrackingNode(lock.get_hash(), &key, curTime);
 
     if ( dynNode == NULL )
         return retValue;
@@ -797,24 +794,18 @@ static void _updateDependentThresholds(
 }
 
 static tSFRFTrackingNode* _getSFRFTrackingNode(
-    const sfip_t* ip,
-    unsigned tid,
+    SFXHASH* hash,
+    const tSFRFTrackingNodeKey* key,
     time_t curTime
     )
 {
     tSFRFTrackingNode* dynNode = NULL;
-    tSFRFTrackingNodeKey key;
     SFXHASH_NODE* hnode = NULL;
 
-    /* Setup key */
-    key.ip = *(ip);
-    key.tid = tid;
-    key.policyId = get_network_policy()->policy_id;
-
     /*
      * Check for any Permanent sid objects for this gid or add this one ...
      */
-    hnode = sfxhash_get_node(rf_hash, (void*)&key);
+    hnode = sfxhash_get_node(hash, key);
     if ( hnode && hnode->data )
     {
         dynNode = (tSFRFTrackingNode*)hnode->data;
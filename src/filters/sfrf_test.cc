@@ -25,10 +25,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "catch/catch.hpp"
 
 #include "main/snort_types.h"
 #include "main/snort_config.h"
+#include "main/policy.h"
 #include "detection/rules.h"
 #include "detection/treenodes.h"
 #include "sfip/sf_ip.h"
@@ -993,6 +998,67 @@ static int CapCheck(int i)
     return 0;
 }
 
+//---------------------------------------------------------------
+// the tracking nodes are shared so the rate must be reached after exactly
+// count events per address no matter how many threads see them
+
+#define NUM_THREADS  8
+#define NUM_ADDRS   64
+#define NUM_HITS  4096         // per thread
+#define THR_COUNT   25
+
+static void ThreadTest(unsigned& orig, unsigned& started)
+{
+    tSFRFConfigNode cfg;
+    memset(&cfg, 0, sizeof(cfg));
+
+    cfg.gid = 300;
+    cfg.sid = 1;
+    cfg.tracking = SFRF_TRACK_BY_SRC;
+    cfg.count = THR_COUNT;
+    cfg.seconds = 60;
+    cfg.newAction = (RuleType)RULE_NEW;
+    cfg.timeout = 60;
+
+    REQUIRE(SFRF_ConfigAdd(snort_conf, &rfc, &cfg) == 0);
+
+    NetworkPolicy* policy = get_network_policy();
+    std::atomic<unsigned> n_orig(0), n_started(0);
+    std::vector<std::thread> threads;
+
+    for ( unsigned t = 0; t < NUM_THREADS; ++t )
+    {
+        threads.push_back(std::thread([&policy, &n_orig, &n_started]()
+        {
+            set_network_policy(policy);
+
+            sfip_t sip, dip;
+            sfip_pton(IP4_DST, &dip);
+
+            for ( unsigned i = 0; i < NUM_HITS; ++i )
+            {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "10.2.0.%u", i % NUM_ADDRS);
+                sfip_pton(buf, &sip);
+
+                int status = SFRF_TestThreshold(
+                    &rfc, 300, 1, &sip, &dip, 100, SFRF_COUNT_INCREMENT);
+
+                if ( status == RULE_ORIG )
+                    ++n_orig;
+
+                else if ( status >= RULE_TYPE__MAX )
+                    ++n_started;
+            }
+        }));
+    }
+    for ( auto& t : threads )
+        t.join();
+
+    orig = n_orig;
+    started = n_started;
+}
+
 //---------------------------------------------------------------
 
 TEST_CASE("sfrf default memcap", "[sfrf]")
@@ -1029,3 +1095,18 @@ TEST_CASE("sfrf minimum memcap", "[sfrf]")
     Term();
 }
 
+
+TEST_CASE("sfrf threads", "[sfrf]")
+{
+    memset(&rfc, 0, sizeof(rfc));
+    rfc.memcap = MEM_DEFAULT;
+
+    unsigned orig, started;
+    ThreadTest(orig, started);
+
+    CHECK(orig == NUM_ADDRS * THR_COUNT);
+    CHECK(started == NUM_ADDRS);
+
+    Term();
+}
+
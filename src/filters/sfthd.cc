@@ -53,29 +53,6 @@
 // This disables adding and testing of Threshold objects
 //#define CRIPPLE
 
-SFXHASH* sfthd_new_hash(unsigned nbytes, size_t key, size_t data)
-{
-    size_t size = key + data;
-    int nrows;
-
-    /* Calc max ip nodes for this memory */
-    if ( nbytes < size )
-    {
-        nbytes = size;
-    }
-    nrows = nbytes / (size);
-
-    return sfxhash_new(
-        nrows,  /* try one node per row - for speed */
-        key,    /* keys size */
-        data,   /* data size */
-        nbytes, /* memcap **/
-        1,      /* ANR flag - true ?- Automatic Node Recovery=ANR */
-        0,      /* ANR callback - none */
-        0,      /* user freemem callback - none */
-        1);     /* Recycle nodes ?*/
-}
-
 /*!
   Create a threshold table, initialize the threshold system,
   and optionally limit it's memory usage.
@@ -87,10 +64,10 @@ SFXHASH* sfthd_new_hash(unsigned nbytes, size_t key, size_t data)
   @retval !0 valid THD_STRUCT
 */
 
-SFXHASH* sfthd_local_new(unsigned bytes)
+FilterCache* sfthd_local_new(unsigned bytes)
 {
-    SFXHASH* local_hash =
-        sfthd_new_hash(bytes,
+    FilterCache* local_hash =
+        FilterCache::create(bytes,
         sizeof(THD_IP_NODE_KEY),
         sizeof(THD_IP_NODE));
 
@@ -102,10 +79,10 @@ SFXHASH* sfthd_local_new(unsigned bytes)
     return local_hash;
 }
 
-SFXHASH* sfthd_global_new(unsigned bytes)
+FilterCache* sfthd_global_new(unsigned bytes)
 {
-    SFXHASH* global_hash =
-        sfthd_new_hash(bytes,
+    FilterCache* global_hash =
+        FilterCache::create(bytes,
         sizeof(THD_IP_GNODE_KEY),
         sizeof(THD_IP_NODE));
 
@@ -146,7 +123,7 @@ THD_STRUCT* sfthd_new(unsigned lbytes, unsigned gbytes)
 #ifdef THD_DEBUG
         printf("Could not allocate the sfxhash table\n");
 #endif
-        sfxhash_delete(thd->ip_nodes);
+        delete thd->ip_nodes;
         free(thd);
         return NULL;
     }
@@ -243,11 +220,8 @@ void sfthd_free(THD_STRUCT* thd)
         return;
 
 #ifndef CRIPPLE
-    if (thd->ip_nodes != NULL)
-        sfxhash_delete(thd->ip_nodes);
-
-    if (thd->ip_gnodes != NULL)
-        sfxhash_delete(thd->ip_gnodes);
+    delete thd->ip_nodes;
+    delete thd->ip_gnodes;
 #endif
 
     free(thd);
@@ -633,8 +607,7 @@ int sfthd_create_threshold(
 {
     //allocate memory fpr sfthd_array if needed.
     PolicyId policyId = get_network_policy()->policy_id;
-    THD_NODE sfthd_node;
-    memset(&sfthd_node, 0, sizeof(sfthd_node));
+    THD_NODE sfthd_node { };
 
     thd_objs->count++;
 
@@ -682,7 +655,7 @@ static char* printIP(unsigned u)
 
 #endif
 
-int sfthd_test_rule(SFXHASH* rule_hash, THD_NODE* sfthd_node,
+int sfthd_test_rule(FilterCache* rule_hash, THD_NODE* sfthd_node,
     const sfip_t* sip, const sfip_t* dip, long curtime)
 {
     int status;
@@ -880,7 +853,7 @@ static inline int sfthd_test_non_suppress(
  *
  */
 int sfthd_test_local(
-    SFXHASH* local_hash,
+    FilterCache* local_cache,
     THD_NODE* sfthd_node,
     const sfip_t* sip,
     const sfip_t* dip,
@@ -947,6 +920,11 @@ int sfthd_test_local(
     /*
      * Check for any Permanent sig_id objects for this gen_id  or add this one ...
      */
+    // the node is shared by all packet threads so hold its shard until
+    // the window and count are updated
+    FilterCacheLock lock(local_cache, &key);
+    SFXHASH* local_hash = lock.get_hash();
+
     status = sfxhash_add(local_hash, (void*)&key, &data);
     if (status == SFXHASH_INTABLE)
     {
@@ -974,7 +952,7 @@ int sfthd_test_local(
  *   Test a global thresholding object
  */
 static inline int sfthd_test_global(
-    SFXHASH* global_hash,
+    FilterCache* global_cache,
     THD_NODE* sfthd_node,
     unsigned sig_id,     /* from current event */
     const sfip_t* sip,        /* " */
@@ -1038,6 +1016,11 @@ static inline int sfthd_test_global(
     data.tstart = data.tlast = curtime; /* Event time */
 
     /* Check for any Permanent sig_id objects for this gen_id  or add this one ...  */
+    // the node is shared by all packet threads so hold its shard until
+    // the window and count are updated
+    FilterCacheLock lock(global_cache, &key);
+    SFXHASH* global_hash = lock.get_hash();
+
     status = sfxhash_add(global_hash, (void*)&key, &data);
     if (status == SFXHASH_INTABLE)
     {
@@ -27,9 +27,12 @@
 #include "config.h"
 #endif
 
+#include <atomic>
+
 #include "utils/sflsq.h"
 #include "hash/sfghash.h"
 #include "hash/sfxhash.h"
+#include "filters/filter_cache.h"
 #include "main/policy.h"
 #include "sfip/sfip_t.h"
 
@@ -127,7 +130,7 @@ typedef struct
     int priority;
     int count;
     unsigned seconds;
-    uint64_t filtered;
+    std::atomic<uint64_t> filtered;  /* bumped by all packet threads */
     sfip_var_t* ip_address;
 } THD_NODE;
 
@@ -183,8 +186,8 @@ typedef struct
  */
 struct THD_STRUCT
 {
-    SFXHASH* ip_nodes;   /* Global hash of active IP's key=THD_IP_NODE_KEY, data=THD_IP_NODE */
-    SFXHASH* ip_gnodes;  /* Global hash of active IP's key=THD_IP_GNODE_KEY, data=THD_IP_GNODE */
+    FilterCache* ip_nodes;   /* Global hash of active IP's key=THD_IP_NODE_KEY, data=THD_IP_NODE */
+    FilterCache* ip_gnodes;  /* Global hash of active IP's key=THD_IP_GNODE_KEY, data=THD_IP_GNODE */
 };
 
 struct ThresholdObjects
@@ -210,13 +213,13 @@ struct ThresholdObjects
 // lbytes = local threshold memcap
 // gbytes = global threshold memcap (0 to disable global)
 THD_STRUCT* sfthd_new(unsigned lbytes, unsigned gbytes);
-SFXHASH* sfthd_local_new(unsigned bytes);
-SFXHASH* sfthd_global_new(unsigned bytes);
+FilterCache* sfthd_local_new(unsigned bytes);
+FilterCache* sfthd_global_new(unsigned bytes);
 void sfthd_free(THD_STRUCT*);
 ThresholdObjects* sfthd_objs_new(void);
 void sfthd_objs_free(ThresholdObjects*);
 
-int sfthd_test_rule(SFXHASH* rule_hash, THD_NODE* sfthd_node,
+int sfthd_test_rule(FilterCache* rule_hash, THD_NODE* sfthd_node,
     const sfip_t* sip, const sfip_t* dip, long curtime);
 
 void* sfthd_create_rule_threshold(
@@ -253,10 +256,8 @@ int sfthd_test_threshold(
     const sfip_t* dip,
     long curtime);
 
-SFXHASH* sfthd_new_hash(unsigned, size_t, size_t);
-
 int sfthd_test_local(
-    SFXHASH* local_hash,
+    FilterCache* local_hash,
     THD_NODE* sfthd_node,
     const sfip_t* sip,
     const sfip_t* dip,
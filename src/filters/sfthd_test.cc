@@ -22,6 +22,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "catch/catch.hpp"
 
 #include "sfip/sf_ip.h"
@@ -29,6 +33,7 @@
 #include "filters/sfthd.h"
 #include "utils/util.h"
 #include "main/snort_config.h"
+#include "main/policy.h"
 
 //---------------------------------------------------------------
 
@@ -90,7 +95,7 @@ typedef struct
 
 static THD_STRUCT* pThd = NULL;
 static ThresholdObjects* pThdObjs = NULL;
-static SFXHASH* dThd = NULL;
+static FilterCache* dThd = NULL;
 
 //---------------------------------------------------------------
 
@@ -890,6 +895,52 @@ static int PacketCheck(int i)
     return 0;
 }
 
+//---------------------------------------------------------------
+// many threads hitting one shared cache must get exactly the same number
+// of loggable events as one thread would
+
+#define NUM_THREADS  8
+#define NUM_ADDRS   64
+#define NUM_HITS  4096         // per thread
+
+static unsigned ThreadTest(FilterCache* cache, int type, int count)
+{
+    void* rule = sfthd_create_rule_threshold(
+        1, THD_TRK_SRC, type, count, 60);
+
+    NetworkPolicy* policy = get_network_policy();
+    std::atomic<unsigned> logged(0);
+    std::vector<std::thread> threads;
+
+    for ( unsigned t = 0; t < NUM_THREADS; ++t )
+    {
+        threads.push_back(std::thread([&policy, &logged, cache, rule]()
+        {
+            set_network_policy(policy);
+
+            sfip_t sip, dip;
+            sfip_pton(IP4_DST, &dip);
+            unsigned n = 0;
+
+            for ( unsigned i = 0; i < NUM_HITS; ++i )
+            {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "10.1.0.%u", i % NUM_ADDRS);
+                sfip_pton(buf, &sip);
+
+                if ( !sfthd_test_rule(cache, (THD_NODE*)rule, &sip, &dip, 100) )
+                    ++n;
+            }
+            logged += n;
+        }));
+    }
+    for ( auto& t : threads )
+        t.join();
+
+    free(rule);
+    return logged;
+}
+
 //---------------------------------------------------------------
 
 TEST_CASE("sfthd normal", "[sfthd]")
@@ -943,3 +994,27 @@ TEST_CASE("sfthd detect", "[sfthd]")
     Term();
 }
 
+
+TEST_CASE("sfthd threads", "[sfthd]")
+{
+    FilterCache* cache = sfthd_local_new(MEM_DEFAULT);
+    REQUIRE(cache);
+    CHECK(cache->get_shards() > 1);
+
+    // per address hits = NUM_THREADS * NUM_HITS / NUM_ADDRS = 512
+    SECTION("limit")
+    {
+        CHECK(ThreadTest(cache, THD_TYPE_LIMIT, 7) == NUM_ADDRS * 7);
+    }
+    SECTION("threshold")
+    {
+        CHECK(ThreadTest(cache, THD_TYPE_THRESHOLD, 50) == NUM_ADDRS * 10);
+    }
+    SECTION("both")
+    {
+        CHECK(ThreadTest(cache, THD_TYPE_BOTH, 20) == NUM_ADDRS);
+    }
+    CHECK(cache->get_count() == NUM_ADDRS);
+    delete cache;
+}
+
@@ -194,7 +194,7 @@ static int print_thd_node(THD_NODE* p, PrintFormat type, unsigned* prnMode)
                 "+-----------------------[filtered events]--------------------------------------\n");
             *prnMode = 2;
         }
-        SnortSnprintfAppend(buf, STD_BUF, " filtered=" STDu64, p->filtered);
+        SnortSnprintfAppend(buf, STD_BUF, " filtered=" STDu64, p->filtered.load());
     }
     LogMessage("%s\n", buf);
 
@@ -349,9 +349,9 @@ void sfthreshold_reset_active(void)
         return;
 
     if (thd_runtime->ip_nodes != NULL)
-        sfxhash_make_empty(thd_runtime->ip_nodes);
+        thd_runtime->ip_nodes->make_empty();
 
     if (thd_runtime->ip_gnodes != NULL)
-        sfxhash_make_empty(thd_runtime->ip_gnodes);
+        thd_runtime->ip_gnodes->make_empty();
 }
 
@@ -57,9 +57,6 @@ Flow::~Flow()
 void Flow::init(PktType proto)
 {
     protocol = proto;
-
-    // FIXIT-M getFlowbitSizeInBytes() should be attribute of ??? (or eliminate)
-    bitop = new BitOp(getFlowbitSizeInBytes());
 }
 
 void Flow::term()
@@ -85,6 +82,16 @@ void Flow::term()
         delete bitop;
 }
 
+BitOp* Flow::get_bitop(bool create)
+{
+    if ( !bitop and create )
+    {
+        unsigned n = getFlowbitSize();
+        bitop = new BitOp(n ? n : 1);
+    }
+    return bitop;
+}
+
 void Flow::reset()
 {
     if ( session )
@@ -116,7 +123,8 @@ void Flow::reset()
     // FIXIT-L need a struct to zero here to make future proof
     memset((uint8_t*)this+offset, 0, sizeof(Flow)-offset);
 
-    bitop->reset();
+    if ( bitop )
+        bitop->reset();
 }
 
 void Flow::restart(bool freeAppData)
@@ -124,7 +132,8 @@ void Flow::restart(bool freeAppData)
     if ( freeAppData )
         free_application_data();
 
-    bitop->reset();
+    if ( bitop )
+        bitop->reset();
 
     ssn_state.ignore_direction = 0;
     ssn_state.session_flags = SSNFLAG_NONE;
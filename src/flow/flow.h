@@ -137,6 +137,16 @@ public:
         RESET,
         ALLOW
     };
+
+    enum BypassReason
+    {
+        BYPASS_NONE,
+        BYPASS_BYTES,
+        BYPASS_RATE,
+        BYPASS_SERVICE,
+        BYPASS_DEPTH,
+        BYPASS_MAX
+    };
     Flow();
     ~Flow();
 
@@ -165,6 +175,9 @@ public:
 
     void set_ttl(Packet*, bool client);
 
+    // flowbits are allocated on first write; nullptr means none are set
+    BitOp* get_bitop(bool create = false);
+
     uint32_t update_session_flags( uint32_t flags )
     {
         return ssn_state.session_flags = flags;
@@ -219,6 +232,10 @@ public:
     bool full_inspection() const
     { return flow_state <= INSPECT; }
 
+    // true once the service inspector has been given inspect_depth bytes
+    bool depth_exhausted() const
+    { return inspect_depth and inspected_bytes >= inspect_depth; }
+
     void set_state(FlowState fs)
     { flow_state = fs; }
 
@@ -300,6 +317,13 @@ public:  // FIXIT-M privatize if possible
     sfip_t server_ip; // or uint8_t to reduce sizeof from 24 to 20
 
     uint64_t expire_time;
+    uint64_t byte_count;  // wire bytes, both directions
+    long start_time;      // packet time of first packet
+    const char* bypass_service;  // last service checked for bypass
+
+    uint64_t inspected_bytes;    // payload given to the service inspector
+    uint64_t inspect_depth;      // inspected_bytes limit; 0 is unlimited
+    const char* depth_service;   // service inspect_depth was set for
 
     int32_t iface_in;
     int32_t iface_out;
@@ -314,6 +338,9 @@ public:  // FIXIT-M privatize if possible
     uint8_t  outer_client_ttl, outer_server_ttl;
 
     uint8_t  response_count;
+    uint8_t  bypass_reason;
+    uint8_t  depth_index;        // stream.depth.services + 1 or 0
+    bool     depth_limited;
 
 public:
     LwState ssn_state;
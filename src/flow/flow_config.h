@@ -21,6 +21,10 @@
 #ifndef FLOW_CONFIG_H
 #define FLOW_CONFIG_H
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 // configured by the stream module for each cache instance
 
 struct FlowConfig
@@ -31,5 +35,40 @@ struct FlowConfig
     unsigned nominal_timeout = 0;
 };
 
+// configured by the stream module for all caches; inspected flows that
+// meet any of these are no longer reassembled or inspected and the rest
+// of their packets are whitelisted
+struct FlowBypassConfig
+{
+    uint64_t max_bytes = 0;  // both directions
+    uint64_t min_rate = 0;   // bytes per second over the life of the flow
+    std::vector<std::string> services;
+
+    bool enabled() const
+    { return max_bytes or min_rate or !services.empty(); }
+};
+
+// Flow::depth_index is a uint8_t with 0 for services not listed
+#define FLOW_DEPTH_MAX_SERVICES 255
+
+struct FlowDepthService
+{
+    std::string service;
+    uint64_t max_bytes = 0;
+};
+
+// configured by the stream module for all caches; limits the payload
+// given to the service inspector of each flow.  once reached, the flow is
+// bypassed or reassembly stops and only the packet headers are inspected.
+struct FlowDepthConfig
+{
+    uint64_t max_bytes = 0;  // services not listed; 0 is unlimited
+    bool bypass = true;      // else header only
+    std::vector<FlowDepthService> services;
+
+    bool enabled() const
+    { return max_bytes or !services.empty(); }
+};
+
 #endif
 
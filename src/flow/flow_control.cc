@@ -38,6 +38,7 @@
 #include "protocols/tcp.h"
 #include "protocols/udp.h"
 #include "protocols/icmp4.h"
+#include "time/latency.h"
 #include "protocols/icmp6.h"
 #include "detection/detect.h"
 
@@ -50,6 +51,8 @@ FlowControl::FlowControl()
     user_cache = nullptr;
     file_cache = nullptr;
     exp_cache = nullptr;
+    bypass = nullptr;
+    depth = nullptr;
 
     ip_mem = icmp_mem = nullptr;
     tcp_mem = udp_mem = nullptr;
@@ -69,6 +72,8 @@ FlowControl::~FlowControl()
     delete user_cache;
     delete file_cache;
     delete exp_cache;
+    delete bypass;
+    delete depth;
 
     free(ip_mem);
     free(icmp_mem);
@@ -89,6 +94,10 @@ static THREAD_LOCAL PegCount udp_count = 0;
 static THREAD_LOCAL PegCount user_count = 0;
 static THREAD_LOCAL PegCount file_count = 0;
 
+static THREAD_LOCAL PegCount bypass_flows[Flow::BYPASS_MAX] = { 0 };
+static THREAD_LOCAL PegCount bypass_pkts = 0;
+static THREAD_LOCAL PegCount bypass_bytes = 0;
+
 uint32_t FlowControl::max_flows(PktType proto)
 {
     FlowCache* cache = get_cache(proto);
@@ -119,12 +128,29 @@ PegCount FlowControl::get_flows(PktType proto)
     }
 }
 
+PegCount FlowControl::get_bypassed_flows(Flow::BypassReason why)
+{ return bypass_flows[why]; }
+
+PegCount FlowControl::get_bypassed_pkts()
+{ return bypass_pkts; }
+
+PegCount FlowControl::get_bypassed_bytes()
+{ return bypass_bytes; }
+
 void FlowControl::clear_counts()
 {
     ip_count = icmp_count = 0;
     tcp_count = udp_count = 0;
     user_count = file_count = 0;
 
+    for ( auto& n : bypass_flows )
+        n = 0;
+
+    bypass_pkts = bypass_bytes = 0;
+
+    for ( auto& n : depth_counts )
+        n = 0;
+
     FlowCache* cache;
 
     if ( (cache = get_cache(PktType::IP)) )
@@ -436,9 +462,12 @@ unsigned FlowControl::process(Flow* flow, Packet* p)
             (!flow->ssn_client || !flow->session->setup(p))) )
             flow->set_state(Flow::ALLOW);
 
+        flow->start_time = p->pkth->ts.tv_sec;
         ++news;
     }
     flow->set_direction(p);
+    flow->byte_count += p->pkth->pktlen;
+    Latency::lap(LS_FLOW);
 
     switch ( flow->flow_state )
     {
@@ -449,10 +478,19 @@ unsigned FlowControl::process(Flow* flow, Packet* p)
     case Flow::INSPECT:
         assert(flow->ssn_client);
         assert(flow->ssn_server);
+
+        if ( (bypass or depth) and check_bypass(flow, p) )
+            break;
+
         flow->session->process(p);
         break;
 
     case Flow::ALLOW:
+        if ( flow->bypass_reason )
+        {
+            bypass_pkts++;
+            bypass_bytes += p->pkth->pktlen;
+        }
         if ( news )
             stream.stop_inspection(flow, p, SSN_DIR_BOTH, -1, 0);
         else
@@ -780,6 +818,112 @@ void FlowControl::init_exp(uint32_t max)
     exp_cache = new ExpectCache(max);
 }
 
+void FlowControl::init_bypass(const FlowBypassConfig& fbc)
+{
+    delete bypass;
+    bypass = new FlowBypassConfig(fbc);
+}
+
+void FlowControl::init_depth(const FlowDepthConfig& fdc)
+{
+    delete depth;
+    depth = new FlowDepthConfig(fdc);
+    depth_counts.assign(fdc.services.size() + 1, 0);
+}
+
+Flow::BypassReason FlowControl::get_bypass_reason(Flow* flow, const Packet* p)
+{
+    if ( bypass->max_bytes and flow->byte_count >= bypass->max_bytes )
+        return Flow::BYPASS_BYTES;
+
+    if ( bypass->min_rate )
+    {
+        long secs = p->pkth->ts.tv_sec - flow->start_time;
+
+        // need at least a second to get a meaningful rate
+        if ( secs > 0 and flow->byte_count / secs >= bypass->min_rate )
+            return Flow::BYPASS_RATE;
+    }
+
+    // check each service the flow is assigned once
+    if ( flow->service and flow->service != flow->bypass_service )
+    {
+        flow->bypass_service = flow->service;
+
+        for ( const auto& s : bypass->services )
+        {
+            if ( s == flow->service )
+                return Flow::BYPASS_SERVICE;
+        }
+    }
+    return Flow::BYPASS_NONE;
+}
+
+// returns true when the flow first reaches its depth for its service
+bool FlowControl::check_depth(Flow* flow)
+{
+    // the budget is per service so it starts over if the service changes
+    // (eg starttls), even if the last service was limited
+    if ( flow->service != flow->depth_service )
+    {
+        flow->depth_service = flow->service;
+        flow->inspect_depth = depth->max_bytes;
+        flow->inspected_bytes = 0;
+        flow->depth_index = 0;
+        flow->depth_limited = false;
+
+        for ( unsigned i = 0; flow->service and i < depth->services.size(); ++i )
+        {
+            if ( depth->services[i].service == flow->service )
+            {
+                flow->inspect_depth = depth->services[i].max_bytes;
+                flow->depth_index = i + 1;
+                break;
+            }
+        }
+    }
+
+    if ( flow->depth_limited or !flow->depth_exhausted() )
+        return false;
+
+    flow->depth_limited = true;
+    depth_counts[flow->depth_index]++;
+    return true;
+}
+
+// returns true if the flow is bypassed
+bool FlowControl::check_bypass(Flow* flow, Packet* p)
+{
+    Flow::BypassReason why = bypass ? get_bypass_reason(flow, p) : Flow::BYPASS_NONE;
+
+    if ( why == Flow::BYPASS_NONE and depth and check_depth(flow) )
+    {
+        if ( depth->bypass )
+            why = Flow::BYPASS_DEPTH;
+
+        else
+        {
+            // header only; InspectorManager::full_inspection() skips the
+            // service inspector and fast pattern rules until the service
+            // changes and the new service's splitters are installed
+            stream.set_splitter(flow, true, nullptr);
+            stream.set_splitter(flow, false, nullptr);
+            return false;
+        }
+    }
+
+    if ( why == Flow::BYPASS_NONE )
+        return false;
+
+    // flush what is queued and leave the session as is; the rest of the
+    // flow is whitelisted by update_verdict()
+    stream.stop_inspection(flow, p, SSN_DIR_BOTH, -1, 0);
+    flow->set_state(Flow::ALLOW);
+    flow->bypass_reason = why;
+    bypass_flows[why]++;
+    return true;
+}
+
 char FlowControl::expected_flow(Flow* flow, Packet* p)
 {
     char ignore = exp_cache->check(p, flow);
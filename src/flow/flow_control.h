@@ -53,6 +53,8 @@ public:
     void init_user(const FlowConfig&, InspectSsnFunc);
     void init_file(const FlowConfig&, InspectSsnFunc);
     void init_exp(uint32_t max);
+    void init_bypass(const FlowBypassConfig&);
+    void init_depth(const FlowDepthConfig&);
 
     void delete_flow(const FlowKey*);
     void delete_flow(Flow*, const char* why);
@@ -77,6 +79,17 @@ public:
 
     PegCount get_prunes(PktType);
     PegCount get_flows(PktType);
+    PegCount get_bypassed_flows(Flow::BypassReason);
+    PegCount get_bypassed_pkts();
+    PegCount get_bypassed_bytes();
+
+    // flows limited by stream.depth, indexed by Flow::depth_index
+    const std::vector<PegCount>& get_depth_counts()
+    { return depth_counts; }
+
+    const FlowDepthConfig* get_depth_config()
+    { return depth; }
+
     void clear_counts();
 
     class Memcap& get_memcap(PktType);
@@ -86,6 +99,9 @@ private:
     void set_key(FlowKey*, Packet*);
 
     unsigned process(Flow*, Packet*);
+    Flow::BypassReason get_bypass_reason(Flow*, const Packet*);
+    bool check_depth(Flow*);
+    bool check_bypass(Flow*, Packet*);
 
 private:
     FlowCache* ip_cache;
@@ -111,6 +127,9 @@ private:
     InspectSsnFunc get_file;
 
     class ExpectCache* exp_cache;
+    FlowBypassConfig* bypass;
+    FlowDepthConfig* depth;
+    std::vector<PegCount> depth_counts;
 };
 
 #endif
@@ -18,45 +18,71 @@
 // data_bus.cc author Russ Combs <rucombs@cisco.com>
 
 #include "framework/data_bus.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 #include "main/policy.h"
 #include "protocols/packet.h"
 
 DataBus& get_data_bus()
 { return get_inspection_policy()->dbus; }
 
-class BufferEvent : public DataEvent
+const PegInfo data_bus_pegs[] =
 {
-public:
-    BufferEvent(const uint8_t* b, unsigned n)
-    { buf = b; len = n; }
+    { "publishes", "events published" },
+    { "unheard", "events published without subscribers" },
+    { "handled", "subscriber calls" },
+    { nullptr, nullptr }
+};
 
-    const uint8_t* get_data(unsigned& n) override
-    { n = len; return buf; }
+THREAD_LOCAL DataBusStats data_bus_stats;
 
-private:
-    const uint8_t* buf;
-    unsigned len;
-};
+//-------------------------------------------------------------------------
+// event ids
+//-------------------------------------------------------------------------
+
+typedef std::unordered_map<std::string, unsigned> DataIdMap;
+
+static std::mutex id_mutex;
 
-class PacketEvent : public DataEvent
+static DataIdMap& get_ids()
 {
-public:
-    PacketEvent(Packet* p)
-    { packet = p; }
+    static DataIdMap ids
+    {
+        { PACKET_EVENT, PACKET_EVENT_ID },
+        { HTTP_URI_EVENT, HTTP_URI_EVENT_ID },
+        { HTTP_RAW_URI_EVENT, HTTP_RAW_URI_EVENT_ID },
+    };
+    return ids;
+}
 
-    const Packet* get_packet() override
-    { return packet; }
+unsigned DataBus::get_id(const char* key)
+{
+    std::lock_guard<std::mutex> lock(id_mutex);
+    DataIdMap& ids = get_ids();
 
-private:
-    const Packet* packet;
-};
+    auto it = ids.find(key);
+
+    if ( it != ids.end() )
+        return it->second;
+
+    unsigned id = ids.size();
+    ids[key] = id;
+    return id;
+}
+
+//-------------------------------------------------------------------------
+// bus
+//-------------------------------------------------------------------------
 
 DataBus::DataBus() { }
 
 DataBus::~DataBus()
 {
-    for ( auto& p : map )
-        for ( auto* h : p.second )
+    for ( auto& v : lists )
+        for ( auto* h : v )
             delete h;
 }
 
@@ -64,30 +90,50 @@ DataBus::~DataBus()
 // publication of given event
 void DataBus::subscribe(const char* key, DataHandler* h)
 {
-    DataList& v = map[key];
-    v.push_back(h);
+    subscribe(get_id(key), h);
+}
+
+void DataBus::subscribe(unsigned id, DataHandler* h)
+{
+    if ( id >= lists.size() )
+        lists.resize(id + 1);
+
+    lists[id].push_back(h);
 }
 
 // notify subscribers of event
-void DataBus::publish(const char* key, DataEvent& e, Flow* f)
+void DataBus::publish(unsigned id, DataEvent& e, Flow* f)
 {
-    DataList& v = map[key];
+    ++data_bus_stats.publishes;
 
-    for ( auto* h : v )
+    if ( id >= lists.size() or lists[id].empty() )
+    {
+        ++data_bus_stats.unheard;
+        return;
+    }
+
+    for ( auto* h : lists[id] )
         h->handle(e, f);
+
+    data_bus_stats.handled += lists[id].size();
 }
 
-void DataBus::publish(const char* key, const uint8_t* buf, unsigned len, Flow* f)
+void DataBus::publish(unsigned id, const uint8_t* buf, unsigned len, Flow* f)
 {
-    BufferEvent e(buf, len);
-    publish(key, e, f);
+    DataEvent e(buf, len);
+    publish(id, e, f);
 }
 
-void DataBus::publish(const char* key, Packet* p, Flow* f)
+void DataBus::publish(unsigned id, Packet* p, Flow* f)
 {
-    PacketEvent e(p);
+    DataEvent e(p);
     if ( !f )
         f = p->flow;
-    publish(key, e, f);
+    publish(id, e, f);
+}
+
+void DataBus::publish(const char* key, DataEvent& e, Flow* f)
+{
+    publish(get_id(key), e, f);
 }
 
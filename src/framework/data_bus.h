@@ -26,36 +26,53 @@
 // a publish-subscribe mechanism, it is possible to add custom processing
 // at arbitrary points, eg when service is identified, or when a URI is
 // available, or when a flow clears.
+//
+// Event keys are interned to small integer ids that are the same for all
+// policies and configurations.  Publishers should get the id once (the
+// common events have fixed ids) and publish by id; that indexes the
+// subscriber list directly and doesn't allocate.
 
-#include <map>
-#include <string>
 #include <vector>
 
-// FIXIT-P evaluate perf; focus is on correctness
 typedef std::vector<class DataHandler*> DataList;
-typedef std::map<std::string, DataList> DataMap;
 
 #include "main/snort_types.h"
+#include "main/thread.h"
+#include "framework/counts.h"
 
 class Flow;
 struct Packet;
 
+// events are typically constructed on the stack by the publisher.  the
+// packet and data accessors aren't virtual; subclasses that provide
+// something else set them in the constructor.
 class DataEvent
 {
 public:
+    DataEvent(const Packet* p)
+    { packet = p; data = nullptr; len = 0; }
+
+    DataEvent(const uint8_t* buf, unsigned n)
+    { packet = nullptr; data = buf; len = n; }
+
     virtual ~DataEvent() { }
 
-    virtual const Packet* get_packet()
-    { return nullptr; }
+    const Packet* get_packet()
+    { return packet; }
 
-    virtual const uint8_t* get_data(unsigned& len)
-    { len = 0; return nullptr; }
+    const uint8_t* get_data(unsigned& n)
+    { n = len; return data; }
 
-    virtual const uint8_t* get_normalized_data(unsigned& len)
-    { return get_data(len); }
+    virtual const uint8_t* get_normalized_data(unsigned& n)
+    { return get_data(n); }
 
 protected:
-    DataEvent() { }
+    DataEvent()
+    { packet = nullptr; data = nullptr; len = 0; }
+
+    const Packet* packet;
+    const uint8_t* data;
+    unsigned len;
 };
 
 class DataHandler
@@ -75,23 +92,54 @@ public:
     DataBus();
     ~DataBus();
 
+    // returns the id of key, assigning the next one if it is new.  ids are
+    // never reused.  this locks; call at configuration or init time.
+    static unsigned get_id(const char* key);
+
     void subscribe(const char* key, DataHandler*);
-    void publish(const char* key, DataEvent&, Flow* = nullptr);
+    void subscribe(unsigned id, DataHandler*);
+
+    // notify subscribers of event
+    void publish(unsigned id, DataEvent&, Flow* = nullptr);
 
     // convenience methods
-    void publish(const char* key, const uint8_t*, unsigned, Flow* = nullptr);
-    void publish(const char* key, Packet*, Flow* = nullptr);
+    void publish(unsigned id, const uint8_t*, unsigned, Flow* = nullptr);
+    void publish(unsigned id, Packet*, Flow* = nullptr);
+
+    // same as above after looking up the id of key (slower)
+    void publish(const char* key, DataEvent&, Flow* = nullptr);
 
 private:
-    DataMap map;
+    std::vector<DataList> lists;  // by id
 };
 
 // FIXIT-L this should be in snort_confg.h or similar but that
 // requires refactoring to work as installed header
 SO_PUBLIC DataBus& get_data_bus();
 
+struct DataBusStats
+{
+    PegCount publishes;
+    PegCount unheard;
+    PegCount handled;
+};
+
+extern const PegInfo data_bus_pegs[];
+extern THREAD_LOCAL DataBusStats data_bus_stats;
+
 // common data events
 #define PACKET_EVENT "detection.packet"
+#define HTTP_URI_EVENT "http_uri"
+#define HTTP_RAW_URI_EVENT "http_raw_uri"
+
+// the common events are interned first so they have these ids
+enum
+{
+    PACKET_EVENT_ID,
+    HTTP_URI_EVENT_ID,
+    HTTP_RAW_URI_EVENT_ID,
+    DATA_EVENT_ID_MAX
+};
 
 #endif
 
@@ -31,7 +31,7 @@
 struct Packet;
 
 // this is the current version of the api
-#define LOGAPI_VERSION ((BASE_API_VERSION << 16) | 0)
+#define LOGAPI_VERSION ((BASE_API_VERSION << 16) | 1)
 
 #define OUTPUT_TYPE_FLAG__NONE  0x0
 #define OUTPUT_TYPE_FLAG__ALERT 0x1
@@ -54,6 +54,9 @@ public:
     virtual void close() { }
     virtual void reset() { }
 
+    // called when the packet thread has nothing to do
+    virtual void idle() { }
+
     virtual void alert(Packet*, const char*, Event*) { }
     virtual void log(Packet*, const char*, Event*) { }
 
@@ -21,6 +21,11 @@
 #define SWAPPER_H
 
 // used to make thread local, pointer-based config swaps by packet threads
+//
+// each reload creates a swapper with the next epoch that holds all of the
+// current configs so a packet thread that misses a swap can go straight to
+// the latest one.  a swapper is retired with the configs it replaced and
+// deleted once every packet thread has applied that epoch or a later one.
 
 struct SnortConfig;
 struct tTargetBasedConfig;
@@ -28,14 +33,25 @@ struct tTargetBasedConfig;
 class Swapper
 {
 public:
+    // startup: the current configs at the current epoch
     Swapper(SnortConfig*, tTargetBasedConfig*);
-    Swapper(SnortConfig*, SnortConfig*);
-    Swapper(tTargetBasedConfig*, tTargetBasedConfig*);
+
+    // reload: old and new configs at the next epoch
+    Swapper(SnortConfig* old_conf, SnortConfig* new_conf,
+        tTargetBasedConfig* old_attribs, tTargetBasedConfig* new_attribs);
+
     ~Swapper();
 
     void apply();
 
+    unsigned get_epoch() const
+    { return epoch; }
+
+    static unsigned get_current_epoch();
+
 private:
+    unsigned epoch;
+
     SnortConfig* old_conf;
     SnortConfig* new_conf;
 
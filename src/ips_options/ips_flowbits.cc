@@ -69,6 +69,10 @@ using namespace std;
 #include "framework/parameter.h"
 #include "framework/module.h"
 
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
 #define s_name "flowbits"
 
 static THREAD_LOCAL ProfileStats flowBitsPerfStats;
@@ -121,6 +125,14 @@ typedef enum
 **
 **  The type element track only one operation.
 */
+struct FLOWBITS_GRP
+{
+    uint16_t count;
+    char* name;
+    uint32_t group_id;
+    BitOp* GrpBitOp;
+};
+
 struct FLOWBITS_OP
 {
     uint16_t* ids;
@@ -130,24 +142,14 @@ struct FLOWBITS_OP
     char* name;
     char* group;
     uint32_t group_id;
+    FLOWBITS_GRP* grp;    /* resolved at parse time; mask built at verify */
 };
 
-typedef struct _FLOWBITS_GRP
-{
-    uint16_t count;
-    uint16_t max_id;
-    char* name;
-    uint32_t group_id;
-    BitOp* GrpBitOp;
-} FLOWBITS_GRP;
-
 static SFGHASH* flowbits_grp_hash = NULL;
 
 static std::forward_list<const FLOWBITS_OP*> op_list;
 
-static int check_flowbits(
-    uint8_t type, uint8_t evalType, uint16_t* ids, uint16_t num_ids,
-    char* group, Packet* p);
+static int check_flowbits(const FLOWBITS_OP*, Packet*);
 
 class FlowBitsOption : public IpsOption
 {
@@ -264,186 +266,166 @@ int FlowBitsOption::eval(Cursor&, Packet* p)
         return DETECTION_OPTION_NO_MATCH;
 
 
-    return check_flowbits(flowbits->type, (uint8_t)flowbits->eval,
-        flowbits->ids, flowbits->num_ids, flowbits->group, p);
+    return check_flowbits(flowbits, p);
 }
 
 //-------------------------------------------------------------------------
 // helper methods
 //-------------------------------------------------------------------------
 
-static inline int clear_group_bit(BitOp* bitop, char* group)
+// group masks are built by init_groups() once all rules are loaded so
+// group operations are simple word-wise mask operations on the flow bits
+static inline const BitOp* get_group_mask(const FLOWBITS_OP* fbop)
 {
-    FLOWBITS_GRP* flowbits_grp;
-    BitOp* GrpBitOp;
-    unsigned int i, max_bytes;
+    const FLOWBITS_GRP* grp = fbop->grp;
 
-    if ( group == NULL )
-        return 0;
+    if ( !grp or !grp->count )
+        return nullptr;
 
-    // FIXIT-M why is the hash lookup done at runtime for flowbits groups?
-    // a pointer to flowbis_grp should be in flowbits config data
-    // this *should* be safe but iff splay mode is disabled
-    flowbits_grp = (FLOWBITS_GRP*)sfghash_find(flowbits_grp_hash, group);
-    if ( flowbits_grp == NULL )
-        return 0;
-    if ((bitop == NULL) || (bitop->get_max_bits() <= flowbits_grp->max_id) || flowbits_grp->count == 0)
+    return grp->GrpBitOp;
+}
+
+static inline int clear_group_bit(BitOp* bitop, const FLOWBITS_OP* fbop)
+{
+    const BitOp* mask = get_group_mask(fbop);
+
+    if ( !mask )
         return 0;
-    GrpBitOp = flowbits_grp->GrpBitOp;
 
-    /* note, max_id is an index, not a count.
-     * Calculate max_bytes by adding 8 to max_id, then dividing by 8.  */
-    max_bytes = (flowbits_grp->max_id + 8) >> 3;
-    for ( i = 0; i < max_bytes; i++ )
-    {
-        (*bitop)[i] &= ~((*GrpBitOp)[i]);
-    }
+    if ( bitop )
+        bitop->clear(*mask);
+
     return 1;
 }
 
-static inline int toggle_group_bit(BitOp* bitop, char* group)
+static inline int toggle_group_bit(BitOp* bitop, const FLOWBITS_OP* fbop)
 {
-    FLOWBITS_GRP* flowbits_grp;
-    BitOp* GrpBitOp;
-    unsigned int i, max_bytes;
+    const BitOp* mask = get_group_mask(fbop);
 
-    if ( group == NULL )
+    if ( !mask )
         return 0;
-    flowbits_grp = (FLOWBITS_GRP*)sfghash_find(flowbits_grp_hash, group);
-    if ( flowbits_grp == NULL )
-        return 0;
-    if ((bitop == NULL) || (bitop->get_max_bits() <= flowbits_grp->max_id) || flowbits_grp->count == 0)
-        return 0;
-    GrpBitOp = flowbits_grp->GrpBitOp;
 
-    /* note, max_id is an index, not a count.
-     * Calculate max_bytes by adding 8 to max_id, then dividing by 8.  */
-    max_bytes = (flowbits_grp->max_id + 8) >> 3;
-    for ( i = 0; i < max_bytes; i++ )
-    {
-        (*bitop)[i] ^= (*GrpBitOp)[i];
-    }
+    bitop->toggle(*mask);
     return 1;
 }
 
-static inline int set_xbits_to_group(
-    BitOp* bitop, uint16_t* ids, uint16_t num_ids, char* group)
+static inline int set_xbits_to_group(BitOp* bitop, const FLOWBITS_OP* fbop)
 {
-    unsigned int i;
-    if (!clear_group_bit(bitop, group))
+    if (!clear_group_bit(bitop, fbop))
         return 0;
-    for (i = 0; i < num_ids; i++)
-        bitop->set(ids[i]);
+    for (unsigned i = 0; i < fbop->num_ids; i++)
+        bitop->set(fbop->ids[i]);
     return 1;
 }
 
-static inline int is_set_flowbits(
-    BitOp* bitop, uint8_t eval, uint16_t* ids,
-    uint16_t num_ids, char* group)
+// a null bitop means that no bits have been set on the flow
+static inline int is_set_flowbits(const BitOp* bitop, const FLOWBITS_OP* fbop)
 {
     unsigned int i;
-    FLOWBITS_GRP* flowbits_grp;
-    Flowbits_eval evalType = (Flowbits_eval)eval;
+    const BitOp* mask;
 
-    switch (evalType)
+    switch (fbop->eval)
     {
     case FLOWBITS_AND:
-        for (i = 0; i < num_ids; i++)
+        if ( !bitop )
+            return fbop->num_ids == 0;
+
+        for (i = 0; i < fbop->num_ids; i++)
         {
-            if (!bitop->is_set(ids[i]))
+            if (!bitop->is_set(fbop->ids[i]))
                 return 0;
         }
         return 1;
-        break;
+
     case FLOWBITS_OR:
-        for (i = 0; i < num_ids; i++)
+        if ( !bitop )
+            return 0;
+
+        for (i = 0; i < fbop->num_ids; i++)
         {
-            if (bitop->is_set(ids[i]))
+            if (bitop->is_set(fbop->ids[i]))
                 return 1;
         }
         return 0;
-        break;
+
     case FLOWBITS_ALL:
-        flowbits_grp = (FLOWBITS_GRP*)sfghash_find(flowbits_grp_hash, group);
-        if ( flowbits_grp == NULL )
+        if ( !fbop->grp )
             return 0;
-        for ( i = 0; i <= (unsigned int)(flowbits_grp->max_id >>3); i++ )
-        {
-            uint8_t val = (*bitop)[i] &
-                (*(flowbits_grp->GrpBitOp))[i];
-            if (val != (*(flowbits_grp->GrpBitOp))[i])
-                return 0;
-        }
-        return 1;
-        break;
+
+        mask = get_group_mask(fbop);
+
+        if ( !mask )
+            return 1;
+
+        return bitop ? bitop->is_set_all(*mask) : mask->is_clear();
+
     case FLOWBITS_ANY:
-        flowbits_grp = (FLOWBITS_GRP*)sfghash_find(flowbits_grp_hash, group);
-        if ( flowbits_grp == NULL )
+        mask = get_group_mask(fbop);
+
+        if ( !bitop or !mask )
             return 0;
-        for ( i = 0; i <= (unsigned int)(flowbits_grp->max_id >>3); i++ )
-        {
-            uint8_t val = (*bitop)[i] &
-                (*(flowbits_grp->GrpBitOp))[i];
-            if (val)
-                return 1;
-        }
-        return 0;
-        break;
+
+        return bitop->is_set_any(*mask);
+
     default:
         return 0;
     }
 }
 
-static int check_flowbits(
-    uint8_t type, uint8_t evalType, uint16_t* ids, uint16_t num_ids, char* group, Packet* p)
+static int check_flowbits(const FLOWBITS_OP* fbop, Packet* p)
 {
     int rval = DETECTION_OPTION_NO_MATCH;
-    BitOp* bitop;
-    Flowbits_eval eval = (Flowbits_eval)evalType;
     int result = 0;
-    int i;
+    unsigned i;
 
-    bitop = stream.get_flow_bitop(p);
-    if (!bitop)
+    if ( !p->flow )
     {
         DebugMessage(DEBUG_FLOWBITS, "No FLOWBITS_DATA");
         return rval;
     }
 
-    switch (type)
+    // only allocate flowbits on the flow when a bit may be set
+    bool create = (fbop->type & (FLOWBITS_SET | FLOWBITS_SETX | FLOWBITS_TOGGLE)) != 0;
+    BitOp* bitop = stream.get_flow_bitop(p, create);
+
+    switch (fbop->type)
     {
     case FLOWBITS_SET:
-        for (i = 0; i < num_ids; i++)
-            bitop->set(ids[i]);
+        for (i = 0; i < fbop->num_ids; i++)
+            bitop->set(fbop->ids[i]);
         result = 1;
         break;
 
     case FLOWBITS_SETX:
-        result = set_xbits_to_group(bitop, ids, num_ids, group);
+        result = set_xbits_to_group(bitop, fbop);
         break;
 
     case FLOWBITS_UNSET:
-        if (eval == FLOWBITS_ALL )
-            clear_group_bit(bitop, group);
-        else
+        if (fbop->eval == FLOWBITS_ALL )
+            clear_group_bit(bitop, fbop);
+
+        else if ( bitop )
         {
-            for (i = 0; i < num_ids; i++)
-                bitop->clear(ids[i]);
+            for (i = 0; i < fbop->num_ids; i++)
+                bitop->clear(fbop->ids[i]);
         }
         result = 1;
         break;
 
     case FLOWBITS_RESET:
-        if (!group)
-            bitop->reset();
+        if (!fbop->group)
+        {
+            if ( bitop )
+                bitop->reset();
+        }
         else
-            clear_group_bit(bitop, group);
+            clear_group_bit(bitop, fbop);
         result = 1;
         break;
 
     case FLOWBITS_ISSET:
 
-        if (is_set_flowbits(bitop,(uint8_t)eval, ids, num_ids, group))
+        if (is_set_flowbits(bitop, fbop))
         {
             result = 1;
         }
@@ -455,7 +437,7 @@ static int check_flowbits(
         break;
 
     case FLOWBITS_ISNOTSET:
-        if (!is_set_flowbits(bitop, (uint8_t)eval, ids, num_ids, group))
+        if (!is_set_flowbits(bitop, fbop))
         {
             result = 1;
         }
@@ -466,19 +448,19 @@ static int check_flowbits(
         break;
 
     case FLOWBITS_TOGGLE:
-        if (group)
-            toggle_group_bit(bitop, group);
+        if (fbop->group)
+            toggle_group_bit(bitop, fbop);
         else
         {
-            for (i = 0; i < num_ids; i++)
+            for (i = 0; i < fbop->num_ids; i++)
             {
-                if (bitop->is_set(ids[i]))
+                if (bitop->is_set(fbop->ids[i]))
                 {
-                    bitop->clear(ids[i]);
+                    bitop->clear(fbop->ids[i]);
                 }
                 else
                 {
-                    bitop->set(ids[i]);
+                    bitop->set(fbop->ids[i]);
                 }
             }
         }
@@ -522,19 +504,11 @@ static uint16_t flowbits_count = 0;
 static uint16_t flowbits_grp_count = 0;
 static int flowbits_toggle = 1;
 
-// FIXIT-L consider allocating flowbits on session on demand instead of
-// preallocating.
-
 unsigned int getFlowbitSize()
 {
     return flowbits_count;
 }
 
-unsigned int getFlowbitSizeInBytes()
-{
-    return flowbits_count ? (flowbits_count + 7) >> 3 : 1;
-}
-
 void FlowbitResetCounts(void)
 {
     SFGHASH_NODE* n;
@@ -854,6 +828,7 @@ static void processFlowBitsWithGroup(char* flowbitsName, char* groupName, FLOWBI
     {
         flowbits->group = SnortStrdup(groupName);
         flowbits->group_id = flowbits_grp->group_id;
+        flowbits->grp = flowbits_grp;
     }
     validateFlowbitsSyntax(flowbits);
     DEBUG_WRAP(printOutFlowbits(flowbits));
@@ -939,6 +914,7 @@ static FLOWBITS_OP* flowbits_parse(const char* data)
             flowbits_grp = getFlowBitGroup(groupName);
             flowbits->group = groupName;
             flowbits->group_id = flowbits_grp->group_id;
+            flowbits->grp = flowbits_grp;
         }
         flowbits->type = FLOWBITS_RESET;
         flowbits->ids   = NULL;
@@ -976,10 +952,6 @@ static FLOWBITS_OP* flowbits_parse(const char* data)
 static void update_group(FLOWBITS_GRP* flowbits_grp, int id)
 {
     flowbits_grp->count++;
-
-    if ( flowbits_grp->max_id < id )
-        flowbits_grp->max_id = id;
-
     flowbits_grp->GrpBitOp->set(id);
 }
 
@@ -988,7 +960,7 @@ static void init_groups()
     if ( !flowbits_hash or !flowbits_grp_hash )
         return;
 
-    unsigned size = getFlowbitSizeInBytes();
+    unsigned size = flowbits_count ? flowbits_count : 1;
 
     for ( SFGHASH_NODE* n = sfghash_findfirst(flowbits_grp_hash);
         n != NULL;
@@ -1002,7 +974,7 @@ static void init_groups()
     while ( !op_list.empty() )
     {
         const FLOWBITS_OP* fbop = op_list.front();
-        FLOWBITS_GRP* fbg = (FLOWBITS_GRP*)sfghash_find(flowbits_grp_hash, fbop->group);
+        FLOWBITS_GRP* fbg = fbop->grp;
         assert(fbg);
 
         for ( int i = 0; i < fbop->num_ids; ++i )
@@ -1269,3 +1241,72 @@ static const IpsApi flowbits_api =
 
 const BaseApi* ips_flowbits = &flowbits_api.base;
 
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+TEST_CASE("flowbits lazy allocation", "[flowbits]")
+{
+    BitOp bits(100);
+
+    CHECK(bits.get_max_bits() == 128);
+    CHECK(bits.is_clear());
+    CHECK(!bits.is_set(99));
+
+    bits.clear(5);
+    bits.reset();
+    CHECK(bits.is_clear());
+
+    bits.set(99);
+    CHECK(bits.is_set(99));
+    CHECK(!bits.is_clear());
+
+    bits.clear(99);
+    CHECK(bits.is_clear());
+}
+
+TEST_CASE("flowbits group masks", "[flowbits]")
+{
+    BitOp grp(200);
+    grp.set(3);
+    grp.set(64);
+    grp.set(190);
+
+    BitOp bits(200);
+    CHECK(!bits.is_set_any(grp));
+    CHECK(!bits.is_set_all(grp));
+
+    bits.set(64);
+    bits.set(10);
+    CHECK(bits.is_set_any(grp));
+    CHECK(!bits.is_set_all(grp));
+
+    bits.set(grp);
+    CHECK(bits.is_set_all(grp));
+
+    bits.clear(grp);
+    CHECK(!bits.is_set_any(grp));
+    CHECK(bits.is_set(10));
+
+    bits.toggle(grp);
+    CHECK(bits.is_set_all(grp));
+    bits.toggle(grp);
+    CHECK(!bits.is_set_any(grp));
+    CHECK(bits.is_set(10));
+}
+
+TEST_CASE("flowbits mask larger than flow", "[flowbits]")
+{
+    // flows allocated before a reload may be smaller than new groups
+    BitOp grp(256);
+    grp.set(1);
+    grp.set(200);
+
+    BitOp bits(64);
+    bits.set(grp);
+    CHECK(bits.is_set(1));
+    CHECK(!bits.is_set_all(grp));
+    CHECK(bits.is_set_any(grp));
+}
+#endif
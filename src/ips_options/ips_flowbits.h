@@ -25,7 +25,6 @@ int FlowBits_SetOperation(void*);
 
 void setFlowbitSize(unsigned);
 unsigned int getFlowbitSize();
-unsigned int getFlowbitSizeInBytes();
 
 #endif
 
@@ -71,11 +71,65 @@
  * utility functions
  *--------------------------------------------------------------------
  */
+static inline char* put_2d(char* s, unsigned u)
+{
+    *s++ = '0' + u / 10;
+    *s++ = '0' + u % 10;
+    return s;
+}
+
+// same output as ts_print() but the date part only changes once a day so
+// it is cached and just the time of day is formatted for each event
 void LogTimeStamp(TextLog* log, Packet* p)
 {
-    char timestamp[TIMEBUF_SIZE];
-    ts_print((struct timeval*)&p->pkth->ts, timestamp);
-    TextLog_Puts(log, timestamp);
+    static THREAD_LOCAL time_t last_day = -1;
+    static THREAD_LOCAL bool last_year = false;
+    static THREAD_LOCAL char date[16];
+    static THREAD_LOCAL int date_len = 0;
+
+    int zone = SnortConfig::output_use_utc() ? 0 : snort_conf->thiszone;
+    bool year = SnortConfig::output_include_year();
+
+    time_t t = p->pkth->ts.tv_sec + zone;
+    unsigned sec = t % 86400;
+    time_t day = t - sec;
+
+    if ( day != last_day or year != last_year )
+    {
+        struct tm ttm;
+        struct tm* lt = gmtime_r(&day, &ttm);
+
+        if ( year )
+            date_len = snprintf(date, sizeof(date), "%02d/%02d/%02d-",
+                lt->tm_mon + 1, lt->tm_mday, lt->tm_year % 100);
+        else
+            date_len = snprintf(date, sizeof(date), "%02d/%02d-",
+                lt->tm_mon + 1, lt->tm_mday);
+
+        last_day = day;
+        last_year = year;
+    }
+    char buf[32];
+    memcpy(buf, date, date_len);
+
+    char* s = buf + date_len;
+    s = put_2d(s, sec / 3600);
+    *s++ = ':';
+    s = put_2d(s, (sec % 3600) / 60);
+    *s++ = ':';
+    s = put_2d(s, sec % 60);
+    *s++ = '.';
+
+    unsigned usec = p->pkth->ts.tv_usec % 1000000;
+
+    for ( int i = 5; i >= 0; --i )
+    {
+        s[i] = '0' + usec % 10;
+        usec /= 10;
+    }
+    s += 6;
+
+    TextLog_Write(log, buf, s - buf);
 }
 
 /*--------------------------------------------------------------------
@@ -324,9 +378,9 @@ void LogIpAddrs(TextLog* log, Packet* p)
         }
         else
         {
-            TextLog_Print(log, ip_fmt,
-                inet_ntoax(p->ptrs.ip_api.get_src()),
-                inet_ntoax((p->ptrs.ip_api.get_dst())));
+            TextLog_PutAddr(log, p->ptrs.ip_api.get_src());
+            TextLog_Write(log, " -> ", 4);
+            TextLog_PutAddr(log, p->ptrs.ip_api.get_dst());
         }
     }
     else
@@ -341,9 +395,13 @@ void LogIpAddrs(TextLog* log, Packet* p)
         }
         else
         {
-            TextLog_Print(log, ip_fmt,
-                inet_ntoax(p->ptrs.ip_api.get_src()), p->ptrs.sp,
-                inet_ntoax(p->ptrs.ip_api.get_dst()), p->ptrs.dp);
+            TextLog_PutAddr(log, p->ptrs.ip_api.get_src());
+            TextLog_Putc(log, ':');
+            TextLog_PutUnsigned(log, p->ptrs.sp);
+            TextLog_Write(log, " -> ", 4);
+            TextLog_PutAddr(log, p->ptrs.ip_api.get_dst());
+            TextLog_Putc(log, ':');
+            TextLog_PutUnsigned(log, p->ptrs.dp);
         }
     }
 }
@@ -791,50 +849,56 @@ static void LogICMPEmbeddedIP(TextLog* log, Packet* p)
     if (log == NULL || p == NULL)
         return;
 
-    // FIXIT-L -- Allocating a new Packet here is ridiculously excessive.
-    Packet* orig_p = PacketManager::encode_new();
-    orig_p->reset();
-    Packet& op = *orig_p;
+    // the embedded datagram is logged through p itself with its decode
+    // state swapped out rather than allocating a packet for it
+    ip::IpApi embed_api;
 
-    if (!layer::set_api_ip_embed_icmp(p, op.ptrs.ip_api))
+    if (!layer::set_api_ip_embed_icmp(p, embed_api))
     {
         TextLog_Puts(log, "\nORIGINAL DATAGRAM TRUNCATED");
     }
     else
     {
+        const DecodeData save_ptrs = p->ptrs;
+        const uint8_t save_proto_next = p->ip_proto_next;
+
+        p->ptrs.reset();
+        p->ptrs.ip_api = embed_api;
+        p->ip_proto_next = embed_api.proto();
+
         switch (p->proto_bits & PROTO_BIT__ICMP_EMBED)
         {
         case PROTO_BIT__TCP_EMBED_ICMP:
         {
-            const tcp::TCPHdr* const tcph = layer::get_tcp_embed_icmp(op.ptrs.ip_api);
+            const tcp::TCPHdr* const tcph = layer::get_tcp_embed_icmp(embed_api);
             if (tcph)
             {
-                orig_p->ptrs.sp = tcph->src_port();
-                orig_p->ptrs.dp = tcph->dst_port();
-                orig_p->ptrs.tcph = tcph;
-                orig_p->ptrs.set_pkt_type(PktType::TCP);
+                p->ptrs.sp = tcph->src_port();
+                p->ptrs.dp = tcph->dst_port();
+                p->ptrs.tcph = tcph;
+                p->ptrs.set_pkt_type(PktType::TCP);
 
                 TextLog_Print(log, "\n** ORIGINAL DATAGRAM DUMP:\n");
-                LogIPHeader(log, orig_p);
+                LogIPHeader(log, p);
 
                 TextLog_Print(log, "Seq: 0x%lX\n",
-                    (u_long)ntohl(orig_p->ptrs.tcph->th_seq));
+                    (u_long)ntohl(p->ptrs.tcph->th_seq));
             }
             break;
         }
 
         case PROTO_BIT__UDP_EMBED_ICMP:
         {
-            const udp::UDPHdr* const udph = layer::get_udp_embed_icmp(op.ptrs.ip_api);
+            const udp::UDPHdr* const udph = layer::get_udp_embed_icmp(embed_api);
             if (udph)
             {
-                orig_p->ptrs.sp = udph->src_port();
-                orig_p->ptrs.dp = udph->dst_port();
-                orig_p->ptrs.udph = udph;
-                orig_p->ptrs.set_pkt_type(PktType::UDP);
+                p->ptrs.sp = udph->src_port();
+                p->ptrs.dp = udph->dst_port();
+                p->ptrs.udph = udph;
+                p->ptrs.set_pkt_type(PktType::UDP);
 
                 TextLog_Print(log, "\n** ORIGINAL DATAGRAM DUMP:\n");
-                LogIPHeader(log, orig_p);
+                LogIPHeader(log, p);
                 TextLog_Print(log, "Len: %d  Csum: %d\n",
                     udph->len() - udp::UDP_HEADER_LEN,
                     udph->cksum());
@@ -845,9 +909,9 @@ static void LogICMPEmbeddedIP(TextLog* log, Packet* p)
         case PROTO_BIT__ICMP_EMBED_ICMP:
         {
             TextLog_Print(log, "\n** ORIGINAL DATAGRAM DUMP:\n");
-            LogIPHeader(log, orig_p);
+            LogIPHeader(log, p);
 
-            const icmp::ICMPHdr* icmph = layer::get_icmp_embed_icmp(op.ptrs.ip_api);
+            const icmp::ICMPHdr* icmph = layer::get_icmp_embed_icmp(embed_api);
             if (icmph != NULL)
                 LogEmbeddedICMPHeader(log, icmph);
             break;
@@ -856,14 +920,17 @@ static void LogICMPEmbeddedIP(TextLog* log, Packet* p)
         default:
         {
             TextLog_Print(log, "\n** ORIGINAL DATAGRAM DUMP:\n");
-            LogIPHeader(log, orig_p);
+            LogIPHeader(log, p);
 
             TextLog_Print(log, "Protocol: 0x%X (unknown or "
-                "header truncated)", orig_p->ptrs.ip_api.proto());
+                "header truncated)", p->ptrs.ip_api.proto());
             break;
         }
         } /* switch */
 
+        p->ptrs = save_ptrs;
+        p->ip_proto_next = save_proto_next;
+
         /* if more than 8 bytes of original IP payload sent */
 
         const int16_t more_bytes = p->dsize - 8;
@@ -875,8 +942,6 @@ static void LogICMPEmbeddedIP(TextLog* log, Packet* p)
 
         TextLog_Puts(log, "** END OF DUMP");
     }
-
-    PacketManager::encode_delete(orig_p);
 }
 
 /*--------------------------------------------------------------------
@@ -0,0 +1,357 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// log_writer.cc
+
+#include "log_writer.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/util.h"
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
+using namespace std;
+
+// how long the writer sleeps when all queues are empty
+#define IDLE_WAIT_MS 1
+
+const PegInfo log_writer_pegs[] =
+{
+    { "records", "records queued for the writer thread" },
+    { "bytes", "bytes queued for the writer thread" },
+    { "over_half", "records queued when the queue was more than half full" },
+    { "blocked", "records that waited for room in the queue" },
+    { "dropped", "records dropped because the queue was full" },
+    { nullptr, nullptr }
+};
+
+THREAD_LOCAL LogWriterStats log_writer_stats;
+
+//-------------------------------------------------------------------------
+// queue
+//-------------------------------------------------------------------------
+
+LogQueue::LogQueue(LogSink* s, unsigned size, LogOverflow lo)
+{
+    unsigned cap = 1;
+
+    while ( cap < size )
+        cap <<= 1;
+
+    sink = s;
+    buf = (uint8_t*)SnortAlloc(cap);
+    mask = cap - 1;
+    overflow = lo;
+
+    head = 0;
+    tail = 0;
+}
+
+LogQueue::~LogQueue()
+{
+    free(buf);
+}
+
+bool LogQueue::put(const void* data, unsigned len)
+{
+    unsigned cap = mask + 1;
+
+    if ( !len )
+        return true;
+
+    if ( len > cap )
+    {
+        log_writer_stats.dropped++;
+        return false;
+    }
+
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t t = tail.load(std::memory_order_acquire);
+
+    if ( cap - (h - t) < len )
+    {
+        if ( overflow == LOG_OVERFLOW_DROP )
+        {
+            log_writer_stats.dropped++;
+            return false;
+        }
+        log_writer_stats.blocked++;
+
+        do
+        {
+            std::this_thread::yield();
+            t = tail.load(std::memory_order_acquire);
+        }
+        while ( cap - (h - t) < len );
+    }
+
+    unsigned pos = h & mask;
+    unsigned n = cap - pos;
+
+    if ( n > len )
+        n = len;
+
+    memcpy(buf + pos, data, n);
+
+    if ( n < len )
+        memcpy(buf, (const uint8_t*)data + n, len - n);
+
+    head.store(h + len, std::memory_order_release);
+
+    log_writer_stats.records++;
+    log_writer_stats.bytes += len;
+
+    if ( (h + len - t) > (cap >> 1) )
+        log_writer_stats.over_half++;
+
+    return true;
+}
+
+size_t LogQueue::drain()
+{
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t h = head.load(std::memory_order_acquire);
+
+    if ( h == t )
+        return 0;
+
+    size_t len = h - t;
+    unsigned pos = t & mask;
+    unsigned n = mask + 1 - pos;
+
+    struct iovec iov[2];
+    int count = 1;
+
+    iov[0].iov_base = buf + pos;
+
+    if ( n >= len )
+        iov[0].iov_len = len;
+
+    else
+    {
+        iov[0].iov_len = n;
+        iov[1].iov_base = buf;
+        iov[1].iov_len = len - n;
+        count = 2;
+    }
+
+    sink->write(iov, count, len);
+    tail.store(h, std::memory_order_release);
+
+    return len;
+}
+
+//-------------------------------------------------------------------------
+// writer thread
+//-------------------------------------------------------------------------
+
+// queue_mutex guards the queue list and is only held to copy it so add()
+// and term() don't wait on the sinks; drain_mutex is held for each pass
+// over the copy so remove() can wait until the writer is done with a queue
+static mutex queue_mutex;
+static mutex drain_mutex;
+static condition_variable queue_cond;
+static vector<LogQueue*> queues;
+
+static thread* writer = nullptr;
+static bool writer_stop = false;
+
+static void writer_main()
+{
+    vector<LogQueue*> active;
+
+    while ( true )
+    {
+        bool stop;
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            active = queues;
+            stop = writer_stop;
+        }
+
+        size_t n = 0;
+        {
+            lock_guard<mutex> lock(drain_mutex);
+
+            for ( auto q : active )
+                n += q->drain();
+        }
+
+        if ( n )
+            continue;
+
+        if ( stop )
+            break;
+
+        unique_lock<mutex> lock(queue_mutex);
+
+        if ( !writer_stop )
+            queue_cond.wait_for(lock, chrono::milliseconds(IDLE_WAIT_MS));
+    }
+}
+
+void LogWriter::add(LogQueue* q)
+{
+    lock_guard<mutex> lock(queue_mutex);
+    queues.push_back(q);
+
+    if ( !writer )
+    {
+        writer_stop = false;
+        writer = new thread(writer_main);
+    }
+}
+
+void LogWriter::remove(LogQueue* q)
+{
+    {
+        lock_guard<mutex> lock(queue_mutex);
+
+        for ( auto it = queues.begin(); it != queues.end(); ++it )
+        {
+            if ( *it == q )
+            {
+                queues.erase(it);
+                break;
+            }
+        }
+    }
+    // the writer may still be draining q from its copy of the list but
+    // won't see it after this pass so the rest is ours
+    lock_guard<mutex> lock(drain_mutex);
+    while ( q->drain() );
+}
+
+void LogWriter::term()
+{
+    {
+        lock_guard<mutex> lock(queue_mutex);
+
+        if ( !writer )
+            return;
+
+        writer_stop = true;
+    }
+    queue_cond.notify_one();
+    writer->join();
+
+    delete writer;
+    writer = nullptr;
+}
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+class TestSink : public LogSink
+{
+public:
+    void write(const struct iovec* iov, int count, size_t len) override
+    {
+        size_t sum = 0;
+
+        for ( int i = 0; i < count; ++i )
+        {
+            data.append((char*)iov[i].iov_base, iov[i].iov_len);
+            sum += iov[i].iov_len;
+        }
+        // catch isn't thread safe so check this later
+        if ( sum != len )
+            ok = false;
+
+        ++writes;
+    }
+
+    std::string data;
+    unsigned writes = 0;
+    bool ok = true;
+};
+
+TEST_CASE("log queue wrap", "[LogQueue]")
+{
+    TestSink sink;
+    LogQueue q(&sink, 10, LOG_OVERFLOW_DROP);
+
+    // size is rounded up to 16
+    CHECK(q.put("0123456789", 10));
+    CHECK(q.drain() == 10);
+    CHECK(q.empty());
+
+    // this one wraps and is drained with 2 iovecs in 1 write
+    CHECK(q.put("abcdefghij", 10));
+    CHECK(q.drain() == 10);
+    CHECK(sink.data == "0123456789abcdefghij");
+    CHECK(sink.writes == 2);
+    CHECK(sink.ok);
+}
+
+TEST_CASE("log queue overflow", "[LogQueue]")
+{
+    TestSink sink;
+    LogQueue q(&sink, 16, LOG_OVERFLOW_DROP);
+
+    PegCount dropped = log_writer_stats.dropped;
+
+    CHECK(q.put("0123456789", 10));
+    CHECK(!q.put("abcdefghij", 10));
+    CHECK(!q.put("this is too long to ever fit", 28));
+    CHECK(log_writer_stats.dropped == dropped + 2);
+
+    CHECK(q.drain() == 10);
+    CHECK(sink.data == "0123456789");
+}
+
+TEST_CASE("log writer thread", "[LogQueue]")
+{
+    TestSink sink;
+    LogQueue q(&sink, 64, LOG_OVERFLOW_BLOCK);
+    LogWriter::add(&q);
+
+    std::string expected;
+
+    for ( unsigned i = 0; i < 1000; ++i )
+    {
+        char rec[32];
+        snprintf(rec, sizeof(rec), "record %u\n", i);
+        CHECK(q.put(rec, strlen(rec)));
+        expected += rec;
+    }
+    LogWriter::remove(&q);
+    LogWriter::term();
+
+    CHECK(q.empty());
+    CHECK(sink.data == expected);
+    CHECK(sink.ok);
+}
+#endif
+
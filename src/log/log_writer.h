@@ -0,0 +1,103 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// log_writer.h
+
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+// LogWriter moves log file output off of the packet threads.  Each logger
+// instance that opts in owns a LogQueue, a lock free single producer /
+// single consumer byte ring.  The packet thread appends complete records
+// and a single writer thread drains all queues, handing each batch to the
+// queue's LogSink as at most two iovecs.  Since records are published
+// whole, a batch always ends on a record boundary.
+
+#include <sys/uio.h>
+#include <atomic>
+
+#include "main/snort_types.h"
+#include "main/thread.h"
+#include "framework/counts.h"
+
+class LogSink
+{
+public:
+    virtual ~LogSink() { }
+
+    // called on the writer thread (or the owning thread during close)
+    virtual void write(const struct iovec*, int count, size_t len) = 0;
+};
+
+enum LogOverflow
+{
+    LOG_OVERFLOW_DROP,   // discard records that don't fit
+    LOG_OVERFLOW_BLOCK   // wait for the writer to make room
+};
+
+class LogQueue
+{
+public:
+    LogQueue(LogSink*, unsigned size, LogOverflow);
+    ~LogQueue();
+
+    // packet thread; returns false if the record was dropped
+    bool put(const void*, unsigned len);
+
+    // writer thread; returns the number of bytes drained
+    size_t drain();
+
+    bool empty() const
+    { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+    LogSink* sink;
+    uint8_t* buf;
+    unsigned mask;
+    LogOverflow overflow;
+
+    // monotonic byte counts; the difference is the queue depth
+    std::atomic<uint64_t> head;  // written by producer
+    std::atomic<uint64_t> tail;  // written by consumer
+};
+
+struct LogWriterStats
+{
+    PegCount records;
+    PegCount bytes;
+    PegCount over_half;
+    PegCount blocked;
+    PegCount dropped;
+};
+
+extern const PegInfo log_writer_pegs[];
+extern THREAD_LOCAL LogWriterStats log_writer_stats;
+
+namespace LogWriter
+{
+// the writer thread is started with the first queue added
+void add(LogQueue*);
+
+// removes the queue and writes anything left from the calling thread
+void remove(LogQueue*);
+
+// drains all queues and stops the writer thread
+void term();
+}
+
+#endif
+
@@ -32,11 +32,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
 
 #include "log.h"
+#include "log_writer.h"
 #include "main/snort_types.h"
+#include "main/snort_config.h"
+#include "sfip/sf_ip.h"
 #include "utils/util.h"
 
+#ifdef UNIT_TEST
+#include <chrono>
+#include "catch/catch.hpp"
+#endif
+
 /* some reasonable minimums */
 #define MIN_BUF  (1* K_BYTES)
 #define MIN_FILE (MIN_BUF)
@@ -51,12 +61,82 @@ struct TextLog
     size_t maxFile;
     time_t last;
 
+/* async attributes: */
+    LogQueue* queue;
+    LogSink* sink;
+
 /* buffer attributes: */
     unsigned int pos;
     unsigned int maxBuf;
     char buf[1];
 };
 
+static void TextLog_Roll(TextLog* const);
+
+/*-------------------------------------------------------------------
+ * TextLogSink: writes queued records from the writer thread
+ * the file, size, and roll state are only touched from here once
+ * the queue is set up
+ *-------------------------------------------------------------------
+ */
+class TextLogSink : public LogSink
+{
+public:
+    TextLogSink(TextLog* t)
+    { txt = t; }
+
+    void write(const struct iovec*, int count, size_t len) override;
+
+private:
+    TextLog* txt;
+};
+
+void TextLogSink::write(const struct iovec* iov, int count, size_t len)
+{
+    if ( txt->size + len > txt->maxFile )
+        TextLog_Roll(txt);
+
+    struct iovec v[2];
+    memcpy(v, iov, count * sizeof(*iov));
+
+    int fd = fileno(txt->file);
+    size_t left = len;
+
+    while ( left )
+    {
+        ssize_t n = writev(fd, v, count);
+
+        if ( n < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            ErrorMessage("TextLog: write to %s failed: %s\n",
+                txt->name ? txt->name : "stdout", get_error(errno));
+            return;
+        }
+        left -= n;
+
+        // partial write; skip what is done and try again
+        while ( n > 0 && count )
+        {
+            if ( (size_t)n < v[0].iov_len )
+            {
+                v[0].iov_base = (char*)v[0].iov_base + n;
+                v[0].iov_len -= n;
+                n = 0;
+            }
+            else
+            {
+                n -= v[0].iov_len;
+                v[0] = v[1];
+                --count;
+            }
+        }
+    }
+    txt->size += len;
+}
+
 /*-------------------------------------------------------------------
  * TextLog_Open/Close: open/close associated log file
  *-------------------------------------------------------------------
@@ -134,6 +214,24 @@ TextLog* TextLog_Init(
     txt->maxBuf = maxBuf;
     TextLog_Reset(txt);
 
+    txt->queue = nullptr;
+    txt->sink = nullptr;
+
+    // stdout is left synchronous to keep console output in order
+    if ( snort_conf and snort_conf->async_log_size and txt->file != stdout )
+    {
+        // records are queued whole so the queue must hold a full buffer
+        unsigned size = snort_conf->async_log_size;
+
+        if ( size < maxBuf )
+            size = maxBuf;
+
+        txt->sink = new TextLogSink(txt);
+        txt->queue = new LogQueue(
+            txt->sink, size, (LogOverflow)snort_conf->async_log_overflow);
+
+        LogWriter::add(txt->queue);
+    }
     return txt;
 }
 
@@ -147,6 +245,13 @@ void TextLog_Term(TextLog* const txt)
         return;
 
     TextLog_Flush(txt);
+
+    if ( txt->queue )
+    {
+        LogWriter::remove(txt->queue);
+        delete txt->queue;
+        delete txt->sink;
+    }
     TextLog_Close(txt->file);
 
     if ( txt->name )
@@ -185,6 +290,14 @@ bool TextLog_Flush(TextLog* const txt)
 
     if ( !txt->pos )
         return false;
+
+    if ( txt->queue )
+    {
+        // the writer thread handles roll over
+        ok = txt->queue->put(txt->buf, txt->pos);
+        TextLog_Reset(txt);
+        return ok;
+    }
     if ( txt->size + txt->pos > txt->maxFile )
         TextLog_Roll(txt);
 
@@ -228,19 +341,19 @@ bool TextLog_Write(TextLog* const txt, const char* str, int len)
         TextLog_Flush(txt);
         avail = TextLog_Avail(txt);
     }
-    len = snprintf(txt->buf+txt->pos, avail, "%s", str);
+    if ( len < 0 )
+        return false;
 
     if ( len >= avail )
     {
+        memcpy(txt->buf+txt->pos, str, avail);
         txt->pos = txt->maxBuf - 1;
         txt->buf[txt->pos] = '\0';
         return false;
     }
-    else if ( len < 0 )
-    {
-        return false;
-    }
+    memcpy(txt->buf+txt->pos, str, len);
     txt->pos += len;
+    txt->buf[txt->pos] = '\0';
     return true;
 }
 
@@ -281,6 +394,94 @@ bool TextLog_Print(TextLog* const txt, const char* fmt, ...)
     return true;
 }
 
+/*-------------------------------------------------------------------
+ * TextLog_Put*: append formatted numbers and addresses
+ * digits are generated backwards into a small local buffer and
+ * appended with one copy
+ *-------------------------------------------------------------------
+ */
+bool TextLog_PutUnsigned(TextLog* const txt, uint64_t u)
+{
+    char tmp[20];
+    char* end = tmp + sizeof(tmp);
+    char* s = end;
+
+    do
+    {
+        *--s = '0' + (u % 10);
+        u /= 10;
+    }
+    while ( u );
+
+    return TextLog_Write(txt, s, end - s);
+}
+
+bool TextLog_PutSigned(TextLog* const txt, int64_t i)
+{
+    if ( i >= 0 )
+        return TextLog_PutUnsigned(txt, i);
+
+    TextLog_Putc(txt, '-');
+    return TextLog_PutUnsigned(txt, -(uint64_t)i);
+}
+
+bool TextLog_PutHex(TextLog* const txt, uint64_t u, unsigned width)
+{
+    static const char* hex = "0123456789ABCDEF";
+    char tmp[16];
+    char* end = tmp + sizeof(tmp);
+    char* s = end;
+
+    if ( width > sizeof(tmp) )
+        width = sizeof(tmp);
+
+    do
+    {
+        *--s = hex[u & 0xF];
+        u >>= 4;
+    }
+    while ( u );
+
+    while ( end - s < (int)width )
+        *--s = '0';
+
+    return TextLog_Write(txt, s, end - s);
+}
+
+bool TextLog_PutAddr(TextLog* const txt, const sfip_t* ip)
+{
+    if ( !ip->is_ip4() )
+    {
+        char tmp[INET6_ADDRSTRLEN];
+        sfip_ntop(ip, tmp, sizeof(tmp));
+        return TextLog_Puts(txt, tmp);
+    }
+
+    // dotted quad is simple and common enough to do here
+    char tmp[INET_ADDRSTRLEN];
+    char* s = tmp;
+
+    for ( int i = 0; i < 4; ++i )
+    {
+        unsigned b = ip->ip8[i];
+
+        if ( b >= 100 )
+        {
+            *s++ = '0' + b / 100;
+            b %= 100;
+            *s++ = '0' + b / 10;
+        }
+        else if ( b >= 10 )
+            *s++ = '0' + b / 10;
+
+        *s++ = '0' + b % 10;
+
+        if ( i < 3 )
+            *s++ = '.';
+    }
+    return TextLog_Write(txt, tmp, s - tmp);
+}
+
 /*-------------------------------------------------------------------
  * TextLog_Quote: write string escaping quotes
  * TBD could be smarter by counting required escapes instead of
@@ -314,3 +515,125 @@ bool TextLog_Quote(TextLog* const txt, const char* qs)
     return true;
 }
 
+#ifdef UNIT_TEST
+
+static TextLog* test_log()
+{
+    // never flushed since the buffer is reset per event
+    return TextLog_Init("stdout", 4*K_BYTES);
+}
+
+static const char* test_str(TextLog* txt)
+{
+    return txt->buf;
+}
+
+TEST_CASE("text log numbers", "[text_log]")
+{
+    TextLog* txt = test_log();
+
+    TextLog_PutUnsigned(txt, 0);
+    TextLog_Putc(txt, ' ');
+    TextLog_PutUnsigned(txt, 18446744073709551615ULL);
+    TextLog_Putc(txt, ' ');
+    TextLog_PutSigned(txt, -42);
+    TextLog_Putc(txt, ' ');
+    TextLog_PutHex(txt, 0xBEEF);
+    TextLog_Putc(txt, ' ');
+    TextLog_PutHex(txt, 0xA, 2);
+    TextLog_Putc(txt, ' ');
+    TextLog_PutHex(txt, 0);
+
+    CHECK(!strcmp(test_str(txt), "0 18446744073709551615 -42 BEEF 0A 0"));
+
+    TextLog_Reset(txt);
+    TextLog_Term(txt);
+}
+
+TEST_CASE("text log addresses", "[text_log]")
+{
+    TextLog* txt = test_log();
+    const char* addrs[] = { "0.0.0.0", "1.22.103.255", "2001:db8::1" };
+
+    for ( auto a : addrs )
+    {
+        sfip_t ip;
+        REQUIRE(sfip_pton(a, &ip) == SFIP_SUCCESS);
+
+        // must match the slow path
+        TextLog_Reset(txt);
+        TextLog_PutAddr(txt, &ip);
+        CHECK(!strcmp(test_str(txt), sfip_to_str(&ip)));
+    }
+    TextLog_Reset(txt);
+    TextLog_Term(txt);
+}
+
+TEST_CASE("text log overflow", "[text_log]")
+{
+    TextLog* txt = test_log();
+    char big[8*K_BYTES];
+
+    memset(big, 'x', sizeof(big));
+    CHECK(!TextLog_Write(txt, big, sizeof(big)));
+    CHECK(TextLog_Avail(txt) == 0);
+
+    TextLog_Reset(txt);
+    TextLog_Term(txt);
+}
+
+// hidden; run with [text_log_perf] to compare against the printf path
+TEST_CASE("text log format 1M events", "[.][text_log_perf]")
+{
+    using namespace std::chrono;
+
+    TextLog* txt = test_log();
+    const unsigned n = 1000000;
+
+    sfip_t src, dst;
+    sfip_pton("192.168.1.10", &src);
+    sfip_pton("10.1.2.3", &dst);
+
+    auto t0 = steady_clock::now();
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        TextLog_Print(txt, "%u, %s:%u, %s:%u, %u:%u:%u, 0x%X\n",
+            i, sfip_to_str(&src), 1024 + (i & 0x7FFF), sfip_to_str(&dst), 80,
+            1, 1000000 + (i & 0xFF), 3, i);
+        TextLog_Reset(txt);
+    }
+    auto t1 = steady_clock::now();
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        TextLog_PutUnsigned(txt, i);
+        TextLog_Write(txt, ", ", 2);
+        TextLog_PutAddr(txt, &src);
+        TextLog_Putc(txt, ':');
+        TextLog_PutUnsigned(txt, 1024 + (i & 0x7FFF));
+        TextLog_Write(txt, ", ", 2);
+        TextLog_PutAddr(txt, &dst);
+        TextLog_Putc(txt, ':');
+        TextLog_PutUnsigned(txt, 80);
+        TextLog_Write(txt, ", ", 2);
+        TextLog_PutUnsigned(txt, 1);
+        TextLog_Putc(txt, ':');
+        TextLog_PutUnsigned(txt, 1000000 + (i & 0xFF));
+        TextLog_Putc(txt, ':');
+        TextLog_PutUnsigned(txt, 3);
+        TextLog_Write(txt, ", 0x", 4);
+        TextLog_PutHex(txt, i);
+        TextLog_NewLine(txt);
+        TextLog_Reset(txt);
+    }
+    auto t2 = steady_clock::now();
+
+    printf("text log 1M events: print %ld ms, put %ld ms\n",
+        (long)duration_cast<milliseconds>(t1 - t0).count(),
+        (long)duration_cast<milliseconds>(t2 - t1).count());
+
+    TextLog_Term(txt);
+}
+
+#endif
@@ -34,6 +34,7 @@
  * name plus a timestamp.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -47,6 +48,7 @@
 // FIXIT-L need a LogMessage based subclass of TextLog
 // or some such to get stdout or syslog
 struct TextLog;
+struct sfip_t;
 
 SO_PUBLIC TextLog* TextLog_Init(
     const char* name, unsigned int maxBuf = 0, size_t maxFile = 0);
@@ -57,6 +59,13 @@ SO_PUBLIC bool TextLog_Quote(TextLog* const, const char*);
 SO_PUBLIC bool TextLog_Write(TextLog* const, const char*, int len);
 SO_PUBLIC bool TextLog_Print(TextLog* const, const char* format, ...);
 
+// direct formatters for the fields that dominate alert output; these
+// write straight into the buffer without going through vsnprintf()
+SO_PUBLIC bool TextLog_PutUnsigned(TextLog* const, uint64_t);
+SO_PUBLIC bool TextLog_PutSigned(TextLog* const, int64_t);
+SO_PUBLIC bool TextLog_PutHex(TextLog* const, uint64_t, unsigned width = 0);
+SO_PUBLIC bool TextLog_PutAddr(TextLog* const, const sfip_t*);
+
 SO_PUBLIC bool TextLog_Flush(TextLog* const);
 SO_PUBLIC int TextLog_Tell(TextLog* const);
 SO_PUBLIC int TextLog_Avail(TextLog* const);
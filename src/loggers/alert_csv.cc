@@ -95,35 +95,46 @@ static void ff_dir(Args& a)
 static void ff_dgm_len(Args& a)
 {
     if (a.pkt->has_ip())
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.ip_api.dgram_len());
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.ip_api.dgram_len());
     else
-        TextLog_Print(csv_log, "%d", a.pkt->dsize);
+        TextLog_PutUnsigned(csv_log, a.pkt->dsize);
 }
 
 static void ff_dst_addr(Args& a)
 {
     if ( a.pkt->has_ip() or a.pkt->is_data() )
-        TextLog_Puts(csv_log, inet_ntoa(a.pkt->ptrs.ip_api.get_dst()));
+        TextLog_PutAddr(csv_log, a.pkt->ptrs.ip_api.get_dst());
 }
 
 static void ff_dst_ap(Args& a)
 {
-    const char* addr = "";
     unsigned port = 0;
 
     if ( a.pkt->has_ip() or a.pkt->is_data() )
-        addr = sfip_to_str(a.pkt->ptrs.ip_api.get_dst());
+        TextLog_PutAddr(csv_log, a.pkt->ptrs.ip_api.get_dst());
 
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
         port = a.pkt->ptrs.dp;
 
-    TextLog_Print(csv_log, "%s:%d", addr, port);
+    TextLog_Putc(csv_log, ':');
+    TextLog_PutUnsigned(csv_log, port);
 }
 
 static void ff_dst_port(Args& a)
 {
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.dp);
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.dp);
+}
+
+static void put_mac(const uint8_t* mac)
+{
+    for ( int i = 0; i < 6; ++i )
+    {
+        if ( i )
+            TextLog_Putc(csv_log, ':');
+
+        TextLog_PutHex(csv_log, mac[i], 2);
+    }
 }
 
 static void ff_eth_dst(Args& a)
@@ -133,9 +144,7 @@ static void ff_eth_dst(Args& a)
 
     const eth::EtherHdr* eh = layer::get_eth_layer(a.pkt);
 
-    TextLog_Print(csv_log, "%02X:%02X:%02X:%02X:%02X:%02X", eh->ether_dst[0],
-        eh->ether_dst[1], eh->ether_dst[2], eh->ether_dst[3],
-        eh->ether_dst[4], eh->ether_dst[5]);
+    put_mac(eh->ether_dst);
 }
 
 static void ff_eth_len(Args& a)
@@ -143,7 +152,8 @@ static void ff_eth_len(Args& a)
     if ( !(a.pkt->proto_bits & PROTO_BIT__ETH) )
         return;
 
-    TextLog_Print(csv_log, "0x%X", a.pkt->pkth->pktlen);
+    TextLog_Puts(csv_log, "0x");
+    TextLog_PutHex(csv_log, a.pkt->pkth->pktlen);
 }
 
 static void ff_eth_src(Args& a)
@@ -153,9 +163,7 @@ static void ff_eth_src(Args& a)
 
     const eth::EtherHdr* eh = layer::get_eth_layer(a.pkt);
 
-    TextLog_Print(csv_log, "%02X:%02X:%02X:%02X:%02X:%02X", eh->ether_src[0],
-        eh->ether_src[1], eh->ether_src[2], eh->ether_src[3],
-        eh->ether_src[4], eh->ether_src[5]);
+    put_mac(eh->ether_src);
 }
 
 static void ff_eth_type(Args& a)
@@ -164,49 +172,50 @@ static void ff_eth_type(Args& a)
         return;
 
     const eth::EtherHdr* eh = layer::get_eth_layer(a.pkt);
-    TextLog_Print(csv_log, "0x%X", ntohs(eh->ether_type));
+    TextLog_Puts(csv_log, "0x");
+    TextLog_PutHex(csv_log, ntohs(eh->ether_type));
 }
 
 static void ff_gid(Args& a)
 {
     if (a.event )
-        TextLog_Print(csv_log, "%u",  a.event->sig_info->generator);
+        TextLog_PutUnsigned(csv_log, a.event->sig_info->generator);
 }
 
 static void ff_icmp_code(Args& a)
 {
     if (a.pkt->ptrs.icmph )
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.icmph->code);
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.icmph->code);
 }
 
 static void ff_icmp_id(Args& a)
 {
     if (a.pkt->ptrs.icmph )
-        TextLog_Print(csv_log, "%d", ntohs(a.pkt->ptrs.icmph->s_icmp_id));
+        TextLog_PutUnsigned(csv_log, ntohs(a.pkt->ptrs.icmph->s_icmp_id));
 }
 
 static void ff_icmp_seq(Args& a)
 {
     if (a.pkt->ptrs.icmph )
-        TextLog_Print(csv_log, "%d", ntohs(a.pkt->ptrs.icmph->s_icmp_seq));
+        TextLog_PutUnsigned(csv_log, ntohs(a.pkt->ptrs.icmph->s_icmp_seq));
 }
 
 static void ff_icmp_type(Args& a)
 {
     if (a.pkt->ptrs.icmph )
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.icmph->type);
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.icmph->type);
 }
 
 static void ff_ip_id(Args& a)
 {
     if (a.pkt->has_ip())
-        TextLog_Print(csv_log, "%u", a.pkt->ptrs.ip_api.id());
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.ip_api.id());
 }
 
 static void ff_ip_len(Args& a)
 {
     if (a.pkt->has_ip())
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.ip_api.pay_len());
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.ip_api.pay_len());
 }
 
 static void ff_msg(Args& a)
@@ -221,7 +230,7 @@ static void ff_pkt_gen(Args& a)
 
 static void ff_pkt_num(Args&)
 {
-    TextLog_Print(csv_log, STDu64, pc.total_from_daq);
+    TextLog_PutUnsigned(csv_log, pc.total_from_daq);
 }
 
 static void ff_proto(Args& a)
@@ -232,51 +241,57 @@ static void ff_proto(Args& a)
 static void ff_rev(Args& a)
 {
     if (a.event )
-        TextLog_Print(csv_log, "%u",  a.event->sig_info->rev);
+        TextLog_PutUnsigned(csv_log, a.event->sig_info->rev);
 }
 
 static void ff_rule(Args& a)
 {
-    TextLog_Print(csv_log, "%u:%u:%u",
-        a.event->sig_info->generator, a.event->sig_info->id, a.event->sig_info->rev);
+    TextLog_PutUnsigned(csv_log, a.event->sig_info->generator);
+    TextLog_Putc(csv_log, ':');
+    TextLog_PutUnsigned(csv_log, a.event->sig_info->id);
+    TextLog_Putc(csv_log, ':');
+    TextLog_PutUnsigned(csv_log, a.event->sig_info->rev);
 }
 
 static void ff_sid(Args& a)
 {
     if (a.event )
-        TextLog_Print(csv_log, "%u",  a.event->sig_info->id);
+        TextLog_PutUnsigned(csv_log, a.event->sig_info->id);
 }
 
 static void ff_src_addr(Args& a)
 {
     if ( a.pkt->has_ip() or a.pkt->is_data() )
-        TextLog_Puts(csv_log, inet_ntoa(a.pkt->ptrs.ip_api.get_src()));
+        TextLog_PutAddr(csv_log, a.pkt->ptrs.ip_api.get_src());
 }
 
 static void ff_src_ap(Args& a)
 {
-    const char* addr = "";
     unsigned port = 0;
 
     if ( a.pkt->has_ip() or a.pkt->is_data() )
-        addr = sfip_to_str(a.pkt->ptrs.ip_api.get_src());
+        TextLog_PutAddr(csv_log, a.pkt->ptrs.ip_api.get_src());
 
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
         port = a.pkt->ptrs.sp;
 
-    TextLog_Print(csv_log, "%s:%d", addr, port);
+    TextLog_Putc(csv_log, ':');
+    TextLog_PutUnsigned(csv_log, port);
 }
 
 static void ff_src_port(Args& a)
 {
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.sp);
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.sp);
 }
 
 static void ff_tcp_ack(Args& a)
 {
     if (a.pkt->ptrs.tcph )
-        TextLog_Print(csv_log, "0x%lX", (u_long)ntohl(a.pkt->ptrs.tcph->th_ack));
+    {
+        TextLog_Puts(csv_log, "0x");
+        TextLog_PutHex(csv_log, ntohl(a.pkt->ptrs.tcph->th_ack));
+    }
 }
 
 static void ff_tcp_flags(Args& a)
@@ -285,38 +300,44 @@ static void ff_tcp_flags(Args& a)
     {
         char tcpFlags[9];
         CreateTCPFlagString(a.pkt->ptrs.tcph, tcpFlags);
-        TextLog_Print(csv_log, "%s", tcpFlags);
+        TextLog_Puts(csv_log, tcpFlags);
     }
 }
 
 static void ff_tcp_len(Args& a)
 {
     if (a.pkt->ptrs.tcph )
-        TextLog_Print(csv_log, "%d", (a.pkt->ptrs.tcph->off()));
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.tcph->off());
 }
 
 static void ff_tcp_seq(Args& a)
 {
     if (a.pkt->ptrs.tcph )
-        TextLog_Print(csv_log, "0x%lX", (u_long)ntohl(a.pkt->ptrs.tcph->th_seq));
+    {
+        TextLog_Puts(csv_log, "0x");
+        TextLog_PutHex(csv_log, ntohl(a.pkt->ptrs.tcph->th_seq));
+    }
 }
 
 static void ff_tcp_win(Args& a)
 {
     if (a.pkt->ptrs.tcph )
-        TextLog_Print(csv_log, "0x%X", ntohs(a.pkt->ptrs.tcph->th_win));
+    {
+        TextLog_Puts(csv_log, "0x");
+        TextLog_PutHex(csv_log, ntohs(a.pkt->ptrs.tcph->th_win));
+    }
 }
 
 static void ff_tos(Args& a)
 {
     if (a.pkt->has_ip())
-        TextLog_Print(csv_log, "%d", a.pkt->ptrs.ip_api.tos());
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.ip_api.tos());
 }
 
 static void ff_ttl(Args& a)
 {
     if (a.pkt->has_ip())
-        TextLog_Print(csv_log, "%d",a.pkt->ptrs.ip_api.ttl());
+        TextLog_PutUnsigned(csv_log, a.pkt->ptrs.ip_api.ttl());
 }
 
 static void ff_timestamp(Args& a)
@@ -327,7 +348,7 @@ static void ff_timestamp(Args& a)
 static void ff_udp_len(Args& a)
 {
     if (a.pkt->ptrs.udph )
-        TextLog_Print(csv_log, "%d", ntohs(a.pkt->ptrs.udph->uh_len));
+        TextLog_PutUnsigned(csv_log, ntohs(a.pkt->ptrs.udph->uh_len));
 }
 
 //-------------------------------------------------------------------------
@@ -508,7 +529,7 @@ void CsvLogger::alert(Packet* p, const char* msg, Event* event)
             first = false;
         else
             // FIXIT-M: Need to check csv_log for nullptr
-            TextLog_Puts(csv_log, sep.c_str());
+            TextLog_Write(csv_log, sep.c_str(), sep.size());
 
         f(a);
     }
@@ -0,0 +1,628 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// columnar.cc
+
+// events are buffered per packet thread in column arrays and written a
+// segment at a time; see columnar_common.h for the file layout.
+
+#include "loggers/columnar_common.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "main/snort_types.h"
+#include "main/snort_config.h"
+#include "main/thread.h"
+#include "framework/logger.h"
+#include "framework/module.h"
+#include "detection/signature.h"
+#include "events/event.h"
+#include "protocols/packet.h"
+#include "protocols/icmp4.h"
+#include "packet_io/active.h"
+#include "packet_io/sfdaq.h"
+#include "utils/util.h"
+
+#define S_NAME "columnar"
+#define F_NAME S_NAME ".log"
+
+using namespace std;
+
+//-------------------------------------------------------------------------
+// segment building
+//-------------------------------------------------------------------------
+
+struct ColConfig
+{
+    string file;
+    unsigned long limit;
+    unsigned segment_size;
+    unsigned flush_interval;
+    bool packets;
+};
+
+static inline unsigned col_align(unsigned n)
+{ return (n + 7) & ~7; }
+
+class ColWriter
+{
+public:
+    ColWriter(const ColConfig&);
+    ~ColWriter();
+
+    void add(Packet*, const char* msg, Event*);
+    void idle();
+
+private:
+    void open_files();
+    void close_files();
+    void flush();
+    void check_limit();
+
+    uint32_t get_msg(const char*);
+    uint64_t put_packet(const Packet*, const Event*);
+    void write(FILE*, const void*, size_t);
+
+private:
+    // a copy since each packet thread has its own file
+    const ColConfig config;
+
+    FILE* log = nullptr;
+    FILE* pkt = nullptr;
+
+    uint64_t log_pos = 0;
+    uint64_t pkt_pos = 0;
+
+    // column data for the current segment
+    uint8_t* cols[COL_MAX - 1];
+    uint8_t* data;
+    unsigned events = 0;
+    time_t started = 0;  // wall clock time of the first event of the segment
+
+    uint32_t min_sec, max_sec;
+    uint32_t min_sid, max_sid;
+
+    // per segment message dictionary; keyed by pointer since messages
+    // are owned by the rules but checked with strcmp in case of reload
+    unordered_map<const char*, uint32_t> msg_map;
+    vector<unsigned> msg_off;
+    string msg_text;
+
+    vector<ColIndexEntry> index;
+};
+
+ColWriter::ColWriter(const ColConfig& c) : config(c)
+{
+    unsigned size = 0;
+
+    for ( unsigned i = 0; i < COL_MSG_DICT; ++i )
+        size += col_align(col_width[i] * config.segment_size);
+
+    data = (uint8_t*)SnortAlloc(size);
+    size = 0;
+
+    for ( unsigned i = 0; i < COL_MSG_DICT; ++i )
+    {
+        cols[i] = data + size;
+        size += col_align(col_width[i] * config.segment_size);
+    }
+    open_files();
+}
+
+ColWriter::~ColWriter()
+{
+    close_files();
+    free(data);
+}
+
+void ColWriter::write(FILE* f, const void* buf, size_t len)
+{
+    if ( fwrite(buf, len, 1, f) != 1 )
+        ErrorMessage("%s: write failed: %s\n", S_NAME, get_error(errno));
+}
+
+void ColWriter::open_files()
+{
+    char name[STD_BUF];
+    uint32_t now = (uint32_t)time(nullptr);
+
+    SnortSnprintf(name, sizeof(name), "%s.%u", config.file.c_str(), now);
+
+    if ( !(log = fopen(name, "wb")) )
+        FatalError("%s: can't open %s: %s\n", S_NAME, name, get_error(errno));
+
+    if ( config.packets )
+    {
+        SnortSnprintf(name, sizeof(name), "%s.%u.pkt", config.file.c_str(), now);
+
+        if ( !(pkt = fopen(name, "wb")) )
+            FatalError("%s: can't open %s: %s\n", S_NAME, name, get_error(errno));
+    }
+
+    ColFileHeader fh;
+    memset(&fh, 0, sizeof(fh));
+
+    fh.magic = COL_MAGIC;
+    fh.byte_order = COL_BYTE_ORDER;
+    fh.version = COL_VERSION;
+    fh.flags = config.packets ? COL_FLAG_PACKETS : 0;
+    fh.created = now;
+    fh.linktype = DAQ_GetBaseProtocol();
+
+    write(log, &fh, sizeof(fh));
+    log_pos = sizeof(fh);
+    pkt_pos = 0;
+}
+
+void ColWriter::close_files()
+{
+    flush();
+
+    if ( !index.empty() )
+    {
+        ColFileTrailer ft;
+        ft.index_offset = log_pos;
+        ft.segments = index.size();
+        ft.magic = COL_IDX_MAGIC;
+
+        write(log, &index[0], index.size() * sizeof(index[0]));
+        write(log, &ft, sizeof(ft));
+        index.clear();
+    }
+    fclose(log);
+    log = nullptr;
+
+    if ( pkt )
+    {
+        fclose(pkt);
+        pkt = nullptr;
+    }
+}
+
+uint32_t ColWriter::get_msg(const char* msg)
+{
+    if ( !msg )
+        msg = "";
+
+    auto it = msg_map.find(msg);
+
+    if ( it != msg_map.end() and !strcmp(msg, msg_text.c_str() + msg_off[it->second]) )
+        return it->second;
+
+    uint32_t id = msg_off.size();
+    msg_map[msg] = id;
+    msg_off.push_back(msg_text.size());
+    msg_text.append(msg, strlen(msg) + 1);
+    return id;
+}
+
+uint64_t ColWriter::put_packet(const Packet* p, const Event* e)
+{
+    if ( !pkt or !p or !p->pkth )
+        return COL_NO_PACKET;
+
+    ColPacketHeader ph;
+    ph.event_id = e->event_id;
+    ph.ts_sec = (uint32_t)p->pkth->ts.tv_sec;
+    ph.ts_usec = (uint32_t)p->pkth->ts.tv_usec;
+    ph.caplen = p->pkth->caplen;
+    ph.pktlen = p->pkth->pktlen;
+    ph.reserved = 0;
+
+    write(pkt, &ph, sizeof(ph));
+    write(pkt, p->pkt, ph.caplen);
+
+    uint64_t off = pkt_pos;
+    pkt_pos += sizeof(ph) + ph.caplen;
+    return off;
+}
+
+static inline void put_addr(uint8_t* col, const sfip_t* ip)
+{
+    if ( ip->is_ip6() )
+    {
+        memcpy(col, ip->ip8, 16);
+        return;
+    }
+    memset(col, 0, 10);
+    col[10] = col[11] = 0xff;
+    memcpy(col + 12, ip->ip8, 4);
+}
+
+void ColWriter::add(Packet* p, const char* msg, Event* e)
+{
+    const SigInfo* si = e->sig_info;
+    unsigned n = events;
+
+    if ( !n )
+    {
+        started = time(nullptr);
+        min_sec = max_sec = e->ref_time.tv_sec;
+        min_sid = max_sid = si->id;
+    }
+    else
+    {
+        if ( e->ref_time.tv_sec < min_sec )
+            min_sec = e->ref_time.tv_sec;
+        else if ( e->ref_time.tv_sec > max_sec )
+            max_sec = e->ref_time.tv_sec;
+
+        if ( si->id < min_sid )
+            min_sid = si->id;
+        else if ( si->id > max_sid )
+            max_sid = si->id;
+    }
+
+    ((uint32_t*)cols[COL_TS_SEC])[n] = e->ref_time.tv_sec;
+    ((uint32_t*)cols[COL_TS_USEC])[n] = e->ref_time.tv_usec;
+    ((uint32_t*)cols[COL_EVENT_ID])[n] = e->event_id;
+    ((uint32_t*)cols[COL_GID])[n] = si->generator;
+    ((uint32_t*)cols[COL_SID])[n] = si->id;
+    ((uint32_t*)cols[COL_REV])[n] = si->rev;
+    ((uint32_t*)cols[COL_CLASS])[n] = si->class_id;
+    ((uint32_t*)cols[COL_PRIORITY])[n] = si->priority;
+    ((uint32_t*)cols[COL_MSG])[n] = get_msg(msg);
+
+    uint8_t proto = 0;
+    uint16_t sp = 0, dp = 0;
+    uint8_t* src = cols[COL_SRC_ADDR] + 16*n;
+    uint8_t* dst = cols[COL_DST_ADDR] + 16*n;
+
+    if ( p and p->has_ip() )
+    {
+        put_addr(src, p->ptrs.ip_api.get_src());
+        put_addr(dst, p->ptrs.ip_api.get_dst());
+
+        if ( p->is_portscan() )
+            proto = p->ps_proto;
+
+        else
+        {
+            proto = p->get_ip_proto_next();
+
+            if ( p->type() == PktType::ICMP )
+            {
+                sp = p->ptrs.icmph->type;
+                dp = p->ptrs.icmph->code;
+            }
+            else
+            {
+                sp = p->ptrs.sp;
+                dp = p->ptrs.dp;
+            }
+        }
+    }
+    else
+    {
+        memset(src, 0, 16);
+        memset(dst, 0, 16);
+    }
+    cols[COL_ACTION][n] = (uint8_t)Active::get_status();
+    cols[COL_PROTO][n] = proto;
+    ((uint16_t*)cols[COL_SRC_PORT])[n] = sp;
+    ((uint16_t*)cols[COL_DST_PORT])[n] = dp;
+    ((uint64_t*)cols[COL_PKT_OFF])[n] = put_packet(p, e);
+
+    if ( ++events == config.segment_size or
+        (config.flush_interval and max_sec - min_sec >= config.flush_interval) )
+    {
+        flush();
+        check_limit();
+    }
+}
+
+// event times don't advance without packets so a partial segment is
+// aged by the wall clock here
+void ColWriter::idle()
+{
+    if ( !events or !config.flush_interval )
+        return;
+
+    if ( time(nullptr) - started >= (time_t)config.flush_interval )
+    {
+        flush();
+        check_limit();
+    }
+}
+
+void ColWriter::check_limit()
+{
+    if ( config.limit and log_pos > config.limit )
+    {
+        close_files();
+        open_files();
+    }
+}
+
+void ColWriter::flush()
+{
+    if ( !events )
+        return;
+
+    ColDirEntry dir[COL_MAX];
+    uint32_t off = 0;
+
+    for ( unsigned i = 0; i < COL_MAX; ++i )
+    {
+        dir[i].id = i;
+        dir[i].width = col_width[i];
+        dir[i].offset = off;
+
+        if ( i == COL_MSG_DICT )
+            dir[i].length = sizeof(uint32_t) + msg_text.size();
+        else
+            dir[i].length = col_width[i] * events;
+
+        off += col_align(dir[i].length);
+    }
+
+    ColSegmentHeader sh;
+    sh.magic = COL_SEG_MAGIC;
+    sh.events = events;
+    sh.length = sizeof(dir) + off;
+    sh.columns = COL_MAX;
+    sh.reserved = 0;
+    sh.min_sec = min_sec;
+    sh.max_sec = max_sec;
+    sh.min_sid = min_sid;
+    sh.max_sid = max_sid;
+
+    ColIndexEntry ie;
+    ie.offset = log_pos;
+    ie.events = events;
+    ie.min_sec = min_sec;
+    ie.max_sec = max_sec;
+    ie.min_sid = min_sid;
+    ie.max_sid = max_sid;
+    ie.reserved = 0;
+    index.push_back(ie);
+
+    write(log, &sh, sizeof(sh));
+    write(log, dir, sizeof(dir));
+
+    static const uint8_t pad[8] = { 0 };
+
+    for ( unsigned i = 0; i < COL_MSG_DICT; ++i )
+    {
+        write(log, cols[i], dir[i].length);
+
+        if ( unsigned n = col_align(dir[i].length) - dir[i].length )
+            write(log, pad, n);
+    }
+
+    uint32_t count = msg_off.size();
+    write(log, &count, sizeof(count));
+    write(log, msg_text.data(), msg_text.size());
+
+    if ( unsigned n = col_align(dir[COL_MSG_DICT].length) - dir[COL_MSG_DICT].length )
+        write(log, pad, n);
+
+    // a segment is complete on disk or not at all as far as tail
+    // readers are concerned
+    fflush(log);
+
+    if ( pkt )
+        fflush(pkt);
+
+    log_pos += sizeof(sh) + sh.length;
+    events = 0;
+
+    msg_map.clear();
+    msg_off.clear();
+    msg_text.clear();
+}
+
+//-------------------------------------------------------------------------
+// module stuff
+//-------------------------------------------------------------------------
+
+static THREAD_LOCAL ColWriter* col_writer = nullptr;
+
+static const Parameter s_params[] =
+{
+    { "limit", Parameter::PT_INT, "0:", "0",
+      "set limit (0 is unlimited)" },
+
+    { "units", Parameter::PT_ENUM, "B | K | M | G", "B",
+      "limit multiplier" },
+
+    { "segment_size", Parameter::PT_INT, "1:65535", "4096",
+      "maximum events per segment" },
+
+    { "flush_interval", Parameter::PT_INT, "0:", "1",
+      "write partial segment when it spans or has waited this many seconds (0 is never)" },
+
+    { "packets", Parameter::PT_BOOL, nullptr, "false",
+      "write packets to <file>.pkt" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+#define s_help \
+    "output events in blocked columnar format for fast filtering"
+
+class ColModule : public Module
+{
+public:
+    ColModule() : Module(S_NAME, s_help, s_params) { }
+
+    bool set(const char*, Value&, SnortConfig*) override;
+    bool begin(const char*, int, SnortConfig*) override;
+    bool end(const char*, int, SnortConfig*) override;
+
+public:
+    unsigned long limit;
+    unsigned units;
+    unsigned segment_size;
+    unsigned flush_interval;
+    bool packets;
+};
+
+bool ColModule::set(const char*, Value& v, SnortConfig*)
+{
+    if ( v.is("limit") )
+        limit = v.get_long();
+
+    else if ( v.is("units") )
+        units = v.get_long();
+
+    else if ( v.is("segment_size") )
+        segment_size = v.get_long();
+
+    else if ( v.is("flush_interval") )
+        flush_interval = v.get_long();
+
+    else if ( v.is("packets") )
+        packets = v.get_bool();
+
+    else
+        return false;
+
+    return true;
+}
+
+bool ColModule::begin(const char*, int, SnortConfig*)
+{
+    limit = 0;
+    units = 0;
+    segment_size = 4096;
+    flush_interval = 1;
+    packets = false;
+    return true;
+}
+
+bool ColModule::end(const char*, int, SnortConfig*)
+{
+    while ( units-- )
+        limit *= 1024;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// logger stuff
+//-------------------------------------------------------------------------
+
+class ColLogger : public Logger
+{
+public:
+    ColLogger(ColModule*);
+
+    void open() override;
+    void close() override;
+
+    void alert(Packet*, const char* msg, Event*) override;
+    void idle() override;
+
+private:
+    ColConfig config;
+};
+
+ColLogger::ColLogger(ColModule* m)
+{
+    config.limit = m->limit;
+    config.segment_size = m->segment_size;
+    config.flush_interval = m->flush_interval;
+    config.packets = m->packets;
+}
+
+void ColLogger::open()
+{
+    if ( SnortConfig::test_mode() )
+        return;
+
+    // config is shared by all packet threads
+    ColConfig c = config;
+    get_instance_file(c.file, F_NAME);
+    col_writer = new ColWriter(c);
+}
+
+void ColLogger::close()
+{
+    delete col_writer;
+    col_writer = nullptr;
+}
+
+void ColLogger::alert(Packet* p, const char* msg, Event* event)
+{
+    if ( col_writer )
+        col_writer->add(p, msg, event);
+}
+
+void ColLogger::idle()
+{
+    if ( col_writer )
+        col_writer->idle();
+}
+
+//-------------------------------------------------------------------------
+// api stuff
+//-------------------------------------------------------------------------
+
+static Module* mod_ctor()
+{ return new ColModule; }
+
+static void mod_dtor(Module* m)
+{ delete m; }
+
+static Logger* col_ctor(SnortConfig*, Module* mod)
+{ return new ColLogger((ColModule*)mod); }
+
+static void col_dtor(Logger* p)
+{ delete p; }
+
+static LogApi col_api
+{
+    {
+        PT_LOGGER,
+        sizeof(LogApi),
+        LOGAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        S_NAME,
+        s_help,
+        mod_ctor,
+        mod_dtor
+    },
+    OUTPUT_TYPE_FLAG__ALERT,
+    col_ctor,
+    col_dtor
+};
+
+#ifdef BUILDING_SO
+SO_PUBLIC const BaseApi* snort_plugins[] =
+{
+    &col_api.base,
+    nullptr
+};
+#else
+const BaseApi* eh_columnar = &col_api.base;
+#endif
+
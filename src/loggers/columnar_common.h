@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// columnar_common.h
+
+#ifndef COLUMNAR_COMMON_H
+#define COLUMNAR_COMMON_H
+
+// on disk layout of the columnar event log shared by the columnar logger
+// and the col_reader tool.  all fields are in host byte order; readers use
+// ColFileHeader.byte_order to reject files from a host of other endianness.
+//
+// file := ColFileHeader segment* [index ColFileTrailer]
+// segment := ColSegmentHeader ColDirEntry[columns] column data
+//
+// each segment holds up to segment_size events stored column by column so
+// a reader can filter on a few columns without decoding the rest.  every
+// column starts on an 8 byte boundary relative to the segment payload.
+// messages are dictionary encoded per segment so segments are self
+// contained.  the index and trailer are written when the file is closed;
+// if they are missing readers fall back to walking segment headers.
+//
+// packets are optionally written to a side file (<log file>.pkt) as
+// ColPacketHeader + data; the event's COL_PKT_OFF column gives the offset
+// of the packet header in that file or COL_NO_PACKET.
+
+#include <stdint.h>
+
+#define COL_MAGIC         0x4c4f4353  // "SCOL"
+#define COL_SEG_MAGIC     0x47455353  // "SSEG"
+#define COL_IDX_MAGIC     0x58444953  // "SIDX"
+#define COL_BYTE_ORDER    0x01020304
+#define COL_VERSION       1
+
+#define COL_FLAG_PACKETS  0x0001
+
+#define COL_NO_PACKET     UINT64_MAX
+
+enum ColId
+{
+    COL_TS_SEC,      // uint32_t
+    COL_TS_USEC,     // uint32_t
+    COL_EVENT_ID,    // uint32_t
+    COL_GID,         // uint32_t
+    COL_SID,         // uint32_t
+    COL_REV,         // uint32_t
+    COL_CLASS,       // uint32_t
+    COL_PRIORITY,    // uint32_t
+    COL_ACTION,      // uint8_t Active::ActiveStatus
+    COL_PROTO,       // uint8_t ip protocol
+    COL_SRC_PORT,    // uint16_t port or icmp type
+    COL_DST_PORT,    // uint16_t port or icmp code
+    COL_SRC_ADDR,    // uint8_t[16], ip4 is v4 mapped
+    COL_DST_ADDR,    // uint8_t[16], ip4 is v4 mapped
+    COL_MSG,         // uint32_t index into COL_MSG_DICT
+    COL_PKT_OFF,     // uint64_t offset into packet file
+    COL_MSG_DICT,    // uint32_t count + count nul terminated strings
+    COL_MAX
+};
+
+// fixed width of each column value; 0 is variable length
+static const unsigned col_width[COL_MAX] =
+{ 4, 4, 4, 4, 4, 4, 4, 4, 1, 1, 2, 2, 16, 16, 4, 8, 0 };
+
+struct ColFileHeader
+{
+    uint32_t magic;
+    uint32_t byte_order;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t created;      // unix time
+    uint32_t linktype;     // DLT of packets in side file
+    uint32_t reserved;
+};
+
+struct ColSegmentHeader
+{
+    uint32_t magic;
+    uint32_t events;
+    uint32_t length;       // bytes following this header
+    uint16_t columns;      // number of ColDirEntry following this header
+    uint16_t reserved;
+    uint32_t min_sec;
+    uint32_t max_sec;
+    uint32_t min_sid;
+    uint32_t max_sid;
+};
+
+struct ColDirEntry
+{
+    uint16_t id;           // ColId
+    uint16_t width;        // col_width[id]
+    uint32_t offset;       // from end of directory
+    uint32_t length;
+};
+
+struct ColIndexEntry
+{
+    uint64_t offset;       // of ColSegmentHeader from start of file
+    uint32_t events;
+    uint32_t min_sec;
+    uint32_t max_sec;
+    uint32_t min_sid;
+    uint32_t max_sid;
+    uint32_t reserved;
+};
+
+// last bytes of a cleanly closed file
+struct ColFileTrailer
+{
+    uint64_t index_offset;
+    uint32_t segments;
+    uint32_t magic;
+};
+
+struct ColPacketHeader
+{
+    uint32_t event_id;
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t caplen;
+    uint32_t pktlen;
+    uint32_t reserved;
+};
+
+#endif
+
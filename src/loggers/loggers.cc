@@ -39,6 +39,7 @@ extern const BaseApi* alert_full;
 extern const BaseApi* alert_syslog;
 extern const BaseApi* log_hext;
 extern const BaseApi* log_pcap;
+extern const BaseApi* eh_columnar;
 extern const BaseApi* eh_unified2;
 #endif
 
@@ -63,6 +64,7 @@ const BaseApi* loggers[] =
     log_pcap,
 
     // both
+    eh_columnar,
     eh_unified2,
 #endif
 
@@ -39,6 +39,7 @@
 #include <netinet/in.h>
 
 #include <string>
+#include <vector>
 
 #include "main/snort_types.h"
 #include "main/snort_debug.h"
@@ -56,6 +57,7 @@
 #include "utils/util.h"
 #include "utils/snort_bounds.h"
 #include "log/obfuscation.h"
+#include "log/log_writer.h"
 #include "packet_io/active.h"
 #include "packet_io/sfdaq.h"
 #include "stream/stream_api.h"
@@ -85,6 +87,11 @@ typedef struct _Unified2LogCallbackData
     uint32_t num_bytes;
 } Unified2LogCallbackData;
 
+/* Used for buffering header and payload of unified records so only one
+ * write is necessary. */
+constexpr unsigned u2_buf_sz =
+    sizeof(Serial_Unified2_Header) + sizeof(Unified2IDSEventIPv6) + IP_MAXPACKET;
+
 struct U2
 {
     int base_proto;
@@ -92,17 +99,23 @@ struct U2
     char filepath[STD_BUF];
     FILE* stream;
     unsigned int current;
+
+    // set when records are written by the LogWriter thread
+    LogQueue* queue;
+    LogSink* sink;
+
+    /* This buffer is used in lieu of the underlying default stream buf to
+     * prevent flushing in the middle of a record.  Every write is force
+     * flushed to disk immediately after the entire record (or batch of
+     * records if async) is written so spoolers get an entire record.
+     * It is kept here since files may be rotated on the writer thread. */
+    char io_buffer[u2_buf_sz];
 };
 
 /* -------------------- Global Variables ----------------------*/
 
 static THREAD_LOCAL U2 u2;
 
-/* Used for buffering header and payload of unified records so only one
- * write is necessary. */
-constexpr unsigned u2_buf_sz =
-    sizeof(Serial_Unified2_Header) + sizeof(Unified2IDSEventIPv6) + IP_MAXPACKET;
-
 // TBD - is performance any better if these buffers are off the heap?
 static THREAD_LOCAL uint8_t write_pkt_buffer[u2_buf_sz];
 
@@ -112,21 +125,14 @@ static THREAD_LOCAL uint8_t write_pkt_buffer[u2_buf_sz];
     (MAX_XFF_WRITE_BUF_LENGTH - \
     sizeof(struct in6_addr) + DECODE_BLEN)
 
-/* This buffer is used in lieu of the underlying default stream buf to
- * prevent flushing in the middle of a record.  Every write is force
- * flushed to disk immediately after the entire record is written so
- * spoolers get an entire record */
-
-/* use the size of the buffer we copy record data into */
-static THREAD_LOCAL char io_buffer[u2_buf_sz];
-
 /* -------------------- Local Functions -----------------------*/
 
 /* Unified2 Output functions */
-static void Unified2InitFile(Unified2Config*);
-static inline void Unified2RotateFile(Unified2Config*);
+static void Unified2InitFile(U2&, Unified2Config*);
+static inline void Unified2RotateFile(U2&, Unified2Config*);
 static void _Unified2LogPacketAlert(Packet*, const char*, Unified2Config*, Event*);
 static void Unified2Write(uint8_t*, uint32_t, Unified2Config*);
+static void Unified2WriteFile(U2&, const uint8_t*, uint32_t, Unified2Config*);
 
 static void _AlertIP4_v2(Packet*, const char*, Unified2Config*, Event*);
 static void _AlertIP6_v2(Packet*, const char*, Unified2Config*, Event*);
@@ -173,7 +179,7 @@ static int GetU2Flags(const Packet*, uint8_t* pimpact)
  *
  * Returns: void function
  */
-static void Unified2InitFile(Unified2Config* config)
+static void Unified2InitFile(U2& u, Unified2Config* config)
 {
     char filepath[STD_BUF];
     char* fname_ptr;
@@ -184,12 +190,12 @@ static void Unified2InitFile(Unified2Config* config)
             "configuration data is NULL.\n", __FILE__, __LINE__);
     }
 
-    u2.timestamp = (uint32_t)time(NULL);
+    u.timestamp = (uint32_t)time(NULL);
 
     if (!config->nostamp)
     {
         if (SnortSnprintf(filepath, sizeof(filepath), "%s.%u",
-            u2.filepath, u2.timestamp) != SNORT_SNPRINTF_SUCCESS)
+            u.filepath, u.timestamp) != SNORT_SNPRINTF_SUCCESS)
         {
             FatalError("%s(%d) Failed to copy unified2 file path.\n",
                 __FILE__, __LINE__);
@@ -199,11 +205,11 @@ static void Unified2InitFile(Unified2Config* config)
     }
     else
     {
-        fname_ptr = u2.filepath;
+        fname_ptr = u.filepath;
     }
 
     // FIXIT-L should use open() instead of fopen()
-    if ((u2.stream = fopen(fname_ptr, "wb")) == NULL)
+    if ((u.stream = fopen(fname_ptr, "wb")) == NULL)
     {
         FatalError("%s(%d) Could not open %s: %s\n",
             __FILE__, __LINE__, fname_ptr, get_error(errno));
@@ -211,7 +217,7 @@ static void Unified2InitFile(Unified2Config* config)
 
     /* Set buffer to size of record buffer so the system doesn't flush
      * part of a record if it's greater than BUFSIZ */
-    if (setvbuf(u2.stream, io_buffer, _IOFBF, sizeof(io_buffer)) != 0)
+    if (setvbuf(u.stream, u.io_buffer, _IOFBF, sizeof(u.io_buffer)) != 0)
     {
         ErrorMessage("%s(%d) Could not set I/O buffer: %s. "
             "Using system default.\n",
@@ -221,8 +227,8 @@ static void Unified2InitFile(Unified2Config* config)
     /* If test mode, close and delete the file */
     if (SnortConfig::test_mode())  // FIXIT-L eliminate test check; should always remove if empty
     {
-        fclose(u2.stream);
-        u2.stream = NULL;
+        fclose(u.stream);
+        u.stream = NULL;
         if (unlink(fname_ptr) == -1)
         {
             ErrorMessage("%s(%d) Running in test mode so we want to remove "
@@ -232,11 +238,11 @@ static void Unified2InitFile(Unified2Config* config)
     }
 }
 
-static inline void Unified2RotateFile(Unified2Config* config)
+static inline void Unified2RotateFile(U2& u, Unified2Config* config)
 {
-    fclose(u2.stream);
-    u2.current = 0;
-    Unified2InitFile(config);
+    fclose(u.stream);
+    u.current = 0;
+    Unified2InitFile(u, config);
 }
 
 static void _AlertIP4_v2(Packet* p, const char*, Unified2Config* config, Event* event)
@@ -303,8 +309,6 @@ static void _AlertIP4_v2(Packet* p, const char*, Unified2Config* config, Event*
         }
     }
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
 
     hdr.length = htonl(sizeof(Unified2IDSEvent));
     hdr.type = htonl(UNIFIED2_IDS_EVENT_VLAN);
@@ -397,8 +401,6 @@ static void _AlertIP6_v2(Packet* p, const char*, Unified2Config* config, Event*
         }
     }
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
 
     hdr.length = htonl(sizeof(Unified2IDSEventIPv6));
     hdr.type = htonl(UNIFIED2_IDS_EVENT_IPV6_VLAN);
@@ -454,8 +456,6 @@ void _WriteExtraData(Unified2Config* config,
     alertHdr.event_type = htonl(EVENT_TYPE_EXTRA_DATA);
     alertHdr.event_length = htonl(write_len - sizeof(Serial_Unified2_Header));
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
 
     hdr.length = htonl(write_len - sizeof(Serial_Unified2_Header));
     hdr.type = htonl(UNIFIED2_EXTRA_DATA);
@@ -593,8 +593,6 @@ static void _Unified2LogPacketAlert(
         logheader.packet_length = 0;
     }
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
 
     hdr.length = htonl(sizeof(Serial_Unified2Packet) - 4 + pkt_length);
     hdr.type = htonl(UNIFIED2_PACKET);
@@ -659,10 +657,6 @@ static ObRet Unified2LogObfuscationCallback(const DAQ_PktHdr_t* pkth,
             return OB_RET_ERROR;
         }
 
-        if ( unifiedData->config->limit &&
-            (u2.current + record_len) > unifiedData->config->limit )
-            Unified2RotateFile(unifiedData->config);
-
         hdr.type = htonl(UNIFIED2_PACKET);
         hdr.length = htonl((sizeof(Serial_Unified2Packet) - 4) + pkth->caplen);
 
@@ -722,9 +716,11 @@ static ObRet Unified2LogObfuscationCallback(const DAQ_PktHdr_t* pkth,
 }
 
 /******************************************************************************
- * Function: Unified2Write()
+ * Function: Unified2WriteFile()
  *
- * Main function for writing to the unified2 file.
+ * Main function for writing to the unified2 file.  This is called from
+ * the packet thread or, if async logging is enabled, from the LogWriter
+ * thread.
  *
  * For low level I/O errors, the current unified2 file is closed and a new
  * one created and a write to the new unified2 file is done.  It was found
@@ -742,6 +738,8 @@ static ObRet Unified2LogObfuscationCallback(const DAQ_PktHdr_t* pkth,
  * unified2 file.
  *
  * Arguments
+ *  U2 &
+ *      The file state of the logger instance
  *  uint8_t *
  *      The buffer containing the data to write
  *  uint32_t
@@ -752,18 +750,19 @@ static ObRet Unified2LogObfuscationCallback(const DAQ_PktHdr_t* pkth,
  * Returns: None
  *
  ******************************************************************************/
-static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config)
+static void Unified2WriteFile(
+    U2& u, const uint8_t* buf, uint32_t buf_len, Unified2Config* config)
 {
     size_t fwcount = 0;
     int ffstatus = 0;
 
     /* Nothing to write or nothing to write to */
-    if ((buf == NULL) || (config == NULL) || (u2.stream == NULL))
+    if ((buf == NULL) || (config == NULL) || (u.stream == NULL))
         return;
 
     /* Don't use fsync().  It is a total performance killer */
-    if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) != 1) ||
-        ((ffstatus = fflush(u2.stream)) != 0))
+    if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u.stream)) != 1) ||
+        ((ffstatus = fflush(u.stream)) != 0))
     {
         /* errno is saved just to avoid other intervening calls
          * (e.g. ErrorMessage) potentially reseting it to something else. */
@@ -779,13 +778,13 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
             if (config->nostamp)
             {
                 ErrorMessage("%s(%d) Failed to write to unified2 file (%s): %s\n",
-                    __FILE__, __LINE__, u2.filepath, get_error(error));
+                    __FILE__, __LINE__, u.filepath, get_error(error));
             }
             else
             {
                 ErrorMessage("%s(%d) Failed to write to unified2 file (%s.%u): %s\n",
-                    __FILE__, __LINE__, u2.filepath,
-                    u2.timestamp, get_error(error));
+                    __FILE__, __LINE__, u.filepath,
+                    u.timestamp, get_error(error));
             }
 
             while ((error == EINTR) && (max_retries != 0))
@@ -800,8 +799,8 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
                 if (fwcount != 1)
                 {
                     /* fwrite() failed.  Redo fwrite and fflush */
-                    if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) == 1) &&
-                        ((ffstatus = fflush(u2.stream)) == 0))
+                    if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u.stream)) == 1) &&
+                        ((ffstatus = fflush(u.stream)) == 0))
                     {
                         ErrorMessage("%s(%d) Write to unified2 file succeeded\n",
                             __FILE__, __LINE__);
@@ -809,7 +808,7 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
                         break;
                     }
                 }
-                else if ((ffstatus = fflush(u2.stream)) == 0)
+                else if ((ffstatus = fflush(u.stream)) == 0)
                 {
                     ErrorMessage("%s(%d) Write to unified2 file succeeded\n",
                         __FILE__, __LINE__);
@@ -838,22 +837,22 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
                     "Closing this unified2 file and creating "
                     "a new one.\n", __FILE__, __LINE__);
 
-                Unified2RotateFile(config);
+                Unified2RotateFile(u, config);
 
                 if (config->nostamp)
                 {
                     ErrorMessage("%s(%d) New unified2 file: %s\n",
-                        __FILE__, __LINE__, u2.filepath);
+                        __FILE__, __LINE__, u.filepath);
                 }
                 else
                 {
                     ErrorMessage("%s(%d) New unified2 file: %s.%u\n",
                         __FILE__, __LINE__,
-                        u2.filepath, u2.timestamp);
+                        u.filepath, u.timestamp);
                 }
 
-                if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) == 1) &&
-                    ((ffstatus = fflush(u2.stream)) == 0))
+                if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u.stream)) == 1) &&
+                    ((ffstatus = fflush(u.stream)) == 0))
                 {
                     ErrorMessage("%s(%d) Write to unified2 file succeeded\n",
                         __FILE__, __LINE__);
@@ -871,13 +870,13 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
                 if (config->nostamp)
                 {
                     ErrorMessage("%s(%d) Failed to write to unified2 file (%s): %s\n",
-                        __FILE__, __LINE__, u2.filepath, get_error(error));
+                        __FILE__, __LINE__, u.filepath, get_error(error));
                 }
                 else
                 {
                     ErrorMessage("%s(%d) Failed to write to unified2 file (%s.%u): %s\n",
-                        __FILE__, __LINE__, u2.filepath,
-                        u2.timestamp, get_error(error));
+                        __FILE__, __LINE__, u.filepath,
+                        u.timestamp, get_error(error));
                 }
 
             /* Fall through */
@@ -901,7 +900,65 @@ static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config
         }
     }
 
-    u2.current += buf_len;
+    u.current += buf_len;
+}
+
+/******************************************************************************
+ * Function: Unified2Write()
+ *
+ * Writes a complete record from the packet thread, either directly or by
+ * queuing it for the LogWriter thread.  Files are rotated on record (or
+ * batch) boundaries when the limit would be exceeded.
+ ******************************************************************************/
+static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config)
+{
+    if ( u2.queue )
+    {
+        u2.queue->put(buf, buf_len);
+        return;
+    }
+
+    if ( config->limit && (u2.current + buf_len) > config->limit )
+        Unified2RotateFile(u2, config);
+
+    Unified2WriteFile(u2, buf, buf_len, config);
+}
+
+class U2Sink : public LogSink
+{
+public:
+    U2Sink(U2& u, Unified2Config* c) : state(u)
+    { config = c; }
+
+    void write(const struct iovec*, int count, size_t len) override;
+
+private:
+    U2& state;
+    Unified2Config* config;
+    std::vector<uint8_t> scratch;  // joins a batch that wraps the queue
+};
+
+void U2Sink::write(const struct iovec* iov, int count, size_t len)
+{
+    if ( config->limit && (state.current + len) > config->limit )
+        Unified2RotateFile(state, config);
+
+    // one write and one flush per batch
+    if ( count == 1 )
+    {
+        Unified2WriteFile(state, (uint8_t*)iov[0].iov_base, iov[0].iov_len, config);
+        return;
+    }
+
+    scratch.resize(len);
+    size_t off = 0;
+
+    for ( int i = 0; i < count; ++i )
+    {
+        memcpy(scratch.data() + off, iov[i].iov_base, iov[i].iov_len);
+        off += iov[i].iov_len;
+    }
+    Unified2WriteFile(state, scratch.data(), off, config);
 }
 
 //-------------------------------------------------------------------------
@@ -1036,13 +1093,36 @@ void U2Logger::open()
     }
     u2.base_proto = htonl(DAQ_GetBaseProtocol());
 
-    Unified2InitFile(&config);
+    Unified2InitFile(u2, &config);
+
+    if ( snort_conf->async_log_size )
+    {
+        // records are queued whole so the queue must hold the largest
+        unsigned size = snort_conf->async_log_size;
+
+        if ( size < u2_buf_sz )
+            size = u2_buf_sz;
+
+        u2.sink = new U2Sink(u2, &config);
+        u2.queue = new LogQueue(
+            u2.sink, size, (LogOverflow)snort_conf->async_log_overflow);
+
+        LogWriter::add(u2.queue);
+    }
 
     stream.reg_xtra_data_log(AlertExtraData, &config);
 }
 
 void U2Logger::close()
 {
+    if ( u2.queue )
+    {
+        LogWriter::remove(u2.queue);
+        delete u2.queue;
+        delete u2.sink;
+        u2.queue = nullptr;
+        u2.sink = nullptr;
+    }
     if ( u2.stream )
         fclose(u2.stream);
 }
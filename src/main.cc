@@ -37,6 +37,7 @@
 #include <netinet/in.h>
 #endif
 
+#include <list>
 #include <string>
 #include <thread>
 using namespace std;
@@ -56,6 +57,7 @@ using namespace std;
 #include "packet_io/intf.h"
 #include "packet_io/sfdaq.h"
 #include "control/idle_processing.h"
+#include "target_based/sftarget_image.h"
 #include "target_based/sftarget_reader.h"
 #include "flow/flow_control.h"
 #include "lua/lua.h"
@@ -74,7 +76,7 @@ using namespace std;
 
 //-------------------------------------------------------------------------
 
-static Swapper* swapper = NULL;
+static std::list<Swapper*> retired;  // in epoch order
 
 static int exit_logged = 0;
 static bool paused = false;
@@ -106,8 +108,15 @@ static bool use_shell(SnortConfig* sc)
 // swap foo
 //-------------------------------------------------------------------------
 
+static unsigned current_epoch = 0;
+
+unsigned Swapper::get_current_epoch()
+{ return current_epoch; }
+
 Swapper::Swapper(SnortConfig* s, tTargetBasedConfig* t)
 {
+    epoch = current_epoch;
+
     old_conf = nullptr;
     new_conf = s;
 
@@ -115,20 +124,14 @@ Swapper::Swapper(SnortConfig* s, tTargetBasedConfig* t)
     new_attribs = t;
 }
 
-Swapper::Swapper(SnortConfig* sold, SnortConfig* snew)
+Swapper::Swapper(
+    SnortConfig* sold, SnortConfig* snew, tTargetBasedConfig* told, tTargetBasedConfig* tnew)
 {
+    epoch = ++current_epoch;
+
     old_conf = sold;
     new_conf = snew;
 
-    old_attribs = nullptr;
-    new_attribs = nullptr;
-}
-
-Swapper::Swapper(tTargetBasedConfig* told, tTargetBasedConfig* tnew)
-{
-    old_conf = nullptr;
-    new_conf = nullptr;
-
     old_attribs = told;
     new_attribs = tnew;
 }
@@ -298,13 +301,16 @@ int main_rotate_stats(lua_State*)
     return 0;
 }
 
+static void swap(Swapper* swapper)
+{
+    retired.push_back(swapper);
+
+    for ( unsigned idx = 0; idx < max_pigs; ++idx )
+        pigs[idx].swap(swapper);
+}
+
 int main_reload_config(lua_State* L)
 {
-    if ( swapper )
-    {
-        request.respond("== reload pending; retry\n");
-        return 0;
-    }
     Lua::ManageStack(L, 1);
     const char* fname = luaL_checkstring(L, 1);
 
@@ -321,21 +327,12 @@ int main_reload_config(lua_State* L)
     snort_conf = sc;
     proc_stats.conf_reloads++;
 
-    swapper = new Swapper(old, sc);
-
-    for ( unsigned idx = 0; idx < max_pigs; ++idx )
-        pigs[idx].swap(swapper);
-
+    swap(new Swapper(old, sc, nullptr, SFAT_GetConfig()));
     return 0;
 }
 
 int main_reload_hosts(lua_State* L)
 {
-    if ( swapper )
-    {
-        request.respond("== reload pending; retry\n");
-        return 0;
-    }
     Lua::ManageStack(L, 1);
     const char* fname = luaL_checkstring(L, 1);
 
@@ -347,8 +344,22 @@ int main_reload_hosts(lua_State* L)
         return 0;
     }
 
-    Shell sh = Shell(fname);
-    sh.configure(snort_conf);
+    if ( SFAT_IsImage(fname) )
+    {
+        if ( !SFAT_LoadImage(fname) )
+        {
+            request.respond("== reload failed\n");
+            return 0;
+        }
+    }
+    else
+    {
+        Shell sh = Shell(fname);
+        sh.configure(snort_conf);
+
+        if ( !SFAT_KeepImage() )
+            request.respond("== hosts image could not be kept\n");
+    }
 
     tTargetBasedConfig* old = SFAT_GetConfig();
     tTargetBasedConfig* tc = SFAT_Swap();
@@ -358,11 +369,7 @@ int main_reload_hosts(lua_State* L)
         request.respond("== reload failed\n");
         return 0;
     }
-    swapper = new Swapper(old, tc);
-
-    for ( unsigned idx = 0; idx < max_pigs; ++idx )
-        pigs[idx].swap(swapper);
-
+    swap(new Swapper(nullptr, snort_conf, old, tc));
     return 0;
 }
 
@@ -650,22 +657,36 @@ static bool service_users()
 
 #endif
 
+// the configs replaced at epoch n can't be in use once every running
+// packet thread has applied epoch n or later
 static bool check_response()
 {
-    if ( !swapper )
+    if ( retired.empty() )
         return false;
 
+    unsigned epoch = Swapper::get_current_epoch();
+
     for ( unsigned idx = 0; idx < max_pigs; ++idx )
     {
-        if ( pigs[idx].analyzer and pigs[idx].analyzer->swap_pending() )
-            return false;
+        Analyzer* a = pigs[idx].analyzer;
+
+        if ( a and !a->is_done() and a->get_epoch() < epoch )
+            epoch = a->get_epoch();
     }
 
-    delete swapper;
-    swapper = nullptr;
+    bool done = false;
 
-    LogMessage("== reload complete\n");
-    return true;
+    while ( !retired.empty() and retired.front()->get_epoch() <= epoch )
+    {
+        delete retired.front();
+        retired.pop_front();
+        done = true;
+    }
+
+    if ( done and retired.empty() )
+        LogMessage("== reload complete\n");
+
+    return done;
 }
 
 static void service_check()
@@ -848,6 +869,11 @@ static void snort_main()
     delete[] pigs;
     pigs = nullptr;
 
+    for ( auto* p : retired )
+        delete p;
+
+    retired.clear();
+
     TimeStop();
 #ifdef BUILD_SHELL
     socket_term();
@@ -46,6 +46,7 @@ Analyzer::Analyzer(const char* s)
     source = s;
     command = AC_NONE;
     swap = nullptr;
+    epoch = 0;
     daqh = nullptr;
 }
 
@@ -53,6 +54,7 @@ void Analyzer::operator()(unsigned id, Swapper* ps)
 {
     set_instance_id(id);
     ps->apply();
+    epoch = ps->get_epoch();
 
     pin_thread_to_cpu(source);
     Snort::thread_init(source);
@@ -110,20 +112,31 @@ bool Analyzer::handle(AnalyzerCommand ac)
         break;
 
     case AC_SWAP:
-        if ( swap )
-        {
-            swap->apply();
-            swap = nullptr;
-        }
         command = AC_NONE;
         break;
 
     default:
         break;
     }
+
+    // a swap set while another command was pending is picked up here too
+    apply_swap();
     return true;
 }
 
+// this is the quiescent point: no packet is in flight so the old configs
+// are released once the epoch is published
+void Analyzer::apply_swap()
+{
+    Swapper* ps = swap.exchange(nullptr);
+
+    if ( !ps )
+        return;
+
+    ps->apply();
+    epoch = ps->get_epoch();
+}
+
 void Analyzer::analyze()
 {
     while ( true )
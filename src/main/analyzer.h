@@ -24,6 +24,8 @@
 // runs in a different thread, it also provides a command facility so that
 // to control the thread and swap configuration.
 
+#include <atomic>
+
 #include "main/snort_types.h"
 
 enum AnalyzerCommand
@@ -53,19 +55,24 @@ public:
     // FIXIT-M add asynchronous response too
     bool execute(AnalyzerCommand);
 
+    // replaces any swap not yet applied; swappers are complete snapshots
     void set_config(Swapper* ps) { swap = ps; }
-    bool swap_pending() { return command == AC_SWAP; }
+
+    // the epoch of the last swap applied
+    unsigned get_epoch() { return epoch; }
 
 private:
     void analyze();
     bool handle(AnalyzerCommand);
+    void apply_swap();
 
 private:
     bool done;
     uint64_t count;
     const char* source;
     volatile AnalyzerCommand command;
-    Swapper* swap;
+    std::atomic<Swapper*> swap;
+    std::atomic<unsigned> epoch;
     void* daqh;
 };
 
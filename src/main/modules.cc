@@ -30,7 +30,9 @@
 #include <string>
 using namespace std;
 
+#include "framework/data_bus.h"
 #include "framework/module.h"
+#include "managers/inspector_manager.h"
 #include "managers/module_manager.h"
 #include "managers/plugin_manager.h"
 #include "main.h"
@@ -45,6 +47,7 @@ using namespace std;
 #include "parser/parse_ip.h"
 #include "file_api/file_service.h"
 #include "file_api/libs/file_config.h"
+#include "log/log_writer.h"
 #include "filters/sfthd.h"
 #include "filters/sfrf.h"
 #include "filters/rate_filter.h"
@@ -61,6 +64,10 @@ using namespace std;
 #include "utils/stats.h"
 #include "target_based/snort_protocols.h"
 
+#ifdef BUILD_SHELL
+#include "lua/lua.h"
+#endif
+
 //-------------------------------------------------------------------------
 // detection module
 //-------------------------------------------------------------------------
@@ -350,11 +357,76 @@ static const Parameter profile_params[] =
     { "modules", Parameter::PT_TABLE, profile_module_params, nullptr,
       "" },
 
+    { "sample", Parameter::PT_INT, "1:", "1",
+      "time 1 in this many packets" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+#ifdef BUILD_SHELL
+static int profile_show(lua_State*)
+{
+    PerfProfilerManager::show_live_stats();
+    return 0;
+}
+
+static int profile_reset(lua_State*)
+{
+    PerfProfilerManager::reset_live_stats();
+    return 0;
+}
+
+static int profile_sample(lua_State* L)
+{
+    Lua::ManageStack(L, 1);
+    lua_Integer rate = luaL_checkinteger(L, 1);
+
+    PerfProfilerManager::set_sample_rate(rate > 0 ? rate : 0);
+    LogMessage("profile: sampling 1 in %u packets\n", PerfProfilerManager::get_sample_rate());
+    return 0;
+}
+
+static int profile_folded(lua_State* L)
+{
+    Lua::ManageStack(L, 1);
+    const char* file = luaL_checkstring(L, 1);
+
+    if ( !PerfProfilerManager::write_folded(file) )
+        LogMessage("profile: can't write %s\n", file);
+
+    return 0;
+}
+
+static const Parameter profile_rate_params[] =
+{
+    { "rate", Parameter::PT_INT, "0:", nullptr,
+      "time 1 in this many packets (0 = off)" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
+static const Parameter profile_file_params[] =
+{
+    { "filename", Parameter::PT_STRING, nullptr, nullptr,
+      "name of file to write" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+static const Command profile_cmds[] =
+{
+    { "show", profile_show, nullptr, "show module and rule profiles collected so far" },
+    { "reset", profile_reset, nullptr, "clear module and rule profiles" },
+    { "sample", profile_sample, profile_rate_params, "change the sampling rate" },
+    { "folded", profile_folded, profile_file_params,
+      "write the module profile as folded stacks for flame graphs" },
+
+    { nullptr, nullptr, nullptr, nullptr }
+};
+#endif
+
 #define profile_help \
-    "configure profiling of rules and/or modules (requires --enable-perf-profiling)"
+    "configure profiling of rules and/or modules"
 
 class ProfileModule : public Module
 {
@@ -362,11 +434,19 @@ public:
     ProfileModule() : Module("profile", profile_help, profile_params) { }
     bool set(const char*, Value&, SnortConfig*) override;
     bool begin(const char*, int, SnortConfig*) override;
+
+#ifdef BUILD_SHELL
+    const Command* get_commands() const override
+    { return profile_cmds; }
+#endif
 };
 
 bool ProfileModule::begin(const char* fqn, int, SnortConfig* sc)
 {
-    if ( !strcmp(fqn, "profile.rules") )
+    if ( !strcmp(fqn, "profile") )
+        sc->profile_sample = 1;
+
+    else if ( !strcmp(fqn, "profile.rules") )
         sc->profile_rules->count = -1;
 
     else if ( !strcmp(fqn, "profile.modules") )
@@ -377,6 +457,12 @@ bool ProfileModule::begin(const char* fqn, int, SnortConfig* sc)
 
 bool ProfileModule::set(const char* fqn, Value& v, SnortConfig* sc)
 {
+    if ( v.is("sample") )
+    {
+        sc->profile_sample = v.get_long();
+        return true;
+    }
+
     ProfileConfig* p;
     const char* spr = "profile.rules";
     const char* spp = "profile.modules";
@@ -632,6 +718,12 @@ static const Parameter output_event_trace_params[] =
 
 static const Parameter output_params[] =
 {
+    { "async_log_size", Parameter::PT_INT, "0:", "0",
+      "bytes queued per log file for writing by a separate thread (0 to write inline)" },
+
+    { "async_log_overflow", Parameter::PT_ENUM, "drop | block", "block",
+      "drop records or wait for the writer when an async log queue is full" },
+
     { "dump_chars_only", Parameter::PT_BOOL, nullptr, "false",
       "turns on character dumps (same as -C)" },
 
@@ -676,11 +768,23 @@ class OutputModule : public Module
 public:
     OutputModule() : Module("output", output_help, output_params) { }
     bool set(const char*, Value&, SnortConfig*) override;
+
+    const PegInfo* get_pegs() const override
+    { return log_writer_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&log_writer_stats; }
 };
 
 bool OutputModule::set(const char*, Value& v, SnortConfig* sc)
 {
-    if ( v.is("dump_chars_only") )
+    if ( v.is("async_log_size") )
+        sc->async_log_size = v.get_long();
+
+    else if ( v.is("async_log_overflow") )
+        sc->async_log_overflow = v.get_long();
+
+    else if ( v.is("dump_chars_only") )
         v.update_mask(sc->output_flags, OUTPUT_FLAG__CHAR_DATA);
 
     else if ( v.is("dump_payload") )
@@ -777,6 +881,25 @@ bool ActiveModule::set(const char*, Value& v, SnortConfig* sc)
     return true;
 }
 
+//-------------------------------------------------------------------------
+// data bus module
+//-------------------------------------------------------------------------
+
+#define data_bus_help \
+    "inspection event publish and subscribe"
+
+class DataBusModule : public Module
+{
+public:
+    DataBusModule() : Module("data_bus", data_bus_help) { }
+
+    const PegInfo* get_pegs() const override
+    { return data_bus_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&data_bus_stats; }
+};
+
 //-------------------------------------------------------------------------
 // packets module
 //-------------------------------------------------------------------------
@@ -812,6 +935,12 @@ class PacketsModule : public Module
 public:
     PacketsModule() : Module("packets", packets_help, packets_params) { }
     bool set(const char*, Value&, SnortConfig*) override;
+
+    const PegInfo* get_pegs() const override
+    { return inspector_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&inspector_stats; }
 };
 
 bool PacketsModule::set(const char*, Value& v, SnortConfig* sc)
@@ -936,6 +1065,9 @@ static const Parameter attribute_table_params[] =
     { "max_metadata_services", Parameter::PT_INT, "1:256", "8",
       "maximum number of services in rule metadata" },
 
+    { "image", Parameter::PT_STRING, nullptr, nullptr,
+      "compiled hosts file to map (see --dump-hosts); not limited by max_hosts" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -961,6 +1093,9 @@ bool AttributeTableModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("max_metadata_services") )
         sc->max_metadata_services = v.get_long();
 
+    else if ( v.is("image") )
+        sc->hosts_image = v.get_string();
+
     else
         return false;
 
@@ -2001,6 +2136,7 @@ void module_init()
     // these modules are not policy specific
     ModuleManager::add_module(new ClassificationsModule);
     ModuleManager::add_module(new DaqModule);
+    ModuleManager::add_module(new DataBusModule);
     ModuleManager::add_module(new DetectionModule);
     ModuleManager::add_module(new PacketsModule);
     ModuleManager::add_module(new ProcessModule);
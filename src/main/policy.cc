@@ -80,7 +80,7 @@ InspectionPolicy::~InspectionPolicy()
 
 void InspectionPolicy::configure()
 {
-    dbus.subscribe(PACKET_EVENT, new AltPktHandler);
+    dbus.subscribe(PACKET_EVENT_ID, new AltPktHandler);
 }
 
 //-------------------------------------------------------------------------
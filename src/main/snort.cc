@@ -80,10 +80,12 @@ using namespace std;
 #include "filters/sfthreshold.h"
 #include "filters/rate_filter.h"
 #include "filters/detection_filter.h"
+#include "time/latency.h"
 #include "time/packet_time.h"
 #include "time/ppm.h"
 #include "time/profiler.h"
 #include "time/periodic.h"
+#include "log/log_writer.h"
 #include "perf_monitor/perf.h"
 #include "ips_options/ips_flowbits.h"
 #include "events/event_queue.h"
@@ -256,6 +258,7 @@ void Snort::init(int argc, char** argv)
     }
 
     FileService::init();
+    InitTagFlows();
     register_profiles();
 
     parser_init();
@@ -267,6 +270,10 @@ void Snort::init(int argc, char** argv)
     sc->merge(snort_cmd_line_conf);
     snort_conf = sc;
 
+#ifdef PERF_PROFILING
+    PerfProfilerManager::init(snort_conf);
+#endif
+
 #ifdef PIGLET
     if ( !Piglet::piglet_mode() )
 #endif
@@ -301,12 +308,16 @@ void Snort::init(int argc, char** argv)
 
     /* Need to do this after dynamic detection stuff is initialized, too */
     IpsManager::global_init(snort_conf);
+    detection_filter_init(snort_conf->detection_filter_config);
 
     MpseManager::activate_search_engine(
         snort_conf->fast_pattern_config->get_search_api(), snort_conf);
 
     SFAT_Start();
 
+    if ( !snort_conf->hosts_dump.empty() and !SFAT_DumpImage(snort_conf->hosts_dump.c_str()) )
+        ParseError("can't dump hosts to %s", snort_conf->hosts_dump.c_str());
+
 #ifdef PIGLET
     if ( !Piglet::piglet_mode() )
 #endif
@@ -406,6 +417,7 @@ void Snort::term()
     FileService::close();
 
     sfthreshold_free();  // FIXDAQ etc.
+    detection_filter_term();
     RateFilter_Cleanup();
 
     periodic_release();
@@ -494,6 +506,7 @@ void Snort::setup(int argc, char* argv[])
 void Snort::cleanup()
 {
     DAQ_Term();
+    LogWriter::term();
 
     if ( !SnortConfig::test_mode() )  // FIXIT-M ideally the check is in one place
         PrintStatistics();
@@ -607,6 +620,12 @@ void Snort::thread_idle()
 {
     if ( flow_con )
         flow_con->timeout_flows(16384, time(NULL));
+    Active::send_queued();
+    EventManager::idle_outputs();
+
+#ifdef PERF_PROFILING
+    PerfProfilerManager::service();
+#endif
     aux_counts.idle++;
 }
 
@@ -635,7 +654,6 @@ void Snort::thread_init(const char* intf)
     InitTag();
 
     EventTrace_Init();
-    detection_filter_init(snort_conf->detection_filter_config);
 
     otnx_match_data_init(snort_conf->num_rule_types);
 
@@ -653,6 +671,9 @@ void Snort::thread_term()
     if ( !snort_conf->dirty_pig )
         InspectorManager::thread_stop(snort_conf);
 
+    // flush responses queued by thread_stop before the counts are summed
+    Active::send_queued();
+
     ModuleManager::accumulate(snort_conf);
     InspectorManager::thread_term(snort_conf);
     ActionManager::thread_term(snort_conf);
@@ -677,7 +698,6 @@ void Snort::thread_term()
 #endif
 
     otnx_match_data_term();
-    detection_filter_term();
     EventTrace_Term();
     CleanupTag();
 
@@ -694,6 +714,9 @@ void Snort::detect_rebuilt_packet(Packet* p)
     int tmp_do_detect = do_detect;
     int tmp_do_detect_content = do_detect_content;
 
+    // reassembly up to here is stream time
+    Latency::lap(LS_STREAM);
+
     SnortEventqPush();
     main_hook(p);
     SnortEventqPop();
@@ -710,6 +733,7 @@ DAQ_Verdict Snort::process_packet(
 
     PacketManager::decode(p, pkthdr, pkt);
     assert(p->pkth && p->pkt);
+    Latency::lap(LS_DECODE);
 
     if (is_frag)
     {
@@ -761,6 +785,11 @@ static DAQ_Verdict update_verdict(DAQ_Verdict verdict, int& inject)
         PacketManager::encode_update(s_packet);
         verdict = DAQ_VERDICT_REPLACE;
     }
+    else if ( s_packet->packet_flags & PKT_PATCHED )
+    {
+        // lengths and checksums are already right
+        verdict = DAQ_VERDICT_REPLACE;
+    }
     else if ( s_packet->packet_flags & PKT_RESIZED )
     {
         // we never increase, only trim, but
@@ -772,7 +801,12 @@ static DAQ_Verdict update_verdict(DAQ_Verdict verdict, int& inject)
         }
     }
     else if ( (s_packet->packet_flags & PKT_IGNORE) ||
-        (s_packet->flow && s_packet->flow->get_ignore_direction( ) == SSN_DIR_BOTH) )
+        (s_packet->flow && s_packet->flow->get_ignore_direction( ) == SSN_DIR_BOTH)
+#ifdef PPM_MGR
+        // shed elephants under load; this ignores the flow like a bypass
+        || (PPM_LOAD_LEVEL() >= PPM_LOAD_BYPASS and ppm_load_bypass(s_packet))
+#endif
+        )
     {
         if ( !Active::get_tunnel_bypass() )
         {
@@ -800,6 +834,9 @@ static DAQ_Verdict update_verdict(DAQ_Verdict verdict, int& inject)
 DAQ_Verdict Snort::packet_callback(
     void*, const DAQ_PktHdr_t* pkthdr, const uint8_t* pkt)
 {
+#ifdef PERF_PROFILING
+    PerfProfilerManager::sample();
+#endif
     PERF_PROFILE(totalPerfStats);
 
     pc.total_from_daq++;
@@ -809,6 +846,13 @@ DAQ_Verdict Snort::packet_callback(
     if ( snort_conf->pkt_skip && pc.total_from_daq <= snort_conf->pkt_skip )
         return DAQ_VERDICT_PASS;
 
+    Latency::start();
+
+#ifdef PPM_MGR
+    if ( PPM_LOAD_ENABLED() )
+        ppm_load_begin();
+#endif
+
     PERF_PROFILE_BLOCK(eventqPerfStats)
     {
         SnortEventqReset();
@@ -826,12 +870,19 @@ DAQ_Verdict Snort::packet_callback(
     UpdateWireStats(&sfBase, pkthdr->caplen, Active::packet_was_dropped(), inject);
     Active::reset();
     PacketManager::encode_reset();
+    Latency::stop();
+
+#ifdef PPM_MGR
+    if ( PPM_LOAD_ENABLED() )
+        ppm_load_end(pkthdr);
+#endif
 
     if ( flow_con ) // FIXIT-M always instantiate
     {
         flow_con->timeout_flows(4, pkthdr->ts.tv_sec);
     }
 
+    Active::send_queued();
     s_packet->pkth = nullptr;  // no longer avail upon sig segv
 
     if ( snort_conf->pkt_cnt && pc.total_from_daq >= snort_conf->pkt_cnt )
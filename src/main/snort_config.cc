@@ -363,6 +363,9 @@ void SnortConfig::merge(SnortConfig* cmd_line)
     if ( !cmd_line->bpf_file.empty() )
         bpf_file = cmd_line->bpf_file;
 
+    if ( !cmd_line->hosts_dump.empty() )
+        hosts_dump = cmd_line->hosts_dump;
+
     if ( !cmd_line->bpf_filter.empty() )
         bpf_filter = cmd_line->bpf_filter;
 
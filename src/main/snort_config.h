@@ -167,6 +167,9 @@ public:
     uint16_t event_trace_max = 0;
     long int tagged_packet_limit = 256;
 
+    uint32_t async_log_size = 0;     // 0 = write from packet threads
+    uint8_t async_log_overflow = 1;  // LogOverflow; LOG_OVERFLOW_BLOCK
+
     std::string log_dir;
 
     //------------------------------------------------------
@@ -234,6 +237,9 @@ public:
     uint32_t max_attribute_services_per_host = 0;
     uint32_t max_metadata_services = 0;
 
+    std::string hosts_image;        // compiled hosts to map
+    std::string hosts_dump;         // --dump-hosts
+
     //------------------------------------------------------
     // packet module stuff
     uint8_t vlan_agnostic = 0;
@@ -322,6 +328,7 @@ public:
     // to avoid plugin compatibility issues
     struct ProfileConfig* profile_rules = nullptr;
     struct ProfileConfig* profile_modules = nullptr;
+    unsigned profile_sample = 0;  // time 1 in this many packets (0 = off)
 
     struct ppm_cfg_t* ppm_cfg = nullptr;
     struct _IntelPmHandles* ipm_handles = nullptr;
@@ -292,6 +292,9 @@ static const Parameter s_params[] =
     { "--dump-defaults", Parameter::PT_STRING, "(optional)", nullptr,
       "[<module prefix>] output module defaults in Lua format" },
 
+    { "--dump-hosts", Parameter::PT_STRING, nullptr, nullptr,
+      "<file> compile the hosts table to an image file (use with -T to compile offline)" },
+
     { "--dump-version", Parameter::PT_STRING, "(optional)", nullptr,
       "output the version, the whole version, and only the version" },
 
@@ -685,6 +688,9 @@ bool SnortModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( v.is("--dump-defaults") )
         dump_defaults(sc, v.get_string());
 
+    else if ( v.is("--dump-hosts") )
+        sc->hosts_dump = v.get_string();
+
     else if ( v.is("--dump-version") )
         dump_version(sc, v.get_string());
 
@@ -251,11 +251,14 @@ void CodecManager::thread_init(SnortConfig* sc)
 
     rand_get(s_rand, s_id_pool.data(), s_id_pool.size());
 #endif
+
+    PacketManager::thread_init();
 }
 
 void CodecManager::thread_term()
 {
     PacketManager::accumulate(); // statistics
+    PacketManager::thread_term();
 
     for ( CodecApiWrapper& wrap : s_codecs )
     {
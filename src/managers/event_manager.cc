@@ -241,6 +241,12 @@ void EventManager::close_outputs()
         p->close();
 }
 
+void EventManager::idle_outputs()
+{
+    for ( auto p : s_loggers.outputs )
+        p->idle();
+}
+
 void EventManager::call_alerters(
     OutputSet* idx, Packet* pkt, const char* message, Event* event)
 {
@@ -33,6 +33,7 @@
 #include "log/obfuscation.h"
 #include "log/messages.h"
 #include "packet_io/active.h"
+#include "time/latency.h"
 #include "time/ppm.h"
 #include "target_based/snort_protocols.h"
 #include "binder/bind_module.h"
@@ -160,6 +161,71 @@ struct PHVector
     { vec[num++] = p; }
 };
 
+// packet types are single bits so there are only a few distinct dispatch
+// paths.  each path holds the handlers of the packet, session, network, and
+// probe inspectors whose proto_bits include that type, in execution order,
+// so per packet evaluation doesn't have to look at anything else.
+
+enum DispatchPath
+{
+    DP_IP, DP_TCP, DP_UDP, DP_ICMP, DP_ARP, DP_PDU, DP_FILE, DP_OTHER, DP_MAX
+};
+
+static inline DispatchPath get_path(PktType t)
+{
+    switch ( t )
+    {
+    case PktType::IP:   return DP_IP;
+    case PktType::TCP:  return DP_TCP;
+    case PktType::UDP:  return DP_UDP;
+    case PktType::ICMP: return DP_ICMP;
+    case PktType::ARP:  return DP_ARP;
+    case PktType::PDU:  return DP_PDU;
+    case PktType::FILE: return DP_FILE;
+    default:            break;
+    }
+    return DP_OTHER;
+}
+
+static const PktType path_type[DP_MAX] =
+{
+    PktType::IP, PktType::TCP, PktType::UDP, PktType::ICMP,
+    PktType::ARP, PktType::PDU, PktType::FILE, PktType::NONE
+};
+
+struct DispatchVector
+{
+    Inspector** vec;
+    unsigned num;
+
+    DispatchVector()
+    { vec = nullptr; num = 0; }
+
+    ~DispatchVector()
+    { if ( vec ) delete[] vec; }
+
+    void build(const PHVector&, PktType);
+};
+
+void DispatchVector::build(const PHVector& phv, PktType t)
+{
+    vec = new Inspector*[phv.num ? phv.num : 1];
+
+    for ( unsigned i = 0; i < phv.num; ++i )
+    {
+        if ( (unsigned)t & phv.vec[i]->pp_class.api.proto_bits )
+            vec[num++] = phv.vec[i]->handler;
+    }
+}
+
+struct DispatchPolicy
+{
+    DispatchVector packet;
+    DispatchVector session;
+    DispatchVector network;
+    DispatchVector probe;
+};
+
 struct FrameworkPolicy
 {
     PHInstanceList ilist;
@@ -171,6 +237,8 @@ struct FrameworkPolicy
     PHVector service;
     PHVector probe;
 
+    DispatchPolicy dispatch[DP_MAX];
+
     Inspector* binder;
     Inspector* wizard;
 
@@ -227,8 +295,39 @@ void FrameworkPolicy::vectorize()
             break;
         }
     }
+
+    for ( unsigned i = 0; i < DP_MAX; ++i )
+    {
+        dispatch[i].packet.build(packet, path_type[i]);
+        dispatch[i].session.build(session, path_type[i]);
+        dispatch[i].network.build(network, path_type[i]);
+        dispatch[i].probe.build(probe, path_type[i]);
+    }
 }
 
+//-------------------------------------------------------------------------
+// stats
+//-------------------------------------------------------------------------
+
+const PegInfo inspector_pegs[] =
+{
+    { "ip dispatches", "packets dispatched to inspectors for raw ip" },
+    { "tcp dispatches", "packets dispatched to inspectors for tcp" },
+    { "udp dispatches", "packets dispatched to inspectors for udp" },
+    { "icmp dispatches", "packets dispatched to inspectors for icmp" },
+    { "arp dispatches", "packets dispatched to inspectors for arp" },
+    { "pdu dispatches", "reassembled packets dispatched to inspectors" },
+    { "file dispatches", "file data packets dispatched to inspectors" },
+    { "other dispatches", "packets of other types (no inspectors apply)" },
+    { "inspector calls", "packet, session, network and probe inspector evaluations" },
+    { nullptr, nullptr }
+};
+
+THREAD_LOCAL InspectorStats inspector_stats;
+
+static_assert(array_size(inspector_stats.dispatches) == DP_MAX,
+    "dispatch counts don't match dispatch paths");
+
 //-------------------------------------------------------------------------
 // global stuff
 //-------------------------------------------------------------------------
@@ -720,24 +819,20 @@ void InspectorManager::print_config(SnortConfig* sc)
 // packet handling
 //-------------------------------------------------------------------------
 
-static inline void execute(
-    Packet* p, PHInstance** prep, unsigned num)
+// service inspectors are never in the dispatch vectors (they are called
+// through the flow's gadget) and proto_bits were applied when the vectors
+// were built so only the pass check remains here
+static inline void execute(Packet* p, const DispatchVector& dv)
 {
-    for ( unsigned i = 0; i < num; ++i, ++prep )
+    Inspector** pi = dv.vec;
+
+    for ( unsigned i = 0; i < dv.num; ++i, ++pi )
     {
         if ( p->packet_flags & PKT_PASS_RULE )
             break;
 
-        PHClass& ppc = (*prep)->pp_class;
-
-        // FIXIT-P these checks can eventually be optimized
-        // but they are required to ensure that session and app
-        // handlers aren't called w/o a session pointer
-        if ( !p->flow && (ppc.api.type == IT_SERVICE) )
-            break;
-
-        if ( (unsigned)p->type() & ppc.api.proto_bits )
-            (*prep)->handler->eval(p);
+        (*pi)->eval(p);
+        ++inspector_stats.calls;
     }
 }
 
@@ -759,12 +854,12 @@ void InspectorManager::bumble(Packet* p)
         flow->session->restart(p);
 }
 
-void InspectorManager::full_inspection(FrameworkPolicy* fp, Packet* p)
+void InspectorManager::full_inspection(const DispatchPolicy& dp, Packet* p)
 {
     Flow* flow = p->flow;
 
     if ( !flow->service )
-        ::execute(p, fp->network.vec, fp->network.num);
+        ::execute(p, dp.network);
 
     else if ( flow->clouseau and !p->is_cooked() )
         bumble(p);
@@ -772,9 +867,14 @@ void InspectorManager::full_inspection(FrameworkPolicy* fp, Packet* p)
     if ( !p->dsize )
         DisableDetect(p);
 
+    // stream.depth reached; headers only (see FlowControl::check_bypass())
+    else if ( flow->depth_exhausted() )
+        do_detect_content = 0;
+
     else if ( flow->gadget && flow->gadget->likes(p) )
     {
         flow->gadget->eval(p);
+        flow->inspected_bytes += p->dsize;
         s_clear = true;
     }
 }
@@ -784,19 +884,30 @@ void InspectorManager::execute(Packet* p)
     FrameworkPolicy* fp = get_inspection_policy()->framework_policy;
     assert(fp);
 
+    DispatchPath path = get_path(p->type());
+    const DispatchPolicy& dp = fp->dispatch[path];
+    ++inspector_stats.dispatches[path];
+
     // FIXIT-L blocked flows should not be normalized
     if ( !p->is_cooked() )
-        ::execute(p, fp->packet.vec, fp->packet.num);
+    {
+        ::execute(p, dp.packet);
+        Latency::lap(LS_INSPECT);
+    }
 
     if ( !p->has_paf_payload() )
-        ::execute(p, fp->session.vec, fp->session.num);
+    {
+        ::execute(p, dp.session);
+        Latency::lap(LS_STREAM);
+    }
 
     Flow* flow = p->flow;
 
     if ( flow && flow->full_inspection() )
-        full_inspection(fp, p);
+        full_inspection(dp, p);
 
-    ::execute(p, fp->probe.vec, fp->probe.num);
+    ::execute(p, dp.probe);
+    Latency::lap(LS_INSPECT);
 }
 
 void InspectorManager::clear(Packet* p)
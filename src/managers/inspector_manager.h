@@ -29,6 +29,7 @@
 
 #include "main/snort_types.h"
 #include "framework/base_api.h"
+#include "framework/counts.h"
 #include "framework/inspector.h"
 
 #ifdef PIGLET
@@ -37,6 +38,7 @@
 #endif
 
 struct Packet;
+struct DispatchPolicy;
 struct FrameworkPolicy;
 struct SnortConfig;
 struct InspectionPolicy;
@@ -92,8 +94,17 @@ public:
 
 private:
     static void bumble(Packet*);
-    static void full_inspection(FrameworkPolicy*, Packet*);
+    static void full_inspection(const DispatchPolicy&, Packet*);
 };
 
+struct InspectorStats
+{
+    PegCount dispatches[8];  // by packet type, see inspector_pegs
+    PegCount calls;
+};
+
+extern const PegInfo inspector_pegs[];
+extern THREAD_LOCAL InspectorStats inspector_stats;
+
 #endif
 
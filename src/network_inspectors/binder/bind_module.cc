@@ -46,6 +46,8 @@ static const PegInfo bind_pegs[] =
     { "blocks", "block bindings" },
     { "allows", "allow bindings" },
     { "inspects", "inspect bindings" },
+    { "cache hits", "binding lookups resolved from the thread cache" },
+    { "cache misses", "binding lookups resolved from the binding table" },
     { nullptr, nullptr }
 };
 
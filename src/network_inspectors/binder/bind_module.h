@@ -36,6 +36,8 @@ struct BindStats
 {
     PegCount packets;
     PegCount verdicts[BindUse::BA_MAX];
+    PegCount cache_hits;
+    PegCount cache_misses;
 };
 
 extern THREAD_LOCAL BindStats bstats;
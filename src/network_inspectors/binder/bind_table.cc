@@ -0,0 +1,249 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// bind_table.cc
+
+#include "bind_table.h"
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+#include "binding.h"
+#include "flow/flow.h"
+#include "flow/flow_key.h"
+
+//-------------------------------------------------------------------------
+// table
+//-------------------------------------------------------------------------
+
+const BindWord* BindTable::Dim::get(unsigned v) const
+{
+    if ( v >= index.size() )
+        return nullptr;
+
+    return &masks[index[v] * words];
+}
+
+// values whose bitmaps are identical get the same class; classes are
+// numbered in order of first appearance
+template<typename Match>
+void BindTable::build(
+    Dim& dim, unsigned values, const std::vector<Binding*>& bv, Match match)
+{
+    std::map<std::vector<BindWord>, uint16_t> classes;
+    std::vector<BindWord> mask(words);
+
+    dim.words = words;
+    dim.index.resize(values);
+    dim.masks.clear();
+
+    for ( unsigned v = 0; v < values; ++v )
+    {
+        std::fill(mask.begin(), mask.end(), 0);
+
+        for ( unsigned i = 0; i < bv.size(); ++i )
+        {
+            if ( match(bv[i]->when, v) )
+                mask[i / BIND_WORD_BITS] |= (BindWord)1 << (i % BIND_WORD_BITS);
+        }
+
+        auto it = classes.find(mask);
+
+        if ( it == classes.end() )
+        {
+            uint16_t c = classes.size();
+            classes[mask] = c;
+            dim.masks.insert(dim.masks.end(), mask.begin(), mask.end());
+            dim.index[v] = c;
+        }
+        else
+            dim.index[v] = it->second;
+    }
+}
+
+void BindTable::compile(const std::vector<Binding*>& bv)
+{
+    words = (bv.size() + BIND_WORD_BITS - 1) / BIND_WORD_BITS;
+    nets = false;
+
+    policy_ids.clear();
+    svcs.clear();
+
+    for ( auto* pb : bv )
+    {
+        if ( pb->when.nets )
+            nets = true;
+
+        if ( pb->when.id )
+            policy_ids.push_back(pb->when.id);
+
+        if ( !pb->when.svc.empty() )
+            svcs.push_back(pb->when.svc);
+    }
+
+    std::sort(policy_ids.begin(), policy_ids.end());
+    policy_ids.erase(std::unique(policy_ids.begin(), policy_ids.end()), policy_ids.end());
+
+    std::sort(svcs.begin(), svcs.end());
+    svcs.erase(std::unique(svcs.begin(), svcs.end()), svcs.end());
+
+    build(ports, 65536, bv, [](const BindWhen& w, unsigned v)
+        { return w.ports.test(v); });
+
+    build(vlans, 4096, bv, [](const BindWhen& w, unsigned v)
+        { return w.vlans.test(v); });
+
+    build(ifaces, 256, bv, [](const BindWhen& w, unsigned v)
+        { return w.ifaces.test(v); });
+
+    build(protos, 256, bv, [](const BindWhen& w, unsigned v)
+        { return (w.protos & v) != 0; });
+
+    build(policies, policy_ids.size() + 1, bv, [this](const BindWhen& w, unsigned v)
+        { return !w.id or (v and w.id == policy_ids[v-1]); });
+
+    build(services, svcs.size() + 2, bv, [this](const BindWhen& w, unsigned v)
+        {
+            if ( !v )
+                return w.svc.empty();
+
+            if ( v > svcs.size() )
+                return false;
+
+            return w.svc == svcs[v-1];
+        });
+}
+
+unsigned BindTable::get_policy(unsigned id) const
+{
+    auto it = std::lower_bound(policy_ids.begin(), policy_ids.end(), id);
+
+    if ( it == policy_ids.end() or *it != id )
+        return 0;
+
+    return it - policy_ids.begin() + 1;
+}
+
+unsigned BindTable::get_service(const char* s) const
+{
+    if ( !s or !*s )
+        return 0;
+
+    unsigned lo = 0, hi = svcs.size();
+
+    while ( lo < hi )
+    {
+        unsigned mid = (lo + hi) / 2;
+        int c = strcmp(s, svcs[mid].c_str());
+
+        if ( !c )
+            return mid + 1;
+
+        if ( c < 0 )
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return svcs.size() + 1;
+}
+
+// out of range values match nothing
+void BindTable::get_candidates(const Flow* flow, BindWord* mask) const
+{
+    if ( !words )
+        return;
+
+    int in = flow->iface_in < 0 ? 0 : flow->iface_in;
+    int out = flow->iface_out < 0 ? 0 : flow->iface_out;
+
+    const BindWord* fi = ifaces.get(in);
+    const BindWord* fo = ifaces.get(out);
+
+    const BindWord* m[] =
+    {
+        ports.get(flow->server_port),
+        vlans.get(flow->key->vlan_tag),
+        protos.get((unsigned)flow->protocol),
+        policies.get(get_policy(flow->policy_id)),
+        services.get(get_service(flow->service)),
+    };
+
+    for ( auto* p : m )
+    {
+        if ( !p or (!fi and !fo) )
+        {
+            memset(mask, 0, words * sizeof(*mask));
+            return;
+        }
+    }
+
+    for ( unsigned i = 0; i < words; ++i )
+    {
+        BindWord w = (fi ? fi[i] : 0) | (fo ? fo[i] : 0);
+
+        for ( auto* p : m )
+            w &= p[i];
+
+        mask[i] = w;
+    }
+}
+
+//-------------------------------------------------------------------------
+// cache
+//-------------------------------------------------------------------------
+
+BindEntry* BindCache::find(
+    unsigned binder, const BindTable& bt, const Flow* flow, BindKey& key, bool& hit)
+{
+    memset(&key, 0, sizeof(key));
+
+    if ( bt.has_nets() )
+    {
+        memcpy(&key.client_ip, &flow->client_ip, sizeof(key.client_ip));
+        memcpy(&key.server_ip, &flow->server_ip, sizeof(key.server_ip));
+    }
+    key.binder = binder;
+    key.policy_id = flow->policy_id;
+    key.iface_in = flow->iface_in;
+    key.iface_out = flow->iface_out;
+    key.server_port = flow->server_port;
+    key.vlan = flow->key->vlan_tag;
+    key.service = bt.get_service(flow->service);
+    key.protocol = (uint8_t)flow->protocol;
+
+    const uint8_t* k = (const uint8_t*)&key;
+    uint32_t h = 2166136261u;
+
+    for ( unsigned i = 0; i < sizeof(key); ++i )
+    {
+        h ^= k[i];
+        h *= 16777619u;
+    }
+    BindEntry* e = &table[(h ^ (h >> 16)) & (BIND_CACHE_SIZE - 1)];
+    hit = !memcmp(&e->key, &key, sizeof(key));
+    return e;
+}
+
+BindWord* BindCache::get_mask(unsigned words)
+{
+    if ( mask.size() < words )
+        mask.resize(words);
+
+    return mask.data();
+}
+
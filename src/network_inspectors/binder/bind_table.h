@@ -0,0 +1,135 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// bind_table.h
+
+#ifndef BIND_TABLE_H
+#define BIND_TABLE_H
+
+// BindTable is the binding list compiled into one bitmap of bindings per
+// value of each flow attribute.  values with the same bitmap share a class
+// so eg only the distinct port groups of the configuration are stored.
+// and'ing the bitmaps for a flow gives the candidate bindings in order;
+// only nets remain to be checked per candidate.
+//
+// BindCache is a per packet thread, direct mapped cache of the bindings
+// that matched a flow tuple (including service) so repeat lookups skip
+// the table and the nets altogether.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sfip/sfip_t.h"
+
+class Flow;
+struct Binding;
+
+typedef uint64_t BindWord;
+
+#define BIND_WORD_BITS 64
+
+class BindTable
+{
+public:
+    void compile(const std::vector<Binding*>&);
+
+    // number of words in a candidate mask
+    unsigned get_words() const
+    { return words; }
+
+    // true if any binding is restricted by address
+    bool has_nets() const
+    { return nets; }
+
+    // service class of flow->service as used in cache keys
+    unsigned get_service(const char*) const;
+
+    // sets mask to the bindings that match flow on everything except nets
+    void get_candidates(const Flow*, BindWord* mask) const;
+
+private:
+    struct Dim
+    {
+        std::vector<uint16_t> index;  // value -> class
+        std::vector<BindWord> masks;  // class -> words of bindings
+        unsigned words = 0;
+
+        const BindWord* get(unsigned v) const;
+    };
+
+    template<typename Match>
+    void build(Dim&, unsigned values, const std::vector<Binding*>&, Match);
+
+    unsigned get_policy(unsigned id) const;
+
+private:
+    unsigned words = 0;
+    bool nets = false;
+
+    Dim ports;
+    Dim vlans;
+    Dim ifaces;
+    Dim protos;
+    Dim policies;   // 0 = other, 1.. = policy_ids
+    Dim services;   // 0 = none, 1.. = svcs, last = other
+
+    std::vector<unsigned> policy_ids;  // sorted distinct when.id
+    std::vector<std::string> svcs;     // sorted distinct when.svc
+};
+
+#define BIND_CACHE_SIZE 1024  // must be a power of 2
+#define BIND_SEQ_MAX 16
+
+struct BindKey
+{
+    sfip_t client_ip;
+    sfip_t server_ip;
+    unsigned binder;
+    unsigned policy_id;
+    int32_t iface_in;
+    int32_t iface_out;
+    uint16_t server_port;
+    uint16_t vlan;
+    uint16_t service;
+    uint8_t protocol;
+    uint8_t pad;
+};
+
+struct BindEntry
+{
+    BindKey key;
+    uint16_t num;
+    uint16_t seq[BIND_SEQ_MAX];  // indices of matching bindings in order
+};
+
+class BindCache
+{
+public:
+    // sets key for flow and returns its slot and whether it holds key
+    BindEntry* find(unsigned binder, const BindTable&, const Flow*, BindKey&, bool& hit);
+
+    // scratch space for candidate masks
+    BindWord* get_mask(unsigned words);
+
+private:
+    std::vector<BindEntry> table = std::vector<BindEntry>(BIND_CACHE_SIZE);
+    std::vector<BindWord> mask;
+};
+
+#endif
+
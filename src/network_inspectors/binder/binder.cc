@@ -17,11 +17,14 @@
 //--------------------------------------------------------------------------
 // binder.cc author Russ Combs <rucombs@cisco.com>
 
+#include <assert.h>
+#include <string.h>
 #include <vector>
 using namespace std;
 
 #include "binding.h"
 #include "bind_module.h"
+#include "bind_table.h"
 #include "flow/flow.h"
 #include "flow/session.h"
 #include "framework/inspector.h"
@@ -45,6 +48,9 @@ using namespace std;
 
 THREAD_LOCAL ProfileStats bindPerfStats;
 
+static THREAD_LOCAL BindCache* bind_cache = nullptr;
+static unsigned s_binder_id = 0;
+
 // FIXIT-P these lookups should be optimized when the dust settles
 #define INS_IP   "stream_ip"
 #define INS_ICMP "stream_icmp"
@@ -406,11 +412,14 @@ private:
 
 private:
     vector<Binding*> bindings;
+    BindTable table;
+    unsigned id;  // distinguishes binders in the thread cache
 };
 
 Binder::Binder(vector<Binding*>& v)
 {
     bindings = std::move(v);
+    id = ++s_binder_id;
 }
 
 Binder::~Binder()
@@ -431,6 +440,7 @@ bool Binder::configure(SnortConfig* sc)
         if ( !pb->use.index )
             set_binding(sc, pb);
     }
+    table.compile(bindings);
     return true;
 }
 
@@ -513,39 +523,108 @@ void Binder::set_binding(SnortConfig*, Binding* pb)
         ParseError("can't bind %s", key);
 }
 
-// FIXIT-P this is a simple linear search until functionality is nailed
-// down.  performance should be the focus of the next iteration.
+static Binder* enter_policy(Flow* flow, const Binding* pb)
+{
+    set_policies(snort_conf, pb->use.index - 1);
+    flow->policy_id = pb->use.index - 1;
+
+    return (Binder*)InspectorManager::get_binder();
+}
+
+// the matching bindings are visited in configuration order so the outcome
+// is the same as checking each binding in turn.  the indices visited are
+// cached so the next flow with the same tuple and service just replays
+// them.  a policy binding hands off to that policy's binder, which has
+// its own entries.
 void Binder::get_bindings(Flow* flow, Stuff& stuff)
 {
-    Binding* pb;
-    unsigned i, sz = bindings.size();
+    assert(bind_cache);
 
-    for ( i = 0; i < sz; i++ )
+    BindKey key;
+    bool hit;
+    BindEntry* e = bind_cache->find(id, table, flow, key, hit);
+
+    if ( hit )
     {
-        pb = bindings[i];
+        ++bstats.cache_hits;
+
+        for ( unsigned n = 0; n < e->num; ++n )
+        {
+            Binding* pb = bindings[e->seq[n]];
+
+            if ( !pb->use.index )
+            {
+                if ( stuff.update(pb) )
+                    return;
+                else
+                    continue;
+            }
+
+            if ( Binder* sub = enter_policy(flow, pb) )
+            {
+                sub->get_bindings(flow, stuff);
+                return;
+            }
+        }
+        return;
+    }
+    ++bstats.cache_misses;
+
+    BindWord* mask = bind_cache->get_mask(table.get_words());
+    table.get_candidates(flow, mask);
+
+    uint16_t seq[BIND_SEQ_MAX];
+    unsigned num = 0;
+    bool cacheable = true;
+    Binder* sub = nullptr;
+
+    for ( unsigned i = 0; i < bindings.size(); ++i )
+    {
+        BindWord w = mask[i / BIND_WORD_BITS];
 
-        if ( !pb->check_all(flow) )
+        if ( !w )
+        {
+            i |= BIND_WORD_BITS - 1;
+            continue;
+        }
+        if ( !(w & ((BindWord)1 << (i % BIND_WORD_BITS))) )
+            continue;
+
+        Binding* pb = bindings[i];
+
+        // FIXIT-M need to check role and addr/ports relative to it
+        if ( !pb->check_addr(flow) )
             continue;
 
+        if ( num < BIND_SEQ_MAX and i <= UINT16_MAX )
+            seq[num++] = i;
+        else
+            cacheable = false;
+
         if ( !pb->use.index )
         {
             if ( stuff.update(pb) )
-                return;
+                break;
             else
                 continue;
         }
 
-        set_policies(snort_conf, pb->use.index - 1);
-        flow->policy_id = pb->use.index - 1;
+        if ( (sub = enter_policy(flow, pb)) )
+            break;
 
-        Binder* sub = (Binder*)InspectorManager::get_binder();
+        // no binder there so continue here with the new policy
+        table.get_candidates(flow, mask);
+    }
 
-        if ( sub )
-        {
-            sub->get_bindings(flow, stuff);
-            return;
-        }
+    if ( cacheable )
+    {
+        memcpy(&e->key, &key, sizeof(key));
+        e->num = num;
+        memcpy(e->seq, seq, num * sizeof(seq[0]));
     }
+
+    if ( sub )
+        sub->get_bindings(flow, stuff);
 }
 
 Inspector* Binder::find_gadget(Flow* flow)
@@ -592,6 +671,17 @@ static void bind_dtor(Inspector* p)
     delete p;
 }
 
+static void bind_tinit()
+{
+    bind_cache = new BindCache;
+}
+
+static void bind_tterm()
+{
+    delete bind_cache;
+    bind_cache = nullptr;
+}
+
 static const InspectApi bind_api =
 {
     {
@@ -612,8 +702,8 @@ static const InspectApi bind_api =
     nullptr, // service
     nullptr, // pinit
     nullptr, // pterm
-    nullptr, // tinit
-    nullptr, // tterm
+    bind_tinit,
+    bind_tterm,
     bind_ctor,
     bind_dtor,
     nullptr, // ssn
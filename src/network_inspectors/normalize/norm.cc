@@ -27,6 +27,8 @@
 
 #include "utils/stats.h"
 #include "perf_monitor/perf.h"
+#include "codecs/ip/checksum.h"
+#include "packet_io/sfdaq.h"
 #include "protocols/ipv4.h"
 #include "protocols/ipv4_options.h"
 #include "protocols/tcp.h"
@@ -105,6 +107,35 @@ static const uint8_t MAX_EOL_PAD[TCP_OPTLENMAX] =
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
+// the checksums patched below are only right if they were right to begin
+// with and no outer checksum covers a changed layer (ie no tunnels).
+// otherwise they are all computed again by PacketManager::encode_update().
+static bool Norm_Patched(const Packet* p)
+{
+    if ( p->ptrs.decode_flags & DECODE_ERR_CKSUM_ALL )
+        return false;
+
+    if ( !SnortConfig::ip_checksums() or !SnortConfig::icmp_checksums() )
+        return false;
+
+    if ( !SnortConfig::tcp_checksums() and
+        !(p->pkth->flags & DAQ_PKT_FLAG_HW_TCP_CS_GOOD) )
+        return false;
+
+    const uint8_t ip4 = PacketManager::proto_id(ETHERTYPE_IPV4);
+    const uint8_t ip6 = PacketManager::proto_id(ETHERTYPE_IPV6);
+    unsigned ip_layers = 0;
+
+    for ( unsigned i = 0; i < p->num_layers; ++i )
+    {
+        uint8_t id = PacketManager::proto_id(p->layers[i].prot_id);
+
+        if ( id == ip4 or id == ip6 )
+            ++ip_layers;
+    }
+    return ip_layers < 2;
+}
+
 // go from inner to outer
 int Norm_Packet(NormalizerConfig* c, Packet* p)
 {
@@ -122,7 +153,12 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
 
     if ( changes > 0 )
     {
-        p->packet_flags |= PKT_MODIFIED;
+        // a trim sets PKT_RESIZED (which includes PKT_MODIFIED) so the
+        // packet still goes through encode_update() and not the patch path
+        if ( !(p->packet_flags & PKT_RESIZED) and Norm_Patched(p) )
+            p->packet_flags |= PKT_PATCHED;
+        else
+            p->packet_flags |= PKT_MODIFIED;
         return 1;
     }
     if ( p->packet_flags & PKT_RESIZED )
@@ -138,11 +174,20 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
 // avoided to ensure that we don't get tripped up by nested protocols.
 // TCP options count and length are a notable exception.
 //
-// also note that checksums are not calculated here.  they are only
-// calculated once after all normalizations are done (here, stream)
-// and any replacements are made.
+// also note that checksums are not calculated here.  they are updated
+// for each change to the header (RFC 1624) and are only calculated if
+// that isn't enough (see Norm_Patched()) or once after all normalizations
+// are done (here, stream) and any replacements are made.
 //-----------------------------------------------------------------------
 
+#define NORM_HDR_MAX 60
+
+static inline void Norm_Patch(
+    uint16_t& cksum, const void* before, const void* after, unsigned len)
+{
+    cksum = checksum::cksum_update(cksum, before, after, len);
+}
+
 #if 0
 static int Norm_Eth(Packet* p, uint8_t layer, int changes)
 {
@@ -172,6 +217,13 @@ static int Norm_IP4(
     uint16_t origbits = fragbits;
     const NormMode mode = get_norm_mode(c);
 
+    const unsigned hlen = p->layers[layer].length;
+    const int start = changes;
+    uint8_t before[NORM_HDR_MAX];
+
+    if ( mode == NORM_MODE_ON )
+        memcpy(before, h, hlen);
+
     if ( Norm_IsEnabled(c, NORM_IP4_TRIM) && (layer == 1) )
     {
         uint32_t len = p->layers[0].length + ntohs(h->ip_len);
@@ -266,6 +318,9 @@ static int Norm_IP4(
         normStats[PC_IP4_OPTS][mode]++;
         sfBase.iPegs[PERF_COUNT_IP4_OPTS][mode]++;
     }
+    if ( changes > start )
+        Norm_Patch(h->ip_csum, before, h, hlen);
+
     return changes;
 }
 
@@ -282,7 +337,10 @@ static int Norm_ICMP4(
     {
         if ( mode == NORM_MODE_ON )
         {
+            uint16_t before;
+            memcpy(&before, h, sizeof(before));
             h->code = icmp::IcmpCode::ECHO_CODE;
+            Norm_Patch(h->csum, &before, h, sizeof(before));
             changes++;
         }
         normStats[PC_ICMP4_ECHO][mode]++;
@@ -333,7 +391,10 @@ static int Norm_ICMP6(
 
         if ( mode == NORM_MODE_ON )
         {
+            uint16_t before;
+            memcpy(&before, h, sizeof(before));
             h->code = static_cast<icmp::IcmpCode>(0);
+            Norm_Patch(h->csum, &before, h, sizeof(before));
             changes++;
         }
         normStats[PC_ICMP6_ECHO][mode]++;
@@ -510,6 +571,14 @@ static int Norm_TCP(
     tcp::TCPHdr* h = reinterpret_cast<tcp::TCPHdr*>(const_cast<uint8_t*>(p->layers[layer].start));
     const NormMode mode = get_norm_mode(c);
 
+    // options past the validated length are also changed
+    const unsigned hlen = h->hlen();
+    const int start = changes;
+    uint8_t before[NORM_HDR_MAX];
+
+    if ( mode == NORM_MODE_ON )
+        memcpy(before, h, hlen);
+
     if ( Norm_IsEnabled(c, NORM_TCP_RSV) )
     {
         if ( h->th_offx2 & TH_RSV )
@@ -623,6 +692,9 @@ static int Norm_TCP(
                 valid_opts_len, changes);
         }
     }
+    if ( changes > start )
+        Norm_Patch(h->th_sum, before, h, hlen);
+
     return changes;
 }
 
@@ -25,6 +25,8 @@
 */
 
 #include "perf.h"
+#include "perf_aggregate.h"
+#include "perf_latency.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -44,6 +46,7 @@
 #include "main/analyzer.h"
 #include "main/snort_types.h"
 #include "protocols/packet.h"
+#include "time/latency.h"
 #include "utils/util.h"
 
 THREAD_LOCAL SFBASE sfBase;
@@ -58,6 +61,7 @@ static inline void sfProcessBaseStats(SFPERF*);
 static inline void sfProcessFlowStats(SFPERF*);
 static inline void sfProcessFlowIpStats(SFPERF*);
 static inline void sfProcessEventStats(SFPERF*);
+static inline void sfProcessLatencyStats(SFPERF*, const LatencyStats*);
 static inline int sfRotateFlowIPStatsFile(SFPERF*);
 static int sfRotateFile(const char*, FILE*, const char*, uint32_t);
 
@@ -204,6 +208,46 @@ void sfCloseFlowIPStatsFile(SFPERF* sfPerf)
     sfPerf->flowip_fh = NULL;
 }
 
+FILE* sfOpenLatencyStatsFile(const char* file)
+{
+    static THREAD_LOCAL bool start_up = true;
+    FILE* fh = NULL;
+
+    // This file needs to be readable by everyone
+    mode_t old_umask = umask(022);
+
+    if (file != NULL)
+    {
+        // Append to the existing file if just starting up, otherwise we've
+        // rotated so start a new one.
+        fh = fopen(file, start_up ? "a" : "w");
+
+        if (fh != NULL)
+        {
+            WriteTimeStamp(fh, start_up ? "start" : "rotate");
+            LogLatencyPerfHeader(fh);
+        }
+    }
+
+    umask(old_umask);
+
+    if (start_up)
+        start_up = false;
+
+    return fh;
+}
+
+void sfCloseLatencyStatsFile(SFPERF* sfPerf)
+{
+    if (sfPerf->latency_fh == NULL)
+        return;
+
+    WriteTimeStamp(sfPerf->latency_fh, "stop");
+
+    fclose(sfPerf->latency_fh);
+    sfPerf->latency_fh = NULL;
+}
+
 static int sfRotateFile(const char* old_file, FILE* old_fh,
     const char* rotate_prefix, uint32_t max_file_size)
 {
@@ -438,6 +482,27 @@ int sfRotateFlowStatsFile(SFPERF* sfPerf)
     return 0;
 }
 
+int sfRotateLatencyStatsFile(SFPERF* sfPerf)
+{
+    if ((sfPerf != NULL) && (sfPerf->latency_file != NULL))
+    {
+        std::string name;
+        const char* file = get_instance_file(name, sfPerf->latency_file);
+        int ret = sfRotateFile(file, sfPerf->latency_fh, "latency", sfPerf->max_file_size);
+
+        if (ret != 0)
+            return ret;
+
+        if ((sfPerf->latency_fh = sfOpenLatencyStatsFile(file)) == NULL)
+        {
+            FatalError("Perfmonitor: Cannot open latency stats file \"%s\": %s.\n",
+                file, get_error(errno));
+        }
+    }
+
+    return 0;
+}
+
 static inline int sfRotateFlowIPStatsFile(SFPERF* sfPerf)
 {
     if ((sfPerf != NULL) && (sfPerf->flowip_file != NULL))
@@ -502,6 +567,18 @@ void sfPerformanceStats(SFPERF* sfPerf, Packet* p)
                     InitEventStats(&sfEvent);
                 }
 
+                if (!(sfPerf->perf_flags & SFPERF_SUMMARY_LATENCY))
+                {
+                    // the stats thread reports the merge of all threads
+                    if (perf_counters)
+                        Latency::publish_interval();
+                    else
+                    {
+                        sfProcessLatencyStats(sfPerf, Latency::get_interval());
+                        Latency::reset_interval();
+                    }
+                }
+
                 SetSampleTime(sfPerf, p);
             }
         }
@@ -672,6 +749,23 @@ static inline void sfProcessEventStats(SFPERF* sfPerf)
         ProcessEventStats(&sfEvent);
 }
 
+static inline void sfProcessLatencyStats(SFPERF* sfPerf, const LatencyStats* ls)
+{
+    if (!(sfPerf->perf_flags & SFPERF_LATENCY))
+        return;
+
+    time_t curr_time = SnortConfig::read_mode() ? sfBase.time : time(NULL);
+
+    ProcessLatencyStats(ls, curr_time, sfPerf->latency_fh,
+        sfPerf->perf_flags & SFPERF_CONSOLE);
+
+    if ((sfPerf->latency_fh != NULL)
+        && sfCheckFileSize(sfPerf->latency_fh, sfPerf->max_file_size))
+    {
+        sfRotateLatencyStatsFile(sfPerf);
+    }
+}
+
 void sfPerfStatsSummary(SFPERF* sfPerf)
 {
     if (sfPerf == NULL)
@@ -690,5 +784,20 @@ void sfPerfStatsSummary(SFPERF* sfPerf)
 
     if (sfPerf->perf_flags & SFPERF_SUMMARY_EVENT)
         sfProcessEventStats(sfPerf);
+
+    if (sfPerf->perf_flags & SFPERF_SUMMARY_LATENCY)
+        sfProcessLatencyStats(sfPerf, Latency::get_thread_total());
+}
+
+// all packet threads merged; call after they have terminated
+void sfPerfLatencySummary()
+{
+    const LatencyStats* ls = Latency::get_total();
+
+    if (ls == NULL)
+        return;
+
+    LogMessage("\nPerfMonitor latency, all threads:");
+    ProcessLatencyStats(ls, time(NULL), NULL, 1);
 }
 
@@ -45,13 +45,17 @@
 #define SFPERF_FLOWIP           0x00000040
 #define SFPERF_TIME_COUNT       0x00000080
 #define SFPERF_MAX_BASE_STATS   0x00000100
+#define SFPERF_LATENCY          0x00000200
+#define SFPERF_AGGREGATE        0x00000400
 
 #define SFPERF_SUMMARY_BASE     0x00001000
 #define SFPERF_SUMMARY_FLOW     0x00002000
 #define SFPERF_SUMMARY_FLOWIP   0x00004000
 #define SFPERF_SUMMARY_EVENT    0x00008000
+#define SFPERF_SUMMARY_LATENCY  0x00010000
 #define SFPERF_SUMMARY \
-    (SFPERF_SUMMARY_BASE|SFPERF_SUMMARY_FLOW|SFPERF_SUMMARY_FLOWIP|SFPERF_SUMMARY_EVENT)
+    (SFPERF_SUMMARY_BASE|SFPERF_SUMMARY_FLOW|SFPERF_SUMMARY_FLOWIP|SFPERF_SUMMARY_EVENT| \
+    SFPERF_SUMMARY_LATENCY)
 
 #define ROLLOVER_THRESH     512
 #define MAX_PERF_FILE_SIZE  INT32_MAX
@@ -74,6 +78,11 @@ typedef struct _SFPERF
     char* flowip_file;
     FILE* flowip_fh;
     uint32_t flowip_memcap;
+    char* latency_file;
+    FILE* latency_fh;
+    char* aggregate_file;
+    char* aggregate_latency_file;
+    int aggregate_format;
 } SFPERF;
 
 /* The perf_monitor state information and collected statistics */
@@ -90,10 +99,14 @@ FILE* sfOpenFlowStatsFile(const char*);
 void sfCloseFlowStatsFile(SFPERF* sfPerf);
 FILE* sfOpenFlowIPStatsFile(const char*);
 void sfCloseFlowIPStatsFile(SFPERF* sfPerf);
+FILE* sfOpenLatencyStatsFile(const char*);
+void sfCloseLatencyStatsFile(SFPERF* sfPerf);
 int sfRotateBaseStatsFile(SFPERF* sfPerf);
 int sfRotateFlowStatsFile(SFPERF* sfPerf);
+int sfRotateLatencyStatsFile(SFPERF* sfPerf);
 void sfPerformanceStats(SFPERF*, Packet*);
 void sfPerfStatsSummary(SFPERF*);
+void sfPerfLatencySummary();
 void SetSampleTime(SFPERF*, Packet*);
 void InitPerfStats(SFPERF* sfPerf);
 
@@ -0,0 +1,369 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// perf_aggregate.cc
+
+#include "perf_aggregate.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "perf.h"
+#include "perf_latency.h"
+#include "log/messages.h"
+#include "main/snort_types.h"
+#include "time/latency.h"
+#include "utils/util.h"
+
+THREAD_LOCAL PerfCounters* perf_counters = nullptr;
+
+static THREAD_LOCAL PerfCounters t_block;
+
+static const char* s_names[PC_MAX] =
+{
+    "wire_pkts",
+    "wire_bytes",
+    "blocked_pkts",
+    "blocked_bytes",
+    "injected_pkts",
+    "pkts",
+    "bytes",
+    "frag_pkts",
+    "frag_bytes",
+    "reass_pkts",
+    "reass_bytes",
+    "rebuilt_pkts",
+    "rebuilt_bytes",
+    "syns",
+    "syn_acks",
+    "new_sessions",
+    "deleted_sessions",
+    "new_udp_sessions",
+    "deleted_udp_sessions",
+    "alerts",
+};
+
+// binary files start with a header followed by fixed size records in
+// native byte order
+#define BIN_MAGIC "SPMA"
+#define BIN_VERSION 1
+
+struct BinRecord
+{
+    uint64_t time;
+    uint32_t seconds;
+    uint32_t threads;
+    uint64_t count[PC_MAX];
+};
+
+// everything below is protected by s_mutex
+static std::mutex s_mutex;
+static std::condition_variable s_cv;
+static std::thread* s_thread = nullptr;
+static bool s_stop = false;
+
+static std::vector<PerfCounters*> s_blocks;
+static uint64_t s_retired[PC_MAX];
+static uint64_t s_last[PC_MAX];
+static time_t s_last_time = 0;
+static unsigned s_exited = 0;
+
+static FILE* s_fh = nullptr;
+static PerfFormat s_format = PF_CSV;
+static unsigned s_interval = 0;
+
+static LatencyStats* s_latency = nullptr;
+static FILE* s_latency_fh = nullptr;
+static bool s_latency_console = false;
+
+//-------------------------------------------------------------------------
+// counters
+//-------------------------------------------------------------------------
+
+void PerfCounters::snapshot(uint64_t* out) const
+{
+    uint64_t s1, s2;
+
+    do
+    {
+        s1 = seq.load(std::memory_order_acquire);
+
+        for ( unsigned i = 0; i < PC_MAX; ++i )
+            out[i] = count[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        s2 = seq.load(std::memory_order_relaxed);
+    }
+    while ( (s1 & 1) or s1 != s2 );
+}
+
+static void collect(uint64_t* sum)
+{
+    memcpy(sum, s_retired, sizeof(s_retired));
+
+    for ( auto* pcs : s_blocks )
+    {
+        uint64_t snap[PC_MAX];
+        pcs->snapshot(snap);
+
+        for ( unsigned i = 0; i < PC_MAX; ++i )
+            sum[i] += snap[i];
+    }
+}
+
+//-------------------------------------------------------------------------
+// output
+//-------------------------------------------------------------------------
+
+static void write_header()
+{
+    switch ( s_format )
+    {
+    case PF_CSV:
+        fprintf(s_fh, "#time,seconds,threads");
+
+        for ( unsigned i = 0; i < PC_MAX; ++i )
+            fprintf(s_fh, ",%s", s_names[i]);
+
+        fprintf(s_fh, "\n");
+        break;
+
+    case PF_JSON:
+        break;
+
+    case PF_BINARY:
+    {
+        uint16_t hdr[2] = { BIN_VERSION, PC_MAX };
+        fwrite(BIN_MAGIC, 4, 1, s_fh);
+        fwrite(hdr, sizeof(hdr), 1, s_fh);
+
+        for ( unsigned i = 0; i < PC_MAX; ++i )
+            fwrite(s_names[i], strlen(s_names[i]) + 1, 1, s_fh);
+        break;
+    }
+    }
+    fflush(s_fh);
+}
+
+static void write_record(time_t t, unsigned sec, unsigned threads, const uint64_t* delta)
+{
+    switch ( s_format )
+    {
+    case PF_CSV:
+        fprintf(s_fh, "%lu,%u,%u", (unsigned long)t, sec, threads);
+
+        for ( unsigned i = 0; i < PC_MAX; ++i )
+            fprintf(s_fh, "," STDu64, delta[i]);
+
+        fprintf(s_fh, "\n");
+        break;
+
+    case PF_JSON:
+        fprintf(s_fh, "{\"time\":%lu,\"seconds\":%u,\"threads\":%u",
+            (unsigned long)t, sec, threads);
+
+        for ( unsigned i = 0; i < PC_MAX; ++i )
+            fprintf(s_fh, ",\"%s\":" STDu64, s_names[i], delta[i]);
+
+        fprintf(s_fh, "}\n");
+        break;
+
+    case PF_BINARY:
+    {
+        BinRecord rec;
+        rec.time = (uint64_t)t;
+        rec.seconds = sec;
+        rec.threads = threads;
+        memcpy(rec.count, delta, sizeof(rec.count));
+        fwrite(&rec, sizeof(rec), 1, s_fh);
+        break;
+    }
+    }
+    fflush(s_fh);
+}
+
+static void report()
+{
+    uint64_t sum[PC_MAX], delta[PC_MAX];
+    collect(sum);
+
+    for ( unsigned i = 0; i < PC_MAX; ++i )
+    {
+        delta[i] = sum[i] - s_last[i];
+        s_last[i] = sum[i];
+    }
+
+    // threads that counted anything this interval
+    unsigned threads = s_blocks.size() + s_exited;
+    s_exited = 0;
+
+    time_t now = time(nullptr);
+    write_record(now, (unsigned)(now - s_last_time), threads, delta);
+    s_last_time = now;
+
+    if ( s_latency and Latency::take_interval(*s_latency) )
+        ProcessLatencyStats(s_latency, now, s_latency_fh, s_latency_console);
+}
+
+//-------------------------------------------------------------------------
+// stats thread
+//-------------------------------------------------------------------------
+
+static void stats_thread()
+{
+    std::unique_lock<std::mutex> lock(s_mutex);
+    bool done;
+
+    do
+    {
+        if ( s_interval )
+            done = s_cv.wait_for(lock, std::chrono::seconds(s_interval), [] { return s_stop; });
+        else
+        {
+            s_cv.wait(lock, [] { return s_stop; });
+            done = true;
+        }
+        report();
+    }
+    while ( !done );
+}
+
+static bool start(const SFPERF* cfg)
+{
+    s_format = (PerfFormat)cfg->aggregate_format;
+    s_interval = (cfg->perf_flags & SFPERF_SUMMARY_BASE) ? 0 : cfg->sample_interval;
+
+    // binary headers can't be appended to the middle of a file
+    s_fh = fopen(cfg->aggregate_file, s_format == PF_BINARY ? "wb" : "a");
+
+    if ( !s_fh )
+    {
+        ErrorMessage("perfmonitor: Cannot open aggregate stats file '%s': %s.\n",
+            cfg->aggregate_file, get_error(errno));
+        return false;
+    }
+    write_header();
+
+    if ( (cfg->perf_flags & SFPERF_LATENCY) and !(cfg->perf_flags & SFPERF_SUMMARY_LATENCY) )
+    {
+        s_latency = new LatencyStats;
+        s_latency_console = (cfg->perf_flags & SFPERF_CONSOLE) != 0;
+
+        if ( cfg->aggregate_latency_file )
+        {
+            s_latency_fh = fopen(cfg->aggregate_latency_file, "a");
+
+            if ( s_latency_fh )
+                LogLatencyPerfHeader(s_latency_fh);
+            else
+                ErrorMessage("perfmonitor: Cannot open aggregate latency file '%s': %s.\n",
+                    cfg->aggregate_latency_file, get_error(errno));
+        }
+    }
+
+    memset(s_retired, 0, sizeof(s_retired));
+    memset(s_last, 0, sizeof(s_last));
+    s_exited = 0;
+    s_last_time = time(nullptr);
+    s_stop = false;
+
+    s_thread = new std::thread(stats_thread);
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// api
+//-------------------------------------------------------------------------
+
+void perf_aggregate_tinit(const SFPERF* cfg)
+{
+    if ( !cfg->aggregate_file )
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    if ( !s_thread and !start(cfg) )
+        return;
+
+    s_blocks.push_back(&t_block);
+    perf_counters = &t_block;
+}
+
+void perf_aggregate_tterm()
+{
+    if ( !perf_counters )
+        return;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    uint64_t snap[PC_MAX];
+    t_block.snapshot(snap);
+
+    for ( unsigned i = 0; i < PC_MAX; ++i )
+    {
+        s_retired[i] += snap[i];
+        t_block.set((PerfCount)i, 0);
+    }
+    ++s_exited;
+
+    for ( auto it = s_blocks.begin(); it != s_blocks.end(); ++it )
+    {
+        if ( *it == &t_block )
+        {
+            s_blocks.erase(it);
+            break;
+        }
+    }
+    perf_counters = nullptr;
+}
+
+void perf_aggregate_term()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        if ( !s_thread )
+            return;
+
+        s_stop = true;
+    }
+    s_cv.notify_one();
+    s_thread->join();
+
+    delete s_thread;
+    s_thread = nullptr;
+
+    fclose(s_fh);
+    s_fh = nullptr;
+
+    if ( s_latency_fh )
+    {
+        fclose(s_latency_fh);
+        s_latency_fh = nullptr;
+    }
+    delete s_latency;
+    s_latency = nullptr;
+}
+
@@ -0,0 +1,118 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// perf_aggregate.h
+
+#ifndef PERF_AGGREGATE_H
+#define PERF_AGGREGATE_H
+
+// System wide base counts.  Each packet thread owns a cache line aligned
+// block of monotonic counters that only it writes; a dedicated stats thread
+// snapshots every registered block at each interval, sums them, and writes
+// the interval deltas as one record to one file for the whole process.
+//
+// Writers bracket each update with begin() / end() which bump a sequence
+// number (odd while updating) so a snapshot retries instead of seeing a
+// packet counted without its bytes.  The packet threads never lock or
+// wait; the registry mutex is only taken when threads start and stop and
+// by the stats thread.
+//
+// With latency enabled, the packet threads also publish their interval
+// latency histograms and the stats thread reports the merge of all threads
+// with each record.  A thread publishes at its own interval boundary so a
+// merged interval may include up to one interval of skew per thread.
+
+#include <atomic>
+#include <stdint.h>
+
+#include "main/thread.h"
+
+struct _SFPERF;
+
+#define AGGREGATE_FILE "perf_monitor_all"
+#define AGGREGATE_LATENCY_FILE "perf_monitor_all_latency"
+
+enum PerfCount
+{
+    PC_WIRE_PKTS,
+    PC_WIRE_BYTES,
+    PC_BLOCKED_PKTS,
+    PC_BLOCKED_BYTES,
+    PC_INJECTED_PKTS,
+    PC_PKTS,
+    PC_BYTES,
+    PC_FRAG_PKTS,
+    PC_FRAG_BYTES,
+    PC_REASS_PKTS,
+    PC_REASS_BYTES,
+    PC_REBUILT_PKTS,
+    PC_REBUILT_BYTES,
+    PC_SYNS,
+    PC_SYN_ACKS,
+    PC_NEW_SESSIONS,
+    PC_DELETED_SESSIONS,
+    PC_NEW_UDP_SESSIONS,
+    PC_DELETED_UDP_SESSIONS,
+    PC_ALERTS,
+    PC_MAX
+};
+
+enum PerfFormat
+{
+    PF_CSV,
+    PF_JSON,
+    PF_BINARY
+};
+
+struct alignas(64) PerfCounters
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> count[PC_MAX];
+
+    // writer side; owning thread only
+    void begin()
+    {
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void add(PerfCount c, uint64_t n)
+    { count[c].store(count[c].load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+    void set(PerfCount c, uint64_t n)
+    { count[c].store(n, std::memory_order_relaxed); }
+
+    void end()
+    { seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // reader side; any thread
+    void snapshot(uint64_t* out) const;
+};
+
+// null unless aggregation is enabled for this thread
+extern THREAD_LOCAL PerfCounters* perf_counters;
+
+// called by the packet threads; the first one starts the stats thread
+void perf_aggregate_tinit(const _SFPERF*);
+void perf_aggregate_tterm();
+
+// stops the stats thread after writing the final record; call after the
+// packet threads have terminated
+void perf_aggregate_term();
+
+#endif
+
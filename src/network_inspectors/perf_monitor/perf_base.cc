@@ -55,6 +55,7 @@
 #include <sys/types.h>
 
 #include "perf.h"
+#include "perf_aggregate.h"
 #include "main/snort_config.h"
 #include "main/snort_types.h"
 #include "framework/mpse.h"
@@ -270,6 +271,19 @@ void UpdateBaseStats(SFBASE* sfBase, Packet* p, bool rebuilt)
      * that make it to the application layer. */
     sfBase->total_packets++;
     sfBase->total_bytes += len;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_PKTS, 1);
+        pcs->add(PC_BYTES, len);
+
+        if ( !rebuilt and p->ptrs.tcph and (p->ptrs.tcph->th_flags & TH_SYN) )
+            pcs->add((p->ptrs.tcph->th_flags & TH_ACK) ? PC_SYN_ACKS : PC_SYNS, 1);
+
+        pcs->set(PC_ALERTS, pc.alert_pkts);
+        pcs->end();
+    }
 }
 
 /*
@@ -300,6 +314,23 @@ void UpdateWireStats(SFBASE* sfBase, int len, int dropped, int inject)
     }
     if ( inject )
         sfBase->total_injected_packets++;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_WIRE_PKTS, 1);
+        pcs->add(PC_WIRE_BYTES, len);
+
+        if ( dropped )
+        {
+            pcs->add(PC_BLOCKED_PKTS, 1);
+            pcs->add(PC_BLOCKED_BYTES, len);
+        }
+        if ( inject )
+            pcs->add(PC_INJECTED_PKTS, 1);
+
+        pcs->end();
+    }
 }
 
 void UpdateMPLSStats(SFBASE* sfBase, int len, int dropped)
@@ -336,6 +367,14 @@ void UpdateIPFragStats(SFBASE* sfBase, int len)
 
     len += 4; /* for the CRC */
     sfBase->total_ipfragmented_bytes += len;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_FRAG_PKTS, 1);
+        pcs->add(PC_FRAG_BYTES, len);
+        pcs->end();
+    }
 }
 
 /*
@@ -356,12 +395,28 @@ void UpdateIPReassStats(SFBASE* sfBase, int len)
 {
     sfBase->total_ipreassembled_bytes += len;
     sfBase->total_ipreassembled_packets++;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_REASS_PKTS, 1);
+        pcs->add(PC_REASS_BYTES, len);
+        pcs->end();
+    }
 }
 
 void UpdateStreamReassStats(SFBASE* sfBase, int len)
 {
     sfBase->total_rebuilt_bytes += len;
     sfBase->total_rebuilt_packets++;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_REBUILT_PKTS, 1);
+        pcs->add(PC_REBUILT_BYTES, len);
+        pcs->end();
+    }
 }
 
 /**API to update stats for packets discarded due to
@@ -414,6 +469,13 @@ int AddStreamSession(SFBASE* sfBase, uint32_t flags)
     if (sfBase->iTotalSessions > sfBase->iMaxSessionsInterval)
         sfBase->iMaxSessionsInterval = sfBase->iTotalSessions;
 
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_NEW_SESSIONS, 1);
+        pcs->end();
+    }
+
     return 0;
 }
 
@@ -463,6 +525,14 @@ int RemoveStreamSession(SFBASE* sfBase)
 {
     sfBase->iTotalSessions--;
     sfBase->iDeletedSessions++;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_DELETED_SESSIONS, 1);
+        pcs->end();
+    }
+
     return 0;
 }
 
@@ -487,6 +557,13 @@ int AddUDPSession(SFBASE* sfBase)
     if (sfBase->iTotalUDPSessions > sfBase->iMaxUDPSessions)
         sfBase->iMaxUDPSessions = sfBase->iTotalUDPSessions;
 
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_NEW_UDP_SESSIONS, 1);
+        pcs->end();
+    }
+
     return 0;
 }
 
@@ -508,6 +585,14 @@ int RemoveUDPSession(SFBASE* sfBase)
 {
     sfBase->iTotalUDPSessions--;
     sfBase->iDeletedUDPSessions++;
+
+    if ( PerfCounters* pcs = perf_counters )
+    {
+        pcs->begin();
+        pcs->add(PC_DELETED_UDP_SESSIONS, 1);
+        pcs->end();
+    }
+
     return 0;
 }
 
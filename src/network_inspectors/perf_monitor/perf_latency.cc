@@ -0,0 +1,125 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// perf_latency.cc
+
+#include "perf_latency.h"
+
+#include "main/snort_types.h"
+#include "log/messages.h"
+#include "time/latency.h"
+
+struct Percentile
+{
+    const char* name;
+    double pct;
+};
+
+static const Percentile s_pcts[] =
+{
+    { "p50", 50.0 },
+    { "p99", 99.0 },
+    { "p99.9", 99.9 },
+};
+
+static const unsigned s_num_pcts = sizeof(s_pcts) / sizeof(s_pcts[0]);
+
+static void WriteLatencyStats(const LatencyStats* ls, time_t t, FILE* fh)
+{
+    double tpu = Latency::get_ticks_per_us();
+
+    fprintf(fh, "%u", (uint32_t)t);
+
+    for ( unsigned s = 0; s < LS_MAX; ++s )
+    {
+        const LatencyHistogram& h = ls->stage[s];
+        fprintf(fh, "," STDu64, h.get_count());
+
+        for ( unsigned i = 0; i < s_num_pcts; ++i )
+            fprintf(fh, ",%.2f", h.get_percentile(s_pcts[i].pct) / tpu);
+
+        fprintf(fh, ",%.2f", h.get_max() / tpu);
+    }
+    fprintf(fh, "\n");
+    fflush(fh);
+}
+
+static void DisplayLatencyStats(const LatencyStats* ls)
+{
+    double tpu = Latency::get_ticks_per_us();
+
+    LogMessage("\n");
+    LogMessage("Snort Latency Stats (usecs)\n");
+    LogMessage("---------------------------\n");
+
+    LogMessage("%-12s %12s", "stage", "count");
+
+    for ( unsigned i = 0; i < s_num_pcts; ++i )
+        LogMessage(" %10s", s_pcts[i].name);
+
+    LogMessage(" %10s\n", "max");
+
+    for ( unsigned s = 0; s < LS_MAX; ++s )
+    {
+        const LatencyHistogram& h = ls->stage[s];
+
+        if ( !h.get_count() )
+            continue;
+
+        LogMessage("%-12s %12" PRIu64, Latency::get_name((LatencyStage)s), h.get_count());
+
+        for ( unsigned i = 0; i < s_num_pcts; ++i )
+            LogMessage(" %10.2f", h.get_percentile(s_pcts[i].pct) / tpu);
+
+        LogMessage(" %10.2f\n", h.get_max() / tpu);
+    }
+}
+
+void ProcessLatencyStats(const LatencyStats* ls, time_t t, FILE* fh, int console)
+{
+    if ( !ls )
+        return;
+
+    if ( console )
+        DisplayLatencyStats(ls);
+
+    if ( fh )
+        WriteLatencyStats(ls, t, fh);
+}
+
+// the columns correspond to WriteLatencyStats() above
+void LogLatencyPerfHeader(FILE* fh)
+{
+    if ( !fh )
+        return;
+
+    fprintf(fh, "#time");
+
+    for ( unsigned s = 0; s < LS_MAX; ++s )
+    {
+        const char* name = Latency::get_name((LatencyStage)s);
+        fprintf(fh, ",%s.count", name);
+
+        for ( unsigned i = 0; i < s_num_pcts; ++i )
+            fprintf(fh, ",%s.%s", name, s_pcts[i].name);
+
+        fprintf(fh, ",%s.max", name);
+    }
+    fprintf(fh, "\n");
+    fflush(fh);
+}
+
@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// perf_latency.h
+
+#ifndef PERF_LATENCY_H
+#define PERF_LATENCY_H
+
+// Reports the per stage latency histograms kept by time/latency as
+// percentiles in usecs, one csv record per interval with a group of
+// count,p50,p99,p99.9,max columns per stage.
+
+#include <stdio.h>
+#include <time.h>
+
+struct LatencyStats;
+
+void LogLatencyPerfHeader(FILE*);
+void ProcessLatencyStats(const LatencyStats*, time_t, FILE*, int console);
+
+#endif
+
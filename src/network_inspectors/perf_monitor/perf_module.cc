@@ -19,11 +19,13 @@
 // perf_module.cc author Russ Combs <rucombs@cisco.com>
 
 #include "perf_module.h"
+#include "perf_aggregate.h"
 #include "utils/util.h"
 
 #define PERF_FILE "perf_monitor.csv"
 #define FLOW_FILE "perf_monitor_flow.csv"
 #define FLIP_FILE "perf_monitor_flow_ip.csv"
+#define LATENCY_FILE "perf_monitor_latency.csv"
 
 //-------------------------------------------------------------------------
 // perf attributes
@@ -75,6 +77,18 @@ static const Parameter s_params[] =
     { "flow_ip_file", Parameter::PT_BOOL, nullptr, "false",
       "output host pair statistics to " FLIP_FILE " instead of stdout" },
 
+    { "latency", Parameter::PT_BOOL, nullptr, "false",
+      "enable per stage packet latency percentiles" },
+
+    { "latency_file", Parameter::PT_BOOL, nullptr, "false",
+      "output latency percentiles to " LATENCY_FILE " instead of stdout" },
+
+    { "aggregate", Parameter::PT_BOOL, nullptr, "false",
+      "also write base counts summed over all packet threads to " AGGREGATE_FILE ".<format>" },
+
+    { "aggregate_format", Parameter::PT_ENUM, "csv | json | binary", "csv",
+      "format of the aggregate file" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -168,6 +182,27 @@ bool PerfMonModule::set(const char*, Value& v, SnortConfig*)
             config.flowip_file = SnortStrdup(FLIP_FILE);
         }
     }
+    else if ( v.is("latency") )
+    {
+        if ( v.get_bool() )
+            config.perf_flags |= SFPERF_LATENCY;
+    }
+    else if ( v.is("latency_file") )
+    {
+        if ( v.get_bool() )
+        {
+            config.perf_flags |= SFPERF_LATENCY;
+            config.latency_file = SnortStrdup(LATENCY_FILE);
+        }
+    }
+    else if ( v.is("aggregate") )
+    {
+        if ( v.get_bool() )
+            config.perf_flags |= SFPERF_AGGREGATE;
+    }
+    else if ( v.is("aggregate_format") )
+        config.aggregate_format = v.get_long();
+
     else
         return false;
 
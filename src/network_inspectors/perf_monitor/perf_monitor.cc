@@ -37,6 +37,7 @@
 #include <string>
 
 #include "perf.h"
+#include "perf_aggregate.h"
 #include "perf_base.h"
 #include "perf_module.h"
 
@@ -46,6 +47,7 @@
 #include "main/snort_debug.h"
 #include "parser/parser.h"
 #include "packet_io/sfdaq.h"
+#include "time/latency.h"
 #include "time/profiler.h"
 #include "framework/inspector.h"
 #include "utils/stats.h"
@@ -191,6 +193,25 @@ static void PrintConfig(SFPERF* pconfig)
         LogMessage("    Flow IP File:     %s\n",
             (pconfig->flowip_file != NULL) ? pconfig->flowip_file : "INACTIVE");
     }
+    LogMessage("  Latency Stats:    %s%s\n",
+        pconfig->perf_flags & SFPERF_LATENCY ? "ACTIVE" : "INACTIVE",
+        pconfig->perf_flags & SFPERF_SUMMARY_LATENCY ? " (SUMMARY)" : "");
+    if (pconfig->perf_flags & SFPERF_LATENCY)
+    {
+        LogMessage("    Latency File:     %s\n",
+            (pconfig->latency_file != NULL) ? pconfig->latency_file : "INACTIVE");
+    }
+    LogMessage("  Aggregate Stats:  %s\n",
+        pconfig->perf_flags & SFPERF_AGGREGATE ? "ACTIVE" : "INACTIVE");
+    if (pconfig->perf_flags & SFPERF_AGGREGATE)
+    {
+        LogMessage("    Aggregate File:   %s\n",
+            (pconfig->aggregate_file != NULL) ? pconfig->aggregate_file : "INACTIVE");
+        if (pconfig->perf_flags & SFPERF_LATENCY)
+            LogMessage("    Latency File:     %s\n",
+                (pconfig->aggregate_latency_file != NULL) ?
+                pconfig->aggregate_latency_file : "INACTIVE");
+    }
     LogMessage("  Console Mode:     %s\n",
         (pconfig->perf_flags & SFPERF_CONSOLE) ? "ACTIVE" : "INACTIVE");
 }
@@ -232,6 +253,15 @@ PerfMonitor::~PerfMonitor ()
 
     if ( config.flowip_file )
         free(config.flowip_file);
+
+    if ( config.latency_file )
+        free(config.latency_file);
+
+    if ( config.aggregate_file )
+        free(config.aggregate_file);
+
+    if ( config.aggregate_latency_file )
+        free(config.aggregate_latency_file);
 }
 
 void PerfMonitor::show(SnortConfig*)
@@ -242,11 +272,36 @@ void PerfMonitor::show(SnortConfig*)
 // FIXIT-L perfmonitor should be logging to one file and writing record type and
 // version fields immediately after timestamp like
 // seconds, usec, type, version#, data1, data2, ...
-bool PerfMonitor::configure(SnortConfig*)
+// the aggregate files are per process so they don't get an instance id
+static char* GetAggregateFile(SnortConfig* sc, const char* name, const char* ext)
+{
+    std::string file = !sc->log_dir.empty() ? sc->log_dir : "./";
+
+    if ( file.back() != '/' )
+        file += '/';
+
+    file += sc->run_prefix;
+    file += name;
+    file += ".";
+    file += ext;
+
+    return SnortStrdup(file.c_str());
+}
+
+bool PerfMonitor::configure(SnortConfig* sc)
 {
     PerfMonitorChangeLogFilesPermission();
     std::string name;
 
+    static const char* ext[] = { "csv", "json", "bin" };
+
+    if ( (config.perf_flags & SFPERF_AGGREGATE) and !config.aggregate_file )
+        config.aggregate_file = GetAggregateFile(sc, AGGREGATE_FILE, ext[config.aggregate_format]);
+
+    if ( (config.perf_flags & SFPERF_AGGREGATE) and config.latency_file and
+        !config.aggregate_latency_file )
+        config.aggregate_latency_file = GetAggregateFile(sc, AGGREGATE_LATENCY_FILE, "csv");
+
     if ( config.file )
     {
         const char* file = get_instance_file(name, config.file);
@@ -279,12 +334,28 @@ bool PerfMonitor::configure(SnortConfig*)
             return false;
         }
     }
+
+    if ( config.latency_file )
+    {
+        const char* file = get_instance_file(name, config.latency_file);
+
+        if ( (config.latency_fh = sfOpenLatencyStatsFile(file)) == NULL )
+        {
+            ParseError("perfmonitor: Cannot open latency stats file '%s'.", file);
+            return false;
+        }
+    }
     return true;
 }
 
 void PerfMonitor::tinit()
 {
     InitPerfStats(&config);
+
+    if ( config.perf_flags & SFPERF_LATENCY )
+        Latency::thread_init();
+
+    perf_aggregate_tinit(&config);
 }
 
 void PerfMonitor::tterm()
@@ -295,6 +366,18 @@ void PerfMonitor::tterm()
     sfCloseBaseStatsFile(&config);
     sfCloseFlowStatsFile(&config);
     sfCloseFlowIPStatsFile(&config);
+    sfCloseLatencyStatsFile(&config);
+
+    if ( config.perf_flags & SFPERF_LATENCY )
+    {
+        // the stats thread reports the rest in its final record
+        if ( perf_counters and !(config.perf_flags & SFPERF_SUMMARY_LATENCY) )
+            Latency::publish_interval();
+
+        Latency::thread_term();
+    }
+
+    perf_aggregate_tterm();
 
     FreeFlowStats(&sfFlow);
 #ifdef LINUX_SMP
@@ -332,6 +415,7 @@ void PerfMonitor::eval(Packet* p)
     {
         sfRotateBaseStatsFile(&config);
         sfRotateFlowStatsFile(&config);
+        sfRotateLatencyStatsFile(&config);
         ClearRotatePerfFileFlag();
     }
 
@@ -364,6 +448,12 @@ static void pm_dtor(Inspector* p)
     delete p;
 }
 
+static void pm_term()
+{
+    perf_aggregate_term();
+    sfPerfLatencySummary();
+}
+
 static const InspectApi pm_api =
 {
     {
@@ -383,7 +473,7 @@ static const InspectApi pm_api =
     nullptr, // buffers
     nullptr, // service
     nullptr, // pinit
-    nullptr, // pterm
+    pm_term,
     nullptr, // tinit
     nullptr, // tterm
     pm_ctor,
@@ -769,10 +769,14 @@ static void PrintPortscanConf(PortscanConfig* config)
 
     LogMessage("    Memcap (in bytes): %lu\n", config->common->memcap);
 
+    LogMessage("    Approximate:       %s\n",
+        config->common->approximate ? "yes" : "no");
+
     if (!config->disabled)
     {
-        LogMessage("    Number of Nodes:   %ld\n",
-            config->common->memcap / (sizeof(PS_PROTO)*proto_cnt-1));
+        if ( !config->common->approximate )
+            LogMessage("    Number of Nodes:   %ld\n",
+                config->common->memcap / (sizeof(PS_PROTO)*proto_cnt-1));
 
         if ( config->logfile )
             LogMessage("    Logfile:           %s\n", "yes");
@@ -877,7 +881,11 @@ bool PortScan::configure(SnortConfig* sc)
 void PortScan::tinit()
 {
     g_tmp_pkt = PacketManager::encode_new();
-    ps_init_hash(config->common->memcap);
+
+    if ( config->common->approximate )
+        ps_init_sketch(config->common->memcap);
+    else
+        ps_init_hash(config->common->memcap);
 
     if ( !config->logfile )
         return;
@@ -43,6 +43,7 @@
 #include <sys/types.h>
 
 #include "ipobj.h"
+#include "ps_sketch.h"
 #include "main/snort_config.h"
 #include "protocols/packet.h"
 #include "time/packet_time.h"
@@ -71,6 +72,7 @@ typedef struct s_PS_ALERT_CONF
 } PS_ALERT_CONF;
 
 static THREAD_LOCAL SFXHASH* portscan_hash = NULL;
+static THREAD_LOCAL PsSketch* portscan_sketch = nullptr;
 
 /*
 **  Scanning configurations.  This is where we configure what the thresholds
@@ -193,6 +195,8 @@ void ps_cleanup(void)
         sfxhash_delete(portscan_hash);
         portscan_hash = NULL;
     }
+    delete portscan_sketch;
+    portscan_sketch = nullptr;
 }
 
 void ps_init_hash(unsigned long memcap)
@@ -217,6 +221,12 @@ void ps_init_hash(unsigned long memcap)
         FatalError("Failed to initialize portscan hash table.\n");
 }
 
+void ps_init_sketch(unsigned long memcap)
+{
+    if ( !portscan_sketch )
+        portscan_sketch = new PsSketch(memcap);
+}
+
 /*
 **  NAME
 **    ps_reset::
@@ -228,6 +238,9 @@ void ps_reset(void)
 {
     if (portscan_hash != NULL)
         sfxhash_make_empty(portscan_hash);
+
+    if ( portscan_sketch )
+        portscan_sketch->clear();
 }
 
 /*
@@ -456,7 +469,10 @@ int PortScan::ps_tracker_lookup(PS_PKT* ps_pkt, PS_TRACKER** scanner,
         /*
         **  Get the scanned tracker.
         */
-        ps_tracker_get(scanned, &key);
+        if ( portscan_sketch )
+            *scanned = portscan_sketch->get(PS_SKETCH_SCANNED, &key, sizeof(key));
+        else
+            ps_tracker_get(scanned, &key);
     }
 
     /*
@@ -474,7 +490,10 @@ int PortScan::ps_tracker_lookup(PS_PKT* ps_pkt, PS_TRACKER** scanner,
         /*
         **  Get the scanner tracker
         */
-        ps_tracker_get(scanner, &key);
+        if ( portscan_sketch )
+            *scanner = portscan_sketch->get(PS_SKETCH_SCANNER, &key, sizeof(key));
+        else
+            ps_tracker_get(scanner, &key);
     }
 
     if ((*scanner == NULL) && (*scanned == NULL))
@@ -560,29 +579,30 @@ int PortScan::ps_get_proto(PS_PKT* ps_pkt, int* proto)
 **  Update the proto time windows based on the portscan sensitivity
 **  level.
 */
-int PortScan::ps_proto_update_window(PS_PROTO* proto, time_t pkt_time)
+static time_t ps_get_interval(int sense_level)
 {
-    time_t interval;
-
-    switch (config->sense_level)
+    switch (sense_level)
     {
     case PS_SENSE_LOW:
-        //interval = 15;
-        interval = 60;
-        break;
+        //return 15;
+        return 60;
 
     case PS_SENSE_MEDIUM:
-        //interval = 15;
-        interval = 90;
-        break;
+        //return 15;
+        return 90;
 
     case PS_SENSE_HIGH:
-        interval = 600;
-        break;
+        return 600;
+    }
+    return 0;
+}
 
-    default:
+int PortScan::ps_proto_update_window(PS_PROTO* proto, time_t pkt_time)
+{
+    time_t interval = ps_get_interval(config->sense_level);
+
+    if ( !interval )
         return -1;
-    }
 
     /*
     **  If we are outside of the window, reset our ps counters.
@@ -618,6 +638,13 @@ int PortScan::ps_proto_update(PS_PROTO* proto, int ps_cnt, int pri_cnt, const sf
     if (!proto)
         return 0;
 
+    /*
+    **  In approximate mode the counts go to the sketch and proto is
+    **  loaded with the resulting estimates.
+    */
+    if ( portscan_sketch and portscan_sketch->update(proto, ps_cnt, pri_cnt, ip, port) )
+        return 0;
+
     /*
     **  If the ps_cnt is negative, that means we are just taking off
     **  for valid connection, and we don't want to do anything else,
@@ -847,7 +874,7 @@ int PortScan::ps_tracker_update_tcp(PS_PKT* ps_pkt, PS_TRACKER* scanner,
         **  open.
         */
         else if ((p->packet_flags & PKT_FROM_SERVER) &&
-            !(p->packet_flags & PKT_STREAM_EST))
+            !(p->packet_flags & PKT_STREAM_EST) && !portscan_sketch)
         {
             if (scanned)
             {
@@ -1583,6 +1610,15 @@ int PortScan::ps_tracker_alert(PS_PKT* ps_pkt, PS_TRACKER* scanner,
         return -1;
     }
 
+    if ( portscan_sketch )
+    {
+        if ( scanner )
+            portscan_sketch->set_alerted(scanner);
+
+        if ( scanned )
+            portscan_sketch->set_alerted(scanned);
+    }
+
     return 0;
 }
 
@@ -1624,6 +1660,9 @@ int PortScan::ps_detect(PS_PKT* ps_pkt)
 
     p = (Packet*)ps_pkt->pkt;
 
+    if ( portscan_sketch )
+        portscan_sketch->rotate(packet_time(), ps_get_interval(config->sense_level));
+
     do
     {
         if (ps_tracker_lookup(ps_pkt, &scanner, &scanned))
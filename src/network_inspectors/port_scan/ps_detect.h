@@ -31,8 +31,9 @@
 struct PsCommon
 {
     unsigned long memcap;
+    bool approximate;
 
-    PsCommon() { memcap = 0; }
+    PsCommon() { memcap = 0; approximate = false; }
 };
 
 struct PortscanConfig
@@ -102,6 +102,7 @@ int ps_detect(PS_PKT* p);
 void ps_tracker_print(PS_TRACKER* tracker);
 
 void ps_init_hash(unsigned long);
+void ps_init_sketch(unsigned long);
 
 #endif
 
@@ -206,6 +206,9 @@ static const Parameter psg_params[] =
     { "memcap", Parameter::PT_INT, "1:", "1048576",
       "maximum tracker memory" },
 
+    { "approximate", Parameter::PT_BOOL, nullptr, "false",
+      "track counts with fixed size sketches instead of per host trackers" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -228,6 +231,7 @@ bool PortScanGlobalModule::begin(const char*, int, SnortConfig*)
 {
     common = new PsCommon;
     common->memcap = 1048576;
+    common->approximate = false;
     return true;
 }
 
@@ -236,6 +240,9 @@ bool PortScanGlobalModule::set(const char*, Value& v, SnortConfig*)
     if ( v.is("memcap") )
         common->memcap = v.get_long();
 
+    else if ( v.is("approximate") )
+        common->approximate = v.get_bool();
+
     else
         return false;
 
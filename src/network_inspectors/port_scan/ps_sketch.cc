@@ -0,0 +1,585 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// ps_sketch.cc
+
+#include "ps_sketch.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "sfip/sf_ip.h"
+
+#ifdef UNIT_TEST
+#include "catch/catch.hpp"
+#endif
+
+#define PS_CONNECTIONS 0
+#define PS_PRIORITIES  1
+
+#define PS_MIN_REGS  (4 * PS_SKETCH_VREGS)
+#define PS_MIN_WIDTH 64
+#define PS_MIN_BITS  512
+
+// hard floors used when the memcap can't cover the minimums above; the
+// register array must be larger than one key's virtual registers or the
+// noise correction in get_unique() is undefined
+#define PS_LOW_REGS  (2 * PS_SKETCH_VREGS)
+#define PS_LOW_WIDTH 4
+#define PS_LOW_BITS  8
+
+//-------------------------------------------------------------------------
+// hashing
+//-------------------------------------------------------------------------
+
+// splitmix64 finalizer; all indices are derived from 64 bit hashes of the
+// key and the element so they are independent of sfxhash and each other
+static inline uint64_t mix(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static uint64_t hash_bytes(const void* pv, unsigned len)
+{
+    const uint8_t* p = (const uint8_t*)pv;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for ( unsigned i = 0; i < len; ++i )
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return mix(h);
+}
+
+static inline unsigned vreg(uint64_t key, unsigned i, unsigned mask)
+{ return mix(key + (i + 1) * 0x9e3779b97f4a7c15ULL) & mask; }
+
+static inline unsigned cell(uint64_t key, unsigned row, unsigned mask)
+{ return mix(key ^ (row + 1) * 0xc2b2ae3d27d4eb4fULL) & mask; }
+
+static inline unsigned bit(uint64_t key, unsigned mask)
+{ return mix(key ^ 0x165667b19e3779f9ULL) & mask; }
+
+// largest power of 2 <= n starting from min, or from low if n < min
+static unsigned pow2_floor(unsigned long n, unsigned min, unsigned low)
+{
+    unsigned p = (n >= min) ? min : low;
+
+    while ( p <= n / 2 and p < (1u << 30) )
+        p *= 2;
+
+    return p;
+}
+
+// hll estimate from a sum of 2^-reg and the number of zero registers
+static double estimate(unsigned m, double sum, unsigned zeros)
+{
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double e = alpha * m * m / sum;
+
+    if ( e <= 2.5 * m and zeros )
+        e = m * log((double)m / zeros);
+
+    return e;
+}
+
+//-------------------------------------------------------------------------
+// sketch
+//-------------------------------------------------------------------------
+
+// the memcap is split 1/2 registers, 1/4 count-min, 1/16 alerted bits
+PsSketch::PsSketch(unsigned long memcap)
+{
+    regs = pow2_floor(memcap / 8, PS_MIN_REGS, PS_LOW_REGS);
+    width = pow2_floor(memcap / 4 / (2 * PS_SKETCH_ROWS * 2 * sizeof(int32_t)),
+        PS_MIN_WIDTH, PS_LOW_WIDTH);
+    bits = pow2_floor(memcap / 16 / 2 * 8, PS_MIN_BITS, PS_LOW_BITS);
+
+    for ( auto& g : gen )
+    {
+        g.ips = new uint8_t[regs];
+        g.ports = new uint8_t[regs];
+        g.counts = new int32_t[PS_SKETCH_ROWS * width * 2];
+        g.alerted = new uint8_t[bits / 8];
+    }
+    clear();
+}
+
+PsSketch::~PsSketch()
+{
+    for ( auto& g : gen )
+    {
+        delete[] g.ips;
+        delete[] g.ports;
+        delete[] g.counts;
+        delete[] g.alerted;
+    }
+}
+
+size_t PsSketch::get_size() const
+{
+    size_t n = 2 * regs + PS_SKETCH_ROWS * width * 2 * sizeof(int32_t) + bits / 8;
+    return 2 * n;
+}
+
+void PsSketch::reset(Generation& g)
+{
+    memset(g.ips, 0, regs);
+    memset(g.ports, 0, regs);
+    memset(g.counts, 0, PS_SKETCH_ROWS * width * 2 * sizeof(int32_t));
+    memset(g.alerted, 0, bits / 8);
+
+    g.ip_sum = g.port_sum = regs;
+    g.ip_zeros = g.port_zeros = regs;
+    g.totals[PS_CONNECTIONS] = g.totals[PS_PRIORITIES] = 0;
+}
+
+void PsSketch::clear()
+{
+    reset(gen[0]);
+    reset(gen[1]);
+    cur = 0;
+    start = 0;
+}
+
+// the previous generation is kept so estimates span at least one full
+// window; after 2 idle windows both are stale
+void PsSketch::rotate(time_t pkt_time, time_t window)
+{
+    if ( !start )
+        start = pkt_time;
+
+    if ( pkt_time < start + window )
+        return;
+
+    cur ^= 1;
+
+    if ( pkt_time >= start + 2 * window )
+        reset(gen[cur ^ 1]);
+
+    reset(gen[cur]);
+    start = pkt_time;
+}
+
+//-------------------------------------------------------------------------
+// unique counts
+//-------------------------------------------------------------------------
+
+void PsSketch::add_unique(bool ports, uint64_t key, uint64_t elem)
+{
+    Generation& g = gen[cur];
+    uint8_t* r = ports ? g.ports : g.ips;
+    double& sum = ports ? g.port_sum : g.ip_sum;
+    unsigned& zeros = ports ? g.port_zeros : g.ip_zeros;
+
+    unsigned i = elem & (PS_SKETCH_VREGS - 1);
+    uint64_t w = elem >> PS_SKETCH_VREG_BITS;
+    uint8_t rho = 1;
+
+    while ( !(w & 1) and rho < 64 - PS_SKETCH_VREG_BITS )
+    {
+        w >>= 1;
+        ++rho;
+    }
+
+    uint8_t& v = r[vreg(key, i, regs - 1)];
+
+    if ( rho <= v )
+        return;
+
+    if ( !v )
+        --zeros;
+
+    sum += ldexp(1.0, -rho) - ldexp(1.0, -v);
+    v = rho;
+}
+
+// virtual hll: estimate the key's registers as a small hll, estimate the
+// whole array to get the average load per register, and remove the share
+// of the key's estimate that is due to other keys
+unsigned PsSketch::get_unique(bool ports, uint64_t key) const
+{
+    const unsigned s = PS_SKETCH_VREGS;
+    const uint8_t* r0 = ports ? gen[0].ports : gen[0].ips;
+    const uint8_t* r1 = ports ? gen[1].ports : gen[1].ips;
+
+    double sum = 0;
+    unsigned zeros = 0;
+
+    for ( unsigned i = 0; i < s; ++i )
+    {
+        unsigned j = vreg(key, i, regs - 1);
+        uint8_t v = r0[j] > r1[j] ? r0[j] : r1[j];
+
+        if ( !v )
+            ++zeros;
+
+        sum += ldexp(1.0, -v);
+    }
+    double es = estimate(s, sum, zeros);
+    double em = 0;
+
+    for ( const auto& g : gen )
+    {
+        if ( ports )
+            em += estimate(regs, g.port_sum, g.port_zeros);
+        else
+            em += estimate(regs, g.ip_sum, g.ip_zeros);
+    }
+    double n = ((double)regs * s / (regs - s)) * (es / s - em / regs);
+
+    if ( n < 0.5 )
+        return 0;
+
+    return (unsigned)(n + 0.5);
+}
+
+//-------------------------------------------------------------------------
+// connection and priority counts
+//-------------------------------------------------------------------------
+
+void PsSketch::add_count(unsigned field, uint64_t key, int n)
+{
+    Generation& g = gen[cur];
+
+    for ( unsigned row = 0; row < PS_SKETCH_ROWS; ++row )
+        g.counts[(row * width + cell(key, row, width - 1)) * 2 + field] += n;
+
+    g.totals[field] += n;
+}
+
+// count-mean-min: subtract the average count of the other cells in each
+// row and take the median of the rows, bounded by the plain count-min
+int PsSketch::get_count(unsigned field, uint64_t key) const
+{
+    int64_t total = gen[0].totals[field] + gen[1].totals[field];
+    int64_t min = INT64_MAX;
+    double est[PS_SKETCH_ROWS];
+
+    for ( unsigned row = 0; row < PS_SKETCH_ROWS; ++row )
+    {
+        unsigned j = (row * width + cell(key, row, width - 1)) * 2 + field;
+        int64_t c = (int64_t)gen[0].counts[j] + gen[1].counts[j];
+
+        if ( c < min )
+            min = c;
+
+        est[row] = c - (double)(total - c) / (width - 1);
+
+        // insertion sort
+        for ( unsigned k = row; k > 0 and est[k] < est[k-1]; --k )
+        {
+            double t = est[k];
+            est[k] = est[k-1];
+            est[k-1] = t;
+        }
+    }
+    double med = (est[PS_SKETCH_ROWS/2 - 1] + est[PS_SKETCH_ROWS/2]) / 2;
+
+    if ( med > min )
+        med = min;
+
+    if ( med < 0.5 )
+        return 0;
+
+    return (int)(med + 0.5);
+}
+
+//-------------------------------------------------------------------------
+// scratch trackers
+//-------------------------------------------------------------------------
+
+PS_TRACKER* PsSketch::get(PsSketchSlot slot, const void* pk, unsigned len)
+{
+    uint64_t key = hash_bytes(pk, len);
+    unsigned b = bit(key, bits - 1);
+    uint8_t m = 1 << (b & 7);
+
+    PS_TRACKER* t = trackers + slot;
+    memset(t, 0, sizeof(*t));
+    keys[slot] = key;
+
+    if ( (gen[0].alerted[b >> 3] & m) or (gen[1].alerted[b >> 3] & m) )
+        t->proto.alerts = PS_ALERT_GENERATED;
+
+    return t;
+}
+
+void PsSketch::set_alerted(PS_TRACKER* t)
+{
+    if ( !t->proto.alerts or t->proto.alerts == PS_ALERT_GENERATED )
+        return;
+
+    for ( unsigned slot = 0; slot < PS_SKETCH_MAX; ++slot )
+    {
+        if ( t != trackers + slot )
+            continue;
+
+        unsigned b = bit(keys[slot], bits - 1);
+        gen[cur].alerted[b >> 3] |= 1 << (b & 7);
+    }
+}
+
+void PsSketch::load(PS_PROTO* proto, uint64_t key)
+{
+    proto->connection_count = get_count(PS_CONNECTIONS, key);
+    proto->priority_count = get_count(PS_PRIORITIES, key);
+    proto->u_ip_count = get_unique(false, key);
+    proto->u_port_count = get_unique(true, key);
+}
+
+// same updates as PortScan::ps_proto_update() but only the other host and
+// port of the current packet are kept for the alert payload ranges
+bool PsSketch::update(
+    PS_PROTO* proto, int ps_cnt, int pri_cnt, const sfip_t* ip, uint16_t port)
+{
+    unsigned slot;
+
+    for ( slot = 0; slot < PS_SKETCH_MAX; ++slot )
+    {
+        if ( proto == &trackers[slot].proto )
+            break;
+    }
+    if ( slot == PS_SKETCH_MAX )
+        return false;
+
+    uint64_t key = keys[slot];
+
+    if ( ps_cnt < 0 )
+    {
+        if ( get_count(PS_CONNECTIONS, key) > 0 )
+            add_count(PS_CONNECTIONS, key, ps_cnt);
+    }
+    else if ( pri_cnt )
+        add_count(PS_PRIORITIES, key, pri_cnt);
+
+    else
+    {
+        add_count(PS_CONNECTIONS, key, ps_cnt);
+        add_unique(false, key, hash_bytes(ip, ip->sfip_size()));
+        add_unique(true, key, mix(port + 1));
+
+        sfip_copy(proto->low_ip, ip);
+        sfip_copy(proto->high_ip, ip);
+        proto->low_p = proto->high_p = port;
+    }
+    load(proto, key);
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static PS_TRACKER* get_host(PsSketch& ps, unsigned n)
+{ return ps.get(PS_SKETCH_SCANNER, &n, sizeof(n)); }
+
+static sfip_t* get_ip(unsigned n)
+{
+    static sfip_t ip;
+    sfip_clear(ip);
+    ip.family = AF_INET;
+    ip.bits = 32;
+    ip.ip32[0] = n;
+    return &ip;
+}
+
+TEST_CASE("ps_sketch size", "[ps_sketch]")
+{
+    PsSketch ps(1048576);
+    CHECK(ps.get_size() <= 1048576);
+}
+
+TEST_CASE("ps_sketch small memcap", "[ps_sketch]")
+{
+    PsSketch ps(4096);
+    CHECK(ps.get_size() <= 4096);
+}
+
+// below 1024 the registers are at the floor; the estimates are rough but
+// must stay finite
+TEST_CASE("ps_sketch tiny memcap", "[ps_sketch]")
+{
+    PsSketch ps(512);
+    ps.rotate(100, 60);
+
+    PS_TRACKER* t = nullptr;
+
+    for ( unsigned i = 0; i < 20; ++i )
+    {
+        t = get_host(ps, 7);
+        ps.update(&t->proto, 1, 0, get_ip(i % 4), 80 + i % 10);
+    }
+    CHECK(t->proto.connection_count == 20);
+    CHECK(t->proto.u_ip_count > 0);
+    CHECK(t->proto.u_ip_count < 100);
+    CHECK(t->proto.u_port_count > 0);
+    CHECK(t->proto.u_port_count < 100);
+
+    t = get_host(ps, 8);
+    ps.update(&t->proto, 0, 1, get_ip(0), 0);
+    CHECK(t->proto.u_ip_count < 100);
+}
+
+TEST_CASE("ps_sketch ip padding", "[ps_sketch]")
+{
+    sfip_t a, b;
+    memset(&a, 0x00, sizeof(a));
+    memset(&b, 0xff, sizeof(b));
+    a.family = b.family = AF_INET;
+    a.bits = b.bits = 32;
+    a.ip32[0] = b.ip32[0] = htonl(0x0a000001);
+
+    CHECK(hash_bytes(&a, a.sfip_size()) == hash_bytes(&b, b.sfip_size()));
+}
+
+TEST_CASE("ps_sketch small counts", "[ps_sketch]")
+{
+    PsSketch ps(1048576);
+    ps.rotate(100, 60);
+
+    PS_TRACKER* t = nullptr;
+
+    for ( unsigned i = 0; i < 20; ++i )
+    {
+        t = get_host(ps, 7);
+        ps.update(&t->proto, 1, 0, get_ip(i % 4), 80 + i % 10);
+    }
+    CHECK(t->proto.connection_count == 20);
+    CHECK(t->proto.u_ip_count == 4);
+    CHECK(t->proto.u_port_count == 10);
+
+    t = get_host(ps, 7);
+    ps.update(&t->proto, -1, 0, get_ip(0), 0);
+    CHECK(t->proto.connection_count == 19);
+
+    t = get_host(ps, 7);
+    ps.update(&t->proto, 0, 3, get_ip(0), 0);
+    CHECK(t->proto.priority_count == 3);
+
+    // other keys are unaffected
+    t = get_host(ps, 8);
+    ps.update(&t->proto, 0, 1, get_ip(0), 0);
+    CHECK(t->proto.connection_count == 0);
+    CHECK(t->proto.u_ip_count == 0);
+    CHECK(t->proto.priority_count == 1);
+}
+
+// a /8 wide sweep from one scanner while every swept host is also tracked
+// (as the scanned side) must still give a usable estimate for the scanner
+// and leave the swept hosts near their true counts
+TEST_CASE("ps_sketch sweep", "[ps_sketch]")
+{
+    PsSketch ps(1048576);
+    ps.rotate(100, 60);
+
+    const unsigned hosts = 1 << 20;  // sampled from a /8
+    PS_TRACKER* t;
+
+    for ( unsigned i = 0; i < hosts; ++i )
+    {
+        unsigned dst = 0x0a000000 | (i * 16);
+
+        t = ps.get(PS_SKETCH_SCANNER, &hosts, sizeof(hosts));
+        ps.update(&t->proto, 1, 0, get_ip(dst), 445);
+
+        t = ps.get(PS_SKETCH_SCANNED, &dst, sizeof(dst));
+        ps.update(&t->proto, 1, 0, get_ip(1), 445);
+    }
+    t = ps.get(PS_SKETCH_SCANNER, &hosts, sizeof(hosts));
+    ps.update(&t->proto, 1, 0, get_ip(0x0a000000), 445);
+
+    CHECK(t->proto.u_ip_count > hosts * 0.6);
+    CHECK(t->proto.u_ip_count < hosts * 1.4);
+    CHECK(t->proto.u_port_count <= 3);
+    CHECK(t->proto.connection_count > hosts * 0.9);
+
+    unsigned dst = 0x0a000000 | 4096;
+    t = ps.get(PS_SKETCH_SCANNED, &dst, sizeof(dst));
+    ps.update(&t->proto, 0, 1, get_ip(1), 0);
+
+    CHECK(t->proto.u_ip_count < 25);
+    CHECK(t->proto.connection_count < 30);
+}
+
+TEST_CASE("ps_sketch alerted", "[ps_sketch]")
+{
+    PsSketch ps(65536);
+    ps.rotate(100, 60);
+
+    PS_TRACKER* t = get_host(ps, 1);
+    CHECK(!t->proto.alerts);
+
+    t->proto.alerts = PS_ALERT_PORTSWEEP;
+    ps.set_alerted(t);
+
+    t = get_host(ps, 1);
+    CHECK(t->proto.alerts == PS_ALERT_GENERATED);
+
+    // still alerted in the next window, cleared after 2
+    ps.rotate(160, 60);
+    t = get_host(ps, 1);
+    CHECK(t->proto.alerts == PS_ALERT_GENERATED);
+
+    ps.rotate(220, 60);
+    t = get_host(ps, 1);
+    CHECK(!t->proto.alerts);
+}
+
+TEST_CASE("ps_sketch decay", "[ps_sketch]")
+{
+    PsSketch ps(65536);
+    ps.rotate(100, 60);
+
+    PS_TRACKER* t = nullptr;
+
+    for ( unsigned i = 0; i < 10; ++i )
+    {
+        t = get_host(ps, 1);
+        ps.update(&t->proto, 1, 0, get_ip(i), 22);
+    }
+    CHECK(t->proto.connection_count == 10);
+
+    ps.rotate(170, 60);
+    t = get_host(ps, 1);
+    ps.update(&t->proto, 1, 0, get_ip(99), 22);
+    CHECK(t->proto.connection_count == 11);
+    CHECK(t->proto.u_ip_count >= 10);
+    CHECK(t->proto.u_ip_count <= 12);
+
+    // idle for 2 windows
+    ps.rotate(300, 60);
+    t = get_host(ps, 1);
+    ps.update(&t->proto, 1, 0, get_ip(99), 22);
+    CHECK(t->proto.connection_count == 1);
+    CHECK(t->proto.u_ip_count == 1);
+}
+
+#endif
+
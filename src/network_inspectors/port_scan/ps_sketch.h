@@ -0,0 +1,118 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// ps_sketch.h
+
+#ifndef PS_SKETCH_H
+#define PS_SKETCH_H
+
+// approximate port_scan tracking in a fixed amount of memory.  instead of a
+// PS_TRACKER per scanner / scanned host:
+//
+// - unique ip and port counts come from virtual HyperLogLog estimators: each
+//   key owns PS_SKETCH_VREGS registers hashed into one shared register array
+//   per count and the noise from other keys sharing those registers is
+//   subtracted using an estimate of the whole array.
+// - connection and priority counts come from a count-min sketch with noise
+//   correction (count-mean-min) so that counts stay usable when a sweep
+//   touches far more hosts than the sketch has cells.
+// - a bitmap remembers which keys already alerted.
+//
+// everything is kept in 2 generations that rotate every window; estimates
+// cover the current and previous generation so a scan isn't split by a
+// rotation.  the PS_TRACKERs handed to the detection code are scratch
+// copies loaded from the estimates.
+
+#include <stdint.h>
+#include <time.h>
+
+#include "ps_detect.h"
+
+#define PS_SKETCH_VREG_BITS 6
+#define PS_SKETCH_VREGS (1 << PS_SKETCH_VREG_BITS)  // virtual registers per key
+#define PS_SKETCH_ROWS   4      // count-min depth
+
+enum PsSketchSlot
+{
+    PS_SKETCH_SCANNER,
+    PS_SKETCH_SCANNED,
+    PS_SKETCH_MAX
+};
+
+class PsSketch
+{
+public:
+    PsSketch(unsigned long memcap);
+    ~PsSketch();
+
+    // start a new generation if pkt_time is past the current window
+    void rotate(time_t pkt_time, time_t window);
+
+    // returns the scratch tracker for key with alerts set to
+    // PS_ALERT_GENERATED if key already alerted in this window
+    PS_TRACKER* get(PsSketchSlot, const void* key, unsigned len);
+
+    // true if proto belongs to one of the scratch trackers; the counts
+    // are applied to the sketch and the estimates loaded into proto
+    bool update(PS_PROTO*, int ps_cnt, int pri_cnt, const sfip_t*, uint16_t port);
+
+    // remember any alert set on the scratch tracker
+    void set_alerted(PS_TRACKER*);
+
+    void clear();
+    size_t get_size() const;
+
+private:
+    struct Generation
+    {
+        uint8_t* ips;           // register arrays
+        uint8_t* ports;
+        int32_t* counts;        // rows x width x 2 (connection, priority)
+        uint8_t* alerted;       // bitmap
+
+        double ip_sum;          // sum of 2^-reg over ips
+        double port_sum;
+        unsigned ip_zeros;
+        unsigned port_zeros;
+        int64_t totals[2];      // sum of each count field
+    };
+
+    void reset(Generation&);
+
+    void add_unique(bool ports, uint64_t key, uint64_t elem);
+    void add_count(unsigned field, uint64_t key, int n);
+
+    unsigned get_unique(bool ports, uint64_t key) const;
+    int get_count(unsigned field, uint64_t key) const;
+
+    void load(PS_PROTO*, uint64_t key);
+
+private:
+    Generation gen[2];
+    unsigned cur;
+    time_t start;
+
+    unsigned regs;              // registers per array; power of 2
+    unsigned width;             // count-min width; power of 2
+    unsigned bits;              // alerted bitmap bits; power of 2
+
+    PS_TRACKER trackers[PS_SKETCH_MAX];
+    uint64_t keys[PS_SKETCH_MAX];
+};
+
+#endif
+
@@ -34,10 +34,17 @@
 #include "packet_io/sfdaq.h"
 #include "protocols/tcp.h"
 #include "protocols/protocol_ids.h"
+#include "protocols/layer.h"
+#include "codecs/ip/checksum.h"
 #include "parser/parser.h"
+#include "utils/stats.h"
 
 #define MAX_ATTEMPTS 20
 
+// a queue holds both directions of a full set of strafed resets
+#define MAX_QUEUED 64
+#define POOL_SIZE (64 * 1024)
+
 // these can't be pkt flags because we do the handling
 // of these flags following all processing and the drop
 // or response may have been produced by a pseudopacket.
@@ -59,6 +66,26 @@ static THREAD_LOCAL eth_t* s_link = NULL;
 static THREAD_LOCAL ip_t* s_ipnet = NULL;
 static THREAD_LOCAL send_t s_send = DAQ_Inject;
 
+// responses are copied into a per thread pool allocated at startup so a
+// burst of blocks doesn't allocate or inject from the middle of detection
+struct QueuedResponse
+{
+    DAQ_PktHdr_t hdr;
+    uint32_t off;
+    uint32_t len;
+    int rev;
+};
+
+struct ResponsePool
+{
+    QueuedResponse queue[MAX_QUEUED];
+    unsigned num;
+    uint32_t used;
+    uint8_t buf[POOL_SIZE];
+};
+
+static THREAD_LOCAL ResponsePool* s_pool = nullptr;
+
 //--------------------------------------------------------------------
 // helpers
 
@@ -78,6 +105,62 @@ int Active::send_ip(
     return ( (uint32_t)sent != len );
 }
 
+// returns space for a queued response or nullptr if it must be sent now
+static uint8_t* reserve(const DAQ_PktHdr_t* h, int rev, uint32_t len)
+{
+    if ( !s_pool or len > POOL_SIZE )
+        return nullptr;
+
+    if ( s_pool->num == MAX_QUEUED or s_pool->used + len > POOL_SIZE )
+        Active::send_queued();
+
+    QueuedResponse& r = s_pool->queue[s_pool->num++];
+    r.hdr = *h;
+    r.off = s_pool->used;
+    r.len = len;
+    r.rev = rev;
+
+    s_pool->used += len;
+    aux_counts.responses_queued++;
+
+    return s_pool->buf + r.off;
+}
+
+static void queue(const DAQ_PktHdr_t* h, int rev, const uint8_t* buf, uint32_t len)
+{
+    if ( uint8_t* pkt = reserve(h, rev, len) )
+        memcpy(pkt, buf, len);
+
+    else if ( !s_send(h, rev, buf, len) )
+        aux_counts.responses_sent++;
+}
+
+// the seq adjustment applied by the tcp encoder
+static inline uint32_t seq_adj(EncodeFlags f)
+{ return (f & ENC_FLAG_SEQ) ? (uint32_t)(f & ENC_FLAG_VAL) : 0; }
+
+// the tcp header is last in an encoded reset; an outer udp or gre
+// checksum would also cover it so tunneled resets aren't patched
+static bool can_patch(const Packet* p)
+{
+    ip::IpApi api;
+    int8_t lyr = 0;
+
+    return layer::set_outer_ip_api(p, api, lyr) and
+        !layer::set_outer_ip_api(p, api, lyr);
+}
+
+static void patch_seq(uint8_t* pkt, uint32_t len, uint32_t delta)
+{
+    tcp::TCPHdr* h = reinterpret_cast<tcp::TCPHdr*>(pkt + len - tcp::TCP_MIN_HEADER_LEN);
+
+    uint32_t old_seq = h->th_seq;
+    uint32_t new_seq = htonl(ntohl(old_seq) + delta);
+
+    h->th_sum = checksum::cksum_update(h->th_sum, &old_seq, &new_seq, sizeof(new_seq));
+    h->th_seq = new_seq;
+}
+
 static inline EncodeFlags GetFlags(void)
 {
     EncodeFlags flags = ENC_FLAG_ID;
@@ -164,6 +247,12 @@ bool Active::init(SnortConfig* sc)
     if ( s_enabled && !s_attempts )
         s_attempts = 1;
 
+    if ( !s_pool )
+        s_pool = new ResponsePool;
+
+    s_pool->num = 0;
+    s_pool->used = 0;
+
     if ( s_enabled && (!DAQ_CanInject() || !sc->respond_device.empty()) )
     {
         if ( SnortConfig::read_mode() || !open(sc->respond_device.c_str()) )
@@ -183,6 +272,9 @@ bool Active::init(SnortConfig* sc)
 
 void Active::term(void)
 {
+    delete s_pool;
+    s_pool = nullptr;
+
     Active::close();
 }
 
@@ -198,22 +290,43 @@ void Active::set_enabled(bool on_off)
 
 void Active::send_reset(Packet* p, EncodeFlags ef)
 {
-    int i;
     EncodeFlags flags = (GetFlags() | ef) & ~ENC_FLAG_VAL;
     EncodeFlags value = ef & ENC_FLAG_VAL;
+    int rev = !(ef & ENC_FLAG_FWD);
 
-    for ( i = 0; i < s_attempts; i++ )
-    {
-        uint32_t len;
-        const uint8_t* rej;
+    // the first reset is a template for the rest since they differ only
+    // by sequence number; it stays in the encode buffer until the next
+    // encode so copies are patched instead of encoding each attempt
+    const uint8_t* rst = nullptr;
+    uint32_t len = 0;
+    uint32_t seq = 0;
+    bool patch = can_patch(p);
 
+    for ( int i = 0; i < s_attempts; i++ )
+    {
         value = Strafe(i, value, p);
+        uint32_t adj = seq_adj(flags | value);
+
+        if ( rst and (adj == seq or patch) )
+        {
+            if ( uint8_t* pkt = reserve(p->pkth, rev, len) )
+            {
+                memcpy(pkt, rst, len);
 
-        rej = PacketManager::encode_response(TcpResponse::RST, flags|value, p, len);
-        if ( !rej )
+                if ( adj != seq )
+                    patch_seq(pkt, len, adj - seq);
+
+                continue;
+            }
+        }
+
+        rst = PacketManager::encode_response(TcpResponse::RST, flags|value, p, len);
+
+        if ( !rst )
             return;
 
-        s_send(p->pkth, !(ef & ENC_FLAG_FWD), rej, len);
+        seq = adj;
+        queue(p->pkth, rev, rst, len);
     }
 }
 
@@ -230,7 +343,7 @@ void Active::send_unreach(Packet* p, UnreachResponse type)
     if ( !rej )
         return;
 
-    s_send(p->pkth, 1, rej, len);
+    queue(p->pkth, 1, rej, len);
 }
 
 bool Active::send_data(
@@ -249,7 +362,7 @@ bool Active::send_data(
         seg = PacketManager::encode_response(TcpResponse::RST, tmp_flags, p, plen);
 
         if ( seg )
-            s_send(p->pkth, !(tmp_flags & ENC_FLAG_FWD), seg, plen);
+            queue(p->pkth, !(tmp_flags & ENC_FLAG_FWD), seg, plen);
     }
     flags |= ENC_FLAG_SEQ;
 
@@ -269,7 +382,7 @@ bool Active::send_data(
         if ( !seg )
             return false;
 
-        s_send(p->pkth, !(flags & ENC_FLAG_FWD), seg, plen);
+        queue(p->pkth, !(flags & ENC_FLAG_FWD), seg, plen);
 
         buf += toSend;
         sent += toSend;
@@ -283,7 +396,7 @@ bool Active::send_data(
         seg = PacketManager::encode_response(TcpResponse::RST, flags, p, plen);
 
         if ( seg )
-            s_send(p->pkth, !(flags & ENC_FLAG_FWD), seg, plen);
+            queue(p->pkth, !(flags & ENC_FLAG_FWD), seg, plen);
     }
 
     return true;
@@ -305,7 +418,23 @@ void Active::inject_data(
     if ( !seg )
         return;
 
-    s_send(p->pkth, !(flags & ENC_FLAG_FWD), seg, plen);
+    queue(p->pkth, !(flags & ENC_FLAG_FWD), seg, plen);
+}
+
+void Active::send_queued()
+{
+    if ( !s_pool or !s_pool->num )
+        return;
+
+    for ( unsigned i = 0; i < s_pool->num; ++i )
+    {
+        const QueuedResponse& r = s_pool->queue[i];
+
+        if ( !s_send(&r.hdr, r.rev, s_pool->buf + r.off, r.len) )
+            aux_counts.responses_sent++;
+    }
+    s_pool->num = 0;
+    s_pool->used = 0;
 }
 
 //--------------------------------------------------------------------
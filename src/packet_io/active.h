@@ -62,6 +62,10 @@ public:
     static bool send_data(Packet*, EncodeFlags, const uint8_t* buf, uint32_t len);
     static void inject_data(Packet*, EncodeFlags, const uint8_t* buf, uint32_t len);
 
+    // responses are queued as they are encoded and injected together
+    // once the wire packet is done (or sooner if the queue fills)
+    static void send_queued();
+
     static bool is_reset_candidate(const Packet*);
     static bool is_unreachable_candidate(const Packet*);
 
@@ -24,12 +24,6 @@
 
 namespace ip
 {
-void IpApi::reset()
-{
-    type = IAT_NONE;
-    iph = nullptr;
-}
-
 void IpApi::set(const IP4Hdr* h4)
 {
     iph = (const void*)h4;
@@ -67,7 +67,12 @@ public:
     void set(const IP6Hdr* h6);
     void set(const sfip_t& src, const sfip_t& dst);
     bool set(const uint8_t* raw_ip_data);
-    void reset();
+
+    inline void reset()
+    {
+        type = IAT_NONE;
+        iph = nullptr;
+    }
 
     // return the 16 bits associated with this IP layers frag_offset/flags
     uint16_t off_w_flags() const;
@@ -141,10 +146,12 @@ public:
     uint8_t ver() const;
 
 private:
-    sfip_t src;
-    sfip_t dst;
+    // reset() only clears these so they go first
     const void* iph;
     Type type;
+
+    sfip_t src;
+    sfip_t dst;
 };
 
 } // namespace ip
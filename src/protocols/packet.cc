@@ -23,6 +23,11 @@
 #include "protocols/packet_manager.h"
 #include "protocols/protocol_ids.h"
 
+#ifdef UNIT_TEST
+#include <sstream>
+#include "catch/catch.hpp"
+#endif
+
 #if 0
 uint8_t Packet::ip_proto_next() const
 {
@@ -183,3 +188,54 @@ const char* Packet::get_pseudo_type() const
     return "other";
 }
 
+#ifdef UNIT_TEST
+// the layout report is shown if a check fails
+#define LAYOUT(os, t, f) \
+    os << #f << " @ " << offsetof(t, f) << " + " << sizeof(((t*)nullptr)->f) << "\n"
+
+static const size_t cache_line = 64;
+
+TEST_CASE("packet layout", "[Packet]")
+{
+    std::ostringstream os;
+    os << "sizeof(Packet) = " << sizeof(Packet) << "\n";
+    LAYOUT(os, Packet, flow);
+    LAYOUT(os, Packet, packet_flags);
+    LAYOUT(os, Packet, xtradata_mask);
+    LAYOUT(os, Packet, proto_bits);
+    LAYOUT(os, Packet, alt_dsize);
+    LAYOUT(os, Packet, num_layers);
+    LAYOUT(os, Packet, ip_proto_next);
+    LAYOUT(os, Packet, pkth);
+    LAYOUT(os, Packet, pkt);
+    LAYOUT(os, Packet, data);
+    LAYOUT(os, Packet, layers);
+    LAYOUT(os, Packet, dsize);
+    LAYOUT(os, Packet, user_policy_id);
+    LAYOUT(os, Packet, ps_proto);
+    LAYOUT(os, Packet, ptrs);
+    LAYOUT(os, Packet, pseudo_type);
+    LAYOUT(os, Packet, iplist_id);
+    os << "sizeof(DecodeData) = " << sizeof(DecodeData) << "\n";
+    LAYOUT(os, DecodeData, ip_api);
+    LAYOUT(os, DecodeData, mplsHdr);
+    INFO(os.str());
+
+    SECTION("size")
+    {
+        CHECK(sizeof(Packet) <= 3 * cache_line);
+    }
+    SECTION("first line holds the per packet fields")
+    {
+        CHECK(offsetof(Packet, pkth) <= 24);
+        CHECK(offsetof(Packet, layers) + sizeof(Layer*) <= cache_line);
+        CHECK(offsetof(Packet, dsize) + sizeof(uint16_t) <= cache_line);
+    }
+    SECTION("reset touches the first two lines only")
+    {
+        CHECK(offsetof(Packet, ptrs) == cache_line);
+        // ip_api.reset() clears the leading iph and type
+        CHECK(offsetof(DecodeData, ip_api) + sizeof(void*) + sizeof(int) <= cache_line);
+    }
+}
+#endif
@@ -91,7 +91,8 @@ extern "C" {
 
 #define PKT_FILE_EVENT_SET   0x00400000
 #define PKT_IGNORE           0x00800000  /* this packet should be ignored, based on port */
-#define PKT_UNUSED_FLAGS     0xfe000000
+#define PKT_PATCHED          0x02000000  /* header changes w/checksums updated in place */
+#define PKT_UNUSED_FLAGS     0xfc000000
 
 // 0x40000000 are available
 #define PKT_PDU_FULL (PKT_PDU_HEAD | PKT_PDU_TAIL)
@@ -134,6 +135,12 @@ constexpr uint8_t DEFAULT_LAYERMAX = 40;
 // Packet is an abstraction describing a unit of work.  it may define a
 // wire packet or it may define a cooked packet.  the latter contains
 // payload data only, no headers.
+//
+// the layout is for a 64 byte aligned Packet (see encode_new()).  the
+// first cache line holds the fields reset and set for every packet and
+// ptrs starts the second so that reset() touches just those 2 lines.
+// fields that are only valid with a flag (pseudo_type) or are rarely
+// used go last.
 struct SO_PUBLIC Packet
 {
     class Flow* flow;   /* for session tracking */
@@ -155,19 +162,19 @@ struct SO_PUBLIC Packet
 
     // These are both set before PacketManager::decode() returns
     const uint8_t* data;        /* packet payload pointer */
-    uint16_t dsize;             /* packet payload size */
-
-    DecodeData ptrs; // convenience pointers used throughout Snort++
     Layer* layers;    /* decoded encapsulations */
-
-    PseudoPacketType pseudo_type;    // valid only when PKT_PSEUDO is set
-    uint32_t iplist_id;
+    uint16_t dsize;             /* packet payload size */
 
     // for correlating configuration with event output
     uint16_t user_policy_id;
 
     uint8_t ps_proto;  // Used for portscan and unified2 logging
 
+    DecodeData ptrs; // convenience pointers used throughout Snort++
+
+    PseudoPacketType pseudo_type;    // valid only when PKT_PSEUDO is set
+    uint32_t iplist_id;
+
     // IP_MAXPACKET is the minimum allowable max_dsize
     // there is no requirement that all data fit into an IP datagram
     // but we do require that an IP datagram fit into Packet space
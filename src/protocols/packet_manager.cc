@@ -21,6 +21,7 @@
 
 #include <vector>
 #include <cstring>
+#include <stdlib.h>
 #include <mutex>
 #include <algorithm>
 #include <limits>
@@ -38,6 +39,14 @@
 #include "protocols/eth.h"
 #include "protocols/icmp4.h"
 #include "protocols/icmp6.h"
+#include "protocols/ipv4.h"
+#include "protocols/ipv6.h"
+#include "protocols/tcp.h"
+#include "protocols/tcp_options.h"
+#include "protocols/teredo.h"
+#include "protocols/udp.h"
+#include "protocols/vlan.h"
+#include "sfip/sf_ip.h"
 #include "time/profiler.h"
 #include "parser/parser.h"
 
@@ -50,6 +59,12 @@
 #include "packet_io/sfdaq.h"
 #include "packet_io/active.h"
 
+#ifdef UNIT_TEST
+#include <arpa/inet.h>
+#include "catch/catch.hpp"
+#include "main/policy.h"
+#endif
+
 #ifdef PERF_PROFILING
 THREAD_LOCAL ProfileStats decodePerfStats;
 #endif
@@ -72,7 +87,8 @@ const std::array<const char*, PacketManager::stat_offset> PacketManager::stat_na
     {
         "total",
         "other",
-        "discards"
+        "discards",
+        "fast path"
     }
 };
 
@@ -84,6 +100,27 @@ static THREAD_LOCAL std::array<uint8_t, Codec::PKT_MAX> s_pkt {
 };
 static THREAD_LOCAL uint8_t* dst_mac = nullptr;
 
+// Fast path: mapped ids of the stock codecs for the common stacks.  Only
+// enabled if the root codec is ethernet and each protocol maps to the
+// codec the fast path mirrors.
+struct FastDecode
+{
+    bool enabled;
+    uint8_t eth;
+    uint8_t vlan;
+    uint8_t ip4;
+    uint8_t ip6;
+    uint8_t tcp;
+    uint8_t udp;
+    uint8_t done;
+};
+
+static THREAD_LOCAL FastDecode s_fast;
+
+#ifndef NDEBUG
+static THREAD_LOCAL Packet* s_check_pkt = nullptr;
+#endif
+
 //-------------------------------------------------------------------------
 // Private helper functions
 //-------------------------------------------------------------------------
@@ -123,12 +160,20 @@ void PacketManager::pop_teredo(Packet* p, RawData& raw)
 
 Packet* PacketManager::encode_new(bool packet_data)
 {
-    Packet* p = (Packet*)SnortAlloc(sizeof(*p));
+    // cache line aligned; see Packet
+    void* mem = nullptr;
+
+    if ( posix_memalign(&mem, 64, sizeof(Packet)) )
+        mem = nullptr;
+
+    Packet* p = (Packet*)mem;
     Layer* lyr = new Layer[CodecManager::max_layers];
 
     if ( !p || !lyr)
         FatalError("encode_new() => Failed to allocate packet\n");
 
+    memset(p, 0, sizeof(*p));
+
     if (!packet_data)
     {
         p->pkt = nullptr;
@@ -189,33 +234,51 @@ void PacketManager::decode(
 {
     PERF_PROFILE(decodePerfStats);
 
+    // initialize all Packet information
+    p->reset();
+    p->pkth = pkthdr;
+    p->pkt = pkt;
+    layer::set_packet_pointer(p);
+
+    s_stats[total_processed]++;
+
+    if ( s_fast.enabled and !cooked )
+    {
+        if ( fast_decode(p) )
+        {
+#ifndef NDEBUG
+            check_fast_decode(p);
+#endif
+            return;
+        }
+        // start over
+        p->reset();
+        p->pkth = pkthdr;
+        p->pkt = pkt;
+    }
+    decode_layers(p, cooked);
+}
+
+void PacketManager::decode_layers(Packet* p, bool cooked)
+{
     DecodeData unsure_encap_ptrs;
 
     uint8_t mapped_prot = CodecManager::grinder;
     uint16_t prev_prot_id = CodecManager::grinder_id;
 
-    RawData raw(pkthdr, pkt);
+    RawData raw(p->pkth, p->pkt);
     CodecData codec_data(FINISHED_DECODE);
 
     if ( cooked )
         codec_data.codec_flags |= CODEC_STREAM_REBUILT;
 
-    // initialize all Packet information
-    p->reset();
-    p->pkth = pkthdr;
-    p->pkt = pkt;
-    p->ptrs.reset();
-    layer::set_packet_pointer(p);
-
-    s_stats[total_processed]++;
-
     // loop until the protocol id is no longer valid
     while (CodecManager::s_protocols[mapped_prot]->decode(raw, codec_data, p->ptrs))
     {
         DebugFormat(DEBUG_DECODE, "Codec %s (protocol_id: %u:"
             "ip header starts at: %p, length is %lu\n",
             CodecManager::s_protocols[mapped_prot]->get_name(),
-            codec_data.next_prot_id, pkt, codec_data.lyr_len);
+            codec_data.next_prot_id, p->pkt, codec_data.lyr_len);
 
         /*
          * We only want the layer immediately following SAVE_LAYER to have the
@@ -282,7 +345,7 @@ void PacketManager::decode(
     DebugFormat(DEBUG_DECODE, "Codec %s (protocol_id: %hu: ip header"
         " starts at: %p, length is %lu\n",
         CodecManager::s_protocols[mapped_prot]->get_name(),
-        prev_prot_id, pkt, (unsigned long)codec_data.lyr_len);
+        prev_prot_id, p->pkt, (unsigned long)codec_data.lyr_len);
 
     s_stats[mapped_prot + stat_offset]++;
 
@@ -345,6 +408,459 @@ void PacketManager::decode(
         p->proto_bits = PROTO_BIT__OTHER;
 }
 
+//-------------------------------------------------------------------------
+// fast path
+//
+// most traffic is eth/ip4/tcp or a close variant and every codec on that
+// path returns early on the same few checks.  fast_decode() does those
+// checks inline and sets exactly what the codecs would.  it declines (and
+// the packet is decoded from scratch by the codecs) if the packet is
+// anything other than routine, ie if any codec would raise an event, count
+// a bad checksum, take an encapsulation branch, or stop early.  so:
+//
+// - eth with ethertype ip4, ip6, or one 802.1Q tag (vid not 0 or 4095)
+// - ip4 w/o options, not fragmented, addresses not loopback, broadcast,
+//   this net, multicast, or reserved, and src != dst
+// - ip6 w/o extension headers and addresses not multicast, loopback, or
+//   unspecified, and src != dst
+// - tcp w/o syn or urg, with only mss, ws, sack, sackok, ts and nop options
+// - udp that isn't teredo or gtp, with no more than 4000 bytes of payload
+//
+// debug builds verify each fast path decode against the codecs.
+//-------------------------------------------------------------------------
+
+void PacketManager::thread_init()
+{
+    const auto& map = CodecManager::s_proto_map;
+    const auto& cd = CodecManager::s_protocols;
+
+    auto is = [&](uint16_t prot, const char* name)
+    { return map[prot] and !strcmp(cd[map[prot]]->get_name(), name); };
+
+    s_fast.eth = CodecManager::grinder;
+    s_fast.vlan = map[ETHERTYPE_8021Q];
+    s_fast.ip4 = map[ETHERTYPE_IPV4];
+    s_fast.ip6 = map[ETHERTYPE_IPV6];
+    s_fast.tcp = map[IPPROTO_ID_TCP];
+    s_fast.udp = map[IPPROTO_ID_UDP];
+    s_fast.done = map[FINISHED_DECODE];
+
+    s_fast.enabled =
+        CodecManager::grinder_id == PROTO_ETHERNET_802_3 and
+        is(PROTO_ETHERNET_802_3, "eth") and is(ETHERTYPE_8021Q, "vlan") and
+        is(ETHERTYPE_IPV4, "ipv4") and is(ETHERTYPE_IPV6, "ipv6") and
+        is(IPPROTO_ID_TCP, "tcp") and is(IPPROTO_ID_UDP, "udp") and
+        CodecManager::max_layers >= 4;
+}
+
+void PacketManager::thread_term()
+{
+#ifndef NDEBUG
+    encode_delete(s_check_pkt);
+    s_check_pkt = nullptr;
+#endif
+}
+
+static inline void fast_layer(
+    Packet* p, uint16_t prot_id, const uint8_t* start, uint16_t len)
+{
+    Layer& lyr = p->layers[p->num_layers++];
+    lyr.prot_id = prot_id;
+    lyr.start = start;
+    lyr.length = len;
+}
+
+static inline bool fast_ip4(Packet* p, const uint8_t*& data, uint32_t& len)
+{
+    if ( len < ip::IP4_HEADER_LEN or snort_conf->hit_ip_maxlayers(0) )
+        return false;
+
+    const ip::IP4Hdr* iph = reinterpret_cast<const ip::IP4Hdr*>(data);
+    const uint32_t ip_len = iph->len();
+
+    // no options, no fragments (DF is ok), no bogus lengths
+    if ( iph->ver() != 4 or iph->hlen() != ip::IP4_HEADER_LEN or
+        ip_len > len or ip_len < ip::IP4_HEADER_LEN or (iph->off_w_flags() & 0xBFFF) )
+        return false;
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(&iph->ip_src);
+    const uint8_t* dst = reinterpret_cast<const uint8_t*>(&iph->ip_dst);
+
+    if ( iph->ip_src == iph->ip_dst or iph->is_src_broadcast() or iph->is_dst_broadcast() )
+        return false;
+
+    if ( src[0] == ip::IP4_LOOPBACK or dst[0] == ip::IP4_LOOPBACK or
+        src[0] == ip::IP4_THIS_NET or dst[0] == ip::IP4_THIS_NET )
+        return false;
+
+    // multicast and reserved (reserved multicast and syn to multicast
+    // are within 224/4)
+    if ( (src[0] >> 4) >= ip::IP4_MULTICAST or (dst[0] >> 4) >= ip::IP4_MULTICAST )
+        return false;
+
+    if ( iph->proto() != IPPROTO_ID_TCP and iph->proto() != IPPROTO_ID_UDP )
+        return false;
+
+    if ( SnortConfig::ip_checksums() and
+        checksum::ip_cksum((const uint16_t*)iph, ip::IP4_HEADER_LEN) )
+        return false;
+
+    p->ptrs.ip_api.set(iph);
+    p->ptrs.set_pkt_type(PktType::IP);
+    p->ip_proto_next = iph->proto();
+    p->proto_bits |= PROTO_BIT__IP;
+
+    fast_layer(p, ETHERTYPE_IPV4, data, ip::IP4_HEADER_LEN);
+    data += ip::IP4_HEADER_LEN;
+    len = ip_len - ip::IP4_HEADER_LEN;
+    return true;
+}
+
+static inline bool fast_ip6(Packet* p, const uint8_t*& data, uint32_t& len)
+{
+    if ( len < ip::IP6_HEADER_LEN or snort_conf->hit_ip_maxlayers(0) )
+        return false;
+
+    const ip::IP6Hdr* ip6h = reinterpret_cast<const ip::IP6Hdr*>(data);
+    const uint32_t ip_len = ip6h->len() + ip::IP6_HEADER_LEN;
+
+    if ( ip6h->ver() != 6 or ip_len > len )
+        return false;
+
+    if ( ip6h->next() != IPPROTO_ID_TCP and ip6h->next() != IPPROTO_ID_UDP )
+        return false;
+
+    if ( ip6h->is_src_multicast() or ip6h->is_dst_multicast() or
+        !ip6h->is_valid_next_header() )
+        return false;
+
+    p->ptrs.ip_api.set(ip6h);
+
+    const sfip_t* src = p->ptrs.ip_api.get_src();
+    const sfip_t* dst = p->ptrs.ip_api.get_dst();
+
+    if ( sfip_contains(src, dst) == SFIP_CONTAINS or
+        sfip_is_loopback(src) or sfip_is_loopback(dst) or !sfip_is_set(dst) )
+        return false;
+
+    p->ptrs.set_pkt_type(PktType::IP);
+    p->ip_proto_next = ip6h->next();
+    p->proto_bits |= PROTO_BIT__IP;
+
+    fast_layer(p, ETHERTYPE_IPV6, data, ip::IP6_HEADER_LEN);
+    data += ip::IP6_HEADER_LEN;
+    len = ip_len - ip::IP6_HEADER_LEN;
+    return true;
+}
+
+template<typename Hdr>
+static inline uint16_t fast_cksum(
+    const Packet* p, const Hdr* h, uint32_t len, uint16_t ph_len)
+{
+    const ip::IpApi& ip_api = p->ptrs.ip_api;
+
+    if ( ip_api.is_ip4() )
+    {
+        checksum::Pseudoheader ph;
+        const ip::IP4Hdr* ip4h = ip_api.get_ip4h();
+        ph.sip = ip4h->get_src();
+        ph.dip = ip4h->get_dst();
+        ph.zero = 0;
+        ph.protocol = ip4h->proto();
+        ph.len = ph_len;
+
+        return std::is_same<Hdr, tcp::TCPHdr>::value ?
+            checksum::tcp_cksum((const uint16_t*)h, len, &ph) :
+            checksum::udp_cksum((const uint16_t*)h, len, &ph);
+    }
+    checksum::Pseudoheader6 ph6;
+    const ip::IP6Hdr* ip6h = ip_api.get_ip6h();
+    COPY4(ph6.sip, ip6h->get_src()->u6_addr32);
+    COPY4(ph6.dip, ip6h->get_dst()->u6_addr32);
+    ph6.zero = 0;
+    ph6.protocol = ip6h->next();
+    ph6.len = ph_len;
+
+    return std::is_same<Hdr, tcp::TCPHdr>::value ?
+        checksum::tcp_cksum((const uint16_t*)h, len, &ph6) :
+        checksum::udp_cksum((const uint16_t*)h, len, &ph6);
+}
+
+// only options that the codec accepts w/o comment
+static inline bool fast_tcp_options(const uint8_t* opt, const uint8_t* end)
+{
+    while ( opt < end )
+    {
+        const tcp::TcpOptCode code = (tcp::TcpOptCode)opt[0];
+        int fixed;
+
+        switch ( code )
+        {
+        case tcp::TcpOptCode::NOP:
+            ++opt;
+            continue;
+
+        case tcp::TcpOptCode::MAXSEG:    fixed = tcp::TCPOLEN_MAXSEG; break;
+        case tcp::TcpOptCode::SACKOK:    fixed = tcp::TCPOLEN_SACKOK; break;
+        case tcp::TcpOptCode::WSCALE:    fixed = tcp::TCPOLEN_WSCALE; break;
+        case tcp::TcpOptCode::TIMESTAMP: fixed = tcp::TCPOLEN_TIMESTAMP; break;
+        case tcp::TcpOptCode::SACK:      fixed = 0; break;
+
+        default:
+            return false;
+        }
+
+        if ( opt + 1 >= end or opt[1] < 2 or opt + opt[1] > end )
+            return false;
+
+        if ( fixed and opt[1] != fixed )
+            return false;
+
+        if ( code == tcp::TcpOptCode::WSCALE and opt[2] > 14 )
+            return false;
+
+        opt += opt[1];
+    }
+    return true;
+}
+
+static inline bool fast_tcp(Packet* p, const uint8_t*& data, uint32_t& len)
+{
+    if ( len < tcp::TCP_MIN_HEADER_LEN )
+        return false;
+
+    const tcp::TCPHdr* tcph = reinterpret_cast<const tcp::TCPHdr*>(data);
+    const uint16_t hlen = tcph->hlen();
+
+    if ( hlen < tcp::TCP_MIN_HEADER_LEN or hlen > len )
+        return false;
+
+    const uint8_t flags = tcph->th_flags;
+
+    if ( (flags & (TH_SYN|TH_URG)) or !(flags & (TH_ACK|TH_RST)) )
+        return false;
+
+    if ( (flags & (TH_FIN|TH_PUSH)) and !(flags & TH_ACK) )
+        return false;
+
+    if ( !tcph->src_port() or !tcph->dst_port() )
+        return false;
+
+    if ( hlen > tcp::TCP_MIN_HEADER_LEN and
+        !fast_tcp_options(data + tcp::TCP_MIN_HEADER_LEN, data + hlen) )
+        return false;
+
+    if ( SnortConfig::tcp_checksums() and
+        !(p->pkth->flags & DAQ_PKT_FLAG_HW_TCP_CS_GOOD) and
+        fast_cksum(p, tcph, len, htons((uint16_t)len)) )
+        return false;
+
+    p->ptrs.tcph = tcph;
+    p->ptrs.sp = tcph->src_port();
+    p->ptrs.dp = tcph->dst_port();
+    p->ptrs.set_pkt_type(PktType::TCP);
+    p->proto_bits |= PROTO_BIT__TCP;
+
+    fast_layer(p, IPPROTO_ID_TCP, data, hlen);
+    data += hlen;
+    len -= hlen;
+    return true;
+}
+
+static inline bool fast_udp(Packet* p, const uint8_t*& data, uint32_t& len)
+{
+    if ( len < udp::UDP_HEADER_LEN )
+        return false;
+
+    const udp::UDPHdr* udph = reinterpret_cast<const udp::UDPHdr*>(data);
+    const uint16_t uhlen = ntohs(udph->uh_len);
+
+    if ( uhlen < udp::UDP_HEADER_LEN or uhlen != len )
+        return false;
+
+    const uint16_t sp = udph->src_port();
+    const uint16_t dp = udph->dst_port();
+
+    if ( !sp or !dp or uhlen - udp::UDP_HEADER_LEN > 4000 )
+        return false;
+
+    if ( SnortConfig::gtp_decoding() and
+        (SnortConfig::is_gtp_port(sp) or SnortConfig::is_gtp_port(dp)) )
+        return false;
+
+    if ( teredo::is_teredo_port(sp) or teredo::is_teredo_port(dp) or
+        SnortConfig::deep_teredo_inspection() )
+        return false;
+
+    if ( SnortConfig::udp_checksums() )
+    {
+        if ( p->ptrs.ip_api.is_ip4() )
+        {
+            if ( udph->uh_chk and fast_cksum(p, udph, uhlen, udph->uh_len) )
+                return false;
+        }
+        else if ( !udph->uh_chk or fast_cksum(p, udph, uhlen, htons((uint16_t)len)) )
+            return false;
+    }
+
+    p->ptrs.udph = udph;
+    p->ptrs.sp = sp;
+    p->ptrs.dp = dp;
+    p->ptrs.set_pkt_type(PktType::UDP);
+    p->proto_bits |= PROTO_BIT__UDP;
+
+    fast_layer(p, IPPROTO_ID_UDP, data, udp::UDP_HEADER_LEN);
+    data += udp::UDP_HEADER_LEN;
+    len -= udp::UDP_HEADER_LEN;
+    return true;
+}
+
+bool PacketManager::fast_decode(Packet* p)
+{
+    const uint8_t* data = p->pkt;
+    uint32_t len = p->pkth->caplen;
+
+    if ( len < eth::ETH_HEADER_LEN )
+        return false;
+
+    const eth::EtherHdr* eh = reinterpret_cast<const eth::EtherHdr*>(data);
+    uint16_t type = eh->ethertype();
+
+    fast_layer(p, PROTO_ETHERNET_802_3, data, eth::ETH_HEADER_LEN);
+    p->proto_bits = PROTO_BIT__ETH;
+    data += eth::ETH_HEADER_LEN;
+    len -= eth::ETH_HEADER_LEN;
+
+    const bool tagged = (type == ETHERTYPE_8021Q);
+
+    if ( tagged )
+    {
+        if ( len < sizeof(vlan::VlanTagHdr) )
+            return false;
+
+        const vlan::VlanTagHdr* vh = reinterpret_cast<const vlan::VlanTagHdr*>(data);
+        const uint16_t vid = vh->vid();
+
+        if ( vid == 0 or vid == 4095 )
+            return false;
+
+        type = vh->proto();
+        fast_layer(p, ETHERTYPE_8021Q, data, sizeof(vlan::VlanTagHdr));
+        p->proto_bits |= PROTO_BIT__VLAN;
+        data += sizeof(vlan::VlanTagHdr);
+        len -= sizeof(vlan::VlanTagHdr);
+    }
+
+    uint8_t ip;
+
+    if ( type == ETHERTYPE_IPV4 )
+    {
+        if ( !fast_ip4(p, data, len) )
+            return false;
+        ip = s_fast.ip4;
+    }
+    else if ( type == ETHERTYPE_IPV6 )
+    {
+        if ( !fast_ip6(p, data, len) )
+            return false;
+        ip = s_fast.ip6;
+    }
+    else
+        return false;
+
+    uint8_t xp;
+
+    if ( p->ip_proto_next == IPPROTO_ID_TCP )
+    {
+        if ( !fast_tcp(p, data, len) )
+            return false;
+        xp = s_fast.tcp;
+    }
+    else
+    {
+        if ( !fast_udp(p, data, len) )
+            return false;
+        xp = s_fast.udp;
+    }
+
+    p->data = data;
+    p->dsize = (uint16_t)len;
+
+    s_stats[fast_path]++;
+    s_stats[s_fast.eth + stat_offset]++;
+
+    if ( tagged )
+        s_stats[s_fast.vlan + stat_offset]++;
+
+    s_stats[ip + stat_offset]++;
+    s_stats[xp + stat_offset]++;
+    s_stats[s_fast.done + stat_offset]++;
+
+    return true;
+}
+
+#ifndef NDEBUG
+// decode the packet again with the codecs and make sure we got the same
+static bool same_layers(const Packet* a, const Packet* b)
+{
+    if ( a->num_layers != b->num_layers )
+        return false;
+
+    for ( unsigned i = 0; i < a->num_layers; ++i )
+    {
+        const Layer& la = a->layers[i];
+        const Layer& lb = b->layers[i];
+
+        if ( la.prot_id != lb.prot_id or la.start != lb.start or la.length != lb.length )
+            return false;
+    }
+    return true;
+}
+
+void PacketManager::check_fast_decode(const Packet* p)
+{
+    if ( !s_check_pkt )
+        s_check_pkt = encode_new(false);
+
+    Packet* q = s_check_pkt;
+    auto save = s_stats;
+
+    q->reset();
+    q->pkth = p->pkth;
+    q->pkt = p->pkt;
+    layer::set_packet_pointer(q);
+
+    decode_layers(q, false);
+
+    layer::set_packet_pointer(p);
+
+    // the codecs should have counted the same layers as the fast path
+    auto fast = save;
+
+    for ( unsigned i = 0; i < p->num_layers; ++i )
+        fast[CodecManager::s_proto_map[p->layers[i].prot_id] + stat_offset]++;
+
+    fast[s_fast.done + stat_offset]++;
+    assert(fast == s_stats);
+    s_stats = save;
+
+    assert(same_layers(p, q));
+    assert(p->proto_bits == q->proto_bits);
+    assert(p->ip_proto_next == q->ip_proto_next);
+    assert(p->data == q->data);
+    assert(p->dsize == q->dsize);
+
+    assert(p->ptrs.tcph == q->ptrs.tcph);
+    assert(p->ptrs.udph == q->ptrs.udph);
+    assert(p->ptrs.icmph == q->ptrs.icmph);
+    assert(p->ptrs.sp == q->ptrs.sp);
+    assert(p->ptrs.dp == q->ptrs.dp);
+    assert(p->ptrs.decode_flags == q->ptrs.decode_flags);
+    assert(p->ptrs.get_pkt_type() == q->ptrs.get_pkt_type());
+    assert(p->ptrs.ip_api == q->ptrs.ip_api);
+}
+#endif
+
 //-------------------------------------------------------------------------
 // encoders operate layer by layer:
 //-------------------------------------------------------------------------
@@ -903,7 +1419,7 @@ void PacketManager::dump_stats()
     std::vector<const char*> pkt_names;
 
     // zero out the default codecs
-    g_stats[3] = 0;
+    g_stats[stat_offset] = 0;
     g_stats[CodecManager::s_proto_map[FINISHED_DECODE] + stat_offset] = 0;
 
     for (unsigned int i = 0; i < stat_names.size(); i++)
@@ -968,3 +1484,421 @@ void PacketManager::log_protocols(TextLog* const text_log,
     }
 }
 
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+bool PacketManager::test_init()
+{
+    set_default_policy();
+
+    CodecManager::grinder_id = PROTO_ETHERNET_802_3;
+    CodecManager::grinder = CodecManager::s_proto_map[PROTO_ETHERNET_802_3];
+    CodecManager::max_layers = snort_conf->num_layers;
+
+    thread_init();
+    return s_fast.enabled;
+}
+
+bool PacketManager::test_decode(
+    Packet* p, Packet* q, const DAQ_PktHdr_t* pkth, const uint8_t* pkt)
+{
+    PegCount fast = s_stats[fast_path];
+    decode(p, pkth, pkt);
+    bool took = s_stats[fast_path] != fast;
+
+    q->reset();
+    q->pkth = pkth;
+    q->pkt = pkt;
+    layer::set_packet_pointer(q);
+
+    decode_layers(q, false);
+    layer::set_packet_pointer(p);
+
+    return took;
+}
+
+// frames are eth / [vlan] / ip4 | ip6 [ext] / tcp | udp / payload with
+// good checksums unless a spec says otherwise
+struct FrameSpec
+{
+    const char* name;
+    bool accept;
+
+    bool vlan = false;
+    uint16_t vid = 10;
+    uint16_t type = 0;      // ethertype after eth / vlan; 0 for ip
+
+    bool ip6 = false;
+    bool ip4_opts = false;
+    bool ip6_ext = false;
+    uint16_t ip4_off = 0;
+    uint8_t proto = IPPROTO_TCP;
+    const char* src = nullptr;
+    const char* dst = nullptr;
+
+    uint8_t flags = TH_ACK;
+    std::vector<uint8_t> opts;
+    uint16_t sp = 40000;
+    uint16_t dp = 80;
+    unsigned payload = 16;
+
+    bool bad_ip = false;
+    bool bad_l4 = false;
+    bool no_udp_cksum = false;
+    unsigned cut = 0;       // bytes dropped from the end of the capture
+
+    FrameSpec(const char* s, bool a) : name(s), accept(a) { }
+};
+
+struct Frame
+{
+    uint8_t buf[4200];
+    uint32_t len;
+    DAQ_PktHdr_t hdr;
+};
+
+static inline void put16(uint8_t* b, uint16_t v)
+{ b[0] = v >> 8; b[1] = v & 0xFF; }
+
+static void build(const FrameSpec& f, Frame& fr)
+{
+    uint8_t* b = fr.buf;
+    memset(fr.buf, 0, sizeof(fr.buf));
+
+    static const uint8_t macs[12] = { 0, 1, 2, 3, 4, 5, 0, 6, 7, 8, 9, 10 };
+    memcpy(b, macs, sizeof(macs));
+    b += sizeof(macs);
+
+    uint16_t type = f.type ? f.type : (f.ip6 ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4);
+
+    if ( f.vlan )
+    {
+        put16(b, ETHERTYPE_8021Q);
+        put16(b + 2, f.vid);
+        b += 4;
+    }
+    put16(b, type);
+    b += 2;
+
+    const unsigned l4_hlen = f.proto == IPPROTO_TCP ? 20 + f.opts.size() : 8;
+    const unsigned l4_len = l4_hlen + f.payload;
+    const unsigned ext_len = f.ip6_ext ? 8 : 0;
+
+    uint8_t* ip = b;
+    uint8_t* l4;
+
+    if ( !f.ip6 )
+    {
+        const unsigned hlen = f.ip4_opts ? 24 : 20;
+        ip[0] = 0x40 | (hlen / 4);
+        put16(ip + 2, hlen + l4_len);
+        put16(ip + 4, 1);
+        put16(ip + 6, f.ip4_off);
+        ip[8] = 64;
+        ip[9] = f.proto;
+        inet_pton(AF_INET, f.src ? f.src : "10.1.1.1", ip + 12);
+        inet_pton(AF_INET, f.dst ? f.dst : "10.2.2.2", ip + 16);
+
+        if ( f.ip4_opts )
+            memset(ip + 20, 1, 4);  // nops
+
+        uint16_t c = checksum::ip_cksum((const uint16_t*)ip, hlen);
+        memcpy(ip + 10, &c, 2);
+
+        if ( f.bad_ip )
+            ip[10] ^= 1;
+
+        l4 = ip + hlen;
+    }
+    else
+    {
+        ip[0] = 0x60;
+        put16(ip + 4, ext_len + l4_len);
+        ip[6] = f.ip6_ext ? IPPROTO_HOPOPTS : f.proto;
+        ip[7] = 64;
+        inet_pton(AF_INET6, f.src ? f.src : "2001:db8::1", ip + 8);
+        inet_pton(AF_INET6, f.dst ? f.dst : "2001:db8::2", ip + 24);
+
+        if ( f.ip6_ext )
+        {
+            uint8_t* ext = ip + 40;
+            ext[0] = f.proto;
+            ext[2] = 1;  // padn
+            ext[3] = 4;
+        }
+        l4 = ip + 40 + ext_len;
+    }
+
+    put16(l4, f.sp);
+    put16(l4 + 2, f.dp);
+
+    if ( f.proto == IPPROTO_TCP )
+    {
+        put16(l4 + 6, 1);
+        put16(l4 + 10, 1);
+        l4[12] = (l4_hlen / 4) << 4;
+        l4[13] = f.flags;
+        put16(l4 + 14, 8192);
+
+        if ( !f.opts.empty() )
+            memcpy(l4 + 20, f.opts.data(), f.opts.size());
+    }
+    else
+        put16(l4 + 4, l4_len);
+
+    memset(l4 + l4_hlen, 'x', f.payload);
+
+    uint16_t c;
+
+    if ( !f.ip6 )
+    {
+        checksum::Pseudoheader ph;
+        memcpy(&ph.sip, ip + 12, 4);
+        memcpy(&ph.dip, ip + 16, 4);
+        ph.zero = 0;
+        ph.protocol = f.proto;
+        ph.len = htons(l4_len);
+
+        c = f.proto == IPPROTO_TCP ?
+            checksum::tcp_cksum((const uint16_t*)l4, l4_len, &ph) :
+            checksum::udp_cksum((const uint16_t*)l4, l4_len, &ph);
+    }
+    else
+    {
+        checksum::Pseudoheader6 ph6;
+        memcpy(ph6.sip, ip + 8, 16);
+        memcpy(ph6.dip, ip + 24, 16);
+        ph6.zero = 0;
+        ph6.protocol = f.proto;
+        ph6.len = htons(l4_len);
+
+        c = f.proto == IPPROTO_TCP ?
+            checksum::tcp_cksum((const uint16_t*)l4, l4_len, &ph6) :
+            checksum::udp_cksum((const uint16_t*)l4, l4_len, &ph6);
+    }
+    if ( f.proto == IPPROTO_UDP and !c )
+        c = 0xFFFF;
+
+    if ( f.no_udp_cksum )
+        c = 0;
+
+    else if ( f.bad_l4 )
+        c ^= 1;
+
+    memcpy(l4 + (f.proto == IPPROTO_TCP ? 16 : 6), &c, 2);
+
+    fr.len = (l4 + l4_len - fr.buf) - f.cut;
+
+    memset(&fr.hdr, 0, sizeof(fr.hdr));
+    fr.hdr.caplen = fr.hdr.pktlen = fr.len;
+}
+
+static void check_same(const Packet* p, const Packet* q)
+{
+    REQUIRE(p->num_layers == q->num_layers);
+
+    for ( unsigned i = 0; i < p->num_layers; ++i )
+    {
+        CHECK(p->layers[i].prot_id == q->layers[i].prot_id);
+        CHECK(p->layers[i].start == q->layers[i].start);
+        CHECK(p->layers[i].length == q->layers[i].length);
+    }
+    CHECK(p->proto_bits == q->proto_bits);
+    CHECK(p->ip_proto_next == q->ip_proto_next);
+    CHECK(p->data == q->data);
+    CHECK(p->dsize == q->dsize);
+
+    CHECK(p->ptrs.tcph == q->ptrs.tcph);
+    CHECK(p->ptrs.udph == q->ptrs.udph);
+    CHECK(p->ptrs.icmph == q->ptrs.icmph);
+    CHECK(p->ptrs.sp == q->ptrs.sp);
+    CHECK(p->ptrs.dp == q->ptrs.dp);
+    CHECK(p->ptrs.decode_flags == q->ptrs.decode_flags);
+    CHECK(p->ptrs.get_pkt_type() == q->ptrs.get_pkt_type());
+    CHECK((p->ptrs.ip_api == q->ptrs.ip_api));
+}
+
+static std::vector<FrameSpec> get_specs()
+{
+    std::vector<FrameSpec> v;
+
+    // accepted
+    v.emplace_back("ip4 tcp ack", true);
+
+    v.emplace_back("ip4 tcp psh ack w/ options", true);
+    v.back().flags = TH_PUSH | TH_ACK;
+    v.back().opts = { 1, 1, 8, 10, 0, 0, 0, 1, 0, 0, 0, 2 };
+
+    v.emplace_back("ip4 tcp sack", true);
+    v.back().opts = { 1, 1, 5, 10, 0, 0, 0, 1, 0, 0, 0, 2 };
+
+    v.emplace_back("ip4 tcp rst", true);
+    v.back().flags = TH_RST;
+    v.back().payload = 0;
+
+    v.emplace_back("ip4 tcp fin ack", true);
+    v.back().flags = TH_FIN | TH_ACK;
+
+    v.emplace_back("ip4 df", true);
+    v.back().ip4_off = 0x4000;
+
+    v.emplace_back("ip4 udp", true);
+    v.back().proto = IPPROTO_UDP;
+    v.back().dp = 53;
+
+    v.emplace_back("ip4 udp w/o checksum", true);
+    v.back().proto = IPPROTO_UDP;
+    v.back().no_udp_cksum = true;
+
+    v.emplace_back("ip6 tcp", true);
+    v.back().ip6 = true;
+
+    v.emplace_back("ip6 udp", true);
+    v.back().ip6 = true;
+    v.back().proto = IPPROTO_UDP;
+
+    v.emplace_back("vlan ip4 tcp", true);
+    v.back().vlan = true;
+
+    v.emplace_back("vlan ip6 udp", true);
+    v.back().vlan = true;
+    v.back().ip6 = true;
+    v.back().proto = IPPROTO_UDP;
+
+    // declined
+    v.emplace_back("tcp syn", false);
+    v.back().flags = TH_SYN;
+    v.back().opts = { 2, 4, 5, 180 };
+
+    v.emplace_back("tcp syn ack", false);
+    v.back().flags = TH_SYN | TH_ACK;
+
+    v.emplace_back("tcp urg", false);
+    v.back().flags = TH_URG | TH_ACK;
+
+    v.emplace_back("tcp w/o ack or rst", false);
+    v.back().flags = TH_PUSH;
+
+    v.emplace_back("tcp unknown option", false);
+    v.back().opts = { 30, 4, 0, 0 };
+
+    v.emplace_back("tcp bad option length", false);
+    v.back().opts = { 8, 12, 0, 0 };
+
+    v.emplace_back("tcp big window scale", false);
+    v.back().opts = { 3, 3, 15, 1 };
+
+    v.emplace_back("tcp port 0", false);
+    v.back().sp = 0;
+
+    v.emplace_back("ip4 options", false);
+    v.back().ip4_opts = true;
+
+    v.emplace_back("ip4 more fragments", false);
+    v.back().ip4_off = 0x2000;
+
+    v.emplace_back("ip4 fragment offset", false);
+    v.back().ip4_off = 0x0010;
+
+    v.emplace_back("ip4 bad checksum", false);
+    v.back().bad_ip = true;
+
+    v.emplace_back("ip4 tcp bad checksum", false);
+    v.back().bad_l4 = true;
+
+    v.emplace_back("ip4 udp bad checksum", false);
+    v.back().proto = IPPROTO_UDP;
+    v.back().bad_l4 = true;
+
+    v.emplace_back("ip6 tcp bad checksum", false);
+    v.back().ip6 = true;
+    v.back().bad_l4 = true;
+
+    v.emplace_back("ip6 udp w/o checksum", false);
+    v.back().ip6 = true;
+    v.back().proto = IPPROTO_UDP;
+    v.back().no_udp_cksum = true;
+
+    v.emplace_back("ip6 extension header", false);
+    v.back().ip6 = true;
+    v.back().ip6_ext = true;
+
+    v.emplace_back("ip4 icmp", false);
+    v.back().proto = IPPROTO_ICMP;
+    v.back().payload = 0;
+
+    v.emplace_back("ip4 loopback", false);
+    v.back().src = "127.0.0.1";
+
+    v.emplace_back("ip4 multicast", false);
+    v.back().dst = "224.0.0.5";
+
+    v.emplace_back("ip4 src == dst", false);
+    v.back().dst = "10.1.1.1";
+
+    v.emplace_back("ip6 multicast", false);
+    v.back().ip6 = true;
+    v.back().dst = "ff02::1";
+
+    v.emplace_back("ip6 loopback", false);
+    v.back().ip6 = true;
+    v.back().src = "::1";
+
+    v.emplace_back("vlan vid 0", false);
+    v.back().vlan = true;
+    v.back().vid = 0;
+
+    v.emplace_back("vlan vid 4095", false);
+    v.back().vlan = true;
+    v.back().vid = 4095;
+
+    v.emplace_back("arp", false);
+    v.back().type = ETHERTYPE_ARP;
+
+    v.emplace_back("udp teredo port", false);
+    v.back().proto = IPPROTO_UDP;
+    v.back().dp = 3544;
+
+    v.emplace_back("udp big payload", false);
+    v.back().proto = IPPROTO_UDP;
+    v.back().payload = 4001;
+
+    v.emplace_back("truncated", false);
+    v.back().cut = 4;
+
+    return v;
+}
+
+TEST_CASE("fast decode matches codecs", "[PacketManager]")
+{
+    if ( !PacketManager::test_init() )
+    {
+        WARN("fast decode not enabled; eth, vlan, ip, tcp, or udp codec missing");
+        return;
+    }
+    Packet* p = PacketManager::encode_new(false);
+    Packet* q = PacketManager::encode_new(false);
+
+    Frame* fr = new Frame;
+
+    for ( const auto& f : get_specs() )
+    {
+        INFO(f.name);
+        build(f, *fr);
+
+        CHECK(PacketManager::test_decode(p, q, &fr->hdr, fr->buf) == f.accept);
+        check_same(p, q);
+    }
+    delete fr;
+
+    // not allocated by encode_new()
+    p->pkth = q->pkth = nullptr;
+    PacketManager::encode_delete(p);
+    PacketManager::encode_delete(q);
+}
+
+#endif
@@ -146,12 +146,34 @@ public:
     static uint8_t proto_id(uint16_t proto)
     { return CodecManager::s_proto_map[proto]; }
 
+#ifdef UNIT_TEST
+    // set this thread up to decode ethernet; true if the fast path is on
+    static bool test_init();
+
+    // decode() into p and decode with the codecs only into q; returns
+    // true if the fast path took the packet
+    static bool test_decode(
+        Packet* p, Packet* q, const struct _daq_pkthdr*, const uint8_t*);
+#endif
+
 private:
     // The only time we should accumulate is when CodecManager tells us too
+    friend void CodecManager::thread_init(SnortConfig*);
     friend void CodecManager::thread_term();
+    static void thread_init();
+    static void thread_term();
     static void accumulate();
     static void pop_teredo(Packet*, RawData&);
 
+    // decode with the codecs, layer by layer
+    static void decode_layers(Packet*, bool cooked);
+
+    // decode plain eth/[vlan]/ip4|ip6/tcp|udp inline; returns false (with
+    // the packet in an undefined state) on anything the codecs would treat
+    // as other than routine.
+    static bool fast_decode(Packet*);
+    static void check_fast_decode(const Packet*);
+
     static bool encode(const Packet* p, EncodeFlags,
         uint8_t lyr_start, uint8_t next_prot, Buffer& buf);
 
@@ -160,7 +182,8 @@ private:
     static const uint8_t total_processed = 0;
     static const uint8_t other_codecs = 1;
     static const uint8_t discards = 2;
-    static const uint8_t stat_offset = 3;
+    static const uint8_t fast_path = 3;
+    static const uint8_t stat_offset = 4;
 
     // declared in header so it can access s_protocols
     static THREAD_LOCAL std::array<PegCount, stat_offset +
@@ -151,6 +151,12 @@
 #include <string.h>
 #include <ctype.h>
 
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #define BNFA_TRACK_Q
 
 #ifdef BNFA_TRACK_Q
@@ -690,7 +696,7 @@ static int _bnfa_add_pattern_states(bnfa_struct_t* bnfa, bnfa_pattern_t* p)
 
     bnfa->bnfaMatchList[state] = pmn;
 
-    return 0;
+    return state;
 }
 
 #ifdef XXXXX
@@ -824,8 +830,10 @@ static int _bnfa_opt_nfa(bnfa_struct_t* bnfa)
 /*
 *   Build a non-deterministic finite automata using Aho-Corasick construction
 *   The keyword trie must already be built via _bnfa_add_pattern_states()
+*   The states whose match lists are merged with their failure states are
+*   appended to merges, if given, as state, failure state pairs.
 */
-static int _bnfa_build_nfa(bnfa_struct_t* bnfa)
+static int _bnfa_build_nfa(bnfa_struct_t* bnfa, std::vector<int>* merges)
 {
     int r, s, i;
     QUEUE q, * queue = &q;
@@ -891,6 +899,12 @@ static int _bnfa_build_nfa(bnfa_struct_t* bnfa)
             */
             FailState[s] = next;
 
+            if ( merges && MatchList[next] )
+            {
+                merges->push_back(s);
+                merges->push_back(next);
+            }
+
             /*
             *  Copy 'next'states MatchList into 's' states MatchList,
             *  we just create a new list nodes, the patterns are not copied.
@@ -1319,6 +1333,151 @@ void bnfaPrint(bnfa_struct_t* bnfa)
     }
 }
 
+/*
+*  Shared transitions
+*
+*  The compacted transition list depends only on the pattern bytes and the
+*  build options, so it is kept in a table keyed by those and reused by any
+*  later state machine built from the same input - in particular the port
+*  groups that didn't change when the rules are reloaded.  Only the match
+*  lists, which point at the user data of each instance, are rebuilt.
+*/
+struct bnfa_shared_s
+{
+    bnfa_state_t* trans;
+    int num_states;
+    int num_trans;
+    int max_states;
+    unsigned refs;
+    std::vector<int> final_states;  /* per pattern, in list order */
+    std::vector<int> merges;        /* see _bnfa_build_nfa() */
+    std::string key;
+};
+
+static std::mutex shared_mutex;
+static std::unordered_map<std::string, bnfa_shared_t*> shared_table;
+static unsigned summary_shared = 0;
+
+static void _bnfa_get_key(bnfa_struct_t* bnfa, std::string& key)
+{
+    int opts[] =
+    {
+        bnfa->bnfaCaseMode, bnfa->bnfaFormat, bnfa->bnfaAlphabetSize,
+        bnfa->bnfaOpt, bnfa->bnfaForceFullZeroState
+    };
+    key.assign((const char*)opts, sizeof(opts));
+
+    for ( bnfa_pattern_t* p = bnfa->bnfaPatterns; p; p = p->next )
+    {
+        key.append((const char*)&p->n, sizeof(p->n));
+        key.append((const char*)p->casepatrn, p->n);
+    }
+}
+
+/* build the match lists over the shared transitions if there are some */
+static int _bnfa_adopt(bnfa_struct_t* bnfa, const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    auto it = shared_table.find(key);
+
+    if ( it == shared_table.end() )
+        return 0;
+
+    bnfa_shared_t* sh = it->second;
+
+    bnfa->bnfaMatchList = (bnfa_match_node_t**)BNFA_MALLOC(
+        sizeof(void*) * sh->num_states, bnfa->matchlist_memory);
+
+    if ( !bnfa->bnfaMatchList )
+        return -1;
+
+    /* so bnfaFree() can clean up if we run out of memory */
+    bnfa->bnfaNumStates = sh->num_states;
+
+    /* same order as _bnfa_add_pattern_states() so matches are reported
+       in the same order as with a fresh compile */
+    unsigned i = 0;
+
+    for ( bnfa_pattern_t* p = bnfa->bnfaPatterns; p; p = p->next, ++i )
+    {
+        bnfa_match_node_t* pmn = (bnfa_match_node_t*)BNFA_MALLOC(
+            sizeof(bnfa_match_node_t), bnfa->matchlist_memory);
+
+        if ( !pmn )
+            return -1;
+
+        int state = sh->final_states[i];
+        pmn->data = p;
+        pmn->next = bnfa->bnfaMatchList[state];
+        bnfa->bnfaMatchList[state] = pmn;
+    }
+
+    /* and add the matches of the failure states as _bnfa_build_nfa() does */
+    for ( unsigned j = 0; j < sh->merges.size(); j += 2 )
+    {
+        bnfa_match_node_t** ml = bnfa->bnfaMatchList;
+        int s = sh->merges[j], fs = sh->merges[j+1];
+
+        for ( bnfa_match_node_t* mn = ml[fs]; mn; mn = mn->next )
+        {
+            bnfa_match_node_t* px = (bnfa_match_node_t*)BNFA_MALLOC(
+                sizeof(bnfa_match_node_t), bnfa->matchlist_memory);
+
+            if ( !px )
+                return -1;
+
+            px->data = mn->data;
+            px->next = ml[s];
+            ml[s] = px;
+        }
+    }
+
+    bnfa->bnfaNumTrans = sh->num_trans;
+    bnfa->bnfaMaxStates = sh->max_states;
+    bnfa->bnfaTransList = sh->trans;
+    bnfa->bnfaShared = sh;
+
+    sh->refs++;
+    summary_shared++;
+
+    return 1;
+}
+
+static void _bnfa_share(
+    bnfa_struct_t* bnfa, std::string& key, std::vector<int>& final_states,
+    std::vector<int>& merges)
+{
+    std::lock_guard<std::mutex> lock(shared_mutex);
+
+    if ( shared_table.find(key) != shared_table.end() )
+        return;
+
+    bnfa_shared_t* sh = new bnfa_shared_t;
+    sh->trans = bnfa->bnfaTransList;
+    sh->num_states = bnfa->bnfaNumStates;
+    sh->num_trans = bnfa->bnfaNumTrans;
+    sh->max_states = bnfa->bnfaMaxStates;
+    sh->refs = 1;
+    sh->final_states.swap(final_states);
+    sh->merges.swap(merges);
+    sh->key.swap(key);
+
+    shared_table[sh->key] = sh;
+    bnfa->bnfaShared = sh;
+}
+
+static void _bnfa_release(bnfa_shared_t* sh)
+{
+    std::lock_guard<std::mutex> lock(shared_mutex);
+
+    if ( --sh->refs )
+        return;
+
+    shared_table.erase(sh->key);
+    free(sh->trans);  /* owner's memory tracker is gone by now */
+    delete sh;
+}
+
 /*
 *  Create a new AC state machine
 */
@@ -1428,8 +1587,11 @@ void bnfaFree(bnfa_struct_t* bnfa)
         bnfa->matchlist_memory);
     BNFA_FREE(bnfa->bnfaNextState,bnfa->bnfaNumStates*sizeof(bnfa_state_t*),
         bnfa->nextstate_memory);
-    BNFA_FREE(bnfa->bnfaTransList,(2*bnfa->bnfaNumStates+bnfa->bnfaNumTrans)*sizeof(bnfa_state_t*),
-        bnfa->nextstate_memory);
+    if ( bnfa->bnfaShared )
+        _bnfa_release(bnfa->bnfaShared);
+    else
+        BNFA_FREE(bnfa->bnfaTransList,(2*bnfa->bnfaNumStates+bnfa->bnfaNumTrans)*sizeof(bnfa_state_t*),
+            bnfa->nextstate_memory);
     free(bnfa);   /* cannot update memory tracker when deleting bnfa so just 'free' it !*/
 }
 
@@ -1482,8 +1644,35 @@ static inline int _bnfaCompile(bnfa_struct_t* bnfa)
     unsigned cntMatchStates;
     int i;
 
+    std::string key;
+    std::vector<int> final_states;
+    std::vector<int> merges;
+
     queue_memory =0;
 
+    if ( bnfa->bnfaFormat == BNFA_SPARSE )
+    {
+        _bnfa_get_key(bnfa, key);
+        int rval = _bnfa_adopt(bnfa, key);
+
+        if ( rval < 0 )
+            return -1;
+
+        if ( rval )
+        {
+            bnfa->bnfaMatchStates = 0;
+
+            for (i=0; i<bnfa->bnfaNumStates; i++)
+            {
+                if ( bnfa->bnfaMatchList[i] )
+                    bnfa->bnfaMatchStates++;
+            }
+            bnfaAccumInfo(bnfa);
+            return 0;
+        }
+        final_states.reserve(bnfa->bnfaPatternCnt);
+    }
+
     /* Count number of states */
     for (plist = bnfa->bnfaPatterns; plist != NULL; plist = plist->next)
     {
@@ -1511,7 +1700,10 @@ static inline int _bnfaCompile(bnfa_struct_t* bnfa)
     bnfa->bnfaNumStates = 0;
     for (plist = bnfa->bnfaPatterns; plist != NULL; plist = plist->next)
     {
-        _bnfa_add_pattern_states (bnfa, plist);
+        int state = _bnfa_add_pattern_states (bnfa, plist);
+
+        if ( bnfa->bnfaFormat == BNFA_SPARSE )
+            final_states.push_back(state);
     }
     bnfa->bnfaNumStates++;
 
@@ -1563,7 +1755,7 @@ static inline int _bnfaCompile(bnfa_struct_t* bnfa)
 #endif
 
     /* Build the nfa w/failure states - time the nfa construction */
-    if ( _bnfa_build_nfa (bnfa) )
+    if ( _bnfa_build_nfa (bnfa, bnfa->bnfaFormat == BNFA_SPARSE ? &merges : nullptr) )
     {
         return -1;
     }
@@ -1607,6 +1799,11 @@ static inline int _bnfaCompile(bnfa_struct_t* bnfa)
     bnfa->bnfaMatchStates = cntMatchStates;
     bnfa->queue_memory    = queue_memory;
 
+    /* can't share a machine that is missing any patterns */
+    if ( bnfa->bnfaFormat == BNFA_SPARSE &&
+        std::find(final_states.begin(), final_states.end(), -1) == final_states.end() )
+        _bnfa_share(bnfa, key, final_states, merges);
+
     bnfaAccumInfo(bnfa);
 
     return 0;
@@ -2521,11 +2718,15 @@ void bnfaPrintInfo(bnfa_struct_t* p)
 void bnfaPrintSummary(void)
 {
     bnfaPrintInfoEx(&summary);
+
+    if ( summary.bnfaNumStates )
+        LogCount("shared instances", summary_shared);
 }
 
 void bnfaInitSummary(void)
 {
     summary_cnt=0;
+    summary_shared=0;
     memset(&summary,0,sizeof(bnfa_struct_t));
 }
 
@@ -113,6 +113,12 @@ enum
     BNFA_NOCASE
 };
 
+/*
+*  Compiled transitions shared by all state machines built from the
+*  same patterns, eg a port group that is unchanged across a reload
+*/
+typedef struct bnfa_shared_s bnfa_shared_t;
+
 /*
 *   Aho-Corasick State Machine Struct
 */
@@ -139,6 +145,7 @@ typedef struct
     bnfa_state_t* bnfaFailState;
 
     bnfa_state_t* bnfaTransList;
+    bnfa_shared_t* bnfaShared;
     int bnfaForceFullZeroState;
 
     int bnfa_memory;
@@ -612,7 +612,7 @@ int HttpInspectMain(HTTPINSPECT_CONF* conf, Packet* p)
         // see comments on call to snort_detect() below
         PERF_PROFILE_BLOCK(hiDetectPerfStats)
         {
-            get_data_bus().publish(PACKET_EVENT, p);
+            get_data_bus().publish(PACKET_EVENT_ID, p);
 #ifdef PERF_PROFILING
             hiDetectCalled = 1;
 #endif
@@ -705,7 +705,7 @@ int HttpInspectMain(HTTPINSPECT_CONF* conf, Packet* p)
                 p->packet_flags |= PKT_HTTP_DECODE;
 
                 get_data_bus().publish(
-                    "http_uri", session->client.request.uri_norm,
+                    HTTP_URI_EVENT_ID, session->client.request.uri_norm,
                     session->client.request.uri_norm_size, p->flow);
             }
             else if ( session->client.request.uri )
@@ -724,7 +724,7 @@ int HttpInspectMain(HTTPINSPECT_CONF* conf, Packet* p)
                 p->packet_flags |= PKT_HTTP_DECODE;
 
                 get_data_bus().publish(
-                    "http_raw_uri", session->client.request.uri,
+                    HTTP_RAW_URI_EVENT_ID, session->client.request.uri,
                     session->client.request.uri_size, p->flow);
             }
 
@@ -25,6 +25,7 @@
 #include "detection/detection_util.h"
 #include "file_api/file_service.h"
 #include "file_api/file_flows.h"
+#include "time/ppm.h"
 
 #include "nhttp_msg_request.h"
 #include "nhttp_msg_header.h"
@@ -138,6 +139,11 @@ void NHttpMsgHeader::prepare_body()
         params->response_depth;
     session_data->detect_depth_remaining[source_id] = (depth != -1) ? depth : INT64_MAX;
     setup_file_processing();
+#ifdef PPM_MGR
+    if (PPM_LOAD_LEVEL() >= PPM_LOAD_SHALLOW)
+        ppm_load_shallow(session_data->detect_depth_remaining[source_id],
+            session_data->file_depth_remaining[source_id]);
+#endif
     setup_decompression();
     update_depth();
     session_data->infractions[source_id].reset();
@@ -286,7 +286,7 @@ static RpcStatus RpcStatefulInspection(RpcDecodeConfig* rconfig,
                     if (RpcPrepRaw(data, rsdata->frag_len, p) != RPC_STATUS__SUCCESS)
                         return RPC_STATUS__ERROR;
 
-                    get_data_bus().publish(PACKET_EVENT, p);
+                    get_data_bus().publish(PACKET_EVENT_ID, p);
                 }
 
                 if ( (dsize > 0) )
@@ -371,7 +371,7 @@ static RpcStatus RpcStatefulInspection(RpcDecodeConfig* rconfig,
                 if ( (dsize > 0) )
                     RpcPreprocEvent(rconfig, rsdata, RPC_MULTIPLE_RECORD);
 
-                get_data_bus().publish(PACKET_EVENT, p);
+                get_data_bus().publish(PACKET_EVENT_ID, p);
                 RpcBufClean(&rsdata->frag);
             }
 
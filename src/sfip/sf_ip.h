@@ -446,6 +446,10 @@ static inline bool sfip_fast_cont4(const sfip_t* ip1, const sfip_t* ip2)
     u_int32_t shift = 32 - sfip_bits(ip1);
     u_int32_t ip = ntohl(*ip2->ip32);
 
+    // shifting by 32 is undefined; /0 contains everything
+    if ( shift >= 32 )
+        return true;
+
     ip >>= shift;
     ip <<= shift;
 
@@ -31,6 +31,9 @@
 #include <ctype.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "utils/util.h"
 #include "sfip/sf_vartable.h"
 
@@ -40,6 +43,7 @@
 static SFIP_RET sfvar_list_compare(sfip_node_t*, sfip_node_t*);
 static inline void sfip_node_free(sfip_node_t*);
 static inline void sfip_node_freelist(sfip_node_t*);
+static void sfvar_free_table(sfip_var_t*);
 
 static inline sfip_var_t* _alloc_var(void)
 {
@@ -57,15 +61,9 @@ void sfvar_free(sfip_var_t* var)
     if (var->value)
         free(var->value);
 
-    if (var->mode == SFIP_LIST)
-    {
-        sfip_node_freelist(var->head);
-        sfip_node_freelist(var->neg_head);
-    }
-    else if (var->mode == SFIP_TABLE)
-    {
-        // XXX
-    }
+    sfip_node_freelist(var->head);
+    sfip_node_freelist(var->neg_head);
+    sfvar_free_table(var);
 
     free(var);
 }
@@ -190,6 +188,8 @@ SFIP_RET sfvar_add(sfip_var_t* dst, sfip_var_t* src)
     if (!dst || !src)
         return SFIP_ARG_ERR;
 
+    sfvar_free_table(dst);
+
     oldhead = dst->head;
     oldneg = dst->neg_head;
 
@@ -239,9 +239,9 @@ SFIP_RET sfvar_add_node(sfip_var_t* var, sfip_node_t* node, int negated)
     if (!var || !node)
         return SFIP_ARG_ERR;
 
-    /* XXX */
-    /* As of this writing, 11/20/06, nodes are always added to
-     * the list, regardless of the mode (list or table). */
+    /* Nodes are always added to the list; a compiled table is dropped
+     * and must be rebuilt with sfvar_compile(). */
+    sfvar_free_table(var);
 
     if (negated)
         head = &var->neg_head;
@@ -289,9 +289,6 @@ SFIP_RET sfvar_add_node(sfip_var_t* var, sfip_node_t* node, int negated)
     p->next = node;
 
     return SFIP_SUCCESS;
-
-    /* XXX Insert new node into routing table */
-//    sfrt_add(node->ip,
 }
 
 static SFIP_RET sfvar_list_compare(sfip_node_t* list1, sfip_node_t* list2)
@@ -427,6 +424,8 @@ static void _negate_lists(sfip_var_t* var)
     for (node = var->neg_head; node; node=node->next)
         _negate_node(node);
 
+    sfvar_free_table(var);
+
     /* Swap lists */
     temp = var->head;
     var->head = var->neg_head;
@@ -635,6 +634,7 @@ sfip_var_t* sfvar_create_alias(const sfip_var_t* alias_from, const char* alias_t
     ret->name = SnortStrdup(alias_to);
     ret->id = alias_from->id;
 
+    sfvar_compile(ret);
     return ret;
 }
 
@@ -774,6 +774,7 @@ sfip_var_t* sfvar_alloc(vartable_t* table, const char* variable, SFIP_RET* statu
         return NULL;
     }
 
+    sfvar_compile(ret);
     return ret;
 }
 
@@ -823,7 +824,7 @@ sfip_var_t* sfvar_deep_copy(const sfip_var_t* var)
 
     ret = (sfip_var_t*)SnortAlloc(sizeof(sfip_var_t));
 
-    ret->mode = var->mode;
+    ret->mode = SFIP_LIST;
     ret->head = _sfvar_deep_copy_list(var->head);
     ret->neg_head = _sfvar_deep_copy_list(var->neg_head);
 
@@ -968,6 +969,288 @@ static inline int _sfvar_ip_in6(sfip_var_t* var, const sfip_t* ip)
     return 0;
 }
 
+//-------------------------------------------------------------------------
+// compiled ranges
+//-------------------------------------------------------------------------
+
+/* The positive list less the negative list is flattened into sorted,
+ * disjoint, inclusive ranges per family so a lookup is a binary search
+ * regardless of how the variable was written.  The semantics of the list
+ * walk above are kept: a node only matches when its address has no bits
+ * set past its prefix, an unset positive ("any") matches all addresses,
+ * and with no positives only the negations apply. */
+
+struct sfip_key6_t
+{
+    uint64_t hi;
+    uint64_t lo;
+};
+
+static inline bool operator<(const sfip_key6_t& a, const sfip_key6_t& b)
+{ return a.hi < b.hi or (a.hi == b.hi and a.lo < b.lo); }
+
+static inline bool operator==(const sfip_key6_t& a, const sfip_key6_t& b)
+{ return a.hi == b.hi and a.lo == b.lo; }
+
+static inline bool operator<=(const sfip_key6_t& a, const sfip_key6_t& b)
+{ return !(b < a); }
+
+template<typename Key>
+struct sfip_range_t
+{
+    Key lo;
+    Key hi;
+};
+
+struct sfip_table_t
+{
+    std::vector< sfip_range_t<uint32_t> > v4;
+    std::vector< sfip_range_t<sfip_key6_t> > v6;
+};
+
+static inline uint32_t _key_max(uint32_t)
+{ return 0xFFFFFFFF; }
+
+static inline uint32_t _key_next(uint32_t k)
+{ return k + 1; }
+
+static inline uint32_t _key_prev(uint32_t k)
+{ return k - 1; }
+
+static inline sfip_key6_t _key_max(const sfip_key6_t&)
+{ return { ~(uint64_t)0, ~(uint64_t)0 }; }
+
+static inline sfip_key6_t _key_next(sfip_key6_t k)
+{
+    if ( !++k.lo )
+        ++k.hi;
+    return k;
+}
+
+static inline sfip_key6_t _key_prev(sfip_key6_t k)
+{
+    if ( !k.lo-- )
+        --k.hi;
+    return k;
+}
+
+static inline sfip_key6_t _key6(const sfip_t* ip)
+{
+    sfip_key6_t k;
+    k.hi = ((uint64_t)ntohl(ip->ip32[0]) << 32) | ntohl(ip->ip32[1]);
+    k.lo = ((uint64_t)ntohl(ip->ip32[2]) << 32) | ntohl(ip->ip32[3]);
+    return k;
+}
+
+static inline uint64_t _mask64(int bits)
+{
+    if ( bits <= 0 )
+        return 0;
+
+    if ( bits >= 64 )
+        return ~(uint64_t)0;
+
+    return ~(uint64_t)0 << (64 - bits);
+}
+
+/* Returns false if the node can't match anything of its family */
+static bool _node_range4(const sfip_t* ip, sfip_range_t<uint32_t>& r)
+{
+    int bits = sfip_bits(ip);
+
+    if ( bits < 0 || bits > 32 )
+        return false;
+
+    uint32_t mask = bits ? 0xFFFFFFFF << (32 - bits) : 0;
+    uint32_t addr = ntohl(ip->ip32[0]);
+
+    if ( !bits )
+        addr = 0;
+
+    else if ( addr & ~mask )
+        return false;
+
+    r.lo = addr;
+    r.hi = addr | ~mask;
+    return true;
+}
+
+static bool _node_range6(const sfip_t* ip, sfip_range_t<sfip_key6_t>& r)
+{
+    int bits = sfip_bits(ip);
+
+    if ( bits < 0 || bits > 128 )
+        return false;
+
+    sfip_key6_t addr = _key6(ip);
+    uint64_t mhi = _mask64(bits);
+    uint64_t mlo = _mask64(bits - 64);
+
+    if ( (addr.hi & ~mhi) || (addr.lo & ~mlo) )
+        return false;
+
+    r.lo = addr;
+    r.hi = { addr.hi | ~mhi, addr.lo | ~mlo };
+    return true;
+}
+
+/* Sorts and coalesces overlapping or adjacent ranges */
+template<typename Key>
+static void _merge(std::vector< sfip_range_t<Key> >& v)
+{
+    if ( v.empty() )
+        return;
+
+    std::sort(v.begin(), v.end(),
+        [](const sfip_range_t<Key>& a, const sfip_range_t<Key>& b)
+        { return a.lo < b.lo; });
+
+    unsigned n = 0;
+
+    for ( unsigned i = 1; i < v.size(); ++i )
+    {
+        sfip_range_t<Key>& cur = v[n];
+
+        if ( cur.hi == _key_max(cur.hi) || v[i].lo <= _key_next(cur.hi) )
+        {
+            if ( cur.hi < v[i].hi )
+                cur.hi = v[i].hi;
+        }
+        else
+            v[++n] = v[i];
+    }
+    v.resize(n + 1);
+}
+
+/* Both inputs merged; returns pos less neg */
+template<typename Key>
+static std::vector< sfip_range_t<Key> > _subtract(
+    const std::vector< sfip_range_t<Key> >& pos,
+    const std::vector< sfip_range_t<Key> >& neg)
+{
+    std::vector< sfip_range_t<Key> > out;
+    unsigned j = 0;
+
+    for ( auto r : pos )
+    {
+        while ( j < neg.size() && neg[j].hi < r.lo )
+            ++j;
+
+        unsigned k = j;
+        bool done = false;
+
+        for ( ; k < neg.size() && neg[k].lo <= r.hi; ++k )
+        {
+            if ( r.lo < neg[k].lo )
+                out.push_back({ r.lo, _key_prev(neg[k].lo) });
+
+            if ( !(neg[k].hi < r.hi) )
+            {
+                done = true;
+                break;
+            }
+            r.lo = _key_next(neg[k].hi);
+        }
+        if ( !done )
+            out.push_back(r);
+    }
+    return out;
+}
+
+template<typename Key>
+static inline bool _range_in(const std::vector< sfip_range_t<Key> >& v, const Key& k)
+{
+    auto it = std::upper_bound(v.begin(), v.end(), k,
+        [](const Key& key, const sfip_range_t<Key>& r)
+        { return key < r.lo; });
+
+    if ( it == v.begin() )
+        return false;
+
+    return !((it - 1)->hi < k);
+}
+
+void sfvar_compile(sfip_var_t* var)
+{
+    if (!var)
+        return;
+
+    sfvar_free_table(var);
+
+    std::vector< sfip_range_t<uint32_t> > pos4, neg4;
+    std::vector< sfip_range_t<sfip_key6_t> > pos6, neg6;
+    sfip_range_t<uint32_t> r4;
+    sfip_range_t<sfip_key6_t> r6;
+    bool any = !var->head;
+
+    for (sfip_node_t* p = var->head; p && !any; p = p->next)
+    {
+        if (!p->ip || !sfip_is_set(p->ip))
+            any = true;
+
+        else if (sfip_family(p->ip) == AF_INET)
+        {
+            if ( _node_range4(p->ip, r4) )
+                pos4.push_back(r4);
+        }
+        else if (sfip_family(p->ip) == AF_INET6)
+        {
+            if ( _node_range6(p->ip, r6) )
+                pos6.push_back(r6);
+        }
+    }
+
+    if (any)
+    {
+        pos4.assign(1, { 0, _key_max(uint32_t()) });
+        pos6.assign(1, { { 0, 0 }, _key_max(sfip_key6_t()) });
+    }
+
+    for (sfip_node_t* p = var->neg_head; p; p = p->next)
+    {
+        if (!p->ip)
+            continue;
+
+        else if (sfip_family(p->ip) == AF_INET)
+        {
+            if ( _node_range4(p->ip, r4) )
+                neg4.push_back(r4);
+        }
+        else if (sfip_family(p->ip) == AF_INET6)
+        {
+            if ( _node_range6(p->ip, r6) )
+                neg6.push_back(r6);
+        }
+    }
+
+    _merge(pos4);
+    _merge(neg4);
+    _merge(pos6);
+    _merge(neg6);
+
+    sfip_table_t* t = new sfip_table_t;
+    t->v4 = _subtract(pos4, neg4);
+    t->v6 = _subtract(pos6, neg6);
+
+    var->table = t;
+    var->mode = SFIP_TABLE;
+}
+
+static void sfvar_free_table(sfip_var_t* var)
+{
+    delete var->table;
+    var->table = nullptr;
+    var->mode = SFIP_LIST;
+}
+
+static inline int _sfvar_table_in(const sfip_table_t* t, const sfip_t* ip)
+{
+    if (sfip_family(ip) == AF_INET)
+        return _range_in(t->v4, ntohl(ip->ip32[0]));
+
+    return _range_in(t->v6, _key6(ip));
+}
+
 /* Returns SFIP_SUCCESS if ip is contained in 'var', SFIP_FAILURE otherwise
    If either argument is NULL, SFIP_ARG_ERR is returned. */
 int sfvar_ip_in(sfip_var_t* var, const sfip_t* ip)
@@ -975,14 +1258,9 @@ int sfvar_ip_in(sfip_var_t* var, const sfip_t* ip)
     if (!var || !ip)
         return 0;
 
-#if 0
     if (var->mode == SFIP_TABLE)
-    {
-        // XXX
-    }
-    else
-    {
-#endif
+        return _sfvar_table_in(var->table, ip);
+
     /* Since this is a performance-critical function it uses different
      * codepaths for IPv6 and IPv4 traffic, rather than the dual-stack
      * functions. */
@@ -995,10 +1273,6 @@ int sfvar_ip_in(sfip_var_t* var, const sfip_t* ip)
     {
         return _sfvar_ip_in6(var, ip);
     }
-#if 0
-}
-
-#endif
 }
 
 void sfip_set_print(const char* prefix, sfip_node_t* p)
@@ -1055,23 +1329,16 @@ void sfvar_print(const char* prefix, sfip_var_t* var)
         return;
     }
 
-    if (var->mode == SFIP_LIST)
+    if (var->head->flags & SFIP_ANY)
     {
-        if (var->head->flags & SFIP_ANY)
-        {
-            if (prefix)
-                LogMessage("%sany\n", prefix);
-            else
-                LogMessage("any\n");
-        }
+        if (prefix)
+            LogMessage("%sany\n", prefix);
         else
-        {
-            sfip_set_print(prefix, var->head);
-        }
+            LogMessage("any\n");
     }
-    else if (var->mode == SFIP_TABLE)
+    else
     {
-        // XXX
+        sfip_set_print(prefix, var->head);
     }
 }
 
@@ -1102,18 +1369,11 @@ void sfvar_print_to_file(FILE* f, sfip_var_t* var)
 
     fprintf(f, "Name: %s\n", var->name);
 
-    if (var->mode == SFIP_LIST)
-    {
-        if (var->head->flags & SFIP_ANY)
-            fprintf(f, "\t%p: <any>\n", (void*)var->head);
-        else
-        {
-            sfip_set_print_to_file(f, var->head);
-        }
-    }
-    else if (var->mode == SFIP_TABLE)
+    if (var->head->flags & SFIP_ANY)
+        fprintf(f, "\t%p: <any>\n", (void*)var->head);
+    else
     {
-        // XXX
+        sfip_set_print_to_file(f, var->head);
     }
 }
 
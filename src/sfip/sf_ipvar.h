@@ -37,7 +37,8 @@
 #include "sfip/sf_ip.h"
 
 /* Selects which mode a given variable is using to
- * store and lookup IP addresses */
+ * lookup IP addresses.  The lists are always kept; SFIP_TABLE means
+ * they were also compiled into sorted address ranges. */
 typedef enum _modes
 {
     SFIP_LIST,
@@ -58,6 +59,9 @@ typedef struct _ip_node
                     /* Should merge them later */
 } sfip_node_t;
 
+/* Disjoint address ranges compiled from the lists */
+struct sfip_table_t;
+
 /* An IP variable onkect */
 struct sfip_var_t
 {
@@ -70,8 +74,8 @@ struct sfip_var_t
     sfip_node_t* neg_head;
 
     /* The mode above will select whether to use the sfip_node_t linked list
-     * or the IP routing table */
-//    sfrt rt;
+     * or the compiled ranges */
+    sfip_table_t* table;
 
     /* Linked list of IP variables for the variable table */
     sfip_var_t* next;
@@ -122,6 +126,11 @@ SFIP_RET sfvar_add_node(sfip_var_t* dst, sfip_node_t* src, int negated);
 /* Compares two variables.  Necessary when building RTN structure */
 SFIP_RET sfvar_compare(const sfip_var_t* one, const sfip_var_t* two);
 
+/* Compiles the lists into ranges so that lookups no longer depend on the
+   number of nodes.  Done once the variable is fully parsed; any later add
+   reverts the variable to list mode until compiled again. */
+void sfvar_compile(sfip_var_t* var);
+
 /* Deep copy. Returns identical, new, linked list of sfipnodes. */
 sfip_var_t* sfvar_deep_copy(const sfip_var_t* src);
 
@@ -30,6 +30,8 @@
 
 #include "main/snort_types.h"
 #include "sf_ip.h"
+#include "sf_ipvar.h"
+#include "sf_vartable.h"
 
 //---------------------------------------------------------------
 
@@ -480,3 +482,108 @@ TEST_CASE("sfip raw", "[sfip]")
         CHECK(RawCheck(i) == 1);
 }
 
+//---------------------------------------------------------------
+// compiled variables must agree with the list walk
+
+static const char* const vars[] =
+{
+    "v 10.0.0.0/8",
+    "v [10.0.0.0/8,!10.1.2.0/24]",
+    "v !10.0.0.0/8",
+    "v [!10.0.0.0/8,!192.168.0.0/16]",
+    "v any",
+    "v [any,!172.16.0.0/12]",
+    "v [1.2.3.4,1.2.3.5,1.2.3.6,10.0.0.0/9,10.128.0.0/9]",
+    "v [10.0.0.0/8,![10.1.0.0/16,10.2.0.0/16],11.1.2.0/24]",
+    "v [2001:db8::/32,!2001:db8:1::/48,10.0.0.0/8]",
+    "v [!2001:db8::/32,!10.0.0.0/8]",
+    "v [::1,fe80::/10,0.0.0.0/0]",
+    "v [$NET,!10.1.2.0/24]",
+    "v [10.0.0.0/8,!$NET]",
+};
+
+static const char* const addrs[] =
+{
+    "0.0.0.0", "9.255.255.255", "10.0.0.0", "10.1.1.255", "10.1.2.0",
+    "10.1.2.255", "10.1.3.0", "10.2.0.1", "10.255.255.255", "11.0.0.0",
+    "172.16.0.0", "172.31.255.255", "192.168.1.1", "1.2.3.4", "1.2.3.7",
+    "255.255.255.255", "::", "::1", "2001:db8::", "2001:db8:1::1",
+    "2001:db8:2::", "2001:db9::", "fe80::1", "febf:ffff::1", "fec0::",
+    "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff",
+};
+
+TEST_CASE("sfvar table", "[sfip]")
+{
+    vartable_t* vt = sfvt_alloc_table();
+    REQUIRE(sfvt_define(vt, "NET", "10.1.0.0/16") == SFIP_SUCCESS);
+
+    for ( auto v : vars )
+    {
+        SFIP_RET status;
+        sfip_var_t* table = sfvar_alloc(vt, v, &status);
+        INFO(v);
+        REQUIRE(table);
+        CHECK(table->mode == SFIP_TABLE);
+
+        sfip_var_t* list = sfvar_deep_copy(table);
+        REQUIRE(list);
+        CHECK(list->mode == SFIP_LIST);
+
+        for ( auto a : addrs )
+        {
+            sfip_t ip;
+            REQUIRE(sfip_pton(a, &ip) == SFIP_SUCCESS);
+            INFO(v << " / " << a);
+            CHECK(sfvar_ip_in(table, &ip) == sfvar_ip_in(list, &ip));
+        }
+
+        srand(0);
+
+        for ( unsigned i = 0; i < 10000; ++i )
+        {
+            sfip_t ip;
+            uint32_t a = ((uint32_t)rand() << 16) ^ rand();
+
+            // mostly around 10/8 to hit the edges of the ranges above
+            if ( i & 1 )
+                a = 0x0a000000 | (a & 0x00ffffff);
+
+            a = htonl(a);
+            REQUIRE(sfip_set_raw(&ip, &a, AF_INET) == SFIP_SUCCESS);
+            CHECK(sfvar_ip_in(table, &ip) == sfvar_ip_in(list, &ip));
+
+            // and 2001:db8:0-3::/64 for the ipv6 ranges
+            uint32_t a6[4] = { htonl(0x20010db8), htonl(rand() & 3), a, a };
+            REQUIRE(sfip_set_raw(&ip, a6, AF_INET6) == SFIP_SUCCESS);
+            CHECK(sfvar_ip_in(table, &ip) == sfvar_ip_in(list, &ip));
+        }
+        sfvar_free(list);
+        sfvar_free(table);
+    }
+    sfvt_free_table(vt);
+}
+
+TEST_CASE("sfvar table add", "[sfip]")
+{
+    vartable_t* vt = sfvt_alloc_table();
+    SFIP_RET status;
+    sfip_var_t* var = sfvar_alloc(vt, "v 10.0.0.0/8", &status);
+    REQUIRE(var);
+
+    sfip_t ip;
+    sfip_pton("192.168.1.1", &ip);
+    CHECK(!sfvar_ip_in(var, &ip));
+
+    sfip_node_t* node = sfipnode_alloc("192.168.0.0/16", &status);
+    REQUIRE(node);
+    CHECK(sfvar_add_node(var, node, 0) == SFIP_SUCCESS);
+    CHECK(var->mode == SFIP_LIST);
+    CHECK(sfvar_ip_in(var, &ip));
+
+    sfvar_compile(var);
+    CHECK(var->mode == SFIP_TABLE);
+    CHECK(sfvar_ip_in(var, &ip));
+    sfvar_free(var);
+    sfvt_free_table(vt);
+}
+
@@ -206,13 +206,30 @@ table_t* sfrt_new(char table_type, char ip_type, long data_size, uint32_t mem_ca
 
         break;
 
+    case POPTRIE:
+        /* leaves hold 24 bit data indices */
+        if (data_size > 0x1000000)
+        {
+            free(table->data);
+            free(table);
+            return NULL;
+        }
+        table->insert = sfrt_poptrie_insert;
+        table->lookup = sfrt_poptrie_lookup;
+        table->free = sfrt_poptrie_free;
+        table->usage = sfrt_poptrie_usage;
+        table->print = sfrt_poptrie_print;
+        table->remove = sfrt_poptrie_remove;
+
+        break;
+
     default:
         free(table->data);
         free(table);
         return NULL;
     }
 
-    /* Allocate the user-specified DIR-n-m table */
+    /* Allocate the user-specified DIR-n-m or Poptrie table */
     switch (table_type)
     {
     case DIR_24_8:
@@ -258,6 +275,10 @@ table_t* sfrt_new(char table_type, char ip_type, long data_size, uint32_t mem_ca
         table->rt6 = sfrt_dir_new(mem_cap, 16,
             8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8);
         break;
+    case POPTRIE:
+        table->rt = sfrt_poptrie_new(mem_cap, 32);
+        table->rt6 = sfrt_poptrie_new(mem_cap, 128);
+        break;
     }
 
     if ((!table->rt) || (!table->rt6))
@@ -353,6 +374,48 @@ GENERIC sfrt_lookup(sfip_t* ip, table_t* table)
     return table->data[tuple.index];
 }
 
+void sfrt_lookup_batch(sfip_t* const* ips, unsigned n, table_t* table, GENERIC* out)
+{
+    unsigned i;
+
+    if (!table || table->table_type != POPTRIE)
+    {
+        for (i = 0; i < n; i++)
+            out[i] = sfrt_lookup(ips[i], table);
+        return;
+    }
+
+    /* Batch runs of the same family; each family has its own trie */
+    for (i = 0; i < n; )
+    {
+        tuple_t tuples[16];
+        unsigned j, m = 0;
+        void* rt;
+
+        if (ips[i]->family == AF_INET)
+            rt = table->rt;
+        else if (ips[i]->family == AF_INET6)
+            rt = table->rt6;
+        else
+        {
+            out[i++] = NULL;
+            continue;
+        }
+
+        while (i + m < n && m < 16 && ips[i + m]->family == ips[i]->family)
+            m++;
+
+        sfrt_poptrie_lookup_batch(ips + i, m, rt, tuples);
+
+        for (j = 0; j < m; j++)
+        {
+            out[i + j] = (tuples[j].index < table->max_size) ?
+                table->data[tuples[j].index] : NULL;
+        }
+        i += m;
+    }
+}
+
 void sfrt_iterate(table_t* table, sfrt_iterator_callback userfunc)
 {
     uint32_t index, count;
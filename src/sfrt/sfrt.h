@@ -43,6 +43,7 @@ struct tuple_t
 };
 
 #include "sfrt/sfrt_dir.h"
+#include "sfrt/sfrt_poptrie.h"
 //#define SUPPORT_LCTRIE
 #ifdef SUPPORT_LCTRIE
 #include "sfrt/sfrt_lctrie.h"
@@ -64,6 +65,7 @@ enum types
     DIR_16x7_4x4,
     DIR_16x8,
     DIR_8x16,
+    POPTRIE,
     IPv4,
     IPv6
 };
@@ -124,6 +126,11 @@ table_t* sfrt_new(char type, char ip_type, long data_size, uint32_t mem_cap);
 void sfrt_free(table_t* table);
 GENERIC sfrt_lookup(sfip_t* ip, table_t* table);
 GENERIC sfrt_search(sfip_t* ip, unsigned char len, table_t* table);
+
+/* Looks up n addresses at once; out[i] is set to the result for ips[i].
+ * POPTRIE tables overlap the memory accesses of the lookups, others
+ * just loop. */
+void sfrt_lookup_batch(sfip_t* const* ips, unsigned n, table_t* table, GENERIC* out);
 typedef void (* sfrt_iterator_callback)(void*);
 struct SnortConfig;
 typedef void (* sfrt_sc_iterator_callback)(SnortConfig*, void*);
@@ -0,0 +1,505 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// sfrt_poptrie.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sfrt.h"  // FIXIT-L these includes are circular
+#include "sfrt_poptrie.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#ifdef __GNUC__
+#define pop_count(x) __builtin_popcountll(x)
+#define pop_prefetch(p) __builtin_prefetch(p)
+#else
+static inline unsigned pop_count(uint64_t x)
+{
+    unsigned n = 0;
+    for ( ; x; x &= x - 1 )
+        ++n;
+    return n;
+}
+#define pop_prefetch(p)
+#endif
+
+#define POP_TOP_BITS 16
+#define POP_TOP_SIZE (1 << POP_TOP_BITS)
+#define POP_MAX_DEPTH 22
+#define POP_BATCH 16
+
+// leaves are the sfrt tuple packed as index << 8 | length
+typedef uint32_t pop_leaf_t;
+
+#define POP_MAX_INDEX 0xFFFFFF
+
+struct pop_node_t
+{
+    uint64_t vector;    // slots with a child
+    uint64_t leafvec;   // slots that start a new leaf run
+    uint32_t base0;     // first leaf
+    uint32_t base1;     // first child
+};
+
+// the subtree under one top level slot is a single block of memory:
+// the nodes breadth first followed by the leaves
+struct pop_tree_t
+{
+    uint32_t num_nodes;
+    uint32_t num_leaves;
+    pop_node_t nodes[1];
+};
+
+// top level slots are either a leaf, tagged with bit 0, or a tree
+typedef uint64_t pop_top_t;
+
+struct pop_table_t
+{
+    dir_table_t* rib;
+    int bits;
+    uint8_t widths[POP_MAX_DEPTH];  // rib dimensions after the top level
+
+    pop_top_t* top;
+    uint32_t num_trees;
+    uint32_t allocated;  // compiled bytes
+
+    // build scratch
+    std::vector<pop_node_t> nodes;
+    std::vector<pop_leaf_t> leaves;
+    std::vector<const dir_sub_table_t*> subs;
+};
+
+// the address in host order, left justified in 128 bits
+struct pop_key_t
+{
+    uint64_t hi;
+    uint64_t lo;
+};
+
+static inline pop_key_t _pop_key(const sfip_t* ip)
+{
+    pop_key_t k;
+
+    if ( ip->family == AF_INET )
+    {
+        k.hi = (uint64_t)ntohl(ip->ip32[0]) << 32;
+        k.lo = 0;
+    }
+    else
+    {
+        k.hi = ((uint64_t)ntohl(ip->ip32[0]) << 32) | ntohl(ip->ip32[1]);
+        k.lo = ((uint64_t)ntohl(ip->ip32[2]) << 32) | ntohl(ip->ip32[3]);
+    }
+    return k;
+}
+
+// strides never straddle a 32 bit word
+static inline unsigned _pop_bits(const pop_key_t& k, unsigned pos, unsigned width)
+{
+    uint64_t mask = ((uint64_t)1 << width) - 1;
+
+    if ( pos < 64 )
+        return (k.hi >> (64 - pos - width)) & mask;
+
+    return (k.lo >> (128 - pos - width)) & mask;
+}
+
+// number of set bits in x at or below v; v < 64
+static inline unsigned _pop_rank(uint64_t x, unsigned v)
+{
+    return pop_count(x & ((((uint64_t)1 << v) << 1) - 1));
+}
+
+static inline const pop_leaf_t* _pop_leaves(const pop_tree_t* tree)
+{
+    return (const pop_leaf_t*)(tree->nodes + tree->num_nodes);
+}
+
+static inline pop_leaf_t _pop_leaf(word index, word length)
+{
+    return (pop_leaf_t)((index << 8) | length);
+}
+
+static inline tuple_t _pop_tuple(pop_leaf_t leaf)
+{
+    tuple_t ret;
+    ret.index = leaf >> 8;
+    ret.length = leaf & 0xFF;
+    return ret;
+}
+
+static inline bool _pop_is_leaf(pop_top_t top)
+{ return top & 1; }
+
+static inline const pop_tree_t* _pop_tree(pop_top_t top)
+{ return (const pop_tree_t*)top; }
+
+// returns the leaf for v in node or null after moving node to its child
+static inline const pop_leaf_t* _pop_step(
+    const pop_tree_t* tree, const pop_node_t*& node, unsigned v)
+{
+    if ( !(node->vector & ((uint64_t)1 << v)) )
+        return _pop_leaves(tree) + node->base0 + _pop_rank(node->leafvec, v) - 1;
+
+    node = tree->nodes + node->base1 + _pop_rank(node->vector, v) - 1;
+    return nullptr;
+}
+
+static inline tuple_t _pop_walk(
+    const pop_table_t* t, const pop_tree_t* tree, const pop_key_t& k)
+{
+    const pop_node_t* node = tree->nodes;
+    const uint8_t* width = t->widths;
+    unsigned pos = POP_TOP_BITS;
+
+    while ( true )
+    {
+        const pop_leaf_t* leaf = _pop_step(tree, node, _pop_bits(k, pos, *width));
+
+        if ( leaf )
+            return _pop_tuple(*leaf);
+
+        pos += *width++;
+    }
+}
+
+//-------------------------------------------------------------------------
+// compile rib to trie
+//-------------------------------------------------------------------------
+
+static inline bool _rib_is_child(const dir_sub_table_t* sub, unsigned i)
+{ return !sub->lengths[i] && sub->entries[i]; }
+
+static size_t _pop_tree_size(unsigned nodes, unsigned leaves)
+{
+    return offsetof(pop_tree_t, nodes) + nodes * sizeof(pop_node_t) +
+        leaves * sizeof(pop_leaf_t);
+}
+
+// breadth first so the children of each node are contiguous
+static pop_tree_t* _pop_build(pop_table_t* t, const dir_sub_table_t* root)
+{
+    t->nodes.clear();
+    t->leaves.clear();
+    t->subs.clear();
+
+    t->nodes.push_back({ 0, 0, 0, 0 });
+    t->subs.push_back(root);
+
+    for ( unsigned n = 0; n < t->subs.size(); ++n )
+    {
+        const dir_sub_table_t* sub = t->subs[n];
+        pop_node_t node = { 0, 0, (uint32_t)t->leaves.size(), (uint32_t)t->nodes.size() };
+        bool have_leaf = false;
+        pop_leaf_t last = 0;
+
+        assert(sub->num_entries <= 64);
+
+        for ( int i = 0; i < sub->num_entries; ++i )
+        {
+            if ( _rib_is_child(sub, i) )
+            {
+                node.vector |= (uint64_t)1 << i;
+                t->nodes.push_back({ 0, 0, 0, 0 });
+                t->subs.push_back((const dir_sub_table_t*)sub->entries[i]);
+                continue;
+            }
+            pop_leaf_t leaf = _pop_leaf(sub->entries[i], sub->lengths[i]);
+
+            if ( !have_leaf || leaf != last )
+            {
+                node.leafvec |= (uint64_t)1 << i;
+                t->leaves.push_back(leaf);
+                last = leaf;
+                have_leaf = true;
+            }
+        }
+        t->nodes[n] = node;
+    }
+
+    size_t size = _pop_tree_size(t->nodes.size(), t->leaves.size());
+    pop_tree_t* tree = (pop_tree_t*)malloc(size);
+
+    if ( !tree )
+        return nullptr;
+
+    tree->num_nodes = t->nodes.size();
+    tree->num_leaves = t->leaves.size();
+
+    memcpy(tree->nodes, t->nodes.data(), t->nodes.size() * sizeof(pop_node_t));
+    memcpy((pop_leaf_t*)_pop_leaves(tree), t->leaves.data(), t->leaves.size() * sizeof(pop_leaf_t));
+
+    t->allocated += size;
+    t->num_trees++;
+    return tree;
+}
+
+static void _pop_free_tree(pop_table_t* t, pop_top_t top)
+{
+    if ( _pop_is_leaf(top) )
+        return;
+
+    pop_tree_t* tree = (pop_tree_t*)top;
+    t->allocated -= _pop_tree_size(tree->num_nodes, tree->num_leaves);
+    t->num_trees--;
+    free(tree);
+}
+
+// rebuild the compiled form of top level slots [first, last)
+static int _pop_update(pop_table_t* t, unsigned first, unsigned last)
+{
+    const dir_sub_table_t* root = t->rib->sub_table;
+
+    for ( unsigned s = first; s < last; ++s )
+    {
+        pop_top_t top;
+
+        if ( _rib_is_child(root, s) )
+        {
+            pop_tree_t* tree = _pop_build(t, (const dir_sub_table_t*)root->entries[s]);
+
+            if ( !tree )
+                return MEM_ALLOC_FAILURE;
+
+            top = (pop_top_t)tree;
+        }
+        else
+        {
+            pop_leaf_t leaf = _pop_leaf(root->entries[s], root->lengths[s]);
+            top = ((pop_top_t)leaf << 32) | 1;
+        }
+        _pop_free_tree(t, t->top[s]);
+        t->top[s] = top;
+    }
+    return RT_SUCCESS;
+}
+
+// the top level slots covered by ip/len
+static int _pop_update_prefix(pop_table_t* t, IP ip, int len)
+{
+    pop_key_t k = _pop_key(ip);
+    unsigned first = _pop_bits(k, 0, POP_TOP_BITS);
+    unsigned last = first + 1;
+
+    if ( len < POP_TOP_BITS )
+    {
+        unsigned span = 1 << (POP_TOP_BITS - len);
+        first &= ~(span - 1);
+        last = first + span;
+    }
+    return _pop_update(t, first, last);
+}
+
+//-------------------------------------------------------------------------
+// sfrt api
+//-------------------------------------------------------------------------
+
+pop_table_t* sfrt_poptrie_new(uint32_t mem_cap, int ip_bits)
+{
+    pop_table_t* t = new pop_table_t;
+
+    t->bits = ip_bits;
+    t->num_trees = 0;
+    t->allocated = sizeof(*t) + POP_TOP_SIZE * sizeof(*t->top);
+
+    // the rib indexes each 32 bit word separately
+    if ( ip_bits == 32 )
+        t->rib = sfrt_dir_new(mem_cap, 4, 16,6,6,4);
+    else
+        t->rib = sfrt_dir_new(mem_cap, 22, 16,6,6,4,
+            6,6,6,6,6,2, 6,6,6,6,6,2, 6,6,6,6,6,2);
+
+    if ( !t->rib )
+    {
+        delete t;
+        return nullptr;
+    }
+
+    for ( int i = 1; i < t->rib->dim_size; ++i )
+        t->widths[i - 1] = t->rib->dimensions[i];
+
+    // all leaves with index and length 0
+    t->top = new pop_top_t[POP_TOP_SIZE];
+
+    for ( unsigned s = 0; s < POP_TOP_SIZE; ++s )
+        t->top[s] = 1;
+
+    return t;
+}
+
+void sfrt_poptrie_free(void* tbl)
+{
+    pop_table_t* t = (pop_table_t*)tbl;
+
+    if ( !t )
+        return;
+
+    for ( unsigned s = 0; s < POP_TOP_SIZE; ++s )
+        _pop_free_tree(t, t->top[s]);
+
+    sfrt_dir_free(t->rib);
+    delete[] t->top;
+    delete t;
+}
+
+tuple_t sfrt_poptrie_lookup(IP ip, void* tbl)
+{
+    const pop_table_t* t = (pop_table_t*)tbl;
+    pop_key_t k = _pop_key(ip);
+    pop_top_t top = t->top[_pop_bits(k, 0, POP_TOP_BITS)];
+
+    if ( _pop_is_leaf(top) )
+        return _pop_tuple(top >> 32);
+
+    return _pop_walk(t, _pop_tree(top), k);
+}
+
+// the walks advance one level per pass; each pass prefetches what the
+// next pass will read so up to POP_BATCH misses are outstanding
+void sfrt_poptrie_lookup_batch(const IP* ips, unsigned n, void* tbl, tuple_t* out)
+{
+    const pop_table_t* t = (pop_table_t*)tbl;
+
+    struct Lane
+    {
+        pop_key_t key;
+        const pop_tree_t* tree;
+        const pop_node_t* node;
+        const pop_leaf_t* leaf;
+        unsigned depth;
+        unsigned pos;
+    } lanes[POP_BATCH];
+
+    for ( unsigned base = 0; base < n; base += POP_BATCH )
+    {
+        unsigned m = n - base < POP_BATCH ? n - base : POP_BATCH;
+        unsigned active = 0;
+
+        for ( unsigned i = 0; i < m; ++i )
+        {
+            lanes[i].key = _pop_key(ips[base + i]);
+            pop_prefetch(t->top + _pop_bits(lanes[i].key, 0, POP_TOP_BITS));
+        }
+
+        for ( unsigned i = 0; i < m; ++i )
+        {
+            Lane& l = lanes[i];
+            pop_top_t top = t->top[_pop_bits(l.key, 0, POP_TOP_BITS)];
+
+            if ( _pop_is_leaf(top) )
+            {
+                out[base + i] = _pop_tuple(top >> 32);
+                l.tree = nullptr;
+                continue;
+            }
+            l.tree = _pop_tree(top);
+            l.node = l.tree->nodes;
+            l.leaf = nullptr;
+            l.depth = 0;
+            l.pos = POP_TOP_BITS;
+            pop_prefetch(l.node);
+            ++active;
+        }
+
+        while ( active )
+        {
+            for ( unsigned i = 0; i < m; ++i )
+            {
+                Lane& l = lanes[i];
+
+                if ( !l.tree )
+                    continue;
+
+                if ( l.leaf )
+                {
+                    out[base + i] = _pop_tuple(*l.leaf);
+                    l.tree = nullptr;
+                    --active;
+                    continue;
+                }
+                unsigned width = t->widths[l.depth++];
+                l.leaf = _pop_step(l.tree, l.node, _pop_bits(l.key, l.pos, width));
+                l.pos += width;
+
+                if ( l.leaf )
+                    pop_prefetch(l.leaf);
+                else
+                    pop_prefetch(l.node);
+            }
+        }
+    }
+}
+
+int sfrt_poptrie_insert(IP ip, int len, word data_index, int behavior, void* tbl)
+{
+    pop_table_t* t = (pop_table_t*)tbl;
+
+    if ( !t || data_index > POP_MAX_INDEX )
+        return DIR_INSERT_FAILURE;
+
+    int ret = sfrt_dir_insert(ip, len, data_index, behavior, t->rib);
+
+    // a failed insert may still have added sub tables
+    int upd = _pop_update_prefix(t, ip, len);
+
+    return ret == RT_SUCCESS ? upd : ret;
+}
+
+word sfrt_poptrie_remove(IP ip, int len, int behavior, void* tbl)
+{
+    pop_table_t* t = (pop_table_t*)tbl;
+
+    if ( !t )
+        return 0;
+
+    word index = sfrt_dir_remove(ip, len, behavior, t->rib);
+    _pop_update_prefix(t, ip, len);
+    return index;
+}
+
+uint32_t sfrt_poptrie_usage(void* tbl)
+{
+    pop_table_t* t = (pop_table_t*)tbl;
+
+    if ( !t )
+        return 0;
+
+    return t->allocated + sfrt_dir_usage(t->rib);
+}
+
+void sfrt_poptrie_print(void* tbl)
+{
+    pop_table_t* t = (pop_table_t*)tbl;
+
+    if ( !t )
+        return;
+
+    printf("Poptrie: %d bits, %u trees, %u bytes compiled\n",
+        t->bits, t->num_trees, t->allocated);
+
+    sfrt_dir_print(t->rib);
+}
+
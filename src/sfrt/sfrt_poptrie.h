@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// sfrt_poptrie.h
+
+#ifndef SFRT_POPTRIE_H
+#define SFRT_POPTRIE_H
+
+// A compressed multibit trie after Asai and Ohara's Poptrie.  The first 16
+// bits index a direct array; the rest of the address is consumed up to 6 bits
+// at a time by nodes that hold 2 64 bit maps instead of 64 entries:
+//
+// - vector has a bit per slot that descends to a child node; children are
+//   stored contiguously so the child is base1 + popcount of the lower bits.
+// - leafvec has a bit per slot that starts a new run of the same leaf so
+//   runs of identical routes are stored once at base0 + popcount.
+//
+// strides don't cross 32 bit words so IPv4 uses 16 + 6 + 6 + 4 bits and
+// IPv6 adds 6 x 5 + 2 for each of the other 3 words.  a lookup touches at
+// most 3 or 21 nodes of 24 bytes.
+//
+// Updates go to a DIR-n-m table with the same strides (the RIB) which keeps
+// the FAVOR_TIME / FAVOR_SPECIFIC semantics of the other types.  Only the
+// subtrees under the direct array slots covered by an updated prefix are
+// rebuilt so the table can be built and changed incrementally.
+
+#include <stdint.h>
+
+struct pop_table_t;
+
+pop_table_t* sfrt_poptrie_new(uint32_t mem_cap, int ip_bits);
+void sfrt_poptrie_free(void*);
+tuple_t sfrt_poptrie_lookup(IP ip, void* table);
+int sfrt_poptrie_insert(IP ip, int len, word data_index,
+    int behavior, void* table);
+uint32_t sfrt_poptrie_usage(void* table);
+void sfrt_poptrie_print(void* table);
+word sfrt_poptrie_remove(IP ip, int len, int behavior, void* table);
+
+// looks up n addresses of the table's family, interleaving the walks
+// and prefetching each level so the cache misses overlap
+void sfrt_poptrie_lookup_batch(const IP* ips, unsigned n, void* table, tuple_t* out);
+
+#endif
+
@@ -22,6 +22,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include <vector>
 
 #include "catch/catch.hpp"
 
@@ -61,7 +64,7 @@ static IP_entry ip_lists[] =
 static int s_debug = 0;
 
 /* Add one ip, then delete that IP*/
-static void test_sfrt_remove_after_insert()
+static void test_sfrt_remove_after_insert(char type)
 {
     table_t* dir;
     unsigned num_entries;
@@ -71,7 +74,7 @@ static void test_sfrt_remove_after_insert()
     if ( s_debug )
         printf("Number of entries: %d \n",num_entries);
 
-    dir = sfrt_new(DIR_16_4x4_16x5_4x4, IPv6, num_entries + 1, 200);
+    dir = sfrt_new(type, IPv6, num_entries + 1, 200);
 
     CHECK(dir != NULL); // "sfrt_new()"
 
@@ -151,7 +154,7 @@ static void test_sfrt_remove_after_insert()
 }
 
 /*Add all IPs, then delete all of them*/
-static void test_sfrt_remove_after_insert_all()
+static void test_sfrt_remove_after_insert_all(char type)
 {
     table_t* dir;
     unsigned num_entries;
@@ -162,7 +165,7 @@ static void test_sfrt_remove_after_insert_all()
     if ( s_debug )
         printf("Number of entries: %d \n",num_entries);
 
-    dir = sfrt_new(DIR_16_4x4_16x5_4x4, IPv6, num_entries + 1, 200);
+    dir = sfrt_new(type, IPv6, num_entries + 1, 200);
 
     CHECK(dir != NULL); // "sfrt_new()"
 
@@ -255,11 +258,263 @@ TEST_CASE("sfrt", "[sfrt]")
 {
     SECTION("remove after insert")
     {
-        test_sfrt_remove_after_insert();
+        test_sfrt_remove_after_insert(DIR_16_4x4_16x5_4x4);
     }
     SECTION("remove after insert all")
     {
-        test_sfrt_remove_after_insert_all();
+        test_sfrt_remove_after_insert_all(DIR_16_4x4_16x5_4x4);
+    }
+    SECTION("poptrie remove after insert")
+    {
+        test_sfrt_remove_after_insert(POPTRIE);
+    }
+    SECTION("poptrie remove after insert all")
+    {
+        test_sfrt_remove_after_insert_all(POPTRIE);
+    }
+}
+
+//---------------------------------------------------------------
+// random prefix sets; the v4 set is shaped like a BGP table with most
+// routes /24, most of the rest /16 - /23, and a few shorter ones.  v6 routes are /32 - /48
+// under 2000::/3.
+
+static unsigned s_seed = 1;
+
+static uint32_t rand32()
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    uint32_t hi = s_seed >> 16;
+    s_seed = s_seed * 1103515245 + 12345;
+    return (hi << 16) | (s_seed >> 16);
+}
+
+static int rand_len4()
+{
+    static const int lens[] =
+    { 16, 16, 17, 18, 19, 19, 20, 20, 20, 21, 21, 22, 22, 22, 22, 23, 23, 23, 23 };
+    uint32_t r = rand32() % 1000;
+
+    if ( r < 2 )
+        return 8 + rand32() % 8;
+
+    if ( r < 550 )
+        return 24;
+
+    if ( r < 580 )
+        return 25 + rand32() % 8;
+
+    return lens[rand32() % (sizeof(lens)/sizeof(lens[0]))];
+}
+
+static int rand_len6()
+{
+    static const int lens[] = { 32, 36, 40, 44, 48, 48, 48, 48, 56, 64 };
+    return lens[rand32() % (sizeof(lens)/sizeof(lens[0]))];
+}
+
+static void rand_prefix(sfip_t& ip, bool v6)
+{
+    uint32_t a[4] = { htonl(rand32()), htonl(rand32()), htonl(rand32()), htonl(rand32()) };
+
+    if ( v6 )
+    {
+        a[0] = htonl((ntohl(a[0]) & 0x1fffffff) | 0x20000000);
+        sfip_set_raw(&ip, a, AF_INET6);
+        ip.bits = rand_len6();
     }
+    else
+    {
+        sfip_set_raw(&ip, a, AF_INET);
+        ip.bits = rand_len4();
+    }
+}
+
+// an address under a random prefix so most lookups hit
+static void rand_addr(sfip_t& ip, const std::vector<sfip_t>& nets)
+{
+    const sfip_t& net = nets[rand32() % nets.size()];
+    uint32_t a[4];
+
+    for ( unsigned i = 0; i < 4; ++i )
+        a[i] = htonl(rand32());
+
+    for ( unsigned i = 0; i < 4 && (int)(32 * i) < net.bits; ++i )
+    {
+        int n = net.bits - 32 * i;
+        uint32_t mask = n >= 32 ? 0xffffffff : ~(0xffffffff >> n);
+        a[i] = htonl((ntohl(net.ip32[i]) & mask) | (ntohl(a[i]) & ~mask));
+    }
+    sfip_set_raw(&ip, a, net.family);
+}
+
+static table_t* load(char type, const std::vector<sfip_t>& nets, int behavior)
+{
+    table_t* t = sfrt_new(type, IPv6, nets.size() + 1, 1024);
+    REQUIRE(t);
+
+    for ( unsigned i = 0; i < nets.size(); ++i )
+    {
+        sfip_t ip = nets[i];
+        sfrt_insert(&ip, ip.bits, (GENERIC)(uintptr_t)(i + 1), behavior, t);
+    }
+    return t;
+}
+
+static void check_same(table_t* dir, table_t* pop, const std::vector<sfip_t>& nets)
+{
+    std::vector<sfip_t> ips(4096);
+    std::vector<sfip_t*> ptrs;
+    std::vector<GENERIC> out(ips.size());
+
+    for ( auto& ip : ips )
+    {
+        rand_addr(ip, nets);
+        ptrs.push_back(&ip);
+    }
+    sfrt_lookup_batch(ptrs.data(), ptrs.size(), pop, out.data());
+
+    unsigned bad = 0, hits = 0;
+
+    for ( unsigned i = 0; i < ips.size(); ++i )
+    {
+        GENERIC p = sfrt_lookup(&ips[i], dir);
+
+        if ( p )
+            ++hits;
+
+        if ( p != sfrt_lookup(&ips[i], pop) or p != out[i] )
+            ++bad;
+    }
+    CHECK(hits > 0);
+    CHECK(bad == 0);
+}
+
+static void test_poptrie(int behavior)
+{
+    std::vector<sfip_t> nets(20000);
+
+    for ( unsigned i = 0; i < nets.size(); ++i )
+        rand_prefix(nets[i], i & 1);
+
+    table_t* dir = load(DIR_8x16, nets, behavior);
+    table_t* pop = load(POPTRIE, nets, behavior);
+
+    check_same(dir, pop, nets);
+
+    // FAVOR_TIME removes depend on the strides; see _dir_remove_all()
+    if ( behavior == RT_FAVOR_TIME )
+    {
+        sfrt_free(dir);
+        sfrt_free(pop);
+        return;
+    }
+
+    for ( unsigned i = 0; i < nets.size(); i += 3 )
+    {
+        sfip_t ip = nets[i];
+        GENERIC p1 = nullptr, p2 = nullptr;
+
+        sfrt_remove(&ip, ip.bits, &p1, behavior, dir);
+        sfrt_remove(&ip, ip.bits, &p2, behavior, pop);
+        CHECK(p1 == p2);
+    }
+    check_same(dir, pop, nets);
+    CHECK(sfrt_num_entries(dir) == sfrt_num_entries(pop));
+
+    sfrt_free(dir);
+    sfrt_free(pop);
+}
+
+TEST_CASE("sfrt poptrie", "[sfrt]")
+{
+    SECTION("favor specific")
+    {
+        test_poptrie(RT_FAVOR_SPECIFIC);
+    }
+    SECTION("favor time")
+    {
+        test_poptrie(RT_FAVOR_TIME);
+    }
+}
+
+//---------------------------------------------------------------
+// lookup benchmark; hidden, run with [sfrt_bench]
+
+static double bench(table_t* t, std::vector<sfip_t*>& ptrs, bool batch)
+{
+    std::vector<GENERIC> out(ptrs.size());
+    uintptr_t sum = 0;
+    clock_t start = clock();
+
+    for ( unsigned r = 0; r < 10; ++r )
+    {
+        if ( batch )
+            sfrt_lookup_batch(ptrs.data(), ptrs.size(), t, out.data());
+        else
+        {
+            for ( unsigned i = 0; i < ptrs.size(); ++i )
+                out[i] = sfrt_lookup(ptrs[i], t);
+        }
+        sum += (uintptr_t)out[r];
+    }
+    double ns = 1e9 * (clock() - start) / CLOCKS_PER_SEC;
+
+    if ( !sum )
+        printf("(no hits)\n");
+
+    return ns / (10.0 * ptrs.size());
+}
+
+static void bench_family(bool v6, unsigned num)
+{
+    std::vector<sfip_t> nets(num);
+
+    for ( auto& net : nets )
+        rand_prefix(net, v6);
+
+    std::vector<sfip_t> ips(1 << 20);
+    std::vector<sfip_t*> ptrs;
+
+    for ( auto& ip : ips )
+    {
+        rand_addr(ip, nets);
+        ptrs.push_back(&ip);
+    }
+
+    static const struct { char type; const char* name; } types[] =
+    {
+        { DIR_16_4x4_16x5_4x4, "dir_16_4x4_16x5_4x4" },
+        { DIR_8x16, "dir_8x16" },
+        { POPTRIE, "poptrie" },
+    };
+
+    printf("%s: %u prefixes, %zu lookups\n", v6 ? "ipv6" : "ipv4", num, ips.size());
+
+    for ( auto& tt : types )
+    {
+        // 16 bit sub tables for each /32 would exceed the memcap
+        if ( v6 and tt.type == DIR_16_4x4_16x5_4x4 )
+            continue;
+
+        clock_t start = clock();
+        table_t* t = load(tt.type, nets, RT_FAVOR_SPECIFIC);
+        double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        printf("    %-20s load %6.2f s  %8u KB  lookup %6.1f ns",
+            tt.name, secs, sfrt_usage(t) / 1024, bench(t, ptrs, false));
+
+        if ( tt.type == POPTRIE )
+            printf("  batch %6.1f ns", bench(t, ptrs, true));
+
+        printf("\n");
+        sfrt_free(t);
+    }
+}
+
+TEST_CASE("sfrt benchmark", "[.][sfrt_bench]")
+{
+    bench_family(false, 600000);
+    bench_family(true, 60000);
 }
 
@@ -58,11 +58,23 @@ struct BaseStats
 
     PegCount file_flows;
     PegCount file_prunes;
+
+    PegCount bypass_size;
+    PegCount bypass_rate;
+    PegCount bypass_service;
+    PegCount bypass_pkts;
+    PegCount bypass_bytes;
+    PegCount bypass_depth;
 };
 
 static BaseStats g_stats;
 static THREAD_LOCAL BaseStats t_stats;
 
+// flows that reached stream.depth by service; the names are taken from
+// the config the counts were made with, not the current one
+static std::vector<PegCount> g_depth_counts;
+static std::vector<std::string> g_depth_names;
+
 const PegInfo base_pegs[] =
 {
     { "ip flows", "total ip sessions" },
@@ -77,6 +89,12 @@ const PegInfo base_pegs[] =
     { "user prunes", "user sessions pruned" },
     { "file flows", "total file sessions" },
     { "file prunes", "file sessions pruned" },
+    { "size bypasses", "sessions bypassed at bypass.max_bytes" },
+    { "rate bypasses", "sessions bypassed at bypass.min_rate" },
+    { "service bypasses", "sessions bypassed for a trusted service" },
+    { "bypassed packets", "packets of bypassed sessions seen after bypass" },
+    { "bypassed bytes", "bytes of bypassed sessions seen after bypass" },
+    { "depth bypasses", "sessions bypassed at stream.depth" },
     { nullptr, nullptr }
 };
 
@@ -103,8 +121,35 @@ void base_sum()
     t_stats.file_flows = flow_con->get_flows(PktType::FILE);
     t_stats.file_prunes = flow_con->get_prunes(PktType::FILE);
 
+    t_stats.bypass_size = flow_con->get_bypassed_flows(Flow::BYPASS_BYTES);
+    t_stats.bypass_rate = flow_con->get_bypassed_flows(Flow::BYPASS_RATE);
+    t_stats.bypass_service = flow_con->get_bypassed_flows(Flow::BYPASS_SERVICE);
+    t_stats.bypass_pkts = flow_con->get_bypassed_pkts();
+    t_stats.bypass_bytes = flow_con->get_bypassed_bytes();
+    t_stats.bypass_depth = flow_con->get_bypassed_flows(Flow::BYPASS_DEPTH);
+
     sum_stats((PegCount*)&g_stats, (PegCount*)&t_stats,
         array_size(base_pegs)-1);
+
+    const FlowDepthConfig* fdc = flow_con->get_depth_config();
+
+    if ( !fdc )
+        return;
+
+    const std::vector<PegCount>& dc = flow_con->get_depth_counts();
+
+    if ( g_depth_names.empty() )
+    {
+        g_depth_names.push_back("other");
+
+        for ( const auto& ds : fdc->services )
+            g_depth_names.push_back(ds.service);
+
+        g_depth_counts.assign(g_depth_names.size(), 0);
+    }
+
+    for ( unsigned i = 0; i < dc.size() and i < g_depth_counts.size(); ++i )
+        g_depth_counts[i] += dc[i];
 }
 
 void base_stats()
@@ -112,6 +157,15 @@ void base_stats()
     show_stats((PegCount*)&g_stats, base_pegs, array_size(base_pegs)-1, MOD_NAME);
 }
 
+void depth_stats()
+{
+    for ( unsigned i = 0; i < g_depth_counts.size(); ++i )
+    {
+        std::string s = "depth limited " + g_depth_names[i];
+        LogCount(s.c_str(), g_depth_counts[i]);
+    }
+}
+
 void base_reset()
 {
     if ( flow_con )
@@ -163,13 +217,12 @@ public:
     void eval(Packet*) override;
 
 public:
-    const StreamModuleConfig* config;
+    // a copy since the module is reused to parse reloads
+    StreamModuleConfig config;
 };
 
-StreamBase::StreamBase(const StreamModuleConfig* c)
-{
-    config = c;
-}
+StreamBase::StreamBase(const StreamModuleConfig* c) : config(*c)
+{ }
 
 void StreamBase::tinit()
 {
@@ -177,52 +230,58 @@ void StreamBase::tinit()
     flow_con = new FlowControl;
     InspectSsnFunc f;
 
-    if ( config->ip_cfg.max_sessions )
+    if ( config.ip_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::IP)) )
         {
-            flow_con->init_ip(config->ip_cfg, f);
+            flow_con->init_ip(config.ip_cfg, f);
             // FIXIT-L update stream_ip to use standard memcap
             //IpSession::set_memcap(flow_con->get_memcap(PktType::IP));
         }
     }
-    if ( config->icmp_cfg.max_sessions )
+    if ( config.icmp_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::ICMP)) )
-            flow_con->init_icmp(config->icmp_cfg, f);
+            flow_con->init_icmp(config.icmp_cfg, f);
     }
-    if ( config->tcp_cfg.max_sessions )
+    if ( config.tcp_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::TCP)) )
         {
-            flow_con->init_tcp(config->tcp_cfg, f);
+            flow_con->init_tcp(config.tcp_cfg, f);
             TcpSession::set_memcap(flow_con->get_memcap(PktType::TCP));
         }
     }
-    if ( config->udp_cfg.max_sessions )
+    if ( config.udp_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::UDP)) )
-            flow_con->init_udp(config->udp_cfg, f);
+            flow_con->init_udp(config.udp_cfg, f);
     }
-    if ( config->user_cfg.max_sessions )
+    if ( config.user_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::PDU)) )
         {
-            flow_con->init_user(config->user_cfg, f);
+            flow_con->init_user(config.user_cfg, f);
             // FIXIT-L update stream_ip to use standard memcap
             //UserSession::set_memcap(flow_con->get_memcap(PktType::PDU));
         }
     }
-    if ( config->file_cfg.max_sessions )
+    if ( config.file_cfg.max_sessions )
     {
         if ( (f = InspectorManager::get_session((uint16_t)PktType::FILE)) )
-            flow_con->init_file(config->file_cfg, f);
+            flow_con->init_file(config.file_cfg, f);
     }
-    uint32_t max = config->tcp_cfg.max_sessions + config->udp_cfg.max_sessions
-        + config->user_cfg.max_sessions;
+    uint32_t max = config.tcp_cfg.max_sessions + config.udp_cfg.max_sessions
+        + config.user_cfg.max_sessions;
 
     if ( max > 0 )
         flow_con->init_exp(max);
+
+    if ( config.bypass_cfg.enabled() )
+        flow_con->init_bypass(config.bypass_cfg);
+
+    if ( config.depth_cfg.enabled() )
+        flow_con->init_depth(config.depth_cfg);
 }
 
 void StreamBase::tterm()
@@ -20,6 +20,7 @@
 
 #include "stream_module.h"
 #include "stream/stream.h"
+#include "parser/parser.h"
 
 #include <string>
 using namespace std;
@@ -53,6 +54,45 @@ CACHE_PARAMS(udp_params,   "65536",         "0", "30", "180");
 CACHE_PARAMS(user_params,   "1024",   "1048576", "30", "180");
 CACHE_PARAMS(file_params,   " 128",         "0", "30", "180");
 
+static const Parameter bypass_params[] =
+{
+    { "max_bytes", Parameter::PT_INT, "0:", "0",
+      "bypass flows after this many bytes in both directions (0 is off)" },
+
+    { "min_rate", Parameter::PT_INT, "0:", "0",
+      "bypass flows averaging at least this many bytes per second (0 is off)" },
+
+    { "trusted_services", Parameter::PT_STRING, nullptr, nullptr,
+      "space separated list of services to bypass once identified" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+static const Parameter depth_service_params[] =
+{
+    { "service", Parameter::PT_STRING, nullptr, nullptr,
+      "name of service" },
+
+    { "max_bytes", Parameter::PT_INT, "0:", "0",
+      "maximum bytes of this service to inspect per flow (0 is unlimited)" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+static const Parameter depth_params[] =
+{
+    { "max_bytes", Parameter::PT_INT, "0:", "0",
+      "maximum bytes of other services to inspect per flow (0 is unlimited)" },
+
+    { "action", Parameter::PT_ENUM, "bypass | header", "bypass",
+      "bypass the flow or inspect packet headers only once max_bytes is reached" },
+
+    { "services", Parameter::PT_LIST, depth_service_params, nullptr,
+      "service specific depths" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
 #define CACHE_TABLE(cache, proto, params) \
     { cache, Parameter::PT_TABLE, params, nullptr, \
       "configure " proto " cache limits" }
@@ -66,6 +106,12 @@ static const Parameter s_params[] =
     CACHE_TABLE("user_cache", "user", user_params),
     CACHE_TABLE("file_cache", "file", file_params),
 
+    { "bypass", Parameter::PT_TABLE, bypass_params, nullptr,
+      "stop inspecting and whitelist large, fast, or trusted flows" },
+
+    { "depth", Parameter::PT_TABLE, depth_params, nullptr,
+      "limit the payload given to the service inspector of each flow" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -88,7 +134,13 @@ bool StreamModule::set(const char* fqn, Value& v, SnortConfig*)
 {
     FlowConfig* fc = nullptr;
 
-    if ( strstr(fqn, "ip_cache") )
+    if ( strstr(fqn, "bypass") )
+        return set_bypass(v);
+
+    else if ( strstr(fqn, "depth") )
+        return set_depth(fqn, v);
+
+    else if ( strstr(fqn, "ip_cache") )
         fc = &config.ip_cfg;
 
     else if ( strstr(fqn, "icmp_cache") )
@@ -127,11 +179,99 @@ bool StreamModule::set(const char* fqn, Value& v, SnortConfig*)
     return true;
 }
 
+bool StreamModule::set_bypass(Value& v)
+{
+    FlowBypassConfig& bc = config.bypass_cfg;
+
+    if ( v.is("max_bytes") )
+        bc.max_bytes = v.get_long();
+
+    else if ( v.is("min_rate") )
+        bc.min_rate = v.get_long();
+
+    else if ( v.is("trusted_services") )
+    {
+        string tok;
+        v.set_first_token();
+
+        while ( v.get_next_token(tok) )
+            bc.services.push_back(tok);
+    }
+    else
+        return false;
+
+    return true;
+}
+
+bool StreamModule::set_depth(const char* fqn, Value& v)
+{
+    if ( strstr(fqn, "services") )
+    {
+        if ( v.is("service") )
+            depth_service.service = v.get_string();
+
+        else if ( v.is("max_bytes") )
+            depth_service.max_bytes = v.get_long();
+
+        else
+            return false;
+    }
+    else if ( v.is("max_bytes") )
+        config.depth_cfg.max_bytes = v.get_long();
+
+    else if ( v.is("action") )
+        config.depth_cfg.bypass = (v.get_long() == 0);
+
+    else
+        return false;
+
+    return true;
+}
+
+bool StreamModule::begin(const char* fqn, int idx, SnortConfig*)
+{
+    // lists accumulate so start over on reload
+    if ( !idx and !strcmp(fqn, MOD_NAME) )
+    {
+        config.bypass_cfg = FlowBypassConfig();
+        config.depth_cfg = FlowDepthConfig();
+    }
+
+    else if ( idx and !strcmp(fqn, "stream.depth.services") )
+        depth_service = FlowDepthService();
+
+    return true;
+}
+
+bool StreamModule::end(const char* fqn, int idx, SnortConfig*)
+{
+    if ( idx and !strcmp(fqn, "stream.depth.services") )
+    {
+        if ( depth_service.service.empty() )
+        {
+            ParseError("stream.depth.services requires a service");
+            return false;
+        }
+        // indices are stored in a uint8_t with 0 for other services
+        if ( config.depth_cfg.services.size() >= FLOW_DEPTH_MAX_SERVICES )
+        {
+            ParseError("stream.depth.services is limited to %u services",
+                FLOW_DEPTH_MAX_SERVICES);
+            return false;
+        }
+        config.depth_cfg.services.push_back(depth_service);
+    }
+    return true;
+}
+
 void StreamModule::sum_stats()
 { base_sum(); }
 
 void StreamModule::show_stats()
-{ base_stats(); }
+{
+    base_stats();
+    depth_stats();
+}
 
 void StreamModule::reset_stats()
 { base_reset(); }
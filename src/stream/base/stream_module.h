@@ -43,6 +43,8 @@ struct StreamModuleConfig
     FlowConfig udp_cfg;
     FlowConfig user_cfg;
     FlowConfig file_cfg;
+    FlowBypassConfig bypass_cfg;
+    FlowDepthConfig depth_cfg;
 };
 
 class StreamModule : public Module
@@ -51,6 +53,8 @@ public:
     StreamModule();
 
     bool set(const char*, Value&, SnortConfig*) override;
+    bool begin(const char*, int, SnortConfig*) override;
+    bool end(const char*, int, SnortConfig*) override;
 
     const PegInfo* get_pegs() const override;
     ProfileStats* get_profile() const override;
@@ -61,11 +65,16 @@ public:
     void reset_stats() override;
 
 private:
+    bool set_bypass(Value&);
+    bool set_depth(const char*, Value&);
+
     StreamModuleConfig config;
+    FlowDepthService depth_service;
 };
 
 extern void base_sum();
 extern void base_stats();
+extern void depth_stats();
 extern void base_reset();
 
 #endif
@@ -335,14 +335,14 @@ void Stream::drop_session(const Packet* p)
 // misc support
 //-------------------------------------------------------------------------
 
-BitOp* Stream::get_flow_bitop(const Packet* p)
+BitOp* Stream::get_flow_bitop(const Packet* p, bool create)
 {
     Flow* flow = p->flow;
 
     if (!flow)
         return NULL;
 
-    return flow->bitop;
+    return flow->get_bitop(create);
 }
 
 void Stream::init_active_response(const Packet* p, Flow* flow)
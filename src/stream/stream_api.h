@@ -164,7 +164,8 @@ public:
         uint32_t eventId, uint32_t eventSecond);
 
     // Get pointer to Flowbits data
-    static BitOp* get_flow_bitop(const Packet*);
+    // returns nullptr if no flowbits were set unless create is true
+    static BitOp* get_flow_bitop(const Packet*, bool create = false);
 
     // Get reassembly direction for given session
     static char get_reassembly_direction(Flow*);
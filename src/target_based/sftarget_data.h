@@ -72,6 +72,10 @@ struct HostAttributeEntry
     HostInfo hostInfo;
     ApplicationEntry* services;
     ApplicationEntry* clients;
+
+    // set if more services are in a mapped hosts image
+    const struct SfatImage* image;
+    uint32_t image_host;
 };
 
 int SFAT_AddHost(HostAttributeEntry*);
@@ -20,6 +20,7 @@
 // sftarget_hostentry.c author Steven Sturges
 
 #include "sftarget_hostentry.h"
+#include "sftarget_image.h"
 
 #if 0
 static bool hasService(const HostAttributeEntry* host_entry,
@@ -121,6 +122,9 @@ int getApplicationProtocolId(const HostAttributeEntry* host_entry,
                 }
             }
         }
+        if ( host_entry->image )
+            return SFAT_ImageProtocolId(
+                host_entry->image, host_entry->image_host, ipprotocol, port);
     }
 
     /* FIXIT: client? doesn't make much sense in terms of specific port */
@@ -0,0 +1,900 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// sftarget_image.cc
+
+#include "sftarget_image.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "sftarget_data.h"
+#include "snort_protocols.h"
+#include "log/messages.h"
+#include "sfip/sfip_t.h"
+
+#ifdef UNIT_TEST
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include "catch/catch.hpp"
+#endif
+
+//-------------------------------------------------------------------------
+// file layout
+//-------------------------------------------------------------------------
+
+#define SFAT_IMAGE_MAGIC 0x54414653  // "SFAT" when native is little endian
+#define SFAT_NO_HOST 0xFFFFFFFF
+#define SFAT_ALIGN 8
+
+struct SfatKey6
+{
+    uint64_t hi;
+    uint64_t lo;
+};
+
+struct SfatImageHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+
+    uint32_t num_v4;     // v4 range starts and hosts
+    uint32_t num_v6;     // v6 range starts and hosts
+    uint32_t num_hosts;
+    uint32_t num_apps;
+    uint32_t num_names;
+    uint32_t num_chars;
+
+    // section offsets from the start of the file
+    uint64_t v4_keys;
+    uint64_t v4_hosts;
+    uint64_t v6_keys;
+    uint64_t v6_hosts;
+    uint64_t hosts;
+    uint64_t apps;
+    uint64_t names;      // offsets into chars
+    uint64_t chars;      // nul terminated protocol names
+};
+
+struct SfatImageHost
+{
+    uint32_t app;        // first service
+    uint16_t num_apps;
+    uint8_t stream_policy;
+    uint8_t frag_policy;
+};
+
+struct SfatImageApp
+{
+    uint16_t port;
+    uint16_t ipproto;    // name index
+    uint16_t protocol;   // name index
+    uint16_t pad;
+};
+
+struct SfatImage
+{
+    const uint8_t* base;
+    size_t size;
+
+    const SfatImageHeader* hdr;
+    const uint32_t* v4_keys;
+    const uint32_t* v4_hosts;
+    const SfatKey6* v6_keys;
+    const uint32_t* v6_hosts;
+    const SfatImageHost* hosts;
+    const SfatImageApp* apps;
+
+    std::vector<int16_t> protos;  // name index -> protocol id
+};
+
+//-------------------------------------------------------------------------
+// keys
+//-------------------------------------------------------------------------
+
+static inline bool operator<(const SfatKey6& a, const SfatKey6& b)
+{ return a.hi < b.hi or (a.hi == b.hi and a.lo < b.lo); }
+
+static inline bool operator==(const SfatKey6& a, const SfatKey6& b)
+{ return a.hi == b.hi and a.lo == b.lo; }
+
+static inline bool operator!=(const SfatKey6& a, const SfatKey6& b)
+{ return !(a == b); }
+
+static inline uint32_t key_max(uint32_t)
+{ return 0xFFFFFFFF; }
+
+static inline uint32_t key_next(uint32_t k)
+{ return k + 1; }
+
+static inline SfatKey6 key_max(const SfatKey6&)
+{ return { ~(uint64_t)0, ~(uint64_t)0 }; }
+
+static inline SfatKey6 key_next(SfatKey6 k)
+{
+    if ( !++k.lo )
+        ++k.hi;
+    return k;
+}
+
+static inline uint32_t key4(const sfip_t* ip)
+{ return ntohl(ip->ip32[0]); }
+
+static inline SfatKey6 key6(const sfip_t* ip)
+{
+    SfatKey6 k;
+    k.hi = ((uint64_t)ntohl(ip->ip32[0]) << 32) | ntohl(ip->ip32[1]);
+    k.lo = ((uint64_t)ntohl(ip->ip32[2]) << 32) | ntohl(ip->ip32[3]);
+    return k;
+}
+
+static inline uint64_t mask64(int bits)
+{
+    if ( bits <= 0 )
+        return 0;
+
+    if ( bits >= 64 )
+        return ~(uint64_t)0;
+
+    return ~(uint64_t)0 << (64 - bits);
+}
+
+//-------------------------------------------------------------------------
+// compile
+//-------------------------------------------------------------------------
+
+template<typename Key>
+struct SfatPrefix
+{
+    Key lo;
+    Key hi;
+    uint32_t host;
+};
+
+static void get_prefix(const sfip_t& ip, SfatPrefix<uint32_t>& p)
+{
+    int bits = ip.bits > 32 ? 32 : ip.bits;
+    uint32_t m = (uint32_t)(mask64(bits) >> 32);
+    p.lo = key4(&ip) & m;
+    p.hi = p.lo | ~m;
+}
+
+static void get_prefix(const sfip_t& ip, SfatPrefix<SfatKey6>& p)
+{
+    SfatKey6 k = key6(&ip);
+    uint64_t mh = mask64(ip.bits), ml = mask64(ip.bits - 64);
+    p.lo = { k.hi & mh, k.lo & ml };
+    p.hi = { p.lo.hi | ~mh, p.lo.lo | ~ml };
+}
+
+// prefixes either nest or are disjoint so a sweep in order of start (outer
+// first) with a stack of the open prefixes gives the most specific host
+// for each range.  of identical prefixes the last one wins.
+template<typename Key>
+static void flatten(
+    std::vector< SfatPrefix<Key> >& pv, std::vector<Key>& keys, std::vector<uint32_t>& hosts)
+{
+    std::stable_sort(pv.begin(), pv.end(),
+        [](const SfatPrefix<Key>& a, const SfatPrefix<Key>& b)
+        { return a.lo < b.lo or (a.lo == b.lo and b.hi < a.hi); });
+
+    std::vector<const SfatPrefix<Key>*> open;
+
+    auto start = [&](Key k, uint32_t h)
+    {
+        if ( !keys.empty() and keys.back() == k )
+            hosts.back() = h;
+
+        else if ( hosts.empty() or hosts.back() != h )
+        {
+            keys.push_back(k);
+            hosts.push_back(h);
+        }
+    };
+
+    auto close = [&]()
+    {
+        const SfatPrefix<Key>* p = open.back();
+        open.pop_back();
+
+        // everything still open ends at max too
+        if ( p->hi == key_max(p->hi) )
+            open.clear();
+        else
+            start(key_next(p->hi), open.empty() ? SFAT_NO_HOST : open.back()->host);
+    };
+
+    for ( auto& p : pv )
+    {
+        while ( !open.empty() and open.back()->hi < p.lo )
+            close();
+
+        if ( !open.empty() and open.back()->lo == p.lo and open.back()->hi == p.hi )
+            open.back() = &p;
+        else
+            open.push_back(&p);
+
+        start(p.lo, p.host);
+    }
+
+    while ( !open.empty() )
+        close();
+}
+
+static uint64_t align(uint64_t n)
+{ return (n + SFAT_ALIGN - 1) & ~(uint64_t)(SFAT_ALIGN - 1); }
+
+template<typename T>
+static uint64_t place(uint64_t& off, size_t num)
+{
+    uint64_t at = off;
+    off = align(off + num * sizeof(T));
+    return at;
+}
+
+template<typename T>
+static void put(std::vector<uint8_t>& buf, uint64_t at, const std::vector<T>& v)
+{
+    if ( !v.empty() )
+        memcpy(&buf[at], v.data(), v.size() * sizeof(T));
+}
+
+bool SFAT_WriteImage(const char* file, const std::vector<const HostAttributeEntry*>& hv)
+{
+    std::vector< SfatPrefix<uint32_t> > p4;
+    std::vector< SfatPrefix<SfatKey6> > p6;
+
+    std::vector<SfatImageHost> hosts;
+    std::vector<SfatImageApp> apps;
+
+    std::map<int16_t, uint16_t> ids;
+    std::vector<uint32_t> names;
+    std::string chars;
+
+    auto name = [&](int16_t id) -> uint16_t
+    {
+        auto it = ids.find(id);
+
+        if ( it != ids.end() )
+            return it->second;
+
+        const char* s = id ? get_protocol_name(id) : nullptr;
+        uint16_t idx = names.size();
+
+        names.push_back(chars.size());
+        chars.append(s ? s : "");
+        chars.push_back('\0');
+
+        ids[id] = idx;
+        return idx;
+    };
+
+    // index 0 is always no protocol
+    name(0);
+
+    for ( auto* h : hv )
+    {
+        if ( !h->ipAddr.is_ip4() and !h->ipAddr.is_ip6() )
+            continue;
+
+        SfatImageHost ih;
+        ih.app = apps.size();
+        ih.num_apps = 0;
+        ih.stream_policy = h->hostInfo.streamPolicy;
+        ih.frag_policy = h->hostInfo.fragPolicy;
+
+        for ( const ApplicationEntry* a = h->services; a and ih.num_apps < 0xFFFF; a = a->next )
+        {
+            SfatImageApp ia;
+            ia.port = a->port;
+            ia.ipproto = name(a->ipproto);
+            ia.protocol = name(a->protocol);
+            ia.pad = 0;
+            apps.push_back(ia);
+            ih.num_apps++;
+        }
+
+        // stable so the most recently added service is still first for
+        // any port that is listed more than once
+        std::stable_sort(apps.begin() + ih.app, apps.end(),
+            [](const SfatImageApp& a, const SfatImageApp& b)
+            { return a.port < b.port; });
+
+        if ( h->ipAddr.is_ip4() )
+        {
+            SfatPrefix<uint32_t> p;
+            get_prefix(h->ipAddr, p);
+            p.host = hosts.size();
+            p4.push_back(p);
+        }
+        else
+        {
+            SfatPrefix<SfatKey6> p;
+            get_prefix(h->ipAddr, p);
+            p.host = hosts.size();
+            p6.push_back(p);
+        }
+        hosts.push_back(ih);
+    }
+
+    if ( names.size() > 0xFFFF )
+    {
+        ErrorMessage("too many protocols for hosts image %s\n", file);
+        return false;
+    }
+
+    std::vector<uint32_t> k4, h4, h6;
+    std::vector<SfatKey6> k6;
+
+    flatten(p4, k4, h4);
+    flatten(p6, k6, h6);
+
+    SfatImageHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+
+    hdr.magic = SFAT_IMAGE_MAGIC;
+    hdr.version = SFAT_IMAGE_VERSION;
+
+    hdr.num_v4 = k4.size();
+    hdr.num_v6 = k6.size();
+    hdr.num_hosts = hosts.size();
+    hdr.num_apps = apps.size();
+    hdr.num_names = names.size();
+    hdr.num_chars = chars.size();
+
+    uint64_t off = align(sizeof(hdr));
+
+    hdr.v4_keys = place<uint32_t>(off, k4.size());
+    hdr.v4_hosts = place<uint32_t>(off, h4.size());
+    hdr.v6_keys = place<SfatKey6>(off, k6.size());
+    hdr.v6_hosts = place<uint32_t>(off, h6.size());
+    hdr.hosts = place<SfatImageHost>(off, hosts.size());
+    hdr.apps = place<SfatImageApp>(off, apps.size());
+    hdr.names = place<uint32_t>(off, names.size());
+    hdr.chars = place<char>(off, chars.size());
+    hdr.size = off;
+
+    std::vector<uint8_t> buf(off, 0);
+    memcpy(&buf[0], &hdr, sizeof(hdr));
+
+    put(buf, hdr.v4_keys, k4);
+    put(buf, hdr.v4_hosts, h4);
+    put(buf, hdr.v6_keys, k6);
+    put(buf, hdr.v6_hosts, h6);
+    put(buf, hdr.hosts, hosts);
+    put(buf, hdr.apps, apps);
+    put(buf, hdr.names, names);
+    memcpy(&buf[hdr.chars], chars.data(), chars.size());
+
+    // write aside and rename so a running snort never maps a partial file
+    std::string tmp = file;
+    tmp += ".tmp";
+
+    FILE* fh = fopen(tmp.c_str(), "wb");
+
+    if ( !fh )
+    {
+        ErrorMessage("can't open %s: %s\n", tmp.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(buf.data(), buf.size(), 1, fh) == 1;
+    ok = !fclose(fh) and ok;
+
+    if ( !ok or rename(tmp.c_str(), file) )
+    {
+        ErrorMessage("can't write %s: %s\n", file, strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    LogMessage("%u hosts written to %s\n", hdr.num_hosts, file);
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// map
+//-------------------------------------------------------------------------
+
+bool SFAT_IsImage(const char* file)
+{
+    FILE* fh = fopen(file, "rb");
+
+    if ( !fh )
+        return false;
+
+    uint32_t magic = 0;
+    bool is = fread(&magic, sizeof(magic), 1, fh) == 1 and magic == SFAT_IMAGE_MAGIC;
+
+    fclose(fh);
+    return is;
+}
+
+template<typename T>
+static bool section(const SfatImage* img, uint64_t off, uint64_t num, const T*& p)
+{
+    if ( off % SFAT_ALIGN or off > img->size or num > (img->size - off) / sizeof(T) )
+        return false;
+
+    p = (const T*)(img->base + off);
+    return true;
+}
+
+template<typename Key>
+static bool check_ranges(const Key* keys, const uint32_t* hosts, uint32_t num, uint32_t max)
+{
+    for ( uint32_t i = 0; i < num; ++i )
+    {
+        if ( i and !(keys[i-1] < keys[i]) )
+            return false;
+
+        if ( hosts[i] != SFAT_NO_HOST and hosts[i] >= max )
+            return false;
+    }
+    return true;
+}
+
+// everything a lookup may index is checked here so lookups needn't be
+static bool validate(SfatImage* img)
+{
+    if ( img->size < sizeof(SfatImageHeader) )
+        return false;
+
+    const SfatImageHeader* h = img->hdr = (const SfatImageHeader*)img->base;
+
+    if ( h->magic != SFAT_IMAGE_MAGIC or h->version != SFAT_IMAGE_VERSION or
+        h->size != img->size )
+        return false;
+
+    const uint32_t* names;
+    const char* chars;
+
+    if ( !section(img, h->v4_keys, h->num_v4, img->v4_keys) or
+        !section(img, h->v4_hosts, h->num_v4, img->v4_hosts) or
+        !section(img, h->v6_keys, h->num_v6, img->v6_keys) or
+        !section(img, h->v6_hosts, h->num_v6, img->v6_hosts) or
+        !section(img, h->hosts, h->num_hosts, img->hosts) or
+        !section(img, h->apps, h->num_apps, img->apps) or
+        !section(img, h->names, h->num_names, names) or
+        !section(img, h->chars, h->num_chars, chars) )
+        return false;
+
+    if ( !check_ranges(img->v4_keys, img->v4_hosts, h->num_v4, h->num_hosts) or
+        !check_ranges(img->v6_keys, img->v6_hosts, h->num_v6, h->num_hosts) )
+        return false;
+
+    for ( uint32_t i = 0; i < h->num_hosts; ++i )
+    {
+        const SfatImageHost& ih = img->hosts[i];
+
+        if ( ih.app > h->num_apps or ih.num_apps > h->num_apps - ih.app )
+            return false;
+    }
+
+    for ( uint32_t i = 0; i < h->num_apps; ++i )
+    {
+        if ( img->apps[i].ipproto >= h->num_names or img->apps[i].protocol >= h->num_names )
+            return false;
+    }
+
+    if ( !h->num_names or !h->num_chars or chars[h->num_chars - 1] )
+        return false;
+
+    img->protos.resize(h->num_names);
+
+    for ( uint32_t i = 0; i < h->num_names; ++i )
+    {
+        if ( names[i] >= h->num_chars )
+            return false;
+
+        const char* s = chars + names[i];
+        img->protos[i] = *s ? AddProtocolReference(s) : 0;
+    }
+    return true;
+}
+
+SfatImage* SFAT_MapImage(const char* file)
+{
+    int fd = open(file, O_RDONLY);
+
+    if ( fd < 0 )
+    {
+        ErrorMessage("can't open hosts image %s: %s\n", file, strerror(errno));
+        return nullptr;
+    }
+
+    struct stat st;
+    void* base = MAP_FAILED;
+
+    if ( !fstat(fd, &st) and st.st_size > 0 )
+        base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if ( base == MAP_FAILED )
+    {
+        ErrorMessage("can't map hosts image %s: %s\n", file, strerror(errno));
+        return nullptr;
+    }
+
+    SfatImage* img = new SfatImage;
+    img->base = (const uint8_t*)base;
+    img->size = st.st_size;
+
+    if ( !validate(img) )
+    {
+        ErrorMessage("invalid hosts image %s\n", file);
+        SFAT_UnmapImage(img);
+        return nullptr;
+    }
+    return img;
+}
+
+void SFAT_UnmapImage(SfatImage* img)
+{
+    if ( !img )
+        return;
+
+    munmap((void*)img->base, img->size);
+    delete img;
+}
+
+//-------------------------------------------------------------------------
+// lookup
+//-------------------------------------------------------------------------
+
+uint32_t SFAT_ImageHosts(const SfatImage* img)
+{ return img ? img->hdr->num_hosts : 0; }
+
+template<typename Key>
+static uint32_t find(const Key* keys, const uint32_t* hosts, uint32_t num, const Key& k)
+{
+    const Key* p = std::upper_bound(keys, keys + num, k);
+
+    if ( p == keys )
+        return SFAT_NO_HOST;
+
+    return hosts[p - keys - 1];
+}
+
+bool SFAT_ImageLookup(const SfatImage* img, const sfip_t* ip, HostAttributeEntry& host)
+{
+    uint32_t idx;
+
+    if ( ip->is_ip4() )
+        idx = find(img->v4_keys, img->v4_hosts, img->hdr->num_v4, key4(ip));
+
+    else if ( ip->is_ip6() )
+        idx = find(img->v6_keys, img->v6_hosts, img->hdr->num_v6, key6(ip));
+
+    else
+        return false;
+
+    if ( idx == SFAT_NO_HOST )
+        return false;
+
+    const SfatImageHost& ih = img->hosts[idx];
+
+    host.hostInfo.streamPolicy = ih.stream_policy;
+    host.hostInfo.fragPolicy = ih.frag_policy;
+    host.services = nullptr;
+    host.clients = nullptr;
+    host.image = img;
+    host.image_host = idx;
+
+    return true;
+}
+
+int16_t SFAT_ImageProtocolId(
+    const SfatImage* img, uint32_t host, int ipprotocol, uint16_t port)
+{
+    const SfatImageHost& ih = img->hosts[host];
+    const SfatImageApp* end = img->apps + ih.app + ih.num_apps;
+
+    const SfatImageApp* p = std::lower_bound(img->apps + ih.app, end, port,
+        [](const SfatImageApp& a, uint16_t v)
+        { return a.port < v; });
+
+    for ( ; p < end and p->port == port; ++p )
+    {
+        if ( img->protos[p->ipproto] == ipprotocol )
+            return img->protos[p->protocol];
+    }
+    return 0;
+}
+
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static sfip_t test_ip(int family, const char* s, int bits)
+{
+    sfip_t ip;
+    memset(&ip, 0, sizeof(ip));
+    ip.family = family;
+    ip.bits = bits;
+    inet_pton(family, s, ip.ip8);
+    return ip;
+}
+
+struct TestHosts
+{
+    HostAttributeEntry h[5];
+    ApplicationEntry a[3];
+    std::vector<const HostAttributeEntry*> hv;
+    std::string file;
+
+    int16_t tcp, http, ssh;
+
+    TestHosts()
+    {
+        InitializeProtocolReferenceTable();
+        tcp = AddProtocolReference("tcp");
+        http = AddProtocolReference("http");
+        ssh = AddProtocolReference("ssh");
+
+        memset(h, 0, sizeof(h));
+        memset(a, 0, sizeof(a));
+
+        h[0].ipAddr = test_ip(AF_INET, "10.0.0.0", 8);
+        h[1].ipAddr = test_ip(AF_INET, "10.1.0.0", 16);
+        h[2].ipAddr = test_ip(AF_INET, "10.1.2.3", 32);
+        h[3].ipAddr = test_ip(AF_INET6, "2001:db8::", 32);
+        h[4].ipAddr = test_ip(AF_INET6, "2001:db8::1", 128);
+
+        for ( unsigned i = 0; i < 5; ++i )
+        {
+            h[i].hostInfo.streamPolicy = i + 1;
+            h[i].hostInfo.fragPolicy = i + 11;
+            hv.push_back(h + i);
+        }
+
+        a[0].port = 80;
+        a[0].ipproto = tcp;
+        a[0].protocol = http;
+        a[1].port = 22;
+        a[1].ipproto = tcp;
+        a[1].protocol = ssh;
+        a[0].next = a + 1;
+        h[1].services = a;
+
+        a[2].port = 8080;
+        a[2].ipproto = tcp;
+        a[2].protocol = http;
+        h[4].services = a + 2;
+
+        char tmp[] = "/tmp/sfat_image_XXXXXX";
+        int fd = mkstemp(tmp);
+        if ( fd >= 0 )
+            close(fd);
+        file = tmp;
+    }
+
+    ~TestHosts()
+    { unlink(file.c_str()); }
+
+    std::vector<uint8_t> read()
+    {
+        std::vector<uint8_t> buf;
+        FILE* fh = fopen(file.c_str(), "rb");
+
+        if ( fh )
+        {
+            uint8_t b[4096];
+            size_t n;
+
+            while ( (n = fread(b, 1, sizeof(b), fh)) > 0 )
+                buf.insert(buf.end(), b, b + n);
+
+            fclose(fh);
+        }
+        return buf;
+    }
+
+    void write(const std::vector<uint8_t>& buf, size_t len)
+    {
+        FILE* fh = fopen(file.c_str(), "wb");
+
+        if ( fh )
+        {
+            if ( len )
+                fwrite(buf.data(), len, 1, fh);
+            fclose(fh);
+        }
+    }
+
+    // true if the modified image is rejected
+    template<typename F>
+    bool rejects(F f)
+    {
+        std::vector<uint8_t> buf = read();
+        f(buf);
+        write(buf, buf.size());
+
+        SfatImage* img = SFAT_MapImage(file.c_str());
+        SFAT_UnmapImage(img);
+        return img == nullptr;
+    }
+};
+
+static int lookup(const SfatImage* img, int family, const char* s, HostAttributeEntry& e)
+{
+    sfip_t ip = test_ip(family, s, family == AF_INET ? 32 : 128);
+    return SFAT_ImageLookup(img, &ip, e) ? e.hostInfo.streamPolicy : 0;
+}
+
+TEST_CASE("sfat image round trip", "[sfat_image]")
+{
+    TestHosts th;
+    REQUIRE(SFAT_WriteImage(th.file.c_str(), th.hv));
+    CHECK(SFAT_IsImage(th.file.c_str()));
+
+    SfatImage* img = SFAT_MapImage(th.file.c_str());
+    REQUIRE(img);
+    CHECK(SFAT_ImageHosts(img) == 5);
+
+    HostAttributeEntry e;
+
+    SECTION("most specific prefix")
+    {
+        CHECK(lookup(img, AF_INET, "9.255.255.255", e) == 0);
+        CHECK(lookup(img, AF_INET, "10.0.0.0", e) == 1);
+        CHECK(lookup(img, AF_INET, "10.2.0.1", e) == 1);
+        CHECK(lookup(img, AF_INET, "10.1.0.0", e) == 2);
+        CHECK(lookup(img, AF_INET, "10.1.2.2", e) == 2);
+        CHECK(lookup(img, AF_INET, "10.1.2.3", e) == 3);
+        CHECK(e.hostInfo.fragPolicy == 13);
+        CHECK(lookup(img, AF_INET, "10.1.2.4", e) == 2);
+        CHECK(lookup(img, AF_INET, "10.1.255.255", e) == 2);
+        CHECK(lookup(img, AF_INET, "10.255.255.255", e) == 1);
+        CHECK(lookup(img, AF_INET, "11.0.0.0", e) == 0);
+    }
+
+    SECTION("ipv6")
+    {
+        CHECK(lookup(img, AF_INET6, "2001:db7:ffff::", e) == 0);
+        CHECK(lookup(img, AF_INET6, "2001:db8::", e) == 4);
+        CHECK(lookup(img, AF_INET6, "2001:db8::1", e) == 5);
+        CHECK(lookup(img, AF_INET6, "2001:db8::2", e) == 4);
+        CHECK(lookup(img, AF_INET6, "2001:db9::", e) == 0);
+    }
+
+    SECTION("services")
+    {
+        REQUIRE(lookup(img, AF_INET, "10.1.9.9", e) == 2);
+        CHECK(e.image == img);
+        CHECK(SFAT_ImageProtocolId(img, e.image_host, th.tcp, 80) == th.http);
+        CHECK(SFAT_ImageProtocolId(img, e.image_host, th.tcp, 22) == th.ssh);
+        CHECK(SFAT_ImageProtocolId(img, e.image_host, th.tcp, 443) == 0);
+
+        REQUIRE(lookup(img, AF_INET6, "2001:db8::1", e) == 5);
+        CHECK(SFAT_ImageProtocolId(img, e.image_host, th.tcp, 8080) == th.http);
+
+        REQUIRE(lookup(img, AF_INET, "10.1.2.3", e) == 3);
+        CHECK(SFAT_ImageProtocolId(img, e.image_host, th.tcp, 80) == 0);
+    }
+
+    SFAT_UnmapImage(img);
+}
+
+TEST_CASE("sfat image rejects", "[sfat_image]")
+{
+    TestHosts th;
+    REQUIRE(SFAT_WriteImage(th.file.c_str(), th.hv));
+
+    std::vector<uint8_t> good = th.read();
+    REQUIRE(good.size() > sizeof(SfatImageHeader));
+
+    SfatImageHeader hdr;
+    memcpy(&hdr, good.data(), sizeof(hdr));
+
+    SECTION("empty")
+    {
+        th.write(good, 0);
+        CHECK(!SFAT_IsImage(th.file.c_str()));
+        CHECK(!SFAT_MapImage(th.file.c_str()));
+    }
+
+    SECTION("truncated")
+    {
+        for ( size_t n : { sizeof(hdr) - 1, sizeof(hdr), good.size() - 1 } )
+        {
+            th.write(good, n);
+            CHECK(!SFAT_MapImage(th.file.c_str()));
+        }
+    }
+
+    SECTION("magic")
+    {
+        CHECK(th.rejects([](std::vector<uint8_t>& b) { b[0] ^= 0xFF; }));
+    }
+
+    SECTION("version")
+    {
+        CHECK(th.rejects([](std::vector<uint8_t>& b)
+            { ((SfatImageHeader*)b.data())->version++; }));
+    }
+
+    SECTION("section out of bounds")
+    {
+        CHECK(th.rejects([](std::vector<uint8_t>& b)
+            { ((SfatImageHeader*)b.data())->num_apps = 0x10000000; }));
+    }
+
+    SECTION("misaligned section")
+    {
+        CHECK(th.rejects([](std::vector<uint8_t>& b)
+            { ((SfatImageHeader*)b.data())->hosts += 1; }));
+    }
+
+    SECTION("host index")
+    {
+        CHECK(th.rejects([&](std::vector<uint8_t>& b)
+            { ((uint32_t*)(b.data() + hdr.v4_hosts))[0] = hdr.num_hosts; }));
+    }
+
+    SECTION("unsorted keys")
+    {
+        CHECK(th.rejects([&](std::vector<uint8_t>& b)
+            {
+                uint32_t* k = (uint32_t*)(b.data() + hdr.v4_keys);
+                std::swap(k[0], k[1]);
+            }));
+    }
+
+    SECTION("service range")
+    {
+        CHECK(th.rejects([&](std::vector<uint8_t>& b)
+            { ((SfatImageHost*)(b.data() + hdr.hosts))[1].num_apps = hdr.num_apps + 1; }));
+    }
+
+    SECTION("protocol name")
+    {
+        CHECK(th.rejects([&](std::vector<uint8_t>& b)
+            { ((SfatImageApp*)(b.data() + hdr.apps))[0].protocol = hdr.num_names; }));
+    }
+
+    SECTION("unterminated names")
+    {
+        CHECK(th.rejects([&](std::vector<uint8_t>& b)
+            { b[hdr.chars + hdr.num_chars - 1] = 'x'; }));
+    }
+
+    SECTION("intact")
+    {
+        CHECK(!th.rejects([](std::vector<uint8_t>&) { }));
+    }
+}
+
+#endif
@@ -0,0 +1,67 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// sftarget_image.h
+
+#ifndef SFTARGET_IMAGE_H
+#define SFTARGET_IMAGE_H
+
+// A host attribute image is the hosts table compiled to a flat file that is
+// mapped read only instead of parsed, so large tables load in the time it
+// takes to validate the headers and the pages are shared with the page
+// cache (and any other process mapping the same file).
+//
+// Host prefixes are flattened into disjoint ranges, most specific first,
+// and stored as sorted range starts with a parallel array of host indices
+// so a lookup is a binary search.  Services are stored per host sorted by
+// port.  Protocols are stored by name and resolved to ids when mapped
+// since ids are assigned at run time.
+//
+// Images are in native byte order and are rejected if the magic, version,
+// or any section doesn't check out.
+
+#include <stdint.h>
+#include <vector>
+
+struct sfip_t;
+struct HostAttributeEntry;
+struct SfatImage;
+
+#define SFAT_IMAGE_VERSION 1
+
+// write hosts to file (via a temporary that is renamed into place)
+bool SFAT_WriteImage(const char* file, const std::vector<const HostAttributeEntry*>&);
+
+// true if file starts with an image header
+bool SFAT_IsImage(const char* file);
+
+// returns nullptr and logs the reason if file can't be used
+SfatImage* SFAT_MapImage(const char* file);
+void SFAT_UnmapImage(SfatImage*);
+
+uint32_t SFAT_ImageHosts(const SfatImage*);
+
+// sets the policies of host to those of the most specific host containing
+// ip and points host at its services; returns false if there is none
+bool SFAT_ImageLookup(const SfatImage*, const sfip_t* ip, HostAttributeEntry& host);
+
+// returns the service protocol of the given image host or 0
+int16_t SFAT_ImageProtocolId(
+    const SfatImage*, uint32_t host, int ipprotocol, uint16_t port);
+
+#endif
+
@@ -37,9 +37,13 @@
 #include <unistd.h>
 #include <time.h>
 
+#include <string>
+#include <vector>
+
 #include "snort_protocols.h"
 #include "sftarget_hostentry.h"
 #include "sftarget_data.h"
+#include "sftarget_image.h"
 
 #include "main/snort_config.h"
 #include "main/snort_debug.h"
@@ -56,7 +60,9 @@
 
 struct tTargetBasedConfig
 {
-    table_t* lookupTable;
+    table_t* lookupTable;  // configured and learned hosts
+    SfatImage* image;      // mapped hosts, shadowed by lookupTable
+    std::string image_file;
 
     tTargetBasedConfig();
     ~tTargetBasedConfig();
@@ -78,17 +84,22 @@ tTargetBasedConfig::tTargetBasedConfig()
     uint32_t max = snort_conf ?
         SnortConfig::get_max_attribute_hosts() : DEFAULT_MAX_ATTRIBUTE_HOSTS;
     lookupTable = sfrt_new(DIR_8x16, IPv6, max + 1, (max>>6) + 1);
+    image = nullptr;
 }
 
 tTargetBasedConfig::~tTargetBasedConfig()
 {
     sfrt_cleanup(lookupTable, SFAT_CleanupCallback);
     sfrt_free(lookupTable);
+    SFAT_UnmapImage(image);
 }
 
 static THREAD_LOCAL tTargetBasedConfig* curr_cfg = NULL;
 static tTargetBasedConfig* next_cfg = NULL;
 
+// image lookups are returned here; valid until the next lookup
+static THREAD_LOCAL HostAttributeEntry image_entry;
+
 static bool sfat_grammar_error_printed = false;
 static bool sfat_insufficient_space_logged = false;
 
@@ -97,7 +108,7 @@ uint32_t SFAT_NumberOfHosts(void)
 {
     if ( curr_cfg && curr_cfg->lookupTable )
     {
-        return sfrt_num_entries(curr_cfg->lookupTable);
+        return sfrt_num_entries(curr_cfg->lookupTable) + SFAT_ImageHosts(curr_cfg->image);
     }
 
     return 0;
@@ -295,7 +306,16 @@ HostAttributeEntry* SFAT_LookupHostEntryByIP(const sfip_t* ipAddr)
     if ( !curr_cfg )
         return NULL;
 
-    return (HostAttributeEntry*)sfrt_lookup((sfip_t*)ipAddr, curr_cfg->lookupTable);
+    HostAttributeEntry* host =
+        (HostAttributeEntry*)sfrt_lookup((sfip_t*)ipAddr, curr_cfg->lookupTable);
+
+    if ( host or !curr_cfg->image )
+        return host;
+
+    if ( !SFAT_ImageLookup(curr_cfg->image, ipAddr, image_entry) )
+        return NULL;
+
+    return &image_entry;
 }
 
 HostAttributeEntry* SFAT_LookupHostEntryBySrc(Packet* p)
@@ -346,10 +366,61 @@ void SFAT_Init()
 
 void SFAT_Start()
 {
+    if ( snort_conf and !snort_conf->hosts_image.empty() and
+        !SFAT_LoadImage(snort_conf->hosts_image.c_str()) )
+    {
+        ParseError("can't load hosts image %s", snort_conf->hosts_image.c_str());
+    }
+
     curr_cfg = next_cfg;
     next_cfg = new tTargetBasedConfig;
 }
 
+bool SFAT_LoadImage(const char* file)
+{
+    SfatImage* img = SFAT_MapImage(file);
+
+    if ( !img )
+        return false;
+
+    SFAT_UnmapImage(next_cfg->image);
+    next_cfg->image = img;
+    next_cfg->image_file = file;
+
+    LogMessage("%u hosts mapped from %s\n", SFAT_ImageHosts(img), file);
+    return true;
+}
+
+bool SFAT_KeepImage()
+{
+    if ( !curr_cfg or curr_cfg->image_file.empty() or next_cfg->image )
+        return true;
+
+    // mapped again rather than shared since each config unmaps its own
+    std::string file = curr_cfg->image_file;
+    return SFAT_LoadImage(file.c_str());
+}
+
+static std::vector<const HostAttributeEntry*>* dump_hosts = nullptr;
+
+static void SFAT_DumpCallback(void* host_attr_ent)
+{
+    dump_hosts->push_back((const HostAttributeEntry*)host_attr_ent);
+}
+
+bool SFAT_DumpImage(const char* file)
+{
+    std::vector<const HostAttributeEntry*> hosts;
+
+    if ( curr_cfg )
+    {
+        dump_hosts = &hosts;
+        sfrt_iterate(curr_cfg->lookupTable, SFAT_DumpCallback);
+        dump_hosts = nullptr;
+    }
+    return SFAT_WriteImage(file, hosts);
+}
+
 tTargetBasedConfig* SFAT_Swap()
 {
     curr_cfg = next_cfg;
@@ -380,6 +451,14 @@ void SFAT_UpdateApplicationProtocol(sfip_t* ipAddr, uint16_t port, uint16_t prot
         host_entry = (HostAttributeEntry*)SnortAlloc(sizeof(*host_entry));
         sfip_set_ip(&host_entry->ipAddr, ipAddr);
 
+        // keep the policies and services of a mapped host visible
+        if ( curr_cfg->image and SFAT_ImageLookup(curr_cfg->image, ipAddr, image_entry) )
+        {
+            host_entry->hostInfo = image_entry.hostInfo;
+            host_entry->image = image_entry.image;
+            host_entry->image_host = image_entry.image_host;
+        }
+
         if ((rval = sfrt_insert(ipAddr, (unsigned char)ipAddr->bits, host_entry,
                 RT_FAVOR_SPECIFIC, curr_cfg->lookupTable)) != RT_SUCCESS)
         {
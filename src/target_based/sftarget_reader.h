@@ -65,5 +65,15 @@ tTargetBasedConfig* SFAT_GetConfig();
 void SFAT_SetConfig(tTargetBasedConfig*);
 void SFAT_Free(tTargetBasedConfig*);
 
+// map a compiled hosts image into the next config
+bool SFAT_LoadImage(const char* file);
+
+// map the current config's image into the next config (if it has one)
+// so a reload of configured hosts doesn't drop the mapped hosts
+bool SFAT_KeepImage();
+
+// compile the current hosts table to an image
+bool SFAT_DumpImage(const char* file);
+
 #endif
 
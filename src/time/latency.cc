@@ -0,0 +1,449 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// latency.cc
+
+#include "latency.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <chrono>
+#include <mutex>
+
+#ifdef UNIT_TEST
+#include <thread>
+#include "catch/catch.hpp"
+#endif
+
+THREAD_LOCAL bool latency_enabled = false;
+
+THREAD_LOCAL uint64_t Latency::t_first = 0;
+THREAD_LOCAL uint64_t Latency::t_last = 0;
+THREAD_LOCAL uint64_t Latency::t_lap[LS_TOTAL];
+THREAD_LOCAL unsigned Latency::t_used = 0;
+
+static THREAD_LOCAL LatencyStats* t_interval = nullptr;
+static THREAD_LOCAL LatencyStats* t_total = nullptr;
+
+// both protected by s_total_mutex
+static LatencyStats* s_total = nullptr;
+static LatencyStats* s_interval = nullptr;
+static std::mutex s_total_mutex;
+
+static const char* s_names[LS_MAX] =
+{
+    "decode",
+    "flow",
+    "stream",
+    "inspectors",
+    "detection",
+    "logging",
+    "verdict",
+    "total"
+};
+
+//-------------------------------------------------------------------------
+// histogram
+//-------------------------------------------------------------------------
+
+unsigned LatencyHistogram::get_bucket(uint64_t v)
+{
+    if ( v < SUB_COUNT )
+        return (unsigned)v;
+
+    if ( v >> MAX_BITS )
+        return NUM_BUCKETS - 1;
+
+    unsigned msb = 63 - __builtin_clzll(v);
+    unsigned shift = msb - (SUB_BITS - 1);
+    unsigned top = (unsigned)(v >> shift);
+
+    return SUB_COUNT + (shift - 1) * HALF_COUNT + (top - HALF_COUNT);
+}
+
+uint64_t LatencyHistogram::get_value(unsigned bucket)
+{
+    if ( bucket < SUB_COUNT )
+        return bucket;
+
+    unsigned j = bucket - SUB_COUNT;
+    unsigned shift = j / HALF_COUNT + 1;
+    uint64_t top = j % HALF_COUNT + HALF_COUNT;
+
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::add(uint64_t ticks)
+{
+    ++buckets[get_bucket(ticks)];
+    ++count;
+
+    if ( ticks > max )
+        max = ticks;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& rhs)
+{
+    if ( !rhs.count )
+        return;
+
+    for ( unsigned i = 0; i < NUM_BUCKETS; ++i )
+        buckets[i] += rhs.buckets[i];
+
+    count += rhs.count;
+
+    if ( rhs.max > max )
+        max = rhs.max;
+}
+
+void LatencyHistogram::reset()
+{
+    count = max = 0;
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint64_t LatencyHistogram::get_percentile(double pct) const
+{
+    if ( !count )
+        return 0;
+
+    uint64_t rank = (uint64_t)(pct / 100.0 * count + 0.5);
+
+    if ( rank < 1 )
+        rank = 1;
+
+    else if ( rank >= count )
+        return max;
+
+    uint64_t sum = 0;
+
+    for ( unsigned i = 0; i < NUM_BUCKETS; ++i )
+    {
+        sum += buckets[i];
+
+        if ( sum >= rank )
+        {
+            uint64_t v = get_value(i);
+            return v < max ? v : max;
+        }
+    }
+    return max;
+}
+
+//-------------------------------------------------------------------------
+// stats
+//-------------------------------------------------------------------------
+
+void LatencyStats::merge(const LatencyStats& rhs)
+{
+    for ( unsigned i = 0; i < LS_MAX; ++i )
+        stage[i].merge(rhs.stage[i]);
+}
+
+void LatencyStats::reset()
+{
+    for ( unsigned i = 0; i < LS_MAX; ++i )
+        stage[i].reset();
+}
+
+//-------------------------------------------------------------------------
+// recorder
+//-------------------------------------------------------------------------
+
+void Latency::thread_init()
+{
+    if ( !t_interval )
+    {
+        t_interval = new LatencyStats;
+        t_total = new LatencyStats;
+    }
+    get_ticks_per_us();  // calibrate before the first packet
+    latency_enabled = true;
+}
+
+void Latency::thread_term()
+{
+    if ( !t_interval )
+        return;
+
+    latency_enabled = false;
+    t_total->merge(*t_interval);
+
+    {
+        std::lock_guard<std::mutex> lock(s_total_mutex);
+
+        if ( !s_total )
+            s_total = new LatencyStats;
+
+        s_total->merge(*t_total);
+    }
+
+    delete t_interval;
+    delete t_total;
+    t_interval = t_total = nullptr;
+}
+
+void Latency::record()
+{
+    uint64_t now = 0;
+    get_clockticks(now);
+
+    t_lap[LS_VERDICT] += now - t_last;
+    t_used |= (1 << LS_VERDICT);
+
+    for ( unsigned i = 0; i < LS_TOTAL; ++i )
+    {
+        if ( t_used & (1 << i) )
+            t_interval->stage[i].add(t_lap[i]);
+    }
+    t_interval->stage[LS_TOTAL].add(now - t_first);
+}
+
+const LatencyStats* Latency::get_interval()
+{ return t_interval; }
+
+void Latency::reset_interval()
+{
+    if ( !t_interval )
+        return;
+
+    t_total->merge(*t_interval);
+    t_interval->reset();
+}
+
+void Latency::publish_interval()
+{
+    if ( !t_interval )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(s_total_mutex);
+
+        if ( !s_interval )
+            s_interval = new LatencyStats;
+
+        s_interval->merge(*t_interval);
+    }
+    reset_interval();
+}
+
+bool Latency::take_interval(LatencyStats& ls)
+{
+    std::lock_guard<std::mutex> lock(s_total_mutex);
+
+    if ( !s_interval or !s_interval->stage[LS_TOTAL].get_count() )
+        return false;
+
+    ls = *s_interval;
+    s_interval->reset();
+    return true;
+}
+
+const LatencyStats* Latency::get_thread_total()
+{
+    reset_interval();
+    return t_total;
+}
+
+const LatencyStats* Latency::get_total()
+{
+    std::lock_guard<std::mutex> lock(s_total_mutex);
+    return s_total;
+}
+
+const char* Latency::get_name(LatencyStage s)
+{ return s_names[s]; }
+
+// calibrated against the steady clock over a few ms instead of the 1 s
+// sleep of ::get_ticks_per_usec() so enabling latency doesn't stall startup
+double Latency::get_ticks_per_us()
+{
+    static double ticks_per_us = []()
+    {
+        using namespace std::chrono;
+        uint64_t t0 = 0, t1 = 0;
+
+        auto c0 = steady_clock::now();
+        get_clockticks(t0);
+
+        while ( steady_clock::now() - c0 < milliseconds(10) )
+            ;
+
+        get_clockticks(t1);
+        auto us = duration_cast<nanoseconds>(steady_clock::now() - c0).count() / 1000.0;
+
+        return (t1 > t0 and us > 0) ? (t1 - t0) / us : 1.0;
+    } ();
+
+    return ticks_per_us;
+}
+
+#ifdef UNIT_TEST
+
+TEST_CASE( "latency histogram buckets", "[latency]" )
+{
+    SECTION( "small values are exact" )
+    {
+        for ( unsigned v = 0; v < LatencyHistogram::SUB_COUNT; ++v )
+        {
+            CHECK( LatencyHistogram::get_bucket(v) == v );
+            CHECK( LatencyHistogram::get_value(v) == v );
+        }
+    }
+
+    SECTION( "buckets are contiguous" )
+    {
+        uint64_t lo = 0;
+
+        for ( unsigned b = 0; b < LatencyHistogram::NUM_BUCKETS; ++b )
+        {
+            uint64_t hi = LatencyHistogram::get_value(b);
+            CHECK( LatencyHistogram::get_bucket(lo) == b );
+            CHECK( LatencyHistogram::get_bucket(hi) == b );
+            lo = hi + 1;
+        }
+        CHECK( lo == (uint64_t)1 << LatencyHistogram::MAX_BITS );
+    }
+
+    SECTION( "relative error is bounded" )
+    {
+        for ( uint64_t v = 1000; v < ((uint64_t)1 << 36); v = v * 3 + 7 )
+        {
+            uint64_t hi = LatencyHistogram::get_value(LatencyHistogram::get_bucket(v));
+            CHECK( hi >= v );
+            CHECK( hi - v <= v / LatencyHistogram::HALF_COUNT );
+        }
+    }
+
+    SECTION( "large values are clamped" )
+    {
+        CHECK( LatencyHistogram::get_bucket(~(uint64_t)0) ==
+            LatencyHistogram::NUM_BUCKETS - 1 );
+    }
+}
+
+TEST_CASE( "latency histogram percentiles", "[latency]" )
+{
+    LatencyHistogram h;
+
+    CHECK( h.get_percentile(50.0) == 0 );
+
+    for ( uint64_t v = 1; v <= 10000; ++v )
+        h.add(v);
+
+    CHECK( h.get_count() == 10000 );
+    CHECK( h.get_max() == 10000 );
+
+    uint64_t p50 = h.get_percentile(50.0);
+    uint64_t p99 = h.get_percentile(99.0);
+
+    CHECK( p50 >= 5000 );
+    CHECK( p50 <= 5000 + 5000 / LatencyHistogram::HALF_COUNT );
+    CHECK( p99 >= 9900 );
+    CHECK( p99 <= 10000 );
+    CHECK( h.get_percentile(100.0) == 10000 );
+
+    SECTION( "merge" )
+    {
+        LatencyHistogram g;
+        g.add(1000000);
+        g.merge(h);
+
+        CHECK( g.get_count() == 10001 );
+        CHECK( g.get_max() == 1000000 );
+        CHECK( g.get_percentile(50.0) == p50 );
+        CHECK( g.get_percentile(100.0) == 1000000 );
+    }
+
+    SECTION( "reset" )
+    {
+        h.reset();
+        CHECK( h.get_count() == 0 );
+        CHECK( h.get_max() == 0 );
+    }
+}
+
+TEST_CASE( "latency recorder", "[latency]" )
+{
+    Latency::start();
+    Latency::stop();
+    CHECK( !Latency::get_interval() );
+
+    Latency::thread_init();
+    CHECK( latency_enabled );
+
+    Latency::start();
+    Latency::lap(LS_DECODE);
+    Latency::lap(LS_DETECT);
+    Latency::lap(LS_DETECT);
+    Latency::stop();
+
+    const LatencyStats* ls = Latency::get_interval();
+    REQUIRE( ls );
+    CHECK( ls->stage[LS_DECODE].get_count() == 1 );
+    CHECK( ls->stage[LS_DETECT].get_count() == 1 );
+    CHECK( ls->stage[LS_FLOW].get_count() == 0 );
+    CHECK( ls->stage[LS_VERDICT].get_count() == 1 );
+    CHECK( ls->stage[LS_TOTAL].get_count() == 1 );
+
+    Latency::reset_interval();
+    CHECK( Latency::get_interval()->stage[LS_TOTAL].get_count() == 0 );
+    CHECK( Latency::get_thread_total()->stage[LS_TOTAL].get_count() == 1 );
+
+    Latency::thread_term();
+    CHECK( !latency_enabled );
+    REQUIRE( Latency::get_total() );
+    CHECK( Latency::get_total()->stage[LS_DECODE].get_count() == 1 );
+}
+
+TEST_CASE( "latency process interval", "[latency]" )
+{
+    LatencyStats* ls = new LatencyStats;
+    CHECK( !Latency::take_interval(*ls) );
+
+    auto run = [](unsigned n)
+    {
+        Latency::thread_init();
+
+        for ( unsigned i = 0; i < n; ++i )
+        {
+            Latency::start();
+            Latency::lap(LS_DECODE);
+            Latency::stop();
+        }
+        Latency::publish_interval();
+        Latency::thread_term();
+    };
+    std::thread t1(run, 3);
+    t1.join();
+    std::thread t2(run, 4);
+    t2.join();
+
+    REQUIRE( Latency::take_interval(*ls) );
+    CHECK( ls->stage[LS_DECODE].get_count() == 7 );
+    CHECK( ls->stage[LS_TOTAL].get_count() == 7 );
+    CHECK( !Latency::take_interval(*ls) );
+
+    delete ls;
+}
+
+#endif
+
@@ -0,0 +1,170 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// latency.h
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Per packet latency by processing stage.  Each packet thread laps a clock
+// at the stage boundaries and adds the time spent in each stage of a wire
+// packet to a log bucketed (HDR style) histogram of that stage.  Rebuilt
+// and pseudo packets are charged to the wire packet that caused them.
+//
+// Recording is thread local and off unless a consumer (perf_monitor)
+// enables it; the lap is then a tick read and an add.  Histograms are
+// merged on demand: the consumer reads the interval histograms of its own
+// thread or publishes them to a process interval that another thread
+// takes, and the thread totals are merged into a process total at exit.
+
+#include <stdint.h>
+
+#include "main/snort_types.h"
+#include "main/thread.h"
+#include "time/cpuclock.h"
+
+enum LatencyStage
+{
+    LS_DECODE,
+    LS_FLOW,
+    LS_STREAM,
+    LS_INSPECT,
+    LS_DETECT,
+    LS_LOG,
+    LS_VERDICT,
+    LS_TOTAL,
+    LS_MAX
+};
+
+// values are bucketed with 2^(SUB_BITS-1) linear sub buckets per power of
+// 2 so the relative error is < 1/32; values >= 2^MAX_BITS ticks are
+// clamped but still count toward max.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+    { reset(); }
+
+    void add(uint64_t ticks);
+    void merge(const LatencyHistogram&);
+    void reset();
+
+    uint64_t get_count() const
+    { return count; }
+
+    uint64_t get_max() const
+    { return max; }
+
+    // pct in [0, 100]; returns the highest value equivalent to the bucket
+    // holding the pct'th value (capped at max) or 0 if empty
+    uint64_t get_percentile(double pct) const;
+
+    static const unsigned SUB_BITS = 6;
+    static const unsigned MAX_BITS = 40;
+    static const unsigned SUB_COUNT = 1 << SUB_BITS;
+    static const unsigned HALF_COUNT = SUB_COUNT / 2;
+    static const unsigned NUM_BUCKETS = SUB_COUNT + (MAX_BITS - SUB_BITS) * HALF_COUNT;
+
+    static unsigned get_bucket(uint64_t);
+    static uint64_t get_value(unsigned bucket);
+
+private:
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[NUM_BUCKETS];
+};
+
+struct LatencyStats
+{
+    LatencyHistogram stage[LS_MAX];
+
+    void merge(const LatencyStats&);
+    void reset();
+};
+
+SO_PUBLIC extern THREAD_LOCAL bool latency_enabled;
+
+class SO_PUBLIC Latency
+{
+public:
+    // thread_init allocates the histograms and enables recording;
+    // thread_term merges the thread total into the process total
+    static void thread_init();
+    static void thread_term();
+
+    static void start()
+    {
+        if ( !latency_enabled )
+            return;
+
+        get_clockticks(t_last);
+        t_first = t_last;
+        t_used = 0;
+
+        for ( unsigned i = 0; i < LS_TOTAL; ++i )
+            t_lap[i] = 0;
+    }
+
+    // charge the time since the last lap to stage
+    static void lap(LatencyStage s)
+    {
+        if ( !latency_enabled )
+            return;
+
+        uint64_t now = 0;
+        get_clockticks(now);
+        t_lap[s] += now - t_last;
+        t_used |= (1 << s);
+        t_last = now;
+    }
+
+    static void stop()
+    {
+        if ( latency_enabled )
+            record();
+    }
+
+    // samples since the last reset_interval() (this thread)
+    static const LatencyStats* get_interval();
+    static void reset_interval();
+
+    // merge this thread's interval into the process interval, then reset it
+    static void publish_interval();
+
+    // copy and clear the process interval; false if nothing was published
+    static bool take_interval(LatencyStats&);
+
+    // samples since thread_init() (this thread)
+    static const LatencyStats* get_thread_total();
+
+    // merge of all terminated threads; null if none recorded
+    static const LatencyStats* get_total();
+
+    static const char* get_name(LatencyStage);
+    static double get_ticks_per_us();
+
+private:
+    static void record();
+
+    static THREAD_LOCAL uint64_t t_first;
+    static THREAD_LOCAL uint64_t t_last;
+    static THREAD_LOCAL uint64_t t_lap[LS_TOTAL];
+    static THREAD_LOCAL unsigned t_used;
+};
+
+#endif
+
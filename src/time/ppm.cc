@@ -51,6 +51,7 @@
 #include <unistd.h>
 #include <syslog.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include "ppm_module.h"
 #include "main/snort_types.h"
@@ -67,6 +68,10 @@
 #include "utils/stats.h"
 #include "utils/util.h"
 #include "sfip/sf_ip.h"
+#include "main/snort_config.h"
+#include "packet_io/sfdaq.h"
+#include "flow/flow.h"
+#include "stream/stream_api.h"
 
 #ifdef PPM_MGR
 
@@ -78,6 +83,11 @@
 #define PPM_DEFAULT_MAX_SUSP_SECS   60
 #define PPM_DEFAULT_RULE_THRESHOLD   5
 
+#define PPM_DEFAULT_LOAD_WINDOW_MSECS  100
+#define PPM_DEFAULT_LOAD_HOLD           10
+#define PPM_DEFAULT_SHALLOW_DEPTH     2048
+#define PPM_DEFAULT_ELEPHANT_BYTES    (1024 * 1024)
+
 PPM_TICKS ppm_tpu = 0; /* ticks per usec */
 
 static ppm_stats_t g_ppm_stats;
@@ -95,6 +105,18 @@ THREAD_LOCAL uint64_t ppm_cur_time = 0;
 THREAD_LOCAL int ppm_abort_this_pkt = 0;
 THREAD_LOCAL int ppm_suspend_this_rule = 0;
 
+/* load shedding */
+THREAD_LOCAL unsigned ppm_load_level = PPM_LOAD_NORMAL;
+
+static const char* ppm_load_names[PPM_LOAD_MAX] =
+{
+    "normal",
+    "no pcre",
+    "shallow",
+    "fast pattern only",
+    "bypass elephants"
+};
+
 #define MAX_DP_NRULES 1000
 typedef struct
 {
@@ -220,6 +242,23 @@ void ppm_print_cfg(ppm_cfg_t* ppm_cfg)
             LogMessage("none ");
         LogMessage("\n");
     }
+
+    if ( ppm_cfg->max_load_level )
+    {
+        LogMessage("\n");
+        LogMessage("Load Shedding Config:\n");
+        LogMessage("  max load level  : %u (%s)\n", ppm_cfg->max_load_level,
+            ppm_load_names[ppm_cfg->max_load_level]);
+        LogMessage("  window          : %lu usecs\n",
+            (unsigned long)(ppm_cfg->load_window_ticks/ppm_tpu));
+        LogMessage("  max packet time : %lu usecs\n",
+            (unsigned long)(ppm_cfg->load_max_pkt_ticks/ppm_tpu));
+        LogMessage("  max lag         : %lu usecs\n", (unsigned long)ppm_cfg->load_max_lag);
+        LogMessage("  max drops       : %g%%\n", ppm_cfg->load_max_drop);
+        LogMessage("  hold            : %u windows\n", ppm_cfg->load_hold);
+        LogMessage("  shallow depth   : %u bytes\n", ppm_cfg->shallow_depth);
+        LogMessage("  elephant flow   : %lu bytes\n", (unsigned long)ppm_cfg->elephant_bytes);
+    }
 }
 
 static int print_rule(int, RuleTreeNode*, OptTreeNode* o)
@@ -248,6 +287,17 @@ void ppm_sum_stats()
     g_ppm_stats.tot_nc_rules += ppm_stats.tot_nc_rules;
     g_ppm_stats.tot_pcre_rule_time += ppm_stats.tot_pcre_rule_time;
     g_ppm_stats.tot_pcre_rules += ppm_stats.tot_pcre_rules;
+
+    g_ppm_stats.load_ups += ppm_stats.load_ups;
+    g_ppm_stats.load_downs += ppm_stats.load_downs;
+
+    for ( unsigned i = 0; i < PPM_LOAD_MAX; ++i )
+        g_ppm_stats.load_pkts[i] += ppm_stats.load_pkts[i];
+
+    g_ppm_stats.load_pcre_skips += ppm_stats.load_pcre_skips;
+    g_ppm_stats.load_nfp_skips += ppm_stats.load_nfp_skips;
+    g_ppm_stats.load_shallow += ppm_stats.load_shallow;
+    g_ppm_stats.load_bypass += ppm_stats.load_bypass;
 }
 
 void ppm_print_summary(ppm_cfg_t* ppm_cfg)
@@ -301,6 +351,27 @@ void ppm_print_summary(ppm_cfg_t* ppm_cfg)
 
         fpWalkOtns(0, print_rule);
     }
+
+    if (ppm_cfg->max_load_level)
+    {
+        LogLabel("load shedding");
+
+        LogCount("level increases", g_ppm_stats.load_ups);
+        LogCount("level decreases", g_ppm_stats.load_downs);
+
+        uint64_t tot = 0;
+
+        for ( unsigned i = 0; i < PPM_LOAD_MAX; ++i )
+            tot += g_ppm_stats.load_pkts[i];
+
+        for ( unsigned i = 0; i <= ppm_cfg->max_load_level; ++i )
+            LogStat(ppm_load_names[i], g_ppm_stats.load_pkts[i], tot);
+
+        LogCount("pcre skipped", g_ppm_stats.load_pcre_skips);
+        LogCount("nfp rules skipped", g_ppm_stats.load_nfp_skips);
+        LogCount("depths capped", g_ppm_stats.load_shallow);
+        LogCount("flows bypassed", g_ppm_stats.load_bypass);
+    }
 }
 
 double ppm_ticks_to_usecs(PPM_TICKS ticks)
@@ -331,6 +402,11 @@ void ppm_init(ppm_cfg_t* ppm_cfg)
     ppm_cfg->max_suspend_ticks *= ppm_tpu;
 #endif
     ppm_cfg->rule_threshold = PPM_DEFAULT_RULE_THRESHOLD;
+
+    ppm_cfg->load_window_ticks = (PPM_TICKS)PPM_DEFAULT_LOAD_WINDOW_MSECS * 1000 * ppm_tpu;
+    ppm_cfg->load_hold = PPM_DEFAULT_LOAD_HOLD;
+    ppm_cfg->shallow_depth = PPM_DEFAULT_SHALLOW_DEPTH;
+    ppm_cfg->elephant_bytes = PPM_DEFAULT_ELEPHANT_BYTES;
 }
 
 /*
@@ -529,5 +605,208 @@ void ppm_set_rule_threshold(ppm_cfg_t* ppm_cfg, unsigned int cnt)
     ppm_cfg->rule_threshold = cnt;
 }
 
+void ppm_set_max_load_level(ppm_cfg_t* ppm_cfg, unsigned level)
+{
+    ppm_cfg->max_load_level = (level < PPM_LOAD_MAX) ? level : PPM_LOAD_MAX - 1;
+}
+
+void ppm_set_load_window(ppm_cfg_t* ppm_cfg, unsigned msecs)
+{
+    ppm_cfg->load_window_ticks = (PPM_TICKS)msecs * 1000 * ppm_tpu;
+}
+
+void ppm_set_load_max_pkt_time(ppm_cfg_t* ppm_cfg, PPM_USECS usecs)
+{
+    ppm_cfg->load_max_pkt_ticks = usecs * ppm_tpu;
+}
+
+void ppm_set_load_max_lag(ppm_cfg_t* ppm_cfg, PPM_USECS usecs)
+{
+    ppm_cfg->load_max_lag = usecs;
+}
+
+void ppm_set_load_max_drop(ppm_cfg_t* ppm_cfg, double pct)
+{
+    ppm_cfg->load_max_drop = pct;
+}
+
+void ppm_set_load_hold(ppm_cfg_t* ppm_cfg, unsigned windows)
+{
+    ppm_cfg->load_hold = windows;
+}
+
+void ppm_set_shallow_depth(ppm_cfg_t* ppm_cfg, uint32_t bytes)
+{
+    ppm_cfg->shallow_depth = bytes;
+}
+
+void ppm_set_elephant_bytes(ppm_cfg_t* ppm_cfg, uint64_t bytes)
+{
+    ppm_cfg->elephant_bytes = bytes;
+}
+
+/*
+ * Load shedding
+ *
+ * Each limit is converted to a load factor = measured / limit and the
+ * level is raised one step at the end of any window with a factor > 1.
+ * It is lowered one step only after load_hold consecutive windows with
+ * all factors < 0.5 so the level doesn't flap around a limit.  The drop
+ * rate and lag are only meaningful live so they are ignored when reading
+ * pcaps.  DAQ queue depth isn't available from the DAQ API so the lag
+ * between capture and processing of the last packet in the window is
+ * used instead; it grows with the backlog.
+ */
+static THREAD_LOCAL PPM_TICKS load_window_start = 0;
+static THREAD_LOCAL PPM_TICKS load_pkt_start = 0;
+static THREAD_LOCAL PPM_TICKS load_busy = 0;
+static THREAD_LOCAL uint64_t load_pkts = 0;
+static THREAD_LOCAL unsigned load_quiet = 0;
+
+static THREAD_LOCAL uint64_t load_daq_rx = 0;
+static THREAD_LOCAL uint64_t load_daq_drop = 0;
+
+static double ppm_load_factor(const ppm_cfg_t* ppm_cfg, const DAQ_PktHdr_t* pkth)
+{
+    double load = 0.0;
+
+    if ( ppm_cfg->load_max_pkt_ticks && load_pkts )
+    {
+        double f = (double)load_busy / load_pkts / ppm_cfg->load_max_pkt_ticks;
+
+        if ( f > load )
+            load = f;
+    }
+
+    if ( SnortConfig::read_mode() )
+        return load;
+
+    if ( ppm_cfg->load_max_lag )
+    {
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+
+        int64_t lag = (int64_t)(now.tv_sec - pkth->ts.tv_sec) * 1000000 +
+            (now.tv_usec - pkth->ts.tv_usec);
+
+        double f = (lag > 0) ? (double)lag / ppm_cfg->load_max_lag : 0.0;
+
+        if ( f > load )
+            load = f;
+    }
+
+    if ( ppm_cfg->load_max_drop > 0.0 )
+    {
+        const DAQ_Stats_t* ds = DAQ_GetStats();
+        uint64_t rx = ds->hw_packets_received;
+        uint64_t drop = ds->hw_packets_dropped;
+
+        // counters restart with the daq
+        if ( rx >= load_daq_rx and drop >= load_daq_drop and rx > load_daq_rx )
+        {
+            double pct = 100.0 * (drop - load_daq_drop) / (rx - load_daq_rx);
+            double f = pct / ppm_cfg->load_max_drop;
+
+            if ( f > load )
+                load = f;
+        }
+        load_daq_rx = rx;
+        load_daq_drop = drop;
+    }
+    return load;
+}
+
+static void ppm_load_set(unsigned level, double load)
+{
+    LogMessage("PPM: load level %u (%s) -> %u (%s), load factor %.2f\n",
+        ppm_load_level, ppm_load_names[ppm_load_level],
+        level, ppm_load_names[level], load);
+
+    if ( level > ppm_load_level )
+        ppm_stats.load_ups++;
+    else
+        ppm_stats.load_downs++;
+
+    ppm_load_level = level;
+    load_quiet = 0;
+}
+
+void ppm_load_begin()
+{
+    cputime(load_pkt_start);
+
+    if ( !load_window_start )
+        load_window_start = load_pkt_start;
+}
+
+void ppm_load_end(const DAQ_PktHdr_t* pkth)
+{
+    PPM_TICKS now;
+    cputime(now);
+
+    load_busy += now - load_pkt_start;
+    load_pkts++;
+    ppm_stats.load_pkts[ppm_load_level]++;
+
+    const ppm_cfg_t* ppm_cfg = snort_conf->ppm_cfg;
+
+    if ( now - load_window_start < ppm_cfg->load_window_ticks )
+        return;
+
+    double load = ppm_load_factor(ppm_cfg, pkth);
+
+    if ( load > 1.0 )
+    {
+        if ( ppm_load_level < ppm_cfg->max_load_level )
+            ppm_load_set(ppm_load_level + 1, load);
+        else
+            load_quiet = 0;
+    }
+    else if ( load < 0.5 and ppm_load_level > PPM_LOAD_NORMAL )
+    {
+        if ( ++load_quiet >= ppm_cfg->load_hold )
+            ppm_load_set(ppm_load_level - 1, load);
+    }
+    else
+        load_quiet = 0;
+
+    load_window_start = now;
+    load_busy = 0;
+    load_pkts = 0;
+}
+
+void ppm_load_shallow(int64_t& detect_depth, int64_t& file_depth)
+{
+    int64_t max = snort_conf->ppm_cfg->shallow_depth;
+    bool capped = false;
+
+    if ( detect_depth > max )
+    {
+        detect_depth = max;
+        capped = true;
+    }
+    if ( file_depth > max )
+    {
+        file_depth = max;
+        capped = true;
+    }
+    if ( capped )
+        ppm_stats.load_shallow++;
+}
+
+bool ppm_load_bypass(Packet* p)
+{
+    Flow* flow = p->flow;
+
+    if ( !flow or !flow->session or
+        flow->byte_count < snort_conf->ppm_cfg->elephant_bytes )
+        return false;
+
+    // same as a stream bypass; flush what is queued and allow the rest
+    stream.stop_inspection(flow, p, SSN_DIR_BOTH, -1, 0);
+    ppm_stats.load_bypass++;
+    return true;
+}
+
 #endif
 
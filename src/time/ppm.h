@@ -35,12 +35,25 @@
 #include "time/cpuclock.h"
 #include "detection/detection_options.h"
 
+struct _daq_pkthdr;
+
 #define cputime get_clockticks
 
 typedef uint64_t PPM_TICKS;
 typedef uint64_t PPM_USECS;
 typedef unsigned int PPM_SECS;
 
+// load shedding levels; each level includes the ones below it
+enum PpmLoadLevel
+{
+    PPM_LOAD_NORMAL,
+    PPM_LOAD_NO_PCRE,       // skip pcre options
+    PPM_LOAD_SHALLOW,       // cap http body and file depth
+    PPM_LOAD_FAST_PATTERN,  // skip rules without a fast pattern
+    PPM_LOAD_BYPASS,        // whitelist elephant flows
+    PPM_LOAD_MAX
+};
+
 struct ppm_cfg_t
 {
     // config section
@@ -57,6 +70,18 @@ struct ppm_cfg_t
     int rule_action; // suspend
 
     uint64_t max_suspend_ticks;
+
+    // load shedding section; off if max_load_level is 0
+    unsigned max_load_level;
+    unsigned load_hold;         // quiet windows before stepping down
+
+    PPM_TICKS load_window_ticks;
+    PPM_TICKS load_max_pkt_ticks;
+    PPM_USECS load_max_lag;
+    double load_max_drop;       // percent
+
+    uint32_t shallow_depth;
+    uint64_t elephant_bytes;
 };
 
 struct ppm_stats_t
@@ -76,6 +101,14 @@ struct ppm_stats_t
 
     uint64_t tot_pcre_rule_time;   // ticks
     uint64_t tot_pcre_rules;
+
+    uint64_t load_ups;
+    uint64_t load_downs;
+    uint64_t load_pkts[PPM_LOAD_MAX];
+    uint64_t load_pcre_skips;
+    uint64_t load_nfp_skips;
+    uint64_t load_shallow;
+    uint64_t load_bypass;
 };
 
 extern THREAD_LOCAL ppm_stats_t ppm_stats;
@@ -109,6 +142,7 @@ extern THREAD_LOCAL unsigned int ppm_rule_times_index;
 extern THREAD_LOCAL uint64_t ppm_cur_time;
 extern THREAD_LOCAL int ppm_abort_this_pkt;
 extern THREAD_LOCAL int ppm_suspend_this_rule;
+extern THREAD_LOCAL unsigned ppm_load_level;
 
 #define PPM_LOG_ALERT      1
 #define PPM_LOG_MESSAGE    2
@@ -118,6 +152,10 @@ extern THREAD_LOCAL int ppm_suspend_this_rule;
 #define PPM_ENABLED()                 (snort_conf->ppm_cfg->enabled > 0)
 #define PPM_PKTS_ENABLED()            (snort_conf->ppm_cfg->max_pkt_ticks > 0)
 #define PPM_RULES_ENABLED()           (snort_conf->ppm_cfg->max_rule_ticks > 0)
+#define PPM_LOAD_ENABLED()            (snort_conf->ppm_cfg->max_load_level > 0)
+
+// current load shedding level of this packet thread
+#define PPM_LOAD_LEVEL()              ppm_load_level
 
 // packet, rule event flags
 #define PPM_PACKET_ABORT_FLAG()       ppm_abort_this_pkt
@@ -307,6 +345,28 @@ void ppm_set_max_pkt_time(ppm_cfg_t*, PPM_USECS);
 void ppm_set_max_rule_time(ppm_cfg_t*, PPM_USECS);
 void ppm_set_max_suspend_time(ppm_cfg_t*, PPM_SECS);
 
+void ppm_set_max_load_level(ppm_cfg_t*, unsigned);
+void ppm_set_load_window(ppm_cfg_t*, unsigned msecs);
+void ppm_set_load_max_pkt_time(ppm_cfg_t*, PPM_USECS);
+void ppm_set_load_max_lag(ppm_cfg_t*, PPM_USECS);
+void ppm_set_load_max_drop(ppm_cfg_t*, double pct);
+void ppm_set_load_hold(ppm_cfg_t*, unsigned);
+void ppm_set_shallow_depth(ppm_cfg_t*, uint32_t);
+void ppm_set_elephant_bytes(ppm_cfg_t*, uint64_t);
+
+// the load controller brackets each wire packet and reevaluates the
+// level at the end of each window from the average packet time, the
+// capture to processing lag (live only), and the daq drop rate
+void ppm_load_begin();
+void ppm_load_end(const struct _daq_pkthdr*);
+
+// level >= PPM_LOAD_SHALLOW: cap the given depths at shallow_depth
+void ppm_load_shallow(int64_t& detect_depth, int64_t& file_depth);
+
+// level >= PPM_LOAD_BYPASS: true if p's flow is an elephant, which is
+// then bypassed with Stream::stop_inspection()
+bool ppm_load_bypass(Packet*);
+
 void ppm_print_cfg(ppm_cfg_t*);
 void ppm_print_summary(ppm_cfg_t*);
 void ppm_sum_stats();
@@ -63,6 +63,31 @@ static const Parameter s_params[] =
     { "rule_log", Parameter::PT_ENUM, "none|log|alert|both", "none",
       "enable event logging for suspended rules" },
 
+    { "max_load_level", Parameter::PT_INT, "0:4", "0",
+      "highest load shedding level: 1 = skip pcre, 2 = cap http and file depth, "
+      "3 = fast pattern rules only, 4 = bypass elephant flows, 0 = off" },
+
+    { "load_window", Parameter::PT_INT, "1:", "100",
+      "msecs between load shedding level checks" },
+
+    { "load_max_pkt_time", Parameter::PT_INT, "0:", "0",
+      "shed load if average packet time exceeds this (usec), 0 = ignore" },
+
+    { "load_max_lag", Parameter::PT_INT, "0:", "0",
+      "shed load if packets are processed this long after capture (usec), 0 = ignore" },
+
+    { "load_max_drops", Parameter::PT_REAL, "0:100", "0",
+      "shed load if this percentage of packets are dropped by the daq, 0 = ignore" },
+
+    { "load_hold", Parameter::PT_INT, "1:", "10",
+      "number of quiet windows before lowering the load shedding level" },
+
+    { "shallow_depth", Parameter::PT_INT, "0:65535", "2048",
+      "maximum http body and file depth when shedding load" },
+
+    { "elephant_bytes", Parameter::PT_INT, "1:", "1048576",
+      "flows larger than this are bypassed when shedding load" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -135,6 +160,30 @@ bool PpmModule::set(const char*, Value& v, SnortConfig* sc)
         if ( u & 0x2 )
             ppm_set_rule_log(sc->ppm_cfg, PPM_LOG_ALERT);
     }
+    else if ( v.is("max_load_level") )
+        ppm_set_max_load_level(sc->ppm_cfg, v.get_long());
+
+    else if ( v.is("load_window") )
+        ppm_set_load_window(sc->ppm_cfg, v.get_long());
+
+    else if ( v.is("load_max_pkt_time") )
+        ppm_set_load_max_pkt_time(sc->ppm_cfg, v.get_long());
+
+    else if ( v.is("load_max_lag") )
+        ppm_set_load_max_lag(sc->ppm_cfg, v.get_long());
+
+    else if ( v.is("load_max_drops") )
+        ppm_set_load_max_drop(sc->ppm_cfg, v.get_real());
+
+    else if ( v.is("load_hold") )
+        ppm_set_load_hold(sc->ppm_cfg, v.get_long());
+
+    else if ( v.is("shallow_depth") )
+        ppm_set_shallow_depth(sc->ppm_cfg, v.get_long());
+
+    else if ( v.is("elephant_bytes") )
+        ppm_set_elephant_bytes(sc->ppm_cfg, v.get_long());
+
     else
         return false;
 
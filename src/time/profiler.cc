@@ -25,12 +25,16 @@
 #endif
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include "detection/fp_detect.h"
@@ -54,7 +58,7 @@
 class ModStatsFunctor
 {
 public:
-    const ProfileStats* operator()(const std::string&);
+    ProfileStats* operator()(const std::string&);
 
     bool is_set() const
     { return type != NONE; }
@@ -93,11 +97,17 @@ public:
     void reset()
     { stats.reset(); totalled = false; }
 
-    const ProfileStats& get_total()
+    const ProfileStats& get_total() const
     { return stats; }
 
     void accumulate();
 
+    // accumulate and clear the thread's stats
+    void publish();
+
+    // clear the thread's stats
+    void discard();
+
     const std::string name;
     std::set<ModStatsNode*> children;
 
@@ -164,7 +174,24 @@ using RuleEntrySortFunc = std::function<bool(const RuleEntry&, const RuleEntry&)
 THREAD_LOCAL ProfileStats totalPerfStats;
 THREAD_LOCAL ProfileStats metaPerfStats;
 
+// true until the first packet so timing outside the packet loop
+// (and in unit tests) is unchanged
+THREAD_LOCAL bool profile_sampled = true;
+
 static ModStatsTree s_module_nodes;
+static std::mutex stats_mutex;
+
+// the shell asks the packet threads to publish or discard their module
+// stats by bumping the request; each thread answers once per request
+enum ProfileRequest { PR_PUBLISH, PR_RESET };
+
+static std::atomic<unsigned> s_sample_rate { 0 };
+static std::atomic<unsigned> s_request { 0 };
+static std::atomic<unsigned> s_request_type { PR_PUBLISH };
+static std::atomic<unsigned> s_answers { 0 };
+
+static THREAD_LOCAL unsigned t_request = 0;
+static THREAD_LOCAL unsigned t_count = 0;
 
 // -----------------------------------------------------------------------------
 // static functions
@@ -210,6 +237,14 @@ static void add_module(std::string name, const char* pname, T v)
     parent.add_child(&node);
 }
 
+static void show_sample_rate()
+{
+    unsigned rate = s_sample_rate;
+
+    if ( rate > 1 )
+        LogMessage("Sampled 1 in %u packets\n", rate);
+}
+
 static void get_mod_entries(ModEntry& parent, ModEntrySortFunc* sort_fn, int count)
 {
     std::vector<ModEntry> entries;
@@ -259,6 +294,8 @@ static void print_mod_entries(ModEntry& root, int count)
     else
         LogMessage("Module Profile Statistics (all)\n");
 
+    show_sample_rate();
+
     // print headers
     LogMessage("%*s%*s%*s%*s%*s%*s%*s%*s\n",
         4, "Num",
@@ -322,12 +359,6 @@ bool get_mod_sort_function(ProfileSort sort_mode, ModEntrySortFunc& sort_fn)
     return true;
 }
 
-static void consolidate_otn_states(OtnState* states)
-{
-    for ( unsigned i = 1; i < get_instance_max(); ++i )
-        states[0] += states[i];
-}
-
 static void sort_rule_stats(std::vector<RuleEntry>& entries, ProfileSort sort_mode)
 {
     RuleEntrySortFunc sort_fn;
@@ -376,21 +407,37 @@ static void sort_rule_stats(std::vector<RuleEntry>& entries, ProfileSort sort_mo
     std::sort(entries.begin(), entries.end(), sort_fn);
 }
 
+// the trees are summed into a copy instead of the otns so this can be
+// called while running and more than once
 static void get_rule_stats_entries(std::vector<RuleEntry>& entries)
 {
     assert(snort_conf);
 
-    detection_option_tree_update_otn_stats(snort_conf->detection_option_tree_hash_table);
+    OtnStatsMap sums;
+    detection_option_tree_sum_otn_stats(snort_conf->detection_option_tree_hash_table, sums);
 
     for ( SFGHASH_NODE* h = sfghash_findfirst(snort_conf->otn_map); h; h = sfghash_findnext(snort_conf->otn_map) )
     {
         OptTreeNode* otn = static_cast<OptTreeNode*>(h->data);
         assert(otn);
 
-        OtnState* states = otn->state;
-        OtnState& state = states[0];
+        OtnState state;
+        memset(&state, 0, sizeof(state));
 
-        consolidate_otn_states(states);
+        for ( unsigned i = 0; i < get_instance_max(); ++i )
+            state += otn->state[i];
+
+        auto it = sums.find(otn);
+
+        if ( it != sums.end() )
+        {
+            const OtnState& tree = it->second;
+            state.ticks += tree.ticks;
+            state.ticks_match += tree.ticks_match;
+            state.ticks_no_match += tree.ticks_no_match;
+            state.checks = std::max(state.checks, tree.checks);
+            state.ppm_disable_cnt += tree.ppm_disable_cnt;
+        }
 
         if ( !state.checks || !state.ticks )
             continue;
@@ -412,6 +459,8 @@ static void print_rule_stats(std::vector<RuleEntry>& entries, int num)
     else
         LogMessage("Rule Profile Statistics (all rules)\n");
 
+    show_sample_rate();
+
     // print headers
     LogMessage(
 #ifdef PPM_MGR
@@ -482,6 +531,87 @@ static void print_rule_stats(std::vector<RuleEntry>& entries, int num)
     }
 }
 
+// each line is the path from the root and the time spent in the last node
+// but not its children, which is what flamegraph.pl expects
+static void write_folded(FILE* f, const ModStatsNode& node, std::string stack)
+{
+    if ( !stack.empty() )
+        stack += ";";
+
+    stack += node.name;
+    uint64_t self = node.get_total().ticks;
+
+    for ( auto child : node.children )
+    {
+        uint64_t ticks = child->get_total().ticks;
+        self = (self > ticks) ? self - ticks : 0;
+        write_folded(f, *child, stack);
+    }
+
+    uint64_t usecs = uint64_t(double(self) / get_ticks_per_us());
+
+    if ( usecs )
+        fprintf(f, "%s " STDu64 "\n", stack.c_str(), usecs);
+}
+
+// the shell shows everything unless configured otherwise
+static ProfileConfig get_live_config(const ProfileConfig* pc)
+{
+    ProfileConfig config = *pc;
+
+    if ( !config.count )
+        config.count = -1;
+
+    return config;
+}
+
+// idle threads only answer when the daq returns so this gives up after a
+// second; returns the number of packet threads that answered
+static unsigned request(ProfileRequest type)
+{
+    s_request_type = type;
+    s_answers = 0;
+    ++s_request;
+
+    for ( unsigned i = 0; i < 100 and s_answers < get_instance_max(); ++i )
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    return s_answers;
+}
+
+static void show_module_stats(const ProfileConfig& config)
+{
+    if ( !config.count )
+        return;
+
+    ModStatsNode& root_node = s_module_nodes[TOTAL];
+    ModEntry root(&root_node, root_node.get_total());
+
+    ModEntrySortFunc sort_fn;
+    if ( get_mod_sort_function(config.sort, sort_fn) )
+        get_mod_entries(root, &sort_fn, config.count);
+
+    else
+        get_mod_entries(root, nullptr, config.count);
+
+    print_mod_entries(root, config.count);
+}
+
+static void show_rule_stats(const ProfileConfig& config)
+{
+    if ( !config.count )
+        return;
+
+    std::vector<RuleEntry> entries;
+    get_rule_stats_entries(entries);
+
+    if ( entries.empty() )
+        return;
+
+    sort_rule_stats(entries, config.sort);
+    print_rule_stats(entries, config.count);
+}
+
 // -----------------------------------------------------------------------------
 // class/struct implementation
 // -----------------------------------------------------------------------------
@@ -489,13 +619,13 @@ static void print_rule_stats(std::vector<RuleEntry>& entries, int num)
 void NodePerfProfiler::update(bool match)
 { stats.update(get_delta(), match); }
 
-const ProfileStats* ModStatsFunctor::operator()(const std::string& key)
+ProfileStats* ModStatsFunctor::operator()(const std::string& key)
 {
     assert(is_set());
 
     if ( type == MODULE )
     {
-        const auto *ps = owner->get_profile();
+        auto* ps = owner->get_profile();
         if ( ps )
             return ps;
 
@@ -524,6 +654,27 @@ void ModStatsNode::accumulate()
     }
 }
 
+void ModStatsNode::publish()
+{
+    if ( !is_set() )
+        return;
+
+    if ( auto* ps = getter(name) )
+    {
+        stats += *ps;
+        ps->reset();
+    }
+}
+
+void ModStatsNode::discard()
+{
+    if ( !is_set() )
+        return;
+
+    if ( auto* ps = getter(name) )
+        ps->reset();
+}
+
 ModEntry::ModEntry(ModStatsNode* node, const ProfileStats& caller_stats) :
         name(node->name), node(node), stats(node->get_total())
 {
@@ -583,36 +734,58 @@ void PerfProfilerManager::register_module(const char* name, const char* pname,
     get_profile_func getter)
 { add_module(name, pname, getter); }
 
+void PerfProfilerManager::init(SnortConfig* sc)
+{ s_sample_rate = sc->profile_sample; }
+
 // thread local
 void PerfProfilerManager::consolidate_stats()
 {
-    static std::mutex stats_mutex;
     std::lock_guard<std::mutex> lock(stats_mutex);
 
     for ( auto it = s_module_nodes.begin(); it != s_module_nodes.end(); ++it )
         it->second.accumulate();
 }
 
-void PerfProfilerManager::show_module_stats()
+void PerfProfilerManager::sample()
 {
-    const auto& config = *snort_conf->profile_modules;
+    service();
 
-    if ( !config.count )
-        return;
+    unsigned rate = s_sample_rate.load(std::memory_order_relaxed);
 
-    ModStatsNode& root_node = s_module_nodes[TOTAL];
-    ModEntry root(&root_node, root_node.get_total());
+    if ( rate and ++t_count >= rate )
+    {
+        t_count = 0;
+        profile_sampled = true;
+    }
+    else
+        profile_sampled = false;
+}
 
-    ModEntrySortFunc sort_fn;
-    if ( get_mod_sort_function(config.sort, sort_fn) )
-        get_mod_entries(root, &sort_fn, config.count);
+void PerfProfilerManager::service()
+{
+    unsigned req = s_request.load(std::memory_order_acquire);
 
-    else
-        get_mod_entries(root, nullptr, config.count);
+    if ( req == t_request )
+        return;
 
-    print_mod_entries(root, config.count);
+    t_request = req;
+    bool reset = (s_request_type == PR_RESET);
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    for ( auto it = s_module_nodes.begin(); it != s_module_nodes.end(); ++it )
+    {
+        if ( reset )
+            it->second.discard();
+        else
+            it->second.publish();
+    }
+    ++s_answers;
 }
 
+void PerfProfilerManager::show_module_stats()
+{ ::show_module_stats(*snort_conf->profile_modules); }
+
 void PerfProfilerManager::reset_module_stats()
 {
     for ( auto it = s_module_nodes.begin(); it != s_module_nodes.end(); ++it )
@@ -620,21 +793,7 @@ void PerfProfilerManager::reset_module_stats()
 }
 
 void PerfProfilerManager::show_rule_stats()
-{
-    const auto& config = *snort_conf->profile_rules;
-
-    if ( !config.count )
-        return;
-
-    std::vector<RuleEntry> entries;
-    get_rule_stats_entries(entries);
-
-    if ( entries.empty() )
-        return;
-
-    sort_rule_stats(entries, config.sort);
-    print_rule_stats(entries, config.count);
-}
+{ ::show_rule_stats(*snort_conf->profile_rules); }
 
 void PerfProfilerManager::reset_rule_stats()
 {
@@ -656,6 +815,7 @@ void PerfProfilerManager::reset_rule_stats()
             memset(&state, 0, sizeof(state));
         }
     }
+    detection_option_tree_reset_stats(snort_conf->detection_option_tree_hash_table);
 }
 
 void PerfProfilerManager::show_all_stats()
@@ -676,6 +836,45 @@ void PerfProfilerManager::reset_all_stats()
         reset_rule_stats();
 }
 
+void PerfProfilerManager::set_sample_rate(unsigned rate)
+{ s_sample_rate = rate; }
+
+unsigned PerfProfilerManager::get_sample_rate()
+{ return s_sample_rate; }
+
+void PerfProfilerManager::show_live_stats()
+{
+    unsigned n = request(PR_PUBLISH);
+    LogMessage("%u of %u packet threads answered\n", n, get_instance_max());
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    ::show_module_stats(get_live_config(snort_conf->profile_modules));
+    ::show_rule_stats(get_live_config(snort_conf->profile_rules));
+}
+
+void PerfProfilerManager::reset_live_stats()
+{
+    request(PR_RESET);
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    reset_module_stats();
+    reset_rule_stats();
+}
+
+bool PerfProfilerManager::write_folded(const char* file)
+{
+    FILE* f = fopen(file, "w");
+
+    if ( !f )
+        return false;
+
+    request(PR_PUBLISH);
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    ::write_folded(f, s_module_nodes[TOTAL], "");
+    return !fclose(f);
+}
+
 // -----------------------------------------------------------------------------
 // unit tests
 // -----------------------------------------------------------------------------
@@ -1006,6 +1205,96 @@ TEST_CASE( "node perf profiler", "[profiler]" )
     }
 }
 
+TEST_CASE( "unsampled perf profiler", "[profiler]" )
+{
+    ProfileStats stats = { 0, 0 };
+    profile_sampled = false;
+
+    SECTION( "perf profiler doesn't update stats" )
+    {
+        {
+            PerfProfiler prof(stats);
+            prof.pause();
+            prof.start();
+        }
+
+        CHECK_FALSE( stats );
+    }
+
+    SECTION( "node perf profiler doesn't update stats" )
+    {
+        dot_node_state_t node_stats;
+        memset(&node_stats, 0, sizeof(node_stats));
+
+        {
+            NodePerfProfiler prof(node_stats);
+            prof.stop(true);
+        }
+
+        CHECK( node_stats.ticks == 0 );
+        CHECK( node_stats.checks == 0 );
+    }
+
+    SECTION( "sampling is fixed at construction" )
+    {
+        {
+            PerfProfiler prof(stats);
+            profile_sampled = true;
+        }
+
+        CHECK_FALSE( stats );
+    }
+
+    profile_sampled = true;
+}
+
+TEST_CASE( "sample rate", "[profiler]" )
+{
+    unsigned sampled = 0;
+
+    SECTION( "off" )
+    {
+        PerfProfilerManager::set_sample_rate(0);
+
+        for ( unsigned i = 0; i < 10; ++i )
+        {
+            PerfProfilerManager::sample();
+            sampled += profile_sampled;
+        }
+
+        CHECK( sampled == 0 );
+    }
+
+    SECTION( "all" )
+    {
+        PerfProfilerManager::set_sample_rate(1);
+
+        for ( unsigned i = 0; i < 10; ++i )
+        {
+            PerfProfilerManager::sample();
+            sampled += profile_sampled;
+        }
+
+        CHECK( sampled == 10 );
+    }
+
+    SECTION( "1 in n" )
+    {
+        PerfProfilerManager::set_sample_rate(5);
+
+        for ( unsigned i = 0; i < 100; ++i )
+        {
+            PerfProfilerManager::sample();
+            sampled += profile_sampled;
+        }
+
+        CHECK( sampled == 20 );
+    }
+
+    PerfProfilerManager::set_sample_rate(0);
+    profile_sampled = true;
+}
+
 TEST_CASE( "perf profiler pause", "[profiler]" )
 {
     ProfilePauseObserver observer;
@@ -1223,6 +1512,58 @@ TEST_CASE( "mod entry", "[profiler]" )
     }
 }
 
+TEST_CASE( "folded stacks", "[profiler]" )
+{
+    static ProfileStats folded_stats[3];
+
+    auto get = [](const char* key) -> ProfileStats*
+    { return &folded_stats[*key - 'a']; };
+
+    uint64_t usec = uint64_t(get_ticks_per_us() * 1000.0);
+    folded_stats[0] = { 10 * usec, 1 };
+    folded_stats[1] = { 6 * usec, 1 };
+    folded_stats[2] = { 3 * usec, 1 };
+
+    ModStatsNode a("a"), b("b"), c("c");
+    a.set(+get);
+    b.set(+get);
+    c.set(+get);
+
+    a.add_child(&b);
+    b.add_child(&c);
+
+    a.accumulate();
+    b.accumulate();
+    c.accumulate();
+
+    FILE* f = tmpfile();
+    REQUIRE( f );
+
+    write_folded(f, a, "");
+    rewind(f);
+
+    std::set<std::string> lines;
+    char buf[64];
+
+    while ( fgets(buf, sizeof(buf), f) )
+    {
+        char* nl = strchr(buf, '\n');
+        if ( nl )
+            *nl = '\0';
+        lines.insert(buf);
+    }
+    fclose(f);
+
+    auto us = [](uint64_t ticks)
+    { return std::to_string(uint64_t(double(ticks) / get_ticks_per_us())); };
+
+    // self time is the node's time less its children's
+    CHECK( lines.size() == 3 );
+    CHECK( lines.count("a " + us(4 * usec)) );
+    CHECK( lines.count("a;b " + us(3 * usec)) );
+    CHECK( lines.count("a;b;c " + us(3 * usec)) );
+}
+
 TEST_CASE( "rule entry", "[profiler]" )
 {
 }
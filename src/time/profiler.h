@@ -33,6 +33,7 @@
 #include "time/cpuclock.h"
 
 class Module;
+struct SnortConfig;
 
 enum ProfileSort
 {
@@ -149,14 +150,21 @@ private:
     uint64_t ticks_start;
 };
 
+// profiling is built in but only the packets picked by
+// PerfProfilerManager::sample() are timed; the rest just test this flag
+extern SO_PUBLIC THREAD_LOCAL bool profile_sampled;
+
 class PerfProfilerBase
 {
 public:
-    PerfProfilerBase()
+    PerfProfilerBase() : sampled(profile_sampled)
     { start(); }
 
     void start()
-    { sw.start(); }
+    {
+        if ( sampled )
+            sw.start();
+    }
 
     void pause()
     { sw.stop(); }
@@ -168,6 +176,9 @@ public:
     uint64_t get_delta() const
     { return sw.get(); }
 
+protected:
+    const bool sampled;
+
 private:
     Stopwatch sw;
 };
@@ -187,7 +198,9 @@ public:
         if ( closed )
             return;
 
-        stats.update(get_delta());
+        if ( sampled )
+            stats.update(get_delta());
+
         closed = true;
     }
 
@@ -213,7 +226,9 @@ public:
         if ( closed )
             return;
 
-        update(match);
+        if ( sampled )
+            update(match);
+
         closed = true;
     }
 
@@ -298,9 +313,17 @@ public:
     static void register_module(const char*, const char*, Module*);
     static void register_module(const char*, const char*, get_profile_func);
 
+    static void init(SnortConfig*);
+
     // thread local
     static void consolidate_stats();
 
+    // packet thread; call before timing each packet
+    static void sample();
+
+    // packet thread; answers shell requests when not sampling
+    static void service();
+
     static void show_module_stats();
     static void reset_module_stats();
 
@@ -309,6 +332,16 @@ public:
 
     static void show_all_stats();
     static void reset_all_stats();
+
+    // main thread; collect stats from the packet threads while running
+    static void set_sample_rate(unsigned);
+    static unsigned get_sample_rate();
+
+    static void show_live_stats();
+    static void reset_live_stats();
+
+    // write the module tree as flame graph folded stacks (microseconds)
+    static bool write_folded(const char* file);
 };
 
 struct ProfileConfig
@@ -23,7 +23,10 @@
 #ifndef BITOP_H
 #define BITOP_H
 
-// A simple, dynamically sized bit vector implementation
+// A simple, dynamically sized bit vector implementation.  Storage is
+// allocated on the first write so that idle instances cost only the
+// object itself.  Bits are kept in 64 bit words so that masks (eg
+// flowbits groups) can be applied a word at a time.
 
 #include <assert.h>
 #include <stdlib.h>
@@ -35,43 +38,63 @@
 class BitOp
 {
 public:
-    BitOp(unsigned int len)
+    BitOp(unsigned int bits)
     {
-        assert(len);
+        assert(bits);
 
-        bit_buf = (uint8_t*)SnortAlloc(len);
-
-        buf_size = (unsigned int)len;
-        max_bits = (unsigned int)(len << 3);
+        num_words = (bits + 63) >> 6;
+        max_bits = num_words << 6;
+        words = nullptr;
     }
 
     ~BitOp()
     {
-        free(bit_buf);
+        free(words);
     }
 
     void reset();
     void set(unsigned int bit);
-    bool is_set(unsigned int bit);
+    bool is_set(unsigned int bit) const;
     void clear(unsigned int bit);
 
-    unsigned int get_max_bits()
+    // word-wise mask operations; masks may be sized differently than
+    // this vector, bits outside of this vector are never set
+    void set(const BitOp& mask);
+    void clear(const BitOp& mask);
+    void toggle(const BitOp& mask);
+
+    bool is_set_all(const BitOp& mask) const;
+    bool is_set_any(const BitOp& mask) const;
+    bool is_clear() const;
+
+    unsigned int get_max_bits() const
     { return max_bits; }
 
-    //FIXIT-L This should be eliminated and better encapsulated.
-    uint8_t& operator[](unsigned int pos)
-    { if ( pos > buf_size) pos = 0; return bit_buf[pos]; }
+private:
+    uint64_t* get_words()
+    {
+        if ( !words )
+            words = (uint64_t*)SnortAlloc(num_words * sizeof(*words));
+        return words;
+    }
+
+    static unsigned min_words(const BitOp& a, const BitOp& b)
+    { return a.num_words < b.num_words ? a.num_words : b.num_words; }
+
+    static uint64_t mask_of(unsigned int bit)
+    { return (uint64_t)1 << (bit & 63); }
 
 private:
-    uint8_t* bit_buf;
-    unsigned int buf_size;
+    uint64_t* words;
+    unsigned int num_words;
     unsigned int max_bits;
 };
 
 // Reset the bit buffer so that it can be reused
 inline void BitOp::reset()
 {
-    memset(bit_buf, 0, buf_size);
+    if ( words )
+        memset(words, 0, num_words * sizeof(*words));
 }
 
 // Set the bit in the specified position within the bit buffer.
@@ -82,20 +105,21 @@ inline void BitOp::set(unsigned int bit)
         assert(false);
         return;
     }
-    uint8_t mask = (uint8_t)(0x80 >> (bit & 7));
-    bit_buf[bit >> 3] |= mask;
+    get_words()[bit >> 6] |= mask_of(bit);
 }
 
 // Checks if the bit at the specified position is set
-inline bool BitOp::is_set(unsigned int bit)
+inline bool BitOp::is_set(unsigned int bit) const
 {
     if ( max_bits <= bit )
     {
         assert(false);
         return false;
     }
-    uint8_t mask = (uint8_t)(0x80 >> (bit & 7));
-    return (mask & bit_buf[bit >> 3]);
+    if ( !words )
+        return false;
+
+    return (words[bit >> 6] & mask_of(bit)) != 0;
 }
 
 // Clear the bit in the specified position within the bit buffer.
@@ -106,9 +130,99 @@ inline void BitOp::clear(unsigned int bit)
         assert(false);
         return;
     }
-    uint8_t mask = (uint8_t)(0x80 >> (bit & 7));
-    bit_buf[bit >> 3] &= ~mask;
+    if ( words )
+        words[bit >> 6] &= ~mask_of(bit);
 }
 
-#endif
+// Set all bits that are set in mask.
+inline void BitOp::set(const BitOp& mask)
+{
+    if ( !mask.words )
+        return;
+
+    uint64_t* w = get_words();
+    unsigned n = min_words(*this, mask);
 
+    for ( unsigned i = 0; i < n; ++i )
+        w[i] |= mask.words[i];
+}
+
+// Clear all bits that are set in mask.
+inline void BitOp::clear(const BitOp& mask)
+{
+    if ( !words or !mask.words )
+        return;
+
+    unsigned n = min_words(*this, mask);
+
+    for ( unsigned i = 0; i < n; ++i )
+        words[i] &= ~mask.words[i];
+}
+
+// Flip all bits that are set in mask.
+inline void BitOp::toggle(const BitOp& mask)
+{
+    if ( !mask.words )
+        return;
+
+    uint64_t* w = get_words();
+    unsigned n = min_words(*this, mask);
+
+    for ( unsigned i = 0; i < n; ++i )
+        w[i] ^= mask.words[i];
+}
+
+// True if every bit set in mask is also set here.
+inline bool BitOp::is_set_all(const BitOp& mask) const
+{
+    if ( !mask.words )
+        return true;
+
+    unsigned n = min_words(*this, mask);
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        uint64_t w = words ? words[i] : 0;
+
+        if ( (w & mask.words[i]) != mask.words[i] )
+            return false;
+    }
+    for ( unsigned i = n; i < mask.num_words; ++i )
+    {
+        if ( mask.words[i] )
+            return false;
+    }
+    return true;
+}
+
+// True if any bit set in mask is also set here.
+inline bool BitOp::is_set_any(const BitOp& mask) const
+{
+    if ( !words or !mask.words )
+        return false;
+
+    unsigned n = min_words(*this, mask);
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        if ( words[i] & mask.words[i] )
+            return true;
+    }
+    return false;
+}
+
+// True if no bits are set.
+inline bool BitOp::is_clear() const
+{
+    if ( !words )
+        return true;
+
+    for ( unsigned i = 0; i < num_words; ++i )
+    {
+        if ( words[i] )
+            return false;
+    }
+    return true;
+}
+
+#endif
@@ -182,6 +182,8 @@ struct DAQStats
     PegCount skipped;
     PegCount fail_open;
     PegCount idle;
+    PegCount responses_queued;
+    PegCount responses_sent;
 };
 
 //-------------------------------------------------------------------------
@@ -209,6 +211,8 @@ const PegInfo daq_names[] =
     { "skipped", "packets skipped at startup" },
     { "fail open", "packets passed during initialization" },
     { "idle", "attempts to acquire from DAQ without available packets" },
+    { "responses queued", "active responses queued for injection" },
+    { "responses sent", "queued active responses injected" },
     { nullptr, nullptr }
 };
 
@@ -233,6 +237,10 @@ const PegInfo pc_names[] =
     { "log limit", "events queued but not logged" },
     { "event limit", "events filtered" },
     { "alert limit", "events previously triggered on same PDU" },
+    { "session tags", "sessions tagged" },
+    { "host tags", "hosts tagged" },
+    { "tag memory", "peak bytes of tag memory summed over packet threads" },
+    { "tag faults", "times the tag memcap was reached" },
     { nullptr, nullptr }
 };
 
@@ -299,6 +307,8 @@ static void get_daq_stats(DAQStats& daq_stats)
     daq_stats.skipped = snort_conf->pkt_skip;
     daq_stats.fail_open = gaux.total_fail_open;
     daq_stats.idle = gaux.idle;
+    daq_stats.responses_queued = gaux.responses_queued;
+    daq_stats.responses_sent = gaux.responses_sent;
 }
 
 void DropStats()
@@ -56,6 +56,10 @@ struct PacketCount
     PegCount log_limit;
     PegCount event_limit;
     PegCount alert_limit;
+    PegCount tag_sessions;
+    PegCount tag_hosts;
+    PegCount tag_memory;
+    PegCount tag_faults;
 };
 
 struct ProcessCount
@@ -74,6 +78,8 @@ struct AuxCount
     PegCount internal_whitelist;
     PegCount total_fail_open;
     PegCount idle;
+    PegCount responses_queued;
+    PegCount responses_sent;
 };
 
 extern ProcessCount proc_stats;
@@ -0,0 +1,429 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2015-2015 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// col_reader.cc
+
+// streaming reader for columnar event logs.  segments are skipped using
+// the index (or segment headers if the file was not closed cleanly) and
+// only the filter columns are examined until a row matches.
+
+#include "loggers/columnar_common.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char* actions[] = { "allow", "cant_drop", "would_drop", "drop" };
+
+struct Filter
+{
+    bool gid, sid, after, before, addr;
+    uint32_t gid_val, sid_val;
+    uint32_t after_val, before_val;
+    uint8_t addr_val[16];
+    bool packets;
+};
+
+static Filter filter;
+
+//-------------------------------------------------------------------------
+// segment processing
+//-------------------------------------------------------------------------
+
+struct Segment
+{
+    ColSegmentHeader hdr;
+    ColDirEntry dir[COL_MAX];
+    vector<uint64_t> buf;  // keeps column data 8 byte aligned
+
+    const uint8_t* col(unsigned id) const
+    { return (const uint8_t*)&buf[0] + dir[id].offset; }
+
+    uint32_t u32(unsigned id, unsigned n) const
+    { return ((const uint32_t*)col(id))[n]; }
+};
+
+static bool skip_segment(uint32_t min_sec, uint32_t max_sec, uint32_t min_sid, uint32_t max_sid)
+{
+    if ( filter.after and max_sec < filter.after_val )
+        return true;
+
+    if ( filter.before and min_sec > filter.before_val )
+        return true;
+
+    if ( filter.sid and (filter.sid_val < min_sid or filter.sid_val > max_sid) )
+        return true;
+
+    return false;
+}
+
+static bool load_segment(FILE* f, Segment& s)
+{
+    if ( fread(&s.hdr, sizeof(s.hdr), 1, f) != 1 or s.hdr.magic != COL_SEG_MAGIC )
+        return false;
+
+    unsigned dir_len = s.hdr.columns * sizeof(ColDirEntry);
+
+    if ( s.hdr.columns < COL_MAX or dir_len > s.hdr.length )
+    {
+        fprintf(stderr, "ERROR: bad segment directory\n");
+        return false;
+    }
+    if ( fread(s.dir, sizeof(s.dir), 1, f) != 1 )
+        return false;
+
+    // skip any columns added by later versions
+    if ( s.hdr.columns > COL_MAX )
+        fseek(f, dir_len - sizeof(s.dir), SEEK_CUR);
+
+    unsigned len = s.hdr.length - dir_len;
+    s.buf.resize((len + 7) / 8 + 1);
+
+    if ( len and fread(&s.buf[0], len, 1, f) != 1 )
+        return false;
+
+    for ( unsigned i = 0; i < COL_MAX; ++i )
+    {
+        if ( s.dir[i].id != i or s.dir[i].offset + s.dir[i].length > len or
+            (col_width[i] and s.dir[i].length < col_width[i] * s.hdr.events) )
+        {
+            fprintf(stderr, "ERROR: bad column %u\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_addr(const uint8_t* a)
+{
+    static const uint8_t v4[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+    char buf[INET6_ADDRSTRLEN];
+
+    if ( !memcmp(a, v4, sizeof(v4)) )
+        inet_ntop(AF_INET, a + 12, buf, sizeof(buf));
+    else
+        inet_ntop(AF_INET6, a, buf, sizeof(buf));
+
+    printf("%s", buf);
+}
+
+static void print_packet(FILE* pf, uint64_t off)
+{
+    ColPacketHeader ph;
+
+    if ( !pf or off == COL_NO_PACKET or fseeko(pf, off, SEEK_SET) or
+        fread(&ph, sizeof(ph), 1, pf) != 1 )
+        return;
+
+    printf("    packet %u bytes captured of %u\n", ph.caplen, ph.pktlen);
+
+    for ( unsigned i = 0; i < ph.caplen; ++i )
+    {
+        int c = fgetc(pf);
+
+        if ( c == EOF )
+            break;
+
+        printf("%s%02x", (i % 16) ? " " : "    ", c);
+
+        if ( (i % 16) == 15 or i + 1 == ph.caplen )
+            printf("\n");
+    }
+}
+
+static unsigned print_segment(const Segment& s, FILE* pf)
+{
+    const unsigned n = s.hdr.events;
+
+    // evaluate filters column at a time; rows are only decoded for
+    // output once they survive all filters
+    vector<uint8_t> match(n, 1);
+
+    if ( filter.sid )
+        for ( unsigned i = 0; i < n; ++i )
+            match[i] &= s.u32(COL_SID, i) == filter.sid_val;
+
+    if ( filter.gid )
+        for ( unsigned i = 0; i < n; ++i )
+            match[i] &= s.u32(COL_GID, i) == filter.gid_val;
+
+    if ( filter.after )
+        for ( unsigned i = 0; i < n; ++i )
+            match[i] &= s.u32(COL_TS_SEC, i) >= filter.after_val;
+
+    if ( filter.before )
+        for ( unsigned i = 0; i < n; ++i )
+            match[i] &= s.u32(COL_TS_SEC, i) <= filter.before_val;
+
+    if ( filter.addr )
+    {
+        const uint8_t* src = s.col(COL_SRC_ADDR);
+        const uint8_t* dst = s.col(COL_DST_ADDR);
+
+        for ( unsigned i = 0; i < n; ++i )
+            match[i] &= !memcmp(src + 16*i, filter.addr_val, 16) or
+                !memcmp(dst + 16*i, filter.addr_val, 16);
+    }
+
+    // message offsets are only needed if something is printed
+    vector<const char*> msgs;
+    unsigned hits = 0;
+
+    for ( unsigned i = 0; i < n; ++i )
+    {
+        if ( !match[i] )
+            continue;
+
+        if ( msgs.empty() )
+        {
+            const uint8_t* d = s.col(COL_MSG_DICT);
+            const char* end = (const char*)d + s.dir[COL_MSG_DICT].length;
+            uint32_t count;
+            memcpy(&count, d, sizeof(count));
+
+            const char* m = (const char*)d + sizeof(count);
+
+            while ( count-- and m < end )
+            {
+                msgs.push_back(m);
+                m += strnlen(m, end - m) + 1;
+            }
+        }
+        uint32_t mid = s.u32(COL_MSG, i);
+        uint8_t act = s.col(COL_ACTION)[i];
+
+        printf("%u.%06u [%u:%u:%u] \"%s\" [C:%u] [P:%u] %s {%u} ",
+            s.u32(COL_TS_SEC, i), s.u32(COL_TS_USEC, i),
+            s.u32(COL_GID, i), s.u32(COL_SID, i), s.u32(COL_REV, i),
+            mid < msgs.size() ? msgs[mid] : "",
+            s.u32(COL_CLASS, i), s.u32(COL_PRIORITY, i),
+            act < sizeof(actions)/sizeof(actions[0]) ? actions[act] : "?",
+            s.col(COL_PROTO)[i]);
+
+        print_addr(s.col(COL_SRC_ADDR) + 16*i);
+        printf(":%u -> ", ((const uint16_t*)s.col(COL_SRC_PORT))[i]);
+        print_addr(s.col(COL_DST_ADDR) + 16*i);
+        printf(":%u\n", ((const uint16_t*)s.col(COL_DST_PORT))[i]);
+
+        if ( filter.packets )
+            print_packet(pf, ((const uint64_t*)s.col(COL_PKT_OFF))[i]);
+
+        ++hits;
+    }
+    return hits;
+}
+
+//-------------------------------------------------------------------------
+// file processing
+//-------------------------------------------------------------------------
+
+static bool read_index(FILE* f, vector<ColIndexEntry>& index)
+{
+    ColFileTrailer ft;
+
+    if ( fseeko(f, -(off_t)sizeof(ft), SEEK_END) or fread(&ft, sizeof(ft), 1, f) != 1 or
+        ft.magic != COL_IDX_MAGIC )
+        return false;
+
+    index.resize(ft.segments);
+
+    if ( !ft.segments or fseeko(f, ft.index_offset, SEEK_SET) or
+        fread(&index[0], sizeof(index[0]), ft.segments, f) != ft.segments )
+        return false;
+
+    return true;
+}
+
+static int dump(const char* file)
+{
+    FILE* f = fopen(file, "rb");
+
+    if ( !f )
+    {
+        fprintf(stderr, "ERROR: can't open %s: %s\n", file, strerror(errno));
+        return 1;
+    }
+
+    ColFileHeader fh;
+
+    if ( fread(&fh, sizeof(fh), 1, f) != 1 or fh.magic != COL_MAGIC )
+    {
+        fprintf(stderr, "ERROR: %s is not a columnar event log\n", file);
+        fclose(f);
+        return 1;
+    }
+    if ( fh.byte_order != COL_BYTE_ORDER or fh.version != COL_VERSION )
+    {
+        fprintf(stderr, "ERROR: %s has unsupported byte order or version\n", file);
+        fclose(f);
+        return 1;
+    }
+
+    FILE* pf = nullptr;
+
+    if ( filter.packets and (fh.flags & COL_FLAG_PACKETS) )
+    {
+        std::string pkt_file = file;
+        pkt_file += ".pkt";
+
+        if ( !(pf = fopen(pkt_file.c_str(), "rb")) )
+            fprintf(stderr, "WARNING: can't open %s: %s\n", pkt_file.c_str(), strerror(errno));
+    }
+
+    vector<ColIndexEntry> index;
+    Segment seg;
+    unsigned segs = 0, skipped = 0, hits = 0;
+
+    if ( read_index(f, index) )
+    {
+        for ( auto& ie : index )
+        {
+            if ( skip_segment(ie.min_sec, ie.max_sec, ie.min_sid, ie.max_sid) )
+            {
+                ++skipped;
+                continue;
+            }
+            if ( fseeko(f, ie.offset, SEEK_SET) or !load_segment(f, seg) )
+                break;
+
+            hits += print_segment(seg, pf);
+            ++segs;
+        }
+    }
+    else
+    {
+        // no index so walk the segment headers; a partial segment at the
+        // end of a live file ends the walk
+        off_t off = sizeof(fh);
+        ColSegmentHeader sh;
+
+        while ( !fseeko(f, off, SEEK_SET) and fread(&sh, sizeof(sh), 1, f) == 1 and
+            sh.magic == COL_SEG_MAGIC )
+        {
+            off += sizeof(sh) + sh.length;
+
+            if ( skip_segment(sh.min_sec, sh.max_sec, sh.min_sid, sh.max_sid) )
+            {
+                ++skipped;
+                continue;
+            }
+            if ( fseeko(f, -(off_t)sizeof(sh), SEEK_CUR) or !load_segment(f, seg) )
+                break;
+
+            hits += print_segment(seg, pf);
+            ++segs;
+        }
+    }
+    fprintf(stderr, "%s: %u events matched in %u segments read, %u skipped\n",
+        file, hits, segs, skipped);
+
+    if ( pf )
+        fclose(pf);
+
+    fclose(f);
+    return 0;
+}
+
+static void usage()
+{
+    puts("usage: col_reader [options] <file>...");
+    puts("    -g <gid>     only events with this generator id");
+    puts("    -s <sid>     only events with this signature id");
+    puts("    -a <secs>    only events at or after this unix time");
+    puts("    -b <secs>    only events at or before this unix time");
+    puts("    -i <ip>      only events with this source or destination address");
+    puts("    -p           dump packets from the side file");
+}
+
+static bool get_addr(const char* s, uint8_t* a)
+{
+    if ( inet_pton(AF_INET6, s, a) == 1 )
+        return true;
+
+    memset(a, 0, 10);
+    a[10] = a[11] = 0xff;
+    return inet_pton(AF_INET, s, a + 12) == 1;
+}
+
+int main(int argc, char** argv)
+{
+    int c;
+
+    while ( (c = getopt(argc, argv, "g:s:a:b:i:ph")) != -1 )
+    {
+        switch ( c )
+        {
+        case 'g':
+            filter.gid = true;
+            filter.gid_val = strtoul(optarg, nullptr, 0);
+            break;
+        case 's':
+            filter.sid = true;
+            filter.sid_val = strtoul(optarg, nullptr, 0);
+            break;
+        case 'a':
+            filter.after = true;
+            filter.after_val = strtoul(optarg, nullptr, 0);
+            break;
+        case 'b':
+            filter.before = true;
+            filter.before_val = strtoul(optarg, nullptr, 0);
+            break;
+        case 'i':
+            if ( !get_addr(optarg, filter.addr_val) )
+            {
+                fprintf(stderr, "ERROR: bad address %s\n", optarg);
+                return 1;
+            }
+            filter.addr = true;
+            break;
+        case 'p':
+            filter.packets = true;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if ( optind >= argc )
+    {
+        usage();
+        return 1;
+    }
+    int ret = 0;
+
+    for ( int i = optind; i < argc; ++i )
+        ret |= dump(argv[i]);
+
+    return ret;
+}
+